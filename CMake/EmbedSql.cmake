@@ -0,0 +1,40 @@
+# Generates C source with bootstrap and migration SQL scripts embedded as NUL-terminated strings.
+#
+# Expected definitions:
+#   OUTPUT     - generated source file
+#   BOOTSTRAP  - script creating schema of the latest version from scratch
+#   MIGRATIONS - scripts upgrading schema by one version each, in order, named after version they upgrade to
+#                (e.g. 2.sql)
+
+function(embed_sql_file _file _name _result)
+    file(READ "${_file}" _hex HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," _bytes "${_hex}")
+    string(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)"
+        "\\1\n    " _bytes "${_bytes}")
+    set(${_result} "static char const ${_name}[] =\n{\n    ${_bytes}0x00\n};\n\n" PARENT_SCOPE)
+endfunction()
+
+set(_source "// generated from SQL scripts by EmbedSql.cmake, do not edit\n\n")
+set(_source "${_source}#include \"private/util/database_sql.h\"\n\n#include <stddef.h>\n\n")
+
+embed_sql_file("${BOOTSTRAP}" "s_bootstrap_sql" _array)
+set(_source "${_source}${_array}")
+
+set(_versions)
+foreach(_migration ${MIGRATIONS})
+    get_filename_component(_version "${_migration}" NAME_WE)
+    embed_sql_file("${_migration}" "s_migration_${_version}_sql" _array)
+    set(_source "${_source}${_array}")
+    list(APPEND _versions ${_version})
+endforeach()
+
+set(_source "${_source}char const* const pddby_db_bootstrap_sql = s_bootstrap_sql;\n\n")
+set(_source "${_source}pddby_db_migration_t const pddby_db_migrations[] =\n{\n")
+foreach(_version ${_versions})
+    set(_source "${_source}    {${_version}, s_migration_${_version}_sql},\n")
+endforeach()
+set(_source "${_source}    {0, NULL}\n};\n")
+
+file(WRITE "${OUTPUT}.tmp" "${_source}")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
@@ -0,0 +1,233 @@
+#include "pddby/answer.h"
+#include "pddby/pddby.h"
+#include "pddby/question.h"
+#include "pddby/topic.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// tickets every thread reads in one run, each with its answers, plus a random one every tenth ticket
+#define PDDBY_BENCH_DEFAULT_TICKETS 2000
+
+struct pddby_bench_thread
+{
+    pthread_t thread;
+    pddby_t* pddby;
+    int first_ticket;
+    int ticket_count;
+    int64_t question_count;
+    int failed;
+};
+
+static void on_message(pddby_t* pddby, int type, char const* text)
+{
+    (void)pddby;
+
+    if (type >= pddby_message_type_warning)
+    {
+        fprintf(stderr, "%s\n", text);
+    }
+}
+
+static int64_t pddby_bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int pddby_bench_read_questions(pddby_t* pddby, pddby_questions_t* questions, int64_t* question_count)
+{
+    if (!questions)
+    {
+        return 0;
+    }
+
+    int result = 1;
+    for (size_t i = 0; i < pddby_array_size(questions); i++)
+    {
+        pddby_question_t const* question = pddby_array_index(questions, i);
+        pddby_answers_t* answers = pddby_answers_find_by_question(pddby, question->id);
+        if (!answers)
+        {
+            result = 0;
+            break;
+        }
+        pddby_answers_free(answers);
+        (*question_count)++;
+    }
+
+    pddby_questions_free(questions);
+    return result;
+}
+
+static void* pddby_bench_thread_main(void* arg)
+{
+    struct pddby_bench_thread* thread = arg;
+
+    for (int i = 0; i < thread->ticket_count && !thread->failed; i++)
+    {
+        // ticket numbers past the ones laid out by decode wrap around, so any number will do
+        thread->failed = !pddby_bench_read_questions(thread->pddby, pddby_questions_find_by_ticket(thread->pddby,
+            thread->first_ticket + i % 100), &thread->question_count);
+        if (!thread->failed && i % 10 == 0)
+        {
+            thread->failed = !pddby_bench_read_questions(thread->pddby, pddby_questions_find_random(thread->pddby),
+                &thread->question_count);
+        }
+    }
+
+    return NULL;
+}
+
+// questions read per second by thread_count threads spread over handles
+static double pddby_bench_run(pddby_t** handles, int handle_count, int thread_count, int ticket_count)
+{
+    struct pddby_bench_thread* threads = calloc(thread_count, sizeof(struct pddby_bench_thread));
+    if (!threads)
+    {
+        return -1;
+    }
+
+    int64_t const start_time = pddby_bench_now();
+
+    int started_count = 0;
+    for (; started_count < thread_count; started_count++)
+    {
+        struct pddby_bench_thread* thread = &threads[started_count];
+        thread->pddby = handles[started_count % handle_count];
+        thread->first_ticket = started_count + 1;
+        thread->ticket_count = ticket_count;
+        if (pthread_create(&thread->thread, NULL, &pddby_bench_thread_main, thread) != 0)
+        {
+            break;
+        }
+    }
+
+    int64_t question_count = 0;
+    int failed = started_count < thread_count;
+    for (int i = 0; i < started_count; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+        question_count += threads[i].question_count;
+        failed |= threads[i].failed;
+    }
+
+    int64_t const elapsed_time = pddby_bench_now() - start_time;
+
+    free(threads);
+
+    return failed ? -1 : question_count * 1e9 / (elapsed_time ? elapsed_time : 1);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s cache_dir [max_threads [handles [tickets]]]\n"
+            "  reads tickets from complete cache in cache_dir with 1, 2, 4, ... max_threads threads, spread over\n"
+            "  given number of handles (0 for a handle per thread)\n", argv[0]);
+        return 1;
+    }
+
+    int const max_thread_count = argc > 2 ? atoi(argv[2]) : 4;
+    int const handle_count_arg = argc > 3 ? atoi(argv[3]) : 1;
+    int const ticket_count = argc > 4 ? atoi(argv[4]) : PDDBY_BENCH_DEFAULT_TICKETS;
+    int const handle_count = handle_count_arg > 0 ? handle_count_arg : max_thread_count;
+    if (max_thread_count < 1 || handle_count_arg < 0 || ticket_count < 1)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return 1;
+    }
+
+    pddby_callbacks_t callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.message = &on_message;
+
+    pddby_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.cache_dir = argv[1];
+    options.log_level = pddby_message_type_warning;
+    options.callbacks = &callbacks;
+
+    pddby_t** handles = calloc(handle_count, sizeof(pddby_t*));
+    if (!handles)
+    {
+        return 1;
+    }
+
+    int result = 0;
+    for (int i = 0; i < handle_count; i++)
+    {
+        handles[i] = pddby_init_with_options(&options);
+        if (!handles[i])
+        {
+            result = 1;
+            break;
+        }
+
+        pddby_use_cache(handles[i], 1);
+        if (!pddby_cache_exists(handles[i]))
+        {
+            fprintf(stderr, "no decoded cache in %s\n", argv[1]);
+            result = 1;
+            break;
+        }
+
+        // other threads may only read through handle once its own thread has queried the cache
+        pddby_topics_t* topics = pddby_topics_find_all(handles[i]);
+        if (!topics)
+        {
+            result = 1;
+            break;
+        }
+        pddby_topics_free(topics);
+    }
+
+    if (result == 0)
+    {
+        printf("%-8s %-8s %14s %8s\n", "threads", "handles", "questions/s", "speedup");
+
+        double single_rate = 0;
+        for (int thread_count = 1; ; thread_count = thread_count * 2 < max_thread_count ? thread_count * 2 :
+            max_thread_count)
+        {
+            // with no handle count given every thread gets a handle of its own
+            int const run_handle_count = handle_count < thread_count ? handle_count : thread_count;
+            double const rate = pddby_bench_run(handles, run_handle_count, thread_count, ticket_count);
+            if (rate < 0)
+            {
+                fprintf(stderr, "run with %d thread(s) failed\n", thread_count);
+                result = 1;
+                break;
+            }
+
+            if (thread_count == 1)
+            {
+                single_rate = rate;
+            }
+            printf("%-8d %-8d %14.0f %8.2f\n", thread_count, run_handle_count, rate,
+                single_rate > 0 ? rate / single_rate : 0);
+
+            if (thread_count == max_thread_count)
+            {
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < handle_count; i++)
+    {
+        if (handles[i])
+        {
+            pddby_close(handles[i]);
+        }
+    }
+    free(handles);
+
+    return result;
+}
@@ -1,6 +1,7 @@
 #include "chooser_dialog.h"
 #include "config.h"
 #include "pddby/section.h"
+#include "pddby/stats.h"
 #include "pddby/topic.h"
 #include "platform.h"
 #include "settings.h"
@@ -77,35 +78,47 @@ gint64 chooser_dialog_get_id(GtkWidget *dialog)
     return g_value_get_int64(&id);
 }
 
-static void add_section_to_model(pddby_section_t *section, GtkListStore *model)
+static void add_section_to_model(pddby_section_t *section, pddby_stats_t *stats, GtkListStore *model)
 {
+    pddby_stat_t const *stat = pddby_stats_find(stats, pddby_stat_kind_section, section->id);
     GtkTreeIter iter;
     gtk_list_store_append(model, &iter);
     gtk_list_store_set(model, &iter, 0, section->id, 1, section->name, 2, section->title_prefix, 3, section->title, 4,
-        pddby_section_get_question_count(section), -1);
+        stat ? (gint)stat->question_count : 0, -1);
 }
 
 GtkListStore *sections_model_new(pddby_t* pddby)
 {
     GtkListStore *model = gtk_list_store_new(5, G_TYPE_INT64, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT);
     pddby_sections_t *sections = pddby_sections_find_all(pddby);
-    pddby_array_foreach(sections, (GFunc)add_section_to_model, model);
+    pddby_stats_t *stats = pddby_stats_find_all(pddby);
+    for (size_t i = 0, size = pddby_array_size(sections); i < size; i++)
+    {
+        add_section_to_model(pddby_array_index(sections, i), stats, model);
+    }
+    pddby_stats_free(stats);
     pddby_sections_free(sections);
     return model;
 }
 
-static void add_topic_to_model(pddby_topic_t *topic, GtkListStore *model)
+static void add_topic_to_model(pddby_topic_t *topic, pddby_stats_t *stats, GtkListStore *model)
 {
+    pddby_stat_t const *stat = pddby_stats_find(stats, pddby_stat_kind_topic, topic->id);
     GtkTreeIter iter;
     gtk_list_store_append(model, &iter);
-    gtk_list_store_set(model, &iter, 0, topic->id, 1, topic->title, 2, (pddby_topic_get_question_count(topic) + 9) / 10, -1);
+    gtk_list_store_set(model, &iter, 0, topic->id, 1, topic->title, 2, stat ? (gint)stat->ticket_count : 0, -1);
 }
 
 GtkListStore *topics_model_new(pddby_t* pddby)
 {
     GtkListStore *model = gtk_list_store_new(3, G_TYPE_INT64, G_TYPE_STRING, G_TYPE_INT);
     pddby_topics_t *topics = pddby_topics_find_all(pddby);
-    pddby_array_foreach(topics, (GFunc)add_topic_to_model, model);
+    pddby_stats_t *stats = pddby_stats_find_all(pddby);
+    for (size_t i = 0, size = pddby_array_size(topics); i < size; i++)
+    {
+        add_topic_to_model(pddby_array_index(topics, i), stats, model);
+    }
+    pddby_stats_free(stats);
     pddby_topics_free(topics);
     return model;
 }
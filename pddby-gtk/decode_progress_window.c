@@ -4,17 +4,22 @@
 
 static GtkWidget *gs_decode_progress_window = NULL;
 
+// older lines are dropped from log view past this many
+static gint const gs_log_max_rows = 500;
+
 static void on_message(pddby_t* pddby, int type, char const* text);
 static void on_progress_begin(pddby_t* pddby, int size);
 static void on_progress(pddby_t* pddby, int pos);
 static void on_progress_end(pddby_t* pddby);
+static void on_progress_ex(pddby_t* pddby, pddby_progress_t const* progress);
 
 static pddby_callbacks_t const gs_callbacks =
 {
     &on_message,
     &on_progress_begin,
     &on_progress,
-    &on_progress_end
+    &on_progress_end,
+    &on_progress_ex
 };
 
 GtkWidget* decode_progress_window_new()
@@ -31,6 +36,8 @@ GtkWidget* decode_progress_window_new()
 
     gtk_builder_connect_signals(builder, NULL);
     gs_decode_progress_window = GTK_WIDGET(gtk_builder_get_object(builder, "decode_progress_window"));
+    g_signal_connect(gs_decode_progress_window, "destroy", G_CALLBACK(gtk_widget_destroyed),
+        &gs_decode_progress_window);
 
     GtkTreeView* tv_log = GTK_TREE_VIEW(gtk_builder_get_object(builder, "tv_log"));
 
@@ -88,16 +95,19 @@ static void on_message(G_GNUC_UNUSED pddby_t* pddby, int type, char const* text)
     }
     gtk_list_store_set(ls_log, &iter, 0, type_text, 1, text, -1);
 
+    gint row_count = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(ls_log), NULL);
+    while (row_count > gs_log_max_rows)
+    {
+        GtkTreeIter first_iter;
+        gtk_tree_model_get_iter_first(GTK_TREE_MODEL(ls_log), &first_iter);
+        gtk_list_store_remove(ls_log, &first_iter);
+        row_count--;
+    }
+
     GtkTreeView* tv_log = GTK_TREE_VIEW(gtk_builder_get_object(builder, "tv_log"));
-    gint row_count = gtk_tree_model_iter_n_children(gtk_tree_view_get_model(tv_log), NULL);
     GtkTreePath* path = gtk_tree_path_new_from_indices(row_count - 1, -1);
     gtk_tree_view_scroll_to_cell(tv_log, path, NULL, FALSE, 0, 0);
     gtk_tree_path_free(path);
-
-    while (gtk_events_pending())
-    {
-        gtk_main_iteration();
-    }
 }
 
 static void on_progress_begin(G_GNUC_UNUSED pddby_t* pddby, int size)
@@ -116,11 +126,6 @@ static void on_progress_begin(G_GNUC_UNUSED pddby_t* pddby, int size)
     gchar* text = g_strdup_printf("0 из %d", size);
     gtk_progress_bar_set_text(pb_progress, text);
     g_free(text);
-
-    while (gtk_events_pending())
-    {
-        gtk_main_iteration();
-    }
 }
 
 static void on_progress(G_GNUC_UNUSED pddby_t* pddby, int pos)
@@ -134,20 +139,6 @@ static void on_progress(G_GNUC_UNUSED pddby_t* pddby, int pos)
 
     GtkAdjustment* pb_progress_adjustment = GTK_ADJUSTMENT(gtk_builder_get_object(builder, "pb_progress_adjustment"));
     gtk_adjustment_set_value(pb_progress_adjustment, pos);
-
-    GtkProgressBar* pb_progress = GTK_PROGRESS_BAR(gtk_builder_get_object(builder, "pb_progress"));
-    gint size = gtk_adjustment_get_upper(pb_progress_adjustment);
-    gchar* text = g_strdup_printf("%d из %d", pos, size);
-    gtk_progress_bar_set_text(pb_progress, text);
-    g_free(text);
-
-    if (!(pos % 10) || pos == size)
-    {
-        while (gtk_events_pending())
-        {
-            gtk_main_iteration();
-        }
-    }
 }
 
 static void on_progress_end(G_GNUC_UNUSED pddby_t* pddby)
@@ -164,9 +155,29 @@ static void on_progress_end(G_GNUC_UNUSED pddby_t* pddby)
 
     GtkProgressBar* pb_progress = GTK_PROGRESS_BAR(gtk_builder_get_object(builder, "pb_progress"));
     gtk_progress_bar_set_text(pb_progress, NULL);
+}
 
-    while (gtk_events_pending())
+static void on_progress_ex(G_GNUC_UNUSED pddby_t* pddby, pddby_progress_t const* progress)
+{
+    if (!gs_decode_progress_window || !progress->size)
     {
-        gtk_main_iteration();
+        return;
     }
+
+    GtkBuilder* builder = GTK_BUILDER(g_object_get_data(G_OBJECT(gs_decode_progress_window), "pdd-builder"));
+    GtkProgressBar* pb_progress = GTK_PROGRESS_BAR(gtk_builder_get_object(builder, "pb_progress"));
+
+    gchar* text;
+    if (progress->eta >= 0)
+    {
+        gint eta = (gint)(progress->eta + 0.5);
+        text = g_strdup_printf("%d из %d (всего %d%%, осталось %d:%02d)", progress->pos, progress->size,
+            (gint)(progress->fraction * 100), eta / 60, eta % 60);
+    }
+    else
+    {
+        text = g_strdup_printf("%d из %d", progress->pos, progress->size);
+    }
+    gtk_progress_bar_set_text(pb_progress, text);
+    g_free(text);
 }
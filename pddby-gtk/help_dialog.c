@@ -30,12 +30,28 @@ static void add_images_to_box(GtkWidget *box, const pddby_images_t *images)
     GtkWidget *hbox = gtk_hbox_new(FALSE, 0);
     for (gsize i = 0, size = pddby_array_size(images); i < size; i++)
     {
-        const pddby_image_t *image = pddby_array_index(images, i);
+        pddby_image_t *image = pddby_array_index(images, i);
         GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
         GError *err = NULL;
-        if (!gdk_pixbuf_loader_write(loader, image->data, image->data_length, &err))
+        pddby_image_reader_t *reader = pddby_image_reader_new(image);
+        if (!reader)
         {
-            g_error("%s\n", err->message);
+            g_error("unable to open image data\n");
+        }
+        guchar buffer[16384];
+        gsize read_size;
+        int ret;
+        while ((ret = pddby_image_reader_read(reader, buffer, sizeof(buffer), &read_size)) == 1)
+        {
+            if (!gdk_pixbuf_loader_write(loader, buffer, read_size, &err))
+            {
+                g_error("%s\n", err->message);
+            }
+        }
+        pddby_image_reader_free(reader);
+        if (ret == -1)
+        {
+            g_error("unable to read image data\n");
         }
         if (!gdk_pixbuf_loader_close(loader, &err))
         {
@@ -88,7 +104,8 @@ GtkWidget *help_dialog_new_with_traffregs(const pddby_question_t *question)
     GtkBuilder *builder;
     GtkWidget *dialog = help_dialog_new(&builder);
 
-    pddby_traffregs_t *traffregs = pddby_traffregs_find_by_question(question->pddby, question->id);
+    pddby_traffregs_with_images_t *traffregs = pddby_traffregs_with_images_find_by_question(question->pddby,
+        question->id);
     if (!traffregs || !pddby_array_size(traffregs))
     {
         return NULL;
@@ -97,14 +114,12 @@ GtkWidget *help_dialog_new_with_traffregs(const pddby_question_t *question)
     GtkWidget *help_box = GTK_WIDGET(gtk_builder_get_object(builder, "box_help"));
     for (gsize i = 0, size = pddby_array_size(traffregs); i < size; i++)
     {
-        pddby_traffreg_t *traffreg = pddby_array_index(traffregs, i);
-        pddby_images_t *images = pddby_images_find_by_traffreg(traffreg->pddby, traffreg->id);
-        add_images_to_box(help_box, images);
-        add_text_to_box(help_box, traffreg->text);
-        pddby_images_free(images);
+        pddby_traffreg_with_images_t *item = pddby_array_index(traffregs, i);
+        add_images_to_box(help_box, item->images);
+        add_text_to_box(help_box, item->traffreg->text);
     }
     gtk_widget_show_all(help_box);
-    pddby_traffregs_free(traffregs);
+    pddby_traffregs_with_images_free(traffregs);
 
     return dialog;
 }
@@ -7,6 +7,53 @@
 
 GtkWidget *main_window = NULL;
 
+static pddby_t* gs_pddby = NULL;
+static pddby_decode_task_t* gs_decode_task = NULL;
+
+static gboolean on_drain_messages(gpointer data)
+{
+    pddby_drain_messages((pddby_t*)data, 0);
+    return TRUE;
+}
+
+static gboolean on_decode_task_poll(gpointer data)
+{
+    GtkWidget* decode_progress_window = GTK_WIDGET(data);
+
+    if (pddby_decode_task_dispatch(gs_decode_task))
+    {
+        return TRUE;
+    }
+
+    gboolean result = pddby_decode_task_finish(gs_decode_task);
+    gs_decode_task = NULL;
+
+    if (result)
+    {
+        gtk_widget_destroy(decode_progress_window);
+
+        main_window = main_window_new(gs_pddby);
+        gtk_widget_show(main_window);
+    }
+    else
+    {
+        decode_progress_window_enable_close(decode_progress_window);
+    }
+
+    return FALSE;
+}
+
+static gboolean on_decode_progress_window_delete(G_GNUC_UNUSED GtkWidget* widget, G_GNUC_UNUSED GdkEvent* event,
+    G_GNUC_UNUSED gpointer user_data)
+{
+    if (gs_decode_task)
+    {
+        pddby_decode_task_cancel(gs_decode_task);
+        return TRUE;
+    }
+    return FALSE;
+}
+
 int main(int argc, char *argv[])
 {
 #ifdef WIN32
@@ -16,12 +63,24 @@ int main(int argc, char *argv[])
 
     gchar* cache_dir = g_build_filename(g_get_user_cache_dir(), "pddby", NULL);
     g_mkdir_with_parents(cache_dir, 0755);
+    gchar* image_store_path = g_build_filename(cache_dir, "images.sqlite", NULL);
 
     GtkWidget* decode_progress_window = decode_progress_window_new();
 
-    pddby_t* pddby = pddby_init(get_share_dir(), cache_dir,
-        decode_progress_window_get_callbacks(decode_progress_window));
+    pddby_options_t options = {0};
+    options.cache_dir = cache_dir;
+    options.image_store_path = image_store_path;
+    options.callbacks = decode_progress_window_get_callbacks(decode_progress_window);
+    options.log_level = pddby_message_type_log;
+    options.log_buffer_size = 1024;
+    options.prefetch_cache = 1;
 
+    pddby_t* pddby = pddby_init_with_options(&options);
+    gs_pddby = pddby;
+
+    g_timeout_add(200, &on_drain_messages, pddby);
+
+    g_free(image_store_path);
     g_free(cache_dir);
 
     gboolean result = FALSE;
@@ -36,36 +95,59 @@ int main(int argc, char *argv[])
         GtkWidget *directory_dialog = gtk_file_chooser_dialog_new("Укажите путь к директории Pdd32 на компакт-диске",
             NULL, GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER, GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL, GTK_STOCK_OPEN,
             GTK_RESPONSE_ACCEPT, NULL);
-        GtkWidget *use_cache_checkbutton = gtk_check_button_new_with_label("Кэшировать данные на жёсткий диск "
+        GtkWidget *cache_vbox = gtk_vbox_new(FALSE, 0);
+        GtkWidget *no_cache_radiobutton = gtk_radio_button_new_with_label(NULL, "Не кэшировать данные");
+        GtkWidget *use_sealed_radiobutton = gtk_radio_button_new_with_label_from_widget(
+            GTK_RADIO_BUTTON(no_cache_radiobutton), "Кэшировать данные в зашифрованном виде (открываются только "
+            "с этим же компакт-диском)");
+        GtkWidget *use_cache_radiobutton = gtk_radio_button_new_with_label_from_widget(
+            GTK_RADIO_BUTTON(no_cache_radiobutton), "Кэшировать данные на жёсткий диск "
             "(подумайте дважды: \"Новый поворот\" не одобряет и может обидеться)");
-        gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(directory_dialog), use_cache_checkbutton);
+        gtk_box_pack_start(GTK_BOX(cache_vbox), no_cache_radiobutton, FALSE, FALSE, 0);
+        gtk_box_pack_start(GTK_BOX(cache_vbox), use_sealed_radiobutton, FALSE, FALSE, 0);
+        gtk_box_pack_start(GTK_BOX(cache_vbox), use_cache_radiobutton, FALSE, FALSE, 0);
+        gtk_widget_show_all(cache_vbox);
+        if (pddby_sealed_cache_exists(pddby))
+        {
+            gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(use_sealed_radiobutton), TRUE);
+        }
+        gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(directory_dialog), cache_vbox);
         if (gtk_dialog_run(GTK_DIALOG(directory_dialog)) != GTK_RESPONSE_ACCEPT)
         {
             return 1;
         }
 
         gchar *pdd32_path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(directory_dialog));
-        pddby_use_cache(pddby, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(use_cache_checkbutton)));
+        gboolean const use_sealed = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(use_sealed_radiobutton));
+        pddby_use_cache(pddby, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(use_cache_radiobutton)));
+        pddby_use_sealed_cache(pddby, use_sealed);
         gtk_widget_destroy(directory_dialog);
 
-        gtk_widget_show_all(decode_progress_window);
-
-        while (gtk_events_pending())
+        // sealed cache made from another disc fails to open and gets decoded over
+        if (use_sealed && pddby_sealed_cache_exists(pddby) && pddby_open_sealed_cache(pddby, pdd32_path))
         {
-            gtk_main_iteration();
-        }
-
-        result = pddby_decode(pddby, pdd32_path);
-        g_free(pdd32_path);
-
-        if (result)
-        {
-            gtk_widget_destroy(decode_progress_window);
+            result = TRUE;
         }
         else
         {
-            decode_progress_window_enable_close(decode_progress_window);
+            g_signal_connect(decode_progress_window, "delete-event", G_CALLBACK(on_decode_progress_window_delete),
+                NULL);
+            gtk_widget_show_all(decode_progress_window);
+
+            gs_decode_task = pddby_decode_async(pddby, pdd32_path);
+
+            if (gs_decode_task)
+            {
+                // window is switched over to main one (or left for error review) once decode finishes
+                g_timeout_add(50, &on_decode_task_poll, decode_progress_window);
+            }
+            else
+            {
+                decode_progress_window_enable_close(decode_progress_window);
+            }
         }
+
+        g_free(pdd32_path);
     }
 
     if (result)
@@ -76,6 +158,12 @@ int main(int argc, char *argv[])
 
     gtk_main();
 
+    if (gs_decode_task)
+    {
+        pddby_decode_task_cancel(gs_decode_task);
+        pddby_decode_task_finish(gs_decode_task);
+    }
+
     pddby_close(pddby);
 
     return 0;
@@ -253,9 +253,25 @@ static void update_question(statistics_t *statistics, GtkWindow *window)
         GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
         pddby_image_t *image = pddby_image_find_by_id(question->pddby, question->image_id);
         GError *err = NULL;
-        if (!gdk_pixbuf_loader_write(loader, image->data, image->data_length, &err))
+        pddby_image_reader_t *reader = pddby_image_reader_new(image);
+        if (!reader)
         {
-            g_error("%s\n", err->message);
+            g_error("unable to open image data\n");
+        }
+        guchar buffer[16384];
+        gsize read_size;
+        int ret;
+        while ((ret = pddby_image_reader_read(reader, buffer, sizeof(buffer), &read_size)) == 1)
+        {
+            if (!gdk_pixbuf_loader_write(loader, buffer, read_size, &err))
+            {
+                g_error("%s\n", err->message);
+            }
+        }
+        pddby_image_reader_free(reader);
+        if (ret == -1)
+        {
+            g_error("unable to read image data\n");
         }
         if (!gdk_pixbuf_loader_close(loader, &err))
         {
@@ -407,8 +423,8 @@ static void on_question_answer(G_GNUC_UNUSED gpointer unused, GtkWindow *window)
                 GtkWidget *error_dialog = gtk_message_dialog_new_with_markup(window, GTK_DIALOG_MODAL,
                     GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
                     "<span size='large' weight='bold'>Правильный ответ: %d</span>", statistics->correct_index + 1);
-                const gchar *advice = ((pddby_question_t *)pddby_array_index(statistics->questions, statistics->index))->
-                    advice;
+                const gchar *advice = pddby_question_get_advice(pddby_array_index(statistics->questions,
+                    statistics->index));
                 if (advice)
                 {
                     gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(error_dialog), "%s", advice);
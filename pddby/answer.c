@@ -1,8 +1,13 @@
 #include "answer.h"
 
 #include "config.h"
+#include "private/cursor.h"
+#include "private/pddby.h"
+#include "private/queries.h"
 #include "private/util/database.h"
+#include "private/util/pack.h"
 #include "private/util/report.h"
+#include "private/util/texts.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -42,6 +47,18 @@ error:
     return NULL;
 }
 
+static pddby_answer_t* pddby_answer_new_from_pack(pddby_t* pddby, int64_t id)
+{
+    struct pddby_pack_answer const* answer = pddby_pack_record(pddby->pack, pddby_pack_answers, id);
+    if (!answer)
+    {
+        return NULL;
+    }
+
+    return pddby_answer_new_with_id(pddby, id, answer->question_id, pddby_pack_string(pddby->pack, answer->text),
+        answer->is_correct);
+}
+
 pddby_answer_t* pddby_answer_new(pddby_t* pddby, int64_t question_id, char const* text, int is_correct)
 {
     return pddby_answer_new_with_id(pddby, 0, question_id, text, is_correct);
@@ -62,21 +79,26 @@ int pddby_answer_save(pddby_answer_t* answer)
 {
     assert(answer);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(answer->pddby, "INSERT INTO `answers` (`question_id`, "
+        "`text_id`, `is_correct`) VALUES (?, ?, ?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(answer->pddby, "INSERT INTO `answers` (`question_id`, `text`, `is_correct`) VALUES (?, ?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
+    }
+
+    int64_t text_id = pddby_texts_intern(answer->pddby, answer->text);
+    if (text_id == -1)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
         !(answer->question_id ?
             pddby_db_bind_int64(db_stmt, 1, answer->question_id) :
             pddby_db_bind_null(db_stmt, 1)) ||
-        !pddby_db_bind_text(db_stmt, 2, answer->text) ||
+        !(text_id ?
+            pddby_db_bind_int64(db_stmt, 2, text_id) :
+            pddby_db_bind_null(db_stmt, 2)) ||
         !pddby_db_bind_int(db_stmt, 3, answer->is_correct))
     {
         goto error;
@@ -101,14 +123,16 @@ error:
 
 pddby_answer_t* pddby_answer_find_by_id(pddby_t* pddby, int64_t id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    if (pddby->pack)
+    {
+        return pddby_answer_new_from_pack(pddby, id);
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT a.`question_id`, t.`text`, a.`is_correct` FROM "
+        "`answers` a LEFT JOIN `texts` t ON t.`id`=a.`text_id` WHERE a.`id`=? LIMIT 1");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `question_id`, `text`, `is_correct` FROM `answers` WHERE `rowid`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -143,14 +167,32 @@ pddby_answers_t* pddby_answers_new(pddby_t* pddby)
 
 pddby_answers_t* pddby_answers_find_by_question(struct pddby* pddby, int64_t question_id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    if (pddby->pack)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `text`, `is_correct` FROM `answers` WHERE `question_id`=?");
-        if (!db_stmt)
+        pddby_answers_t* answers = pddby_answers_new(pddby);
+        if (!answers)
         {
             goto error;
         }
+
+        size_t count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_question_answers, question_id, &count);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!pddby_array_add(answers, pddby_answer_new_from_pack(pddby, ids[i])))
+            {
+                pddby_answers_free(answers);
+                goto error;
+            }
+        }
+
+        return answers;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_ANSWERS_BY_QUESTION);
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -192,6 +234,75 @@ error:
     return NULL;
 }
 
+static void pddby_answer_row_read_db(void* row, int fields, pddby_db_stmt_t* db_stmt)
+{
+    pddby_answer_row_t* answer = row;
+    answer->id = pddby_db_column_int64(db_stmt, 0);
+    answer->question_id = pddby_db_column_int64(db_stmt, 1);
+    answer->text = fields & pddby_cursor_field_text ? pddby_db_column_text(db_stmt, 2) : NULL;
+    answer->is_correct = pddby_db_column_int(db_stmt, 3);
+}
+
+static int pddby_answer_row_read_pack(void* row, int fields, pddby_pack_t const* pack, int64_t id)
+{
+    struct pddby_pack_answer const* pack_answer = pddby_pack_record(pack, pddby_pack_answers, id);
+    if (!pack_answer)
+    {
+        return 0;
+    }
+
+    pddby_answer_row_t* answer = row;
+    answer->id = id;
+    answer->question_id = pack_answer->question_id;
+    answer->text = fields & pddby_cursor_field_text ? pddby_pack_string(pack, pack_answer->text) : NULL;
+    answer->is_correct = pack_answer->is_correct;
+    return 1;
+}
+
+pddby_cursor_t* pddby_answers_cursor_by_question(pddby_t* pddby, int64_t question_id, int fields)
+{
+    if (pddby->pack)
+    {
+        size_t count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_question_answers, question_id, &count);
+        pddby_cursor_t* cursor = pddby_cursor_new_from_pack(pddby, fields, sizeof(pddby_answer_row_t), ids, count,
+            &pddby_answer_row_read_pack);
+        if (!cursor)
+        {
+            goto error;
+        }
+        return cursor;
+    }
+
+    // texts are looked up only if asked for
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(pddby, fields & pddby_cursor_field_text ?
+        "SELECT a.`id`, a.`question_id`, t.`text`, a.`is_correct` FROM `answers` a LEFT JOIN `texts` t ON "
+        "t.`id`=a.`text_id` WHERE a.`question_id`=?" :
+        "SELECT `id`, `question_id`, NULL, `is_correct` FROM `answers` WHERE `question_id`=?");
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
+    if (!pddby_db_bind_int64(db_stmt, 1, question_id))
+    {
+        pddby_db_finalize(db_stmt);
+        goto error;
+    }
+
+    pddby_cursor_t* cursor = pddby_cursor_new_from_db(pddby, fields, sizeof(pddby_answer_row_t), db_stmt,
+        &pddby_answer_row_read_db);
+    if (!cursor)
+    {
+        goto error;
+    }
+    return cursor;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to open answer cursor with question id = %lld", question_id);
+    return NULL;
+}
+
 void pddby_answers_free(pddby_answers_t* answers)
 {
     assert(answers);
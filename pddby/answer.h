@@ -7,6 +7,7 @@ extern "C"
 #endif
 
 #include "array.h"
+#include "cursor.h"
 #include "pddby.h"
 
 #include <stdint.h>
@@ -24,6 +25,17 @@ struct pddby_answer
 typedef struct pddby_answer pddby_answer_t;
 typedef pddby_array_t pddby_answers_t;
 
+// borrowed view of answer, see pddby_cursor_next
+struct pddby_answer_row
+{
+    int64_t id;
+    int64_t question_id;
+    char const* text;
+    int is_correct;
+};
+
+typedef struct pddby_answer_row pddby_answer_row_t;
+
 pddby_answer_t* pddby_answer_new(pddby_t* pddby, int64_t question_id, char const* text, int is_correct);
 void pddby_answer_free(pddby_answer_t* answer);
 
@@ -33,6 +45,8 @@ pddby_answer_t* pddby_answer_find_by_id(pddby_t* pddby, int64_t id);
 
 pddby_answers_t* pddby_answers_new(pddby_t* pddby);
 pddby_answers_t* pddby_answers_find_by_question(pddby_t* pddby, int64_t question_id);
+// yields pddby_answer_row_t rows
+pddby_cursor_t* pddby_answers_cursor_by_question(pddby_t* pddby, int64_t question_id, int fields);
 void pddby_answers_free(pddby_answers_t* answers);
 
 #ifdef __cplusplus
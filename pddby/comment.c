@@ -1,7 +1,11 @@
 #include "comment.h"
 
 #include "config.h"
+#include "private/pddby.h"
+#include "private/queries.h"
 #include "private/util/database.h"
+#include "private/util/identity.h"
+#include "private/util/pack.h"
 #include "private/util/report.h"
 
 #include <assert.h>
@@ -12,9 +16,18 @@
 #include <dmalloc.h>
 #endif
 
+static void pddby_comment_dispose(pddby_comment_t* comment)
+{
+    if (comment->text)
+    {
+        free(comment->text);
+    }
+}
+
 static pddby_comment_t* pddby_comment_new_with_id(pddby_t* pddby, int64_t id, int32_t number, char const* text)
 {
-    pddby_comment_t* comment = calloc(1, sizeof(pddby_comment_t));
+    pddby_comment_t* comment = pddby_identity_new(pddby, pddby_identity_comment, sizeof(pddby_comment_t),
+        (pddby_identity_dispose_func_t)&pddby_comment_dispose);
     if (!comment)
     {
         goto error;
@@ -36,39 +49,68 @@ error:
     pddby_report(pddby, pddby_message_type_error, "unable to create comment object");
     if (comment)
     {
-        pddby_comment_free(comment);
+        pddby_identity_release(pddby, comment);
     }
     return NULL;
 }
 
+// row is only turned into object if it's not mapped yet
+static pddby_comment_t* pddby_comment_new_shared(pddby_t* pddby, int64_t id, int32_t number, char const* text)
+{
+    pddby_comment_t* comment = pddby_identity_find(pddby, pddby_identity_comment, id);
+    if (comment)
+    {
+        return comment;
+    }
+
+    comment = pddby_comment_new_with_id(pddby, id, number, text);
+    return comment ? pddby_identity_add(pddby, pddby_identity_comment, id, comment) : NULL;
+}
+
+static pddby_comment_t* pddby_comment_new_from_pack(pddby_t* pddby, int64_t id)
+{
+    struct pddby_pack_comment const* comment = pddby_pack_record(pddby->pack, pddby_pack_comments, id);
+    if (!comment)
+    {
+        return NULL;
+    }
+
+    return pddby_comment_new_shared(pddby, id, comment->number, pddby_pack_string(pddby->pack, comment->text));
+}
+
 pddby_comment_t* pddby_comment_new(pddby_t* pddby, int32_t number, char const* text)
 {
     return pddby_comment_new_with_id(pddby, 0, number, text);
 }
 
-void pddby_comment_free(pddby_comment_t* comment)
+pddby_comment_t* pddby_comment_retain(pddby_comment_t* comment)
 {
     assert(comment);
 
-    if (comment->text)
-    {
-        free(comment->text);
-    }
-    free(comment);
+    return pddby_identity_retain(comment->pddby, comment);
+}
+
+void pddby_comment_release(pddby_comment_t* comment)
+{
+    assert(comment);
+
+    pddby_identity_release(comment->pddby, comment);
+}
+
+void pddby_comment_free(pddby_comment_t* comment)
+{
+    pddby_comment_release(comment);
 }
 
 int pddby_comment_save(pddby_comment_t* comment)
 {
     assert(comment);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(comment->pddby, "INSERT INTO `comments` (`number`, `text`) "
+        "VALUES (?, ?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(comment->pddby, "INSERT INTO `comments` (`number`, `text`) VALUES (?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -97,14 +139,22 @@ error:
 
 pddby_comment_t* pddby_comment_find_by_id(pddby_t* pddby, int64_t id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_comment_t* comment = pddby_identity_find(pddby, pddby_identity_comment, id);
+    if (comment)
+    {
+        return comment;
+    }
+
+    if (pddby->pack)
+    {
+        return pddby_comment_new_from_pack(pddby, id);
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT `number`, `text` FROM `comments` WHERE `id`=? "
+        "LIMIT 1");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `number`, `text` FROM `comments` WHERE `rowid`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -124,7 +174,7 @@ pddby_comment_t* pddby_comment_find_by_id(pddby_t* pddby, int64_t id)
     int32_t number = pddby_db_column_int(db_stmt, 0);
     char const* text = pddby_db_column_text(db_stmt, 1);
 
-    return pddby_comment_new_with_id(pddby, id, number, text);
+    return pddby_comment_new_shared(pddby, id, number, text);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find comment object with id = %lld", id);
@@ -133,14 +183,15 @@ error:
 
 pddby_comment_t* pddby_comment_find_by_number(pddby_t* pddby, int32_t number)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    if (pddby->pack)
+    {
+        return pddby_comment_new_from_pack(pddby, pddby_pack_find_by_number(pddby->pack, pddby_pack_comments, number));
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_COMMENT_BY_NUMBER);
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `text` FROM `comments` WHERE `number`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -160,7 +211,7 @@ pddby_comment_t* pddby_comment_find_by_number(pddby_t* pddby, int32_t number)
     int64_t id = pddby_db_column_int64(db_stmt, 0);
     char const* text = pddby_db_column_text(db_stmt, 1);
 
-    return pddby_comment_new_with_id(pddby, id, number, text);
+    return pddby_comment_new_shared(pddby, id, number, text);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find comment object with number = %d", number);
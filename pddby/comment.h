@@ -24,6 +24,9 @@ typedef struct pddby_comment pddby_comment_t;
 typedef pddby_array_t pddby_comments_t;
 
 pddby_comment_t* pddby_comment_new(pddby_t* pddby, int32_t number, char const* text);
+pddby_comment_t* pddby_comment_retain(pddby_comment_t* comment);
+void pddby_comment_release(pddby_comment_t* comment);
+// same as pddby_comment_release
 void pddby_comment_free(pddby_comment_t* comment);
 
 int pddby_comment_save(pddby_comment_t* comment);
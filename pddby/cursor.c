@@ -0,0 +1,134 @@
+#include "cursor.h"
+
+#include "config.h"
+#include "private/cursor.h"
+#include "private/pddby.h"
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+struct pddby_cursor
+{
+    pddby_t* pddby;
+    int fields;
+
+    pddby_db_stmt_t* db_stmt;
+    pddby_cursor_read_db_func_t read_db;
+
+    uint32_t const* ids;
+    size_t count;
+    size_t index;
+    pddby_cursor_read_pack_func_t read_pack;
+
+    // row_size bytes follow
+    void* row;
+};
+
+static pddby_cursor_t* pddby_cursor_new(pddby_t* pddby, int fields, size_t row_size)
+{
+    pddby_cursor_t* cursor = calloc(1, sizeof(pddby_cursor_t) + row_size);
+    if (!cursor)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to create cursor");
+        return NULL;
+    }
+
+    cursor->pddby = pddby;
+    cursor->fields = fields;
+    cursor->row = cursor + 1;
+
+    return cursor;
+}
+
+pddby_cursor_t* pddby_cursor_new_from_db(pddby_t* pddby, int fields, size_t row_size, pddby_db_stmt_t* db_stmt,
+    pddby_cursor_read_db_func_t read_func)
+{
+    assert(db_stmt);
+    assert(read_func);
+
+    pddby_cursor_t* cursor = pddby_cursor_new(pddby, fields, row_size);
+    if (!cursor)
+    {
+        pddby_db_finalize(db_stmt);
+        return NULL;
+    }
+
+    cursor->db_stmt = db_stmt;
+    cursor->read_db = read_func;
+
+    return cursor;
+}
+
+pddby_cursor_t* pddby_cursor_new_from_pack(pddby_t* pddby, int fields, size_t row_size, uint32_t const* ids,
+    size_t count, pddby_cursor_read_pack_func_t read_func)
+{
+    assert(ids || !count);
+    assert(read_func);
+
+    pddby_cursor_t* cursor = pddby_cursor_new(pddby, fields, row_size);
+    if (!cursor)
+    {
+        return NULL;
+    }
+
+    cursor->ids = ids;
+    cursor->count = count;
+    cursor->read_pack = read_func;
+
+    return cursor;
+}
+
+int pddby_cursor_next(pddby_cursor_t* cursor, void const** row)
+{
+    assert(cursor);
+    assert(row);
+
+    *row = NULL;
+
+    int result;
+    if (cursor->db_stmt)
+    {
+        result = pddby_db_step(cursor->db_stmt);
+        if (result == 1)
+        {
+            cursor->read_db(cursor->row, cursor->fields, cursor->db_stmt);
+        }
+    }
+    else if (cursor->index < cursor->count)
+    {
+        result = cursor->read_pack(cursor->row, cursor->fields, cursor->pddby->pack, cursor->ids[cursor->index++]) ?
+            1 : -1;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (result == -1)
+    {
+        pddby_report(cursor->pddby, pddby_message_type_error, "unable to read cursor row");
+        return -1;
+    }
+
+    if (result == 1)
+    {
+        *row = cursor->row;
+    }
+    return result;
+}
+
+void pddby_cursor_free(pddby_cursor_t* cursor)
+{
+    assert(cursor);
+
+    if (cursor->db_stmt)
+    {
+        pddby_db_finalize(cursor->db_stmt);
+    }
+    free(cursor);
+}
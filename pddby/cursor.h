@@ -0,0 +1,31 @@
+#ifndef PDDBY_CURSOR_H
+#define PDDBY_CURSOR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "pddby.h"
+
+// columns a cursor fills in besides ids and numbers; skipped ones are left NULL and cost nothing to query
+enum pddby_cursor_field
+{
+    pddby_cursor_field_text = 1 << 0,
+    pddby_cursor_field_data = 1 << 1,
+    pddby_cursor_field_all = pddby_cursor_field_text | pddby_cursor_field_data
+};
+
+struct pddby_cursor;
+typedef struct pddby_cursor pddby_cursor_t;
+
+// walks query results without copying them: row, along with texts and data it points to, is only valid until next
+// call to pddby_cursor_next or pddby_cursor_free; returns 1 with row set, 0 when done, -1 on error
+int pddby_cursor_next(pddby_cursor_t* cursor, void const** row);
+void pddby_cursor_free(pddby_cursor_t* cursor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PDDBY_CURSOR_H
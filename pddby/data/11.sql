@@ -1 +0,0 @@
-10.sql
\ No newline at end of file
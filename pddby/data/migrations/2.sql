@@ -0,0 +1,73 @@
+-- version 1 caches predate `user_version` and have no keys or indexes --------
+ALTER TABLE `settings` RENAME TO `settings_1`;
+ALTER TABLE `images` RENAME TO `images_1`;
+ALTER TABLE `comments` RENAME TO `comments_1`;
+ALTER TABLE `traffregs` RENAME TO `traffregs_1`;
+ALTER TABLE `images_traffregs` RENAME TO `images_traffregs_1`;
+ALTER TABLE `sections` RENAME TO `sections_1`;
+ALTER TABLE `topics` RENAME TO `topics_1`;
+ALTER TABLE `questions` RENAME TO `questions_1`;
+ALTER TABLE `questions_sections` RENAME TO `questions_sections_1`;
+ALTER TABLE `questions_traffregs` RENAME TO `questions_traffregs_1`;
+ALTER TABLE `answers` RENAME TO `answers_1`;
+
+-- create schema --------------------------------------------------------------
+CREATE TABLE `settings` (`key` TEXT PRIMARY KEY, `value` TEXT) WITHOUT ROWID;
+CREATE TABLE `images` (`id` INTEGER PRIMARY KEY, `name` TEXT NOT NULL);
+CREATE INDEX `images_name` ON `images` (`name`);
+CREATE TABLE `image_data` (`image_id` INTEGER PRIMARY KEY, `data` BLOB);
+CREATE TABLE `comments` (`id` INTEGER PRIMARY KEY, `number` INTEGER NOT NULL, `text` TEXT);
+CREATE INDEX `comments_number` ON `comments` (`number`);
+CREATE TABLE `traffregs` (`id` INTEGER PRIMARY KEY, `number` INTEGER NOT NULL, `text` TEXT);
+CREATE INDEX `traffregs_number` ON `traffregs` (`number`);
+CREATE TABLE `images_traffregs` (`traffreg_id` INTEGER NOT NULL, `position` INTEGER NOT NULL, `image_id` INTEGER NOT NULL,
+    PRIMARY KEY (`traffreg_id`, `position`)) WITHOUT ROWID;
+CREATE TABLE `sections` (`id` INTEGER PRIMARY KEY, `name` TEXT NOT NULL UNIQUE, `title_prefix` TEXT, `title` TEXT);
+CREATE TABLE `topics` (`id` INTEGER PRIMARY KEY, `number` INTEGER NOT NULL UNIQUE, `title` TEXT);
+CREATE TABLE `questions` (`id` INTEGER PRIMARY KEY, `topic_id` INTEGER NOT NULL, `text` TEXT, `image_id` INTEGER,
+    `comment_id` INTEGER);
+CREATE INDEX `questions_topic_id` ON `questions` (`topic_id`);
+CREATE TABLE `question_advices` (`question_id` INTEGER PRIMARY KEY, `advice` TEXT);
+CREATE TABLE `questions_sections` (`section_id` INTEGER NOT NULL, `question_id` INTEGER NOT NULL,
+    PRIMARY KEY (`section_id`, `question_id`)) WITHOUT ROWID;
+CREATE TABLE `questions_traffregs` (`question_id` INTEGER NOT NULL, `position` INTEGER NOT NULL,
+    `traffreg_id` INTEGER NOT NULL, PRIMARY KEY (`question_id`, `position`)) WITHOUT ROWID;
+CREATE TABLE `answers` (`id` INTEGER PRIMARY KEY, `question_id` INTEGER NOT NULL, `text` TEXT, `is_correct` INTEGER);
+CREATE INDEX `answers_question_id` ON `answers` (`question_id`);
+
+-- copy data over, link order used to be implied by `rowid` --------------------
+INSERT OR REPLACE INTO `settings` (`key`, `value`) SELECT `key`, `value` FROM `settings_1` ORDER BY `rowid`;
+INSERT INTO `images` (`id`, `name`) SELECT `rowid`, `name` FROM `images_1`;
+INSERT INTO `image_data` (`image_id`, `data`) SELECT `rowid`, `data` FROM `images_1`;
+INSERT INTO `comments` (`id`, `number`, `text`) SELECT `rowid`, `number`, `text` FROM `comments_1`;
+INSERT INTO `traffregs` (`id`, `number`, `text`) SELECT `rowid`, `number`, `text` FROM `traffregs_1`;
+INSERT INTO `images_traffregs` (`traffreg_id`, `position`, `image_id`)
+    SELECT it.`traffreg_id`, (SELECT COUNT(*) FROM `images_traffregs_1` p WHERE p.`traffreg_id`=it.`traffreg_id` AND
+    p.`rowid`<it.`rowid`), it.`image_id` FROM `images_traffregs_1` it;
+INSERT INTO `sections` (`id`, `name`, `title_prefix`, `title`) SELECT `rowid`, `name`, `title_prefix`, `title`
+    FROM `sections_1`;
+INSERT INTO `topics` (`id`, `number`, `title`) SELECT `rowid`, CAST(`number` AS INTEGER), `title` FROM `topics_1`;
+INSERT INTO `questions` (`id`, `topic_id`, `text`, `image_id`, `comment_id`)
+    SELECT `rowid`, `topic_id`, `text`, `image_id`, `comment_id` FROM `questions_1`;
+INSERT INTO `question_advices` (`question_id`, `advice`)
+    SELECT `rowid`, `advice` FROM `questions_1` WHERE `advice` IS NOT NULL;
+INSERT OR IGNORE INTO `questions_sections` (`section_id`, `question_id`)
+    SELECT `section_id`, `question_id` FROM `questions_sections_1`;
+INSERT INTO `questions_traffregs` (`question_id`, `position`, `traffreg_id`)
+    SELECT qt.`question_id`, (SELECT COUNT(*) FROM `questions_traffregs_1` p WHERE p.`question_id`=qt.`question_id` AND
+    p.`rowid`<qt.`rowid`), qt.`traffreg_id` FROM `questions_traffregs_1` qt;
+INSERT INTO `answers` (`id`, `question_id`, `text`, `is_correct`)
+    SELECT `rowid`, `question_id`, `text`, `is_correct` FROM `answers_1`;
+
+-- drop old tables ------------------------------------------------------------
+DROP TABLE `settings_1`;
+DROP TABLE `images_1`;
+DROP TABLE `comments_1`;
+DROP TABLE `traffregs_1`;
+DROP TABLE `images_traffregs_1`;
+DROP TABLE `sections_1`;
+DROP TABLE `topics_1`;
+DROP TABLE `questions_1`;
+DROP TABLE `questions_sections_1`;
+DROP TABLE `questions_traffregs_1`;
+DROP TABLE `answers_1`;
@@ -0,0 +1,4 @@
+-- image payloads may be stored compressed, `format` tells how ---------------
+ALTER TABLE `image_data` ADD COLUMN `format` INTEGER NOT NULL DEFAULT 0;
+ALTER TABLE `image_data` ADD COLUMN `size` INTEGER NOT NULL DEFAULT 0;
+UPDATE `image_data` SET `size`=length(`data`);
@@ -0,0 +1,33 @@
+-- repeating texts are stored once and referred to by id ---------------------
+CREATE TABLE `texts` (`id` INTEGER PRIMARY KEY, `hash` INTEGER NOT NULL, `text` TEXT NOT NULL);
+CREATE INDEX `texts_hash` ON `texts` (`hash`);
+
+INSERT INTO `texts` (`hash`, `text`)
+    SELECT pddby_text_hash(`text`), `text` FROM (SELECT `text` FROM `answers` UNION SELECT `advice` FROM
+    `question_advices` UNION SELECT `text` FROM `traffregs`) WHERE `text` IS NOT NULL;
+
+DROP INDEX `traffregs_number`;
+ALTER TABLE `traffregs` RENAME TO `traffregs_3`;
+CREATE TABLE `traffregs` (`id` INTEGER PRIMARY KEY, `number` INTEGER NOT NULL, `text_id` INTEGER);
+CREATE INDEX `traffregs_number` ON `traffregs` (`number`);
+INSERT INTO `traffregs` (`id`, `number`, `text_id`)
+    SELECT r.`id`, r.`number`, t.`id` FROM `traffregs_3` r LEFT JOIN `texts` t ON t.`hash`=pddby_text_hash(r.`text`)
+    AND t.`text`=r.`text`;
+DROP TABLE `traffregs_3`;
+
+ALTER TABLE `question_advices` RENAME TO `question_advices_3`;
+CREATE TABLE `question_advices` (`question_id` INTEGER PRIMARY KEY, `advice_id` INTEGER);
+INSERT INTO `question_advices` (`question_id`, `advice_id`)
+    SELECT a.`question_id`, t.`id` FROM `question_advices_3` a LEFT JOIN `texts` t ON
+    t.`hash`=pddby_text_hash(a.`advice`) AND t.`text`=a.`advice`;
+DROP TABLE `question_advices_3`;
+
+DROP INDEX `answers_question_id`;
+ALTER TABLE `answers` RENAME TO `answers_3`;
+CREATE TABLE `answers` (`id` INTEGER PRIMARY KEY, `question_id` INTEGER NOT NULL, `text_id` INTEGER,
+    `is_correct` INTEGER);
+CREATE INDEX `answers_question_id` ON `answers` (`question_id`);
+INSERT INTO `answers` (`id`, `question_id`, `text_id`, `is_correct`)
+    SELECT a.`id`, a.`question_id`, t.`id`, a.`is_correct` FROM `answers_3` a LEFT JOIN `texts` t ON
+    t.`hash`=pddby_text_hash(a.`text`) AND t.`text`=a.`text`;
+DROP TABLE `answers_3`;
@@ -0,0 +1,2 @@
+-- image payloads may live in shared store instead, keyed by `hash` ----------
+ALTER TABLE `images` ADD COLUMN `hash` TEXT;
@@ -0,0 +1,3 @@
+-- source files decode consumed, so that it can redo only what changed -------
+CREATE TABLE `manifest` (`path` TEXT PRIMARY KEY, `size` INTEGER NOT NULL, `mtime` INTEGER NOT NULL,
+    `hash` TEXT NOT NULL) WITHOUT ROWID;
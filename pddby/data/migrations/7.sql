@@ -0,0 +1,3 @@
+-- questions of every ticket, laid out by decode from `ticket_topics_distribution`
+CREATE TABLE `tickets` (`ticket_number` INTEGER NOT NULL, `slot` INTEGER NOT NULL, `question_id` INTEGER NOT NULL,
+    PRIMARY KEY (`ticket_number`, `slot`)) WITHOUT ROWID;
@@ -0,0 +1,17 @@
+-- per section and per topic question statistics, refreshed by decode --------
+CREATE TABLE `stats` (`kind` INTEGER NOT NULL, `owner_id` INTEGER NOT NULL, `question_count` INTEGER NOT NULL,
+    `ticket_count` INTEGER NOT NULL, `image_question_count` INTEGER NOT NULL,
+    `traffreg_question_count` INTEGER NOT NULL, `comment_question_count` INTEGER NOT NULL,
+    PRIMARY KEY (`kind`, `owner_id`)) WITHOUT ROWID;
+
+INSERT INTO `stats` (`kind`, `owner_id`, `question_count`, `ticket_count`, `image_question_count`,
+    `traffreg_question_count`, `comment_question_count`)
+    SELECT 0, s.`id`, COUNT(q.`id`), (COUNT(q.`id`) + 9) / 10, COUNT(NULLIF(q.`image_id`, 0)),
+    SUM(EXISTS (SELECT 1 FROM `questions_traffregs` qt WHERE qt.`question_id`=q.`id`)),
+    COUNT(NULLIF(q.`comment_id`, 0)) FROM `sections` s LEFT JOIN `questions_sections` qs ON qs.`section_id`=s.`id`
+    LEFT JOIN `questions` q ON q.`id`=qs.`question_id` GROUP BY s.`id`;
+INSERT INTO `stats` (`kind`, `owner_id`, `question_count`, `ticket_count`, `image_question_count`,
+    `traffreg_question_count`, `comment_question_count`)
+    SELECT 1, t.`id`, COUNT(q.`id`), (COUNT(q.`id`) + 9) / 10, COUNT(NULLIF(q.`image_id`, 0)),
+    SUM(EXISTS (SELECT 1 FROM `questions_traffregs` qt WHERE qt.`question_id`=q.`id`)),
+    COUNT(NULLIF(q.`comment_id`, 0)) FROM `topics` t LEFT JOIN `questions` q ON q.`topic_id`=t.`id` GROUP BY t.`id`;
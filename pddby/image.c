@@ -1,8 +1,14 @@
 #include "image.h"
 
 #include "config.h"
+#include "private/cursor.h"
+#include "private/image.h"
+#include "private/pddby.h"
+#include "private/queries.h"
 #include "private/util/aux.h"
+#include "private/util/compress.h"
 #include "private/util/database.h"
+#include "private/util/pack.h"
 #include "private/util/report.h"
 #include "private/util/string.h"
 
@@ -14,7 +20,34 @@
 #include <dmalloc.h>
 #endif
 
-static pddby_image_t* pddby_image_new_with_id(pddby_t* pddby, int64_t id, char const* name, void const* data, size_t data_length)
+#define PDDBY_IMAGE_READER_CHUNK_SIZE 16384
+
+enum pddby_image_location
+{
+    // data, if any, is right there in image object
+    pddby_image_location_memory,
+    pddby_image_location_data,
+    pddby_image_location_store,
+    pddby_image_location_pack
+};
+
+struct pddby_image_reader
+{
+    pddby_t* pddby;
+
+    // stored data comes either from memory or from blob
+    unsigned char const* data;
+    pddby_db_blob_t* blob;
+    size_t stored_size;
+    size_t stored_offset;
+
+    // compressed data only
+    pddby_decompress_stream_t* stream;
+    unsigned char chunk[PDDBY_IMAGE_READER_CHUNK_SIZE];
+};
+
+static pddby_image_t* pddby_image_new_with_id(pddby_t* pddby, int64_t id, char const* name, void const* data,
+    size_t data_length)
 {
     pddby_image_t *image = calloc(1, sizeof(pddby_image_t));
     if (!image)
@@ -54,6 +87,55 @@ error:
     return NULL;
 }
 
+static pddby_image_t* pddby_image_new_stored(pddby_t* pddby, int64_t id, char const* name, int format, int location,
+    int64_t row_id, size_t data_length)
+{
+    pddby_image_t* image = pddby_image_new_with_id(pddby, id, name, NULL, 0);
+    if (!image)
+    {
+        return NULL;
+    }
+
+    image->data_length = data_length;
+    image->stored_format = format;
+    image->stored_location = location;
+    image->stored_row_id = row_id;
+
+    return image;
+}
+
+pddby_image_t* pddby_image_new_from_db(pddby_t* pddby, int64_t id, char const* name, pddby_db_stmt_t* db_stmt,
+    int column)
+{
+    int64_t const data_row_id = pddby_db_column_int64(db_stmt, column + 2);
+    int64_t const store_row_id = pddby_db_column_int64(db_stmt, column + 3);
+
+    int location = pddby_image_location_memory;
+    if (data_row_id)
+    {
+        location = pddby_image_location_data;
+    }
+    else if (store_row_id)
+    {
+        location = pddby_image_location_store;
+    }
+
+    return pddby_image_new_stored(pddby, id, name, pddby_db_column_int(db_stmt, column), location,
+        data_row_id ? data_row_id : store_row_id, pddby_db_column_int64(db_stmt, column + 1));
+}
+
+pddby_image_t* pddby_image_new_from_pack(pddby_t* pddby, int64_t id)
+{
+    struct pddby_pack_image const* image = pddby_pack_record(pddby->pack, pddby_pack_images, id);
+    if (!image)
+    {
+        return NULL;
+    }
+
+    return pddby_image_new_stored(pddby, id, pddby_pack_string(pddby->pack, image->name), pddby_compress_format_raw,
+        pddby_image_location_pack, id, image->data_size);
+}
+
 pddby_image_t* pddby_image_new(pddby_t* pddby, char const* name, void const* data, size_t data_length)
 {
     return pddby_image_new_with_id(pddby, 0, name, data, data_length);
@@ -78,14 +160,24 @@ int pddby_image_save(pddby_image_t* image)
 {
     assert(image);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(image->pddby, "INSERT INTO `images` (`name`) VALUES (?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(image->pddby, "INSERT INTO `images` (`name`, `data`) VALUES (?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
+    }
+
+    pddby_db_stmt_t* data_db_stmt = pddby_db_prepare_cached(image->pddby, "INSERT INTO `image_data` (`image_id`, "
+        "`data`, `format`, `size`) VALUES (?, ?, ?, ?)");
+    if (!data_db_stmt)
+    {
+        goto error;
+    }
+
+    size_t data_length;
+    void const* data = pddby_image_get_data(image, &data_length);
+    if (!data && image->stored_location != pddby_image_location_memory)
+    {
+        goto error;
     }
 
     char* image_name = pddby_string_downcase(image->pddby, image->name);
@@ -98,8 +190,7 @@ int pddby_image_save(pddby_image_t* image)
     image->name = image_name;
 
     if (!pddby_db_reset(db_stmt) ||
-        !pddby_db_bind_text(db_stmt, 1, image->name) ||
-        !pddby_db_bind_blob(db_stmt, 2, image->data, image->data_length))
+        !pddby_db_bind_text(db_stmt, 1, image->name))
     {
         goto error;
     }
@@ -114,6 +205,35 @@ int pddby_image_save(pddby_image_t* image)
 
     image->id = pddby_db_last_insert_id(image->pddby);
 
+    int format = pddby_compress_format_raw;
+    void* compressed_data = NULL;
+    size_t compressed_data_length;
+    if (pddby_compress(data, data_length, &compressed_data, &compressed_data_length))
+    {
+        format = pddby_compress_format_zlib;
+    }
+
+    int bound =
+        pddby_db_reset(data_db_stmt) &&
+        pddby_db_bind_int64(data_db_stmt, 1, image->id) &&
+        pddby_db_bind_blob(data_db_stmt, 2, compressed_data ? compressed_data : data,
+            compressed_data ? compressed_data_length : data_length) &&
+        pddby_db_bind_int(data_db_stmt, 3, format) &&
+        pddby_db_bind_int64(data_db_stmt, 4, data_length);
+    ret = bound ? pddby_db_step(data_db_stmt) : -1;
+
+    if (compressed_data)
+    {
+        free(compressed_data);
+    }
+
+    if (ret == -1)
+    {
+        goto error;
+    }
+
+    assert(ret == 0);
+
     return 1;
 
 error:
@@ -121,16 +241,229 @@ error:
     return 0;
 }
 
-pddby_image_t* pddby_image_find_by_id(pddby_t* pddby, int64_t id)
+void const* pddby_image_get_data(pddby_image_t* image, size_t* data_length)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    assert(image);
+
+    if (!image->data && image->stored_location != pddby_image_location_memory)
+    {
+        pddby_image_reader_t* reader = pddby_image_reader_new(image);
+        if (!reader)
+        {
+            goto error;
+        }
+
+        unsigned char* data = malloc(image->data_length ? image->data_length : 1);
+        size_t offset = 0;
+        int result = data ? 1 : -1;
+        while (result == 1 && offset < image->data_length)
+        {
+            size_t read_size;
+            result = pddby_image_reader_read(reader, data + offset, image->data_length - offset, &read_size);
+            offset += read_size;
+        }
+
+        pddby_image_reader_free(reader);
+
+        if (result == -1 || offset != image->data_length)
+        {
+            if (data)
+            {
+                free(data);
+            }
+            goto error;
+        }
+
+        image->data = data;
+    }
+
+    if (data_length)
+    {
+        *data_length = image->data ? image->data_length : 0;
+    }
+    return image->data;
+
+error:
+    pddby_report(image->pddby, pddby_message_type_error, "unable to get image object data");
+    return NULL;
+}
+
+pddby_image_reader_t* pddby_image_reader_new(pddby_image_t* image)
+{
+    assert(image);
+
+    pddby_image_reader_t* reader = calloc(1, sizeof(pddby_image_reader_t));
+    if (!reader)
+    {
+        goto error;
+    }
+
+    reader->pddby = image->pddby;
+
+    int format = pddby_compress_format_raw;
+    if (image->data || image->stored_location == pddby_image_location_memory)
+    {
+        reader->data = image->data;
+        reader->stored_size = image->data ? image->data_length : 0;
+    }
+    else if (image->stored_location == pddby_image_location_pack)
+    {
+        struct pddby_pack_image const* pack_image = pddby_pack_record(image->pddby->pack, pddby_pack_images,
+            image->stored_row_id);
+        reader->data = pack_image ? pddby_pack_blob(image->pddby->pack, pack_image->data_offset,
+            pack_image->data_size) : NULL;
+        if (!reader->data)
+        {
+            goto error;
+        }
+        reader->stored_size = pack_image->data_size;
+    }
+    else
+    {
+        int const in_store = image->stored_location == pddby_image_location_store;
+        reader->blob = pddby_db_blob_open(image->pddby, in_store ? "store" : "main", in_store ? "blobs" : "image_data",
+            "data", image->stored_row_id);
+        if (!reader->blob)
+        {
+            goto error;
+        }
+        reader->stored_size = pddby_db_blob_size(reader->blob);
+        format = image->stored_format;
+    }
+
+    switch (format)
+    {
+    case pddby_compress_format_raw:
+        break;
+    case pddby_compress_format_zlib:
+        reader->stream = pddby_decompress_stream_new(image->pddby);
+        if (!reader->stream)
+        {
+            goto error;
+        }
+        break;
+    default:
+        pddby_report(image->pddby, pddby_message_type_error, "unknown compression format %d", format);
+        goto error;
+    }
+
+    return reader;
+
+error:
+    pddby_report(image->pddby, pddby_message_type_error, "unable to open image object data with id = %lld",
+        image->id);
+    if (reader)
+    {
+        pddby_image_reader_free(reader);
+    }
+    return NULL;
+}
+
+void pddby_image_reader_free(pddby_image_reader_t* reader)
+{
+    assert(reader);
+
+    if (reader->stream)
+    {
+        pddby_decompress_stream_free(reader->stream);
+    }
+    if (reader->blob)
+    {
+        pddby_db_blob_close(reader->blob);
+    }
+    free(reader);
+}
+
+int pddby_image_reader_read(pddby_image_reader_t* reader, void* buffer, size_t size, size_t* read_size)
+{
+    assert(reader);
+    assert(buffer);
+    assert(read_size);
+
+    *read_size = 0;
+
+    if (!reader->stream)
+    {
+        size_t const count = size < reader->stored_size - reader->stored_offset ? size :
+            reader->stored_size - reader->stored_offset;
+        if (!count)
+        {
+            return 0;
+        }
+
+        if (reader->blob)
+        {
+            if (!pddby_db_blob_read(reader->blob, buffer, count, reader->stored_offset))
+            {
+                goto error;
+            }
+        }
+        else
+        {
+            memcpy(buffer, reader->data + reader->stored_offset, count);
+        }
+
+        reader->stored_offset += count;
+        *read_size = count;
+        return 1;
+    }
+
+    for (;;)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `name`, `data` FROM `images` WHERE `rowid`=? LIMIT 1");
-        if (!db_stmt)
+        if (pddby_decompress_stream_wants_input(reader->stream))
+        {
+            if (reader->stored_offset == reader->stored_size)
+            {
+                // compressed data is cut short
+                goto error;
+            }
+
+            size_t count = reader->stored_size - reader->stored_offset;
+            void const* input = reader->data + reader->stored_offset;
+            if (reader->blob)
+            {
+                count = count < sizeof(reader->chunk) ? count : sizeof(reader->chunk);
+                if (!pddby_db_blob_read(reader->blob, reader->chunk, count, reader->stored_offset))
+                {
+                    goto error;
+                }
+                input = reader->chunk;
+            }
+
+            pddby_decompress_stream_feed(reader->stream, input, count);
+            reader->stored_offset += count;
+        }
+
+        int const result = pddby_decompress_stream_read(reader->stream, buffer, size, read_size);
+        if (result == -1)
         {
             goto error;
         }
+        if (result == 0 || *read_size)
+        {
+            return result;
+        }
+    }
+
+error:
+    pddby_report(reader->pddby, pddby_message_type_error, "unable to read image object data");
+    return -1;
+}
+
+pddby_image_t* pddby_image_find_by_id(pddby_t* pddby, int64_t id)
+{
+    if (pddby->pack)
+    {
+        return pddby_image_new_from_pack(pddby, id);
+    }
+
+    // data itself is left in storage until asked for
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT i.`name`, COALESCE(d.`format`, s.`format`), "
+        "COALESCE(d.`size`, s.`size`), d.`image_id`, s.`row_id` FROM `images` i LEFT JOIN `image_data` d ON "
+        "d.`image_id`=i.`id` LEFT JOIN `image_store` s ON s.`hash`=i.`hash` WHERE i.`id`=? LIMIT 1");
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -147,11 +480,7 @@ pddby_image_t* pddby_image_find_by_id(pddby_t* pddby, int64_t id)
         return NULL;
     }
 
-    char const* name = pddby_db_column_text(db_stmt, 0);
-    void const* data = pddby_db_column_blob(db_stmt, 1);
-    size_t data_length = pddby_db_column_bytes(db_stmt, 1);
-
-    return pddby_image_new_with_id(pddby, id, name, data, data_length);
+    return pddby_image_new_from_db(pddby, id, pddby_db_column_text(db_stmt, 0), db_stmt, 1);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find image object with id = %lld", id);
@@ -162,18 +491,21 @@ pddby_image_t* pddby_image_find_by_name(pddby_t* pddby, char const* name)
 {
     assert(name);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    char* image_name = pddby_string_downcase(pddby, name);
+    if (!image_name)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `data` FROM `images` WHERE `name`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
-    char *image_name = pddby_string_downcase(pddby, name);
-    if (!image_name)
+    if (pddby->pack)
+    {
+        int64_t id = pddby_pack_find_image_by_name(pddby->pack, image_name);
+        free(image_name);
+        return pddby_image_new_from_pack(pddby, id);
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_IMAGE_BY_NAME);
+    if (!db_stmt)
     {
         goto error;
     }
@@ -189,14 +521,11 @@ pddby_image_t* pddby_image_find_by_name(pddby_t* pddby, char const* name)
     case -1:
         goto error;
     case 0:
+        free(image_name);
         return NULL;
     }
 
-    int64_t id = pddby_db_column_int64(db_stmt, 0);
-    void const* data = pddby_db_column_blob(db_stmt, 1);
-    size_t data_length = pddby_db_column_bytes(db_stmt, 1);
-
-    pddby_image_t* image = pddby_image_new_with_id(pddby, id, image_name, data, data_length);
+    pddby_image_t* image = pddby_image_new_from_db(pddby, pddby_db_column_int64(db_stmt, 0), image_name, db_stmt, 1);
 
     free(image_name);
 
@@ -204,6 +533,10 @@ pddby_image_t* pddby_image_find_by_name(pddby_t* pddby, char const* name)
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find image object with name = \"%s\"", name);
+    if (image_name)
+    {
+        free(image_name);
+    }
     return NULL;
 }
 
@@ -214,15 +547,32 @@ pddby_images_t* pddby_images_new(pddby_t* pddby)
 
 pddby_images_t* pddby_images_find_by_traffreg(pddby_t* pddby, int64_t traffreg_id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    if (pddby->pack)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT i.`rowid`, i.`name`, i.`data` FROM `images` i INNER JOIN "
-            "`images_traffregs` it ON i.`rowid`=it.`image_id` WHERE it.`traffreg_id`=?");
-        if (!db_stmt)
+        pddby_images_t* images = pddby_images_new(pddby);
+        if (!images)
         {
             goto error;
         }
+
+        size_t count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_traffreg_images, traffreg_id, &count);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!pddby_array_add(images, pddby_image_new_from_pack(pddby, ids[i])))
+            {
+                pddby_images_free(images);
+                goto error;
+            }
+        }
+
+        return images;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_IMAGES_BY_TRAFFREG);
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -242,10 +592,8 @@ pddby_images_t* pddby_images_find_by_traffreg(pddby_t* pddby, int64_t traffreg_i
     {
         int64_t id = pddby_db_column_int64(db_stmt, 0);
         char const* name = pddby_db_column_text(db_stmt, 1);
-        void const* data = pddby_db_column_blob(db_stmt, 2);
-        size_t data_length = pddby_db_column_bytes(db_stmt, 2);
 
-        if (!pddby_array_add(images, pddby_image_new_with_id(pddby, id, name, data, data_length)))
+        if (!pddby_array_add(images, pddby_image_new_from_db(pddby, id, name, db_stmt, 2)))
         {
             ret = -1;
             break;
@@ -265,6 +613,88 @@ error:
     return NULL;
 }
 
+static void pddby_image_row_read_db(void* row, int fields, pddby_db_stmt_t* db_stmt)
+{
+    pddby_image_row_t* image = row;
+    image->id = pddby_db_column_int64(db_stmt, 0);
+    image->name = fields & pddby_cursor_field_text ? pddby_db_column_text(db_stmt, 1) : NULL;
+    if (fields & pddby_cursor_field_data)
+    {
+        image->stored_data = pddby_db_column_blob(db_stmt, 2);
+        image->stored_data_length = pddby_db_column_bytes(db_stmt, 2);
+        image->stored_format = pddby_db_column_int(db_stmt, 3);
+        image->data_length = pddby_db_column_int64(db_stmt, 4);
+    }
+}
+
+static int pddby_image_row_read_pack(void* row, int fields, pddby_pack_t const* pack, int64_t id)
+{
+    struct pddby_pack_image const* pack_image = pddby_pack_record(pack, pddby_pack_images, id);
+    if (!pack_image)
+    {
+        return 0;
+    }
+
+    pddby_image_row_t* image = row;
+    image->id = id;
+    image->name = fields & pddby_cursor_field_text ? pddby_pack_string(pack, pack_image->name) : NULL;
+    if (fields & pddby_cursor_field_data)
+    {
+        image->stored_data = pddby_pack_blob(pack, pack_image->data_offset, pack_image->data_size);
+        image->stored_data_length = image->stored_data ? pack_image->data_size : 0;
+        image->stored_format = pddby_compress_format_raw;
+        image->data_length = image->stored_data_length;
+    }
+    return 1;
+}
+
+pddby_cursor_t* pddby_images_cursor_by_traffreg(pddby_t* pddby, int64_t traffreg_id, int fields)
+{
+    if (pddby->pack)
+    {
+        size_t count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_traffreg_images, traffreg_id, &count);
+        pddby_cursor_t* cursor = pddby_cursor_new_from_pack(pddby, fields, sizeof(pddby_image_row_t), ids, count,
+            &pddby_image_row_read_pack);
+        if (!cursor)
+        {
+            goto error;
+        }
+        return cursor;
+    }
+
+    // without data neither image store nor image data pages are touched
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(pddby, fields & pddby_cursor_field_data ?
+        "SELECT i.`id`, i.`name`, COALESCE(d.`data`, s.`data`), COALESCE(d.`format`, s.`format`), "
+        "COALESCE(d.`size`, s.`size`) FROM `images_traffregs` it INNER JOIN `images` i ON i.`id`=it.`image_id` LEFT "
+        "JOIN `image_data` d ON d.`image_id`=i.`id` LEFT JOIN `image_store` s ON s.`hash`=i.`hash` WHERE "
+        "it.`traffreg_id`=? ORDER BY it.`position`" :
+        "SELECT i.`id`, i.`name` FROM `images_traffregs` it INNER JOIN `images` i ON i.`id`=it.`image_id` WHERE "
+        "it.`traffreg_id`=? ORDER BY it.`position`");
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
+    if (!pddby_db_bind_int64(db_stmt, 1, traffreg_id))
+    {
+        pddby_db_finalize(db_stmt);
+        goto error;
+    }
+
+    pddby_cursor_t* cursor = pddby_cursor_new_from_db(pddby, fields, sizeof(pddby_image_row_t), db_stmt,
+        &pddby_image_row_read_db);
+    if (!cursor)
+    {
+        goto error;
+    }
+    return cursor;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to open image cursor with traffreg id = %lld", traffreg_id);
+    return NULL;
+}
+
 void pddby_images_free(pddby_images_t* images)
 {
     assert(images);
@@ -7,6 +7,7 @@ extern "C"
 #endif
 
 #include "array.h"
+#include "cursor.h"
 #include "pddby.h"
 
 #include <stdint.h>
@@ -17,23 +18,56 @@ struct pddby_image
 
     int64_t id;
     char* name;
+    // use pddby_image_get_data or pddby_image_reader_new, images found in storage only read their data on request
     void* data;
     size_t data_length;
+
+    // where in storage data is and how it is kept there
+    int stored_format;
+    int stored_location;
+    int64_t stored_row_id;
 };
 
 typedef struct pddby_image pddby_image_t;
 typedef pddby_array_t pddby_images_t;
 
+// borrowed view of image, see pddby_cursor_next; data is left the way it is stored, compressed or not
+struct pddby_image_row
+{
+    int64_t id;
+    char const* name;
+    size_t data_length;
+
+    int stored_format;
+    void const* stored_data;
+    size_t stored_data_length;
+};
+
+typedef struct pddby_image_row pddby_image_row_t;
+
 pddby_image_t* pddby_image_new(pddby_t* pddby, char const* name, void const* data, size_t data_length);
 void pddby_image_free(pddby_image_t* image);
 
 int pddby_image_save(pddby_image_t* image);
 
+void const* pddby_image_get_data(pddby_image_t* image, size_t* data_length);
+
+struct pddby_image_reader;
+typedef struct pddby_image_reader pddby_image_reader_t;
+
+// streams image data in pieces straight out of storage, e.g. into image decoder, without keeping all of it around
+pddby_image_reader_t* pddby_image_reader_new(pddby_image_t* image);
+void pddby_image_reader_free(pddby_image_reader_t* reader);
+// 1 with up to size bytes put into buffer, 0 once all data is read, -1 on error
+int pddby_image_reader_read(pddby_image_reader_t* reader, void* buffer, size_t size, size_t* read_size);
+
 pddby_image_t* pddby_image_find_by_id(pddby_t* pddby, int64_t id);
 pddby_image_t* pddby_image_find_by_name(pddby_t* pddby, char const* name);
 
 pddby_images_t* pddby_images_new(pddby_t* pddby);
 pddby_images_t* pddby_images_find_by_traffreg(pddby_t* pddby, int64_t traffreg_id);
+// yields pddby_image_row_t rows
+pddby_cursor_t* pddby_images_cursor_by_traffreg(pddby_t* pddby, int64_t traffreg_id, int fields);
 void pddby_images_free(pddby_images_t* images);
 
 #ifdef __cplusplus
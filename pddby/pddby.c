@@ -2,17 +2,42 @@
 
 #include "private/decode/decode.h"
 #include "private/decode/decode_context.h"
+#include "private/decode/decode_manifest.h"
+#include "private/decode/decode_sink.h"
+#include "private/decode/decode_task.h"
 #include "private/pddby.h"
+#include "private/question.h"
 #include "private/util/database.h"
+#include "private/util/identity.h"
+#include "private/util/log.h"
+#include "private/util/pack.h"
+#include "private/util/seal.h"
+#include "private/util/settings.h"
+#include "private/util/trace.h"
 #include "private/util/report.h"
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 pddby_t* pddby_init(char const* share_dir, char const* cache_dir, pddby_callbacks_t const* callbacks)
 {
-    srand(time(0));
+    (void)share_dir;
+
+    pddby_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.cache_dir = cache_dir;
+    options.callbacks = callbacks;
+    options.log_level = pddby_message_type_debug;
+
+    return pddby_init_with_options(&options);
+}
+
+pddby_t* pddby_init_with_options(pddby_options_t const* options)
+{
+    assert(options);
 
     pddby_t* result = calloc(1, sizeof(pddby_t));
     if (!result)
@@ -20,9 +45,80 @@ pddby_t* pddby_init(char const* share_dir, char const* cache_dir, pddby_callback
         return NULL;
     }
 
-    result->callbacks = callbacks;
+    result->callbacks = options->callbacks;
+    result->progress.interval_msec = 100;
+    result->log_level = options->log_level;
+
+    pddby_random_init(&result->random, options->use_random_seed ? options->random_seed :
+        (uint64_t)time(0) ^ (uintptr_t)result);
+
+    if (options->trace_path)
+    {
+        result->trace_path = strdup(options->trace_path);
+        if (!result->trace_path)
+        {
+            free(result);
+            return NULL;
+        }
+    }
 
-    pddby_db_init(result, share_dir, cache_dir);
+    if (options->log_buffer_size > 0)
+    {
+        result->log = pddby_log_new(result, options->log_buffer_size);
+        if (!result->log)
+        {
+            if (result->trace_path)
+            {
+                free(result->trace_path);
+            }
+            free(result);
+            return NULL;
+        }
+    }
+
+    result->identity_map = pddby_identity_map_new(result);
+    result->settings = pddby_settings_new(result);
+    if (!result->identity_map || !result->settings)
+    {
+        if (result->settings)
+        {
+            pddby_settings_free(result->settings);
+        }
+        if (result->identity_map)
+        {
+            pddby_identity_map_free(result->identity_map);
+        }
+        if (result->log)
+        {
+            pddby_log_free(result->log);
+        }
+        if (result->trace_path)
+        {
+            free(result->trace_path);
+        }
+        free(result);
+        return NULL;
+    }
+
+    pthread_mutex_init(&result->random_mutex, NULL);
+
+    pddby_db_init(result, options->cache_dir);
+    pddby_db_set_image_store(result, options->image_store_path);
+
+    if (options->prefetch_cache)
+    {
+        pddby_db_prefetch(result);
+    }
+
+    if (options->pack_path && access(options->pack_path, R_OK) == 0)
+    {
+        // broken pack is not fatal, database is still there to decode into
+        result->pack = pddby_pack_open(result, options->pack_path);
+        if (result->pack)
+        {
+            pddby_settings_load(result);
+        }
+    }
 
     return result;
 }
@@ -32,10 +128,57 @@ void pddby_close(pddby_t* pddby)
     assert(pddby);
 
     pddby_db_cleanup(pddby);
+    pddby_identity_map_free(pddby->identity_map);
+    pddby_settings_free(pddby->settings);
+
+    if (pddby->pack)
+    {
+        pddby_pack_close(pddby->pack);
+    }
+
+    if (pddby->decode_output_path)
+    {
+        free(pddby->decode_output_path);
+    }
+    if (pddby->trace_path)
+    {
+        free(pddby->trace_path);
+    }
+    if (pddby->log)
+    {
+        pddby_drain_messages(pddby, 0);
+        pddby_log_free(pddby->log);
+    }
 
+    pthread_mutex_destroy(&pddby->random_mutex);
     free(pddby);
 }
 
+int pddby_drain_messages(pddby_t* pddby, int max_count)
+{
+    assert(pddby);
+
+    if (!pddby->log)
+    {
+        return 0;
+    }
+
+    return pddby_log_drain(pddby->log, max_count > 0 ? max_count : 0);
+}
+
+static void pddby_decode_finish_trace(pddby_t* pddby, pddby_trace_span_t const* span)
+{
+    if (!pddby->trace)
+    {
+        return;
+    }
+
+    pddby_trace_end(pddby, span, pddby->progress.bytes, pddby->progress.items);
+    pddby_trace_finish(pddby->trace);
+    pddby_trace_free(pddby->trace);
+    pddby->trace = NULL;
+}
+
 int pddby_decode(pddby_t* pddby, char const* root_path)
 {
     assert(pddby);
@@ -53,27 +196,84 @@ int pddby_decode(pddby_t* pddby, char const* root_path)
         NULL
     };
 
+    // rough relative cost of each stage, used to estimate overall progress
+    static double const s_decode_stage_weights[] =
+    {
+        45,
+        5,
+        10,
+        40
+    };
+
+    if (pddby->trace_path || (pddby->callbacks && pddby->callbacks->trace_summary))
+    {
+        pddby->trace = pddby_trace_new(pddby, pddby->trace_path);
+    }
+
+    pddby_trace_span_t decode_span;
+    pddby_trace_begin(pddby, &decode_span, pddby_trace_decode);
+
+    // decoding into existing cache may change rows behind objects mapped so far
+    pddby_identity_map_clear(pddby->identity_map);
+
     pddby->decode_context = pddby_decode_context_new(pddby, root_path);
     if (!pddby->decode_context)
     {
         goto error;
     }
 
+    pddby_report_stages_begin(pddby, s_decode_stage_weights,
+        sizeof(s_decode_stage_weights) / sizeof(*s_decode_stage_weights));
+
     for (pddby_decode_stage_t const* stage = s_decode_stages; *stage; stage++)
     {
-        if (!(*stage)(pddby))
+        pddby_report_stage(pddby, stage - s_decode_stages);
+
+        int64_t const stage_bytes = pddby->progress.bytes;
+        int64_t const stage_items = pddby->progress.items;
+
+        pddby_trace_span_t stage_span;
+        pddby_trace_begin(pddby, &stage_span, pddby_trace_stage_images + (stage - s_decode_stages));
+        int const stage_result = (*stage)(pddby);
+        pddby_trace_end(pddby, &stage_span, pddby->progress.bytes - stage_bytes, pddby->progress.items - stage_items);
+
+        if (!stage_result)
         {
             goto error;
         }
     }
 
+    pddby_report_stages_end(pddby);
+
+    pddby_decode_manifest_t* manifest = pddby->decode_context->manifest;
+    if ((manifest && !pddby_decode_manifest_save(manifest)) ||
+        !pddby_decode_sink_finish(pddby->decode_context->sink) ||
+        (manifest && !pddby_decode_manifest_commit(manifest)))
+    {
+        goto error;
+    }
+
     pddby_decode_context_free(pddby->decode_context);
     pddby->decode_context = NULL;
 
+    // questions may have been added or removed by decode
+    pddby_questions_pool_invalidate(pddby);
+
+    pddby_decode_finish_trace(pddby, &decode_span);
+
     return 1;
 
 error:
-    pddby_report(pddby, pddby_message_type_error, "unable to decode");
+    pddby_report_stages_end(pddby);
+
+    if (pddby_decode_task_is_cancelled(pddby))
+    {
+        pddby_report(pddby, pddby_message_type_log, "decode cancelled");
+    }
+    else
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to decode");
+    }
 
     if (pddby->decode_context)
     {
@@ -81,14 +281,49 @@ error:
         pddby->decode_context = NULL;
     }
 
+    pddby_decode_finish_trace(pddby, &decode_span);
+
     return 0;
 }
 
+int pddby_decode_set_output(pddby_t* pddby, int output, char const* path)
+{
+    assert(pddby);
+
+    char* new_path = NULL;
+    if (path)
+    {
+        new_path = strdup(path);
+        if (!new_path)
+        {
+            pddby_report(pddby, pddby_message_type_error, "unable to set decode output");
+            return 0;
+        }
+    }
+
+    if (pddby->decode_output_path)
+    {
+        free(pddby->decode_output_path);
+    }
+
+    pddby->decode_output = output;
+    pddby->decode_output_path = new_path;
+
+    return 1;
+}
+
+void pddby_set_progress_frequency(pddby_t* pddby, int frequency)
+{
+    assert(pddby);
+
+    pddby->progress.interval_msec = frequency > 0 ? 1000 / frequency : 0;
+}
+
 int pddby_cache_exists(pddby_t* pddby)
 {
     assert(pddby);
 
-    return pddby_db_exists(pddby);
+    return pddby->pack || pddby_db_exists(pddby);
 }
 
 void pddby_use_cache(pddby_t* pddby, int value)
@@ -97,3 +332,26 @@ void pddby_use_cache(pddby_t* pddby, int value)
 
     pddby_db_use_cache(pddby, value);
 }
+
+int pddby_sealed_cache_exists(pddby_t* pddby)
+{
+    assert(pddby);
+
+    return pddby_db_sealed_exists(pddby);
+}
+
+void pddby_use_sealed_cache(pddby_t* pddby, int value)
+{
+    assert(pddby);
+
+    pddby_db_use_sealed(pddby, value);
+}
+
+int pddby_open_sealed_cache(pddby_t* pddby, char const* root_path)
+{
+    assert(pddby);
+    assert(root_path);
+
+    uint8_t key[PDDBY_SEAL_KEY_SIZE];
+    return pddby_decode_disc_key(pddby, root_path, key) && pddby_db_load_sealed(pddby, key);
+}
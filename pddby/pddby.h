@@ -6,7 +6,10 @@ extern "C"
 {
 #endif
 
+#include <stdint.h>
+
 typedef struct pddby pddby_t;
+typedef struct pddby_decode_task pddby_decode_task_t;
 
 enum pddby_message_type
 {
@@ -16,6 +19,36 @@ enum pddby_message_type
     pddby_message_type_error
 };
 
+struct pddby_progress
+{
+    // current stage and its position, stage is -1 outside of decode
+    int stage;
+    int stage_count;
+    int pos;
+    int size;
+
+    // overall completion in [0, 1], stages weighted by their expected cost
+    double fraction;
+    double items_per_second;
+    double bytes_per_second;
+    // estimated seconds left, negative if not known yet
+    double eta;
+};
+
+typedef struct pddby_progress pddby_progress_t;
+
+// totals for one kind of work done during decode (e.g. "file_read", "regex", "insert")
+struct pddby_trace_entry
+{
+    char const* name;
+    unsigned long count;
+    double seconds;
+    unsigned long long bytes;
+    unsigned long long records;
+};
+
+typedef struct pddby_trace_entry pddby_trace_entry_t;
+
 struct pddby_callbacks
 {
     void (*message)(pddby_t* pddby, int type, char const* text);
@@ -23,18 +56,97 @@ struct pddby_callbacks
     void (*progress_begin)(pddby_t* pddby, int size);
     void (*progress)(pddby_t* pddby, int pos);
     void (*progress_end)(pddby_t* pddby);
+
+    // optional, called at the same (rate-limited) points as progress
+    void (*progress_ex)(pddby_t* pddby, pddby_progress_t const* progress);
+
+    // optional, enables timing of decode and receives its totals once decode is finished
+    void (*trace_summary)(pddby_t* pddby, pddby_trace_entry_t const* entries, int count);
 };
 
 typedef struct pddby_callbacks pddby_callbacks_t;
 
+struct pddby_options
+{
+    // unused since schema SQL is built into library, kept for source compatibility
+    char const* share_dir;
+    char const* cache_dir;
+    pddby_callbacks_t const* callbacks;
+
+    // messages of lower type are dropped before being formatted
+    int log_level;
+    // if non-zero, messages are kept in a buffer of that many slots and only delivered through message callback
+    // from pddby_drain_messages; this is cheap to log into from any thread
+    int log_buffer_size;
+
+    // if set, decode timeline is written there in Chrome trace event format (chrome://tracing, Perfetto)
+    char const* trace_path;
+
+    // if non-zero, existing cache file is read ahead in background so that first queries don't wait for disk
+    int prefetch_cache;
+
+    // if set and pack file produced by decode exists there, all data is served from it instead of database
+    char const* pack_path;
+
+    // if set, image payloads of cache file go to database there, which can be shared by caches of different discs
+    // so that images they have in common are only decrypted and stored once
+    char const* image_store_path;
+
+    // if set, random tickets drawn through handle are the same from run to run for the same random_seed (zero
+    // included), otherwise generator is seeded from time
+    int use_random_seed;
+    uint64_t random_seed;
+};
+
+typedef struct pddby_options pddby_options_t;
+
+enum pddby_decode_output
+{
+    pddby_decode_output_database,
+    pddby_decode_output_null,
+    pddby_decode_output_jsonl,
+    // read-only memory-mappable snapshot, see pack_path option
+    pddby_decode_output_pack
+};
+
+// handles share no state: each has its own database connection and prepared statements, so different handles may
+// be used from different threads at the same time; a single handle must only be used by one thread at a time, except
+// that once the thread that created it has queried a complete cache, other threads may read through it too, each
+// getting its own connection to the cache; decoding or writing anything still needs the handle to itself
+//
+// topics, sections, comments and traffregs found through a handle are shared: finding the same row again returns the
+// same object, which must not be modified; every find or retain is matched by release (or free), all before the
+// handle is closed
+//
+// share_dir is unused, see pddby_options
 pddby_t* pddby_init(char const* share_dir, char const* cache_dir, pddby_callbacks_t const* callbacks);
+pddby_t* pddby_init_with_options(pddby_options_t const* options);
 void pddby_close(pddby_t* pddby);
 
+// delivers up to max_count (0 for all) buffered messages, returns number of messages delivered
+int pddby_drain_messages(pddby_t* pddby, int max_count);
+
 int pddby_decode(pddby_t* pddby, char const* root_path);
+int pddby_decode_set_output(pddby_t* pddby, int output, char const* path);
+
+// runs decode on a worker thread; callbacks are queued and only delivered from pddby_decode_task_dispatch, which
+// should be called periodically from frontend's own loop; handle must not be used otherwise until task is finished
+pddby_decode_task_t* pddby_decode_async(pddby_t* pddby, char const* root_path);
+int pddby_decode_task_dispatch(pddby_decode_task_t* task);
+void pddby_decode_task_cancel(pddby_decode_task_t* task);
+int pddby_decode_task_finish(pddby_decode_task_t* task);
+
+// limits progress callbacks to given number per second, 0 to report every item
+void pddby_set_progress_frequency(pddby_t* pddby, int frequency);
 
 int pddby_cache_exists(pddby_t* pddby);
 void pddby_use_cache(pddby_t* pddby, int value);
 
+// sealed cache is encrypted with key derived from disc and can only be opened while that disc is at root_path
+int pddby_sealed_cache_exists(pddby_t* pddby);
+void pddby_use_sealed_cache(pddby_t* pddby, int value);
+int pddby_open_sealed_cache(pddby_t* pddby, char const* root_path);
+
 #ifdef __cplusplus
 }
 #endif
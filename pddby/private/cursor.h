@@ -0,0 +1,22 @@
+#ifndef PDDBY_PRIVATE_CURSOR_H
+#define PDDBY_PRIVATE_CURSOR_H
+
+#include "cursor.h"
+#include "private/util/database.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct pddby_pack;
+
+typedef void (*pddby_cursor_read_db_func_t)(void* row, int fields, pddby_db_stmt_t* db_stmt);
+typedef int (*pddby_cursor_read_pack_func_t)(void* row, int fields, struct pddby_pack const* pack, int64_t id);
+
+// takes over db_stmt, which is finalized along with cursor
+pddby_cursor_t* pddby_cursor_new_from_db(pddby_t* pddby, int fields, size_t row_size, pddby_db_stmt_t* db_stmt,
+    pddby_cursor_read_db_func_t read_func);
+// ids are links borrowed from pack
+pddby_cursor_t* pddby_cursor_new_from_pack(pddby_t* pddby, int fields, size_t row_size, uint32_t const* ids,
+    size_t count, pddby_cursor_read_pack_func_t read_func);
+
+#endif // PDDBY_PRIVATE_CURSOR_H
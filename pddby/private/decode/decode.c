@@ -2,21 +2,22 @@
 
 #include "decode_context.h"
 #include "decode_image.h"
+#include "decode_manifest.h"
 #include "decode_questions.h"
+#include "decode_sink.h"
+#include "decode_task.h"
 
-#include "comment.h"
 #include "config.h"
 #include "private/pddby.h"
 #include "private/platform.h"
 #include "private/util/aux.h"
-#include "private/util/database.h"
 #include "private/util/delphi.h"
 #include "private/util/regex.h"
 #include "private/util/report.h"
 #include "private/util/settings.h"
+#include "private/util/trace.h"
 #include "section.h"
 #include "topic.h"
-#include "traffreg.h"
 
 #include <dirent.h>
 #include <errno.h>
@@ -30,35 +31,25 @@
 #include <dmalloc.h>
 #endif
 
-typedef void* (*pddby_object_new_t)(pddby_t* pddby, int32_t, char const*);
-typedef int (*pddby_object_save_t)(void*);
-typedef void (*pddby_object_free_t)(void*);
-typedef int (*pddby_object_set_images_t)(void*, pddby_images_t* images);
-
 int pddby_decode_images(pddby_t* pddby)
 {
-    char** image_dir_names = NULL;
-
-    char* raw_image_dirs = pddby_settings_get(pddby, "image_dirs");
-    if (!raw_image_dirs)
-    {
-        goto error;
-    }
-
-    image_dir_names = pddby_string_split(pddby, raw_image_dirs, ":");
-    free(raw_image_dirs);
+    size_t image_dir_count;
+    char const* const* image_dir_names = pddby_settings_get_string_list(pddby, pddby_setting_image_dirs,
+        &image_dir_count);
     if (!image_dir_names)
     {
         goto error;
     }
 
-    if (!pddby_db_tx_begin(pddby))
+    if (!pddby_decode_sink_batch_begin(pddby->decode_context->sink))
     {
         goto error;
     }
 
+    pddby_report_stage_parts(pddby, image_dir_count);
+
     int result = 1;
-    char** dir_name = image_dir_names;
+    char const* const* dir_name = image_dir_names;
     while (*dir_name)
     {
         DIR* dir = NULL;
@@ -76,6 +67,9 @@ int pddby_decode_images(pddby_t* pddby)
             goto cycle_error;
         }
 
+        pddby_trace_span_t span;
+        pddby_trace_begin(pddby, &span, pddby_trace_dir_scan);
+
         dir = opendir(images_path);
         if (!dir)
         {
@@ -112,17 +106,27 @@ int pddby_decode_images(pddby_t* pddby)
         }
         dir = NULL;
 
+        pddby_trace_end(pddby, &span, 0, pddby_array_size(image_dirs));
+
         pddby_report_progress_begin(pddby, pddby_array_size(image_dirs));
 
         for (size_t i = 0, size = pddby_array_size(image_dirs); i < size; i++)
         {
+            if (pddby_decode_task_is_cancelled(pddby))
+            {
+                goto cycle_error;
+            }
+
             char* image_path = pddby_aux_build_filename(pddby, images_path, pddby_array_index(image_dirs, i), 0);
             if (!image_path)
             {
                 goto cycle_error;
             }
 
-            result = pddby_decode_image(pddby, image_path, pddby->decode_context->image_magic);
+            int const changed = pddby->decode_context->manifest ?
+                pddby_decode_manifest_check(pddby->decode_context->manifest, image_path) : 1;
+            result = changed != -1 &&
+                (!changed || pddby_decode_image(pddby, image_path, pddby->decode_context->image_magic));
             free(image_path);
             if (!result)
             {
@@ -162,22 +166,15 @@ cycle_error:
         goto error;
     }
 
-    if (!pddby_db_tx_commit(pddby))
+    if (!pddby_decode_sink_batch_end(pddby->decode_context->sink))
     {
         goto error;
     }
 
-    pddby_stringv_free(image_dir_names);
     return result;
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to decode images");
-
-    if (image_dir_names)
-    {
-        pddby_stringv_free(image_dir_names);
-    }
-
     return 0;
 }
 
@@ -185,7 +182,7 @@ static int32_t* pddby_decode_table(pddby_t* pddby, uint16_t magic, char const* p
 {
     int32_t* table = NULL;
     char* t = NULL;
-    if (!pddby_aux_file_get_contents(pddby, path, &t, table_size))
+    if (!pddby_decode_file_get_contents(pddby, path, &t, table_size))
     {
         goto error;
     }
@@ -225,9 +222,8 @@ error:
     return NULL;
 }
 
-static int pddby_decode_simple_data(pddby_t* pddby, char const* dat_path, char const* dbt_path,
-    pddby_object_new_t object_new, pddby_object_save_t object_save, pddby_object_free_t object_free,
-    pddby_object_set_images_t object_set_images)
+static int pddby_decode_simple_data(pddby_t* pddby, char const* dat_path, char const* dbt_path, int record_type,
+    pddby_map_t* record_ids)
 {
     struct markup_regex_data
     {
@@ -337,7 +333,7 @@ static int pddby_decode_simple_data(pddby_t* pddby, char const* dat_path, char c
         }
     }
 
-    if (!pddby_db_tx_begin(pddby))
+    if (!pddby_decode_sink_batch_begin(pddby->decode_context->sink))
     {
         goto error;
     }
@@ -345,24 +341,26 @@ static int pddby_decode_simple_data(pddby_t* pddby, char const* dat_path, char c
     pddby_report_progress_begin(pddby, table_size);
 
     int result = 1;
+    int64_t* image_ids = NULL;
     for (size_t i = 0; i < table_size; i++)
     {
-        void* object = NULL;
         char* number = NULL;
         char* images = NULL;
         char* text = NULL;
+        size_t image_ids_size = 0;
 
-        pddby_images_t* object_images = pddby_images_new(pddby);
-        if (!object_images)
+        if (pddby_decode_task_is_cancelled(pddby))
         {
             goto cycle_error;
         }
 
-        if (table[i] == -1)
-        {
-            object = object_new(pddby, table[i], NULL);
-        }
-        else
+        pddby_decode_record_t record;
+        record.type = record_type;
+        // comment and traffreg records share layout
+        record.value.comment.number = table[i];
+        record.value.comment.text = NULL;
+
+        if (table[i] != -1)
         {
             int32_t next_offset = str_size;
             for (size_t j = 0; j < table_size; j++)
@@ -373,11 +371,15 @@ static int pddby_decode_simple_data(pddby_t* pddby, char const* dat_path, char c
                 }
             }
 
+            pddby_trace_span_t span;
+            pddby_trace_begin(pddby, &span, pddby_trace_convert);
             char* data = pddby_string_convert(pddby->decode_context->iconv, str + table[i], next_offset - table[i]);
+            pddby_trace_end(pddby, &span, next_offset - table[i], 1);
             if (!data)
             {
                 goto cycle_error;
             }
+            pddby_report_progress_bytes(pddby, next_offset - table[i]);
 
             pddby_regex_match_t* match;
             if (!pddby_regex_match(simple_data_regex, data, &match))
@@ -421,20 +423,34 @@ static int pddby_decode_simple_data(pddby_t* pddby, char const* dat_path, char c
                     goto cycle_error;
                 }
 
+                int64_t* new_image_ids = realloc(image_ids, pddby_stringv_length(image_names) * sizeof(int64_t));
+                if (!new_image_ids)
+                {
+                    pddby_stringv_free(image_names);
+                    goto cycle_error;
+                }
+                image_ids = new_image_ids;
+
                 char** in = image_names;
                 while (*in)
                 {
-                    pddby_image_t* image = pddby_image_find_by_name(pddby, pddby_string_chomp(*in + 1));
-                    if (!image)
+                    char* image_name = pddby_string_downcase(pddby, pddby_string_chomp(*in + 1));
+                    if (!image_name)
                     {
                         pddby_stringv_free(image_names);
                         goto cycle_error;
                     }
-                    if (!pddby_array_add(object_images, image))
+                    if (!pddby_map_get(pddby->decode_context->image_ids, image_name, strlen(image_name),
+                        &image_ids[image_ids_size]))
                     {
+                        pddby_report(pddby, pddby_message_type_error, "unable to find image with name = \"%s\"",
+                            image_name);
+                        free(image_name);
                         pddby_stringv_free(image_names);
                         goto cycle_error;
                     }
+                    free(image_name);
+                    image_ids_size++;
                     in++;
                 }
                 pddby_stringv_free(image_names);
@@ -453,31 +469,44 @@ static int pddby_decode_simple_data(pddby_t* pddby, char const* dat_path, char c
                 text = new_text;
             }
 
-            object = object_new(pddby, atoi(number), pddby_string_chomp(text));
-
-            free(text);
-            free(images);
-            free(number);
-
-            number = images = text = NULL;
+            record.value.comment.number = atoi(number);
+            record.value.comment.text = pddby_string_chomp(text);
         }
-        if (!object)
+
+        if (!pddby_decode_sink_write(pddby->decode_context->sink, &record))
         {
             goto cycle_error;
         }
 
-        if (!object_save(object))
+        if (!pddby_map_set(record_ids, &record.value.comment.number, sizeof(int32_t), record.id))
         {
             goto cycle_error;
         }
 
-        if (object_set_images && !object_set_images(object, object_images))
+        if (record_type == pddby_decode_record_traffreg)
         {
-            goto cycle_error;
+            for (size_t j = 0; j < image_ids_size; j++)
+            {
+                if (!pddby_decode_sink_write_link(pddby->decode_context->sink, pddby_decode_link_image_traffreg,
+                    image_ids[j], record.id))
+                {
+                    goto cycle_error;
+                }
+            }
         }
 
-        pddby_images_free(object_images);
-        object_free(object);
+        if (text)
+        {
+            free(text);
+        }
+        if (images)
+        {
+            free(images);
+        }
+        if (number)
+        {
+            free(number);
+        }
 
         pddby_report_progress(pddby, i + 1);
         continue;
@@ -485,9 +514,9 @@ static int pddby_decode_simple_data(pddby_t* pddby, char const* dat_path, char c
 cycle_error:
         pddby_report(pddby, pddby_message_type_error, "unable to decode simple data object #%lu", i);
 
-        if (object_images)
+        if (image_ids)
         {
-            pddby_images_free(object_images);
+            free(image_ids);
         }
         if (text)
         {
@@ -501,17 +530,18 @@ cycle_error:
         {
             free(number);
         }
-        if (object)
-        {
-            object_free(object);
-        }
 
         goto error;
     }
 
+    if (image_ids)
+    {
+        free(image_ids);
+    }
+
     pddby_report_progress_end(pddby);
 
-    if (!pddby_db_tx_commit(pddby))
+    if (!pddby_decode_sink_batch_end(pddby->decode_context->sink))
     {
         goto error;
     }
@@ -558,6 +588,25 @@ error:
     return 0;
 }
 
+static int pddby_decode_simple_data_changed(pddby_t* pddby, char const* dat_path, char const* dbt_path)
+{
+    pddby_decode_manifest_t* manifest = pddby->decode_context->manifest;
+    if (!manifest)
+    {
+        return 1;
+    }
+
+    // both have to be recorded
+    int const dat_changed = pddby_decode_manifest_check(manifest, dat_path);
+    int const dbt_changed = pddby_decode_manifest_check(manifest, dbt_path);
+    if (dat_changed == -1 || dbt_changed == -1)
+    {
+        return -1;
+    }
+
+    return dat_changed || dbt_changed;
+}
+
 int pddby_decode_comments(pddby_t* pddby)
 {
     char* comments_dat_path = NULL;
@@ -577,9 +626,10 @@ int pddby_decode_comments(pddby_t* pddby)
         goto error;
     }
 
-    if (!pddby_decode_simple_data(pddby, comments_dat_path, comments_dbt_path,
-        (pddby_object_new_t)pddby_comment_new, (pddby_object_save_t)pddby_comment_save,
-        (pddby_object_free_t)pddby_comment_free, NULL))
+    int const changed = pddby_decode_simple_data_changed(pddby, comments_dat_path, comments_dbt_path);
+    if (changed == -1 ||
+        (changed && !pddby_decode_simple_data(pddby, comments_dat_path, comments_dbt_path,
+            pddby_decode_record_comment, pddby->decode_context->comment_ids)))
     {
         goto error;
     }
@@ -623,9 +673,12 @@ int pddby_decode_traffregs(pddby_t* pddby)
         goto error;
     }
 
-    if (!pddby_decode_simple_data(pddby, traffreg_dat_path, traffreg_dbt_path,
-        (pddby_object_new_t)pddby_traffreg_new, (pddby_object_save_t)pddby_traffreg_save,
-        (pddby_object_free_t)pddby_traffreg_free, (pddby_object_set_images_t)pddby_traffreg_set_images))
+    int const changed = pddby_decode_simple_data_changed(pddby, traffreg_dat_path, traffreg_dbt_path);
+    if (changed == -1 ||
+        (changed && pddby_decode_manifest_is_incremental(pddby->decode_context->manifest) &&
+            !pddby_decode_manifest_drop_traffreg_images(pddby->decode_context->manifest)) ||
+        (changed && !pddby_decode_simple_data(pddby, traffreg_dat_path, traffreg_dbt_path,
+            pddby_decode_record_traffreg, pddby->decode_context->traffreg_ids)))
     {
         goto error;
     }
@@ -662,6 +715,10 @@ int pddby_decode_questions(pddby_t* pddby)
         goto error;
     }
 
+    pddby_decode_manifest_t* manifest = pddby->decode_context->manifest;
+
+    // section tables tell which section every question belongs to
+    int sections_changed = 0;
     size_t sections_data_size = 0;
     for (size_t i = 0, size = pddby_array_size(sections); i < size; i++)
     {
@@ -681,6 +738,14 @@ int pddby_decode_questions(pddby_t* pddby)
             goto error;
         }
 
+        int const changed = manifest ? pddby_decode_manifest_check(manifest, section_dat_path) : 1;
+        if (changed == -1)
+        {
+            free(section_dat_path);
+            goto error;
+        }
+        sections_changed = sections_changed || changed;
+
         size_t size;
         pddby_topic_question_t* data = pddby_decode_topic_questions_table(pddby->decode_context, section_dat_path,
             &size);
@@ -713,6 +778,8 @@ int pddby_decode_questions(pddby_t* pddby)
         goto error;
     }
 
+    pddby_report_stage_parts(pddby, pddby_array_size(topics));
+
     for (size_t i = 0, size = pddby_array_size(topics); i < size; i++)
     {
         pddby_topic_t *topic = pddby_array_index(topics, i);
@@ -730,7 +797,25 @@ int pddby_decode_questions(pddby_t* pddby)
             goto error;
         }
 
-        int result = pddby_decode_questions_data(pddby->decode_context, part_dbt_path, topic->number, sections_data,
+        int const changed = manifest ? pddby_decode_manifest_check(manifest, part_dbt_path) : 1;
+        if (changed == -1)
+        {
+            free(part_dbt_path);
+            goto error;
+        }
+
+        if (!changed && !sections_changed)
+        {
+            free(part_dbt_path);
+            pddby_report_progress_begin(pddby, 0);
+            pddby_report_progress_end(pddby);
+            continue;
+        }
+
+        // questions get new ids, nothing refers to them yet
+        int result = (!pddby_decode_manifest_is_incremental(manifest) ||
+            pddby_decode_manifest_drop_topic_questions(manifest, topic->number)) &&
+            pddby_decode_questions_data(pddby->decode_context, part_dbt_path, topic->number, sections_data,
             sections_data_size);
         free(part_dbt_path);
         if (!result)
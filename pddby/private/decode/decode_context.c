@@ -1,8 +1,13 @@
 #include "decode_context.h"
 
+#include "private/pddby.h"
 #include "private/util/aux.h"
+#include "private/util/database.h"
 #include "private/util/delphi.h"
+#include "private/util/image_store.h"
 #include "private/util/report.h"
+#include "private/util/seal.h"
+#include "private/util/trace.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -12,6 +17,7 @@
 #include <time.h>
 
 static int pddby_decode_init_magic(pddby_decode_context_t* context);
+static int pddby_decode_derive_key(pddby_decode_context_t* context, uint8_t* key);
 
 static char* pddby_decode_string(pddby_decode_context_t* context, char const* path, size_t* str_size, int8_t topic_number);
 static char* pddby_decode_string_v12(pddby_decode_context_t* context, char const* path, size_t* str_size, int8_t topic_number);
@@ -34,11 +40,56 @@ pddby_decode_context_t* pddby_decode_context_new(pddby_t* pddby, char const* roo
     context->root_path = root_path;
     context->pddby = pddby;
 
-    if (!pddby_decode_init_magic(context))
+    pddby_trace_span_t span;
+    pddby_trace_begin(pddby, &span, pddby_trace_magic);
+    int const magic_result = pddby_decode_init_magic(context);
+    pddby_trace_end(pddby, &span, 0, 0);
+    if (!magic_result)
     {
         goto error;
     }
 
+    if (pddby_db_is_sealed(pddby) && !pddby_decode_derive_key(context, context->sealed_key))
+    {
+        goto error;
+    }
+
+    context->image_ids = pddby_map_new(pddby);
+    context->comment_ids = pddby_map_new(pddby);
+    context->traffreg_ids = pddby_map_new(pddby);
+    if (!context->image_ids || !context->comment_ids || !context->traffreg_ids)
+    {
+        goto error;
+    }
+
+    if (pddby->decode_output == pddby_decode_output_database && pddby_db_uses_cache(pddby))
+    {
+        // has to come before anything opens database
+        context->manifest = pddby_decode_manifest_new(pddby, root_path, context->data_magic, context->image_magic);
+        if (!context->manifest)
+        {
+            goto error;
+        }
+
+        if (pddby_decode_manifest_is_incremental(context->manifest) &&
+            (!pddby_decode_manifest_load_ids(context->manifest, pddby_decode_record_image, context->image_ids) ||
+            !pddby_decode_manifest_load_ids(context->manifest, pddby_decode_record_comment, context->comment_ids) ||
+            !pddby_decode_manifest_load_ids(context->manifest, pddby_decode_record_traffreg, context->traffreg_ids)))
+        {
+            goto error;
+        }
+    }
+
+    context->sink = pddby_decode_sink_new(pddby, pddby->decode_output, pddby->decode_output_path);
+    if (!context->sink)
+    {
+        goto error;
+    }
+
+    // other outputs need payloads of all images
+    context->use_image_store = pddby->decode_output == pddby_decode_output_database &&
+        pddby_image_store_is_available(pddby);
+
     return context;
 
 error:
@@ -52,10 +103,58 @@ error:
     return NULL;
 }
 
+int pddby_decode_file_get_contents(pddby_t* pddby, char const* path, char** buffer, size_t* buffer_size)
+{
+    if (!pddby_aux_file_get_contents(pddby, path, buffer, buffer_size))
+    {
+        return 0;
+    }
+
+    if (pddby->decode_context && pddby->decode_context->manifest &&
+        !pddby_decode_manifest_note_contents(pddby->decode_context->manifest, path, *buffer, *buffer_size))
+    {
+        free(*buffer);
+        *buffer = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+int pddby_decode_disc_key(pddby_t* pddby, char const* root_path, uint8_t* key)
+{
+    pddby_decode_context_t context;
+    memset(&context, 0, sizeof(context));
+    context.pddby = pddby;
+    context.root_path = root_path;
+
+    return pddby_decode_init_magic(&context) && pddby_decode_derive_key(&context, key);
+}
+
 void pddby_decode_context_free(pddby_decode_context_t* context)
 {
     assert(context);
 
+    if (context->manifest)
+    {
+        pddby_decode_manifest_free(context->manifest);
+    }
+    if (context->sink)
+    {
+        pddby_decode_sink_free(context->sink);
+    }
+    if (context->traffreg_ids)
+    {
+        pddby_map_free(context->traffreg_ids);
+    }
+    if (context->comment_ids)
+    {
+        pddby_map_free(context->comment_ids);
+    }
+    if (context->image_ids)
+    {
+        pddby_map_free(context->image_ids);
+    }
     if (context->iconv)
     {
         pddby_iconv_free(context->iconv);
@@ -96,11 +195,11 @@ static int pddby_decode_init_magic_2006(pddby_decode_context_t* context)
     }
 
     context->data_magic = 0;
-    pddby_delphi_set_randseed((buffer[0] | (buffer[1] << 8)) & 0x0ffff);
+    uint64_t rand_seed = (buffer[0] | (buffer[1] << 8)) & 0x0ffff;
 
     for (int i = 0; i < 255; i++)
     {
-        context->data_magic ^= buffer[pddby_delphi_random(16 * 1024)];
+        context->data_magic ^= buffer[pddby_delphi_random(&rand_seed, 16 * 1024)];
     }
     context->data_magic = context->data_magic * buffer[16 * 1024] + 0x1998;
 
@@ -156,7 +255,7 @@ static int pddby_decode_init_magic_2008(pddby_decode_context_t* context)
     }
 
     context->data_magic = 0x2008;
-    pddby_delphi_set_randseed((buffer[0] | (buffer[1] << 8)) & 0x0ffff);
+    uint64_t rand_seed = (buffer[0] | (buffer[1] << 8)) & 0x0ffff;
 
     while (!feof(f))
     {
@@ -171,7 +270,7 @@ static int pddby_decode_init_magic_2008(pddby_decode_context_t* context)
         }
         for (int i = 0; i < 256; i++)
         {
-            uint8_t ch = buffer[pddby_delphi_random(length)];
+            uint8_t ch = buffer[pddby_delphi_random(&rand_seed, length)];
             for (int j = 0; j < 8; j++)
             {
                 uint16_t old_magic = context->data_magic;
@@ -213,7 +312,8 @@ static int pddby_decode_init_magic(pddby_decode_context_t* context)
         goto error;
     }
 
-    struct tm root_tm = *gmtime(&root_stat.st_mtime);
+    struct tm root_tm;
+    gmtime_r(&root_stat.st_mtime, &root_tm);
 
     int result = 0;
     // TODO: better checks
@@ -290,20 +390,45 @@ error:
     return 0;
 }
 
+static int pddby_decode_derive_key(pddby_decode_context_t* context, uint8_t* key)
+{
+    // magic numbers alone are shared by discs of the same year, executable checksum tells them apart when present
+    char secret[64];
+    int const secret_size = snprintf(secret, sizeof(secret), "%04x%04x", context->data_magic, context->image_magic);
+
+    char* checksum = NULL;
+    char* pdd32_path = pddby_aux_build_filename_ci(context->pddby, context->root_path, "pdd32.exe", 0);
+    if (pdd32_path)
+    {
+        checksum = pddby_aux_file_get_checksum(context->pddby, pdd32_path);
+        free(pdd32_path);
+    }
+    if (checksum)
+    {
+        strncat(secret, checksum, sizeof(secret) - secret_size - 1);
+        free(checksum);
+    }
+
+    return pddby_seal_derive_key(context->pddby, secret, strlen(secret), key);
+}
+
 static char* pddby_decode_string(pddby_decode_context_t* context, char const* path, size_t* str_size, int8_t topic_number)
 {
     char* str;
-    if (!pddby_aux_file_get_contents(context->pddby, path, &str, str_size))
+    if (!pddby_decode_file_get_contents(context->pddby, path, &str, str_size))
     {
         pddby_report(context->pddby, pddby_message_type_error, "unable to decode string");
         return NULL;
     }
 
+    pddby_trace_span_t span;
+    pddby_trace_begin(context->pddby, &span, pddby_trace_decrypt);
     for (size_t i = 0; i < *str_size; i++)
     {
         // TODO: magic numbers?
         str[i] ^= (context->data_magic & 0x0ff) ^ topic_number ^ (i & 1 ? 0x30 : 0x16) ^ ((i + 1) % 255);
     }
+    pddby_trace_end(context->pddby, &span, *str_size, 0);
 
     return str;
 }
@@ -311,16 +436,19 @@ static char* pddby_decode_string(pddby_decode_context_t* context, char const* pa
 static char* pddby_decode_string_v12(pddby_decode_context_t* context, char const* path, size_t* str_size, int8_t topic_number)
 {
     char* str;
-    if (!pddby_aux_file_get_contents(context->pddby, path, &str, str_size))
+    if (!pddby_decode_file_get_contents(context->pddby, path, &str, str_size))
     {
         pddby_report(context->pddby, pddby_message_type_error, "unable to decode string");
         return NULL;
     }
 
+    pddby_trace_span_t span;
+    pddby_trace_begin(context->pddby, &span, pddby_trace_decrypt);
     for (size_t i = 0; i < *str_size; i++)
     {
         str[i] ^= (context->data_magic >> 8) ^ (i & 1 ? topic_number : 0) ^ (i & 1 ? 0x80 : 0xaa) ^ ((i + 1) % 255);
     }
+    pddby_trace_end(context->pddby, &span, *str_size, 0);
 
     return str;
 }
@@ -328,16 +456,19 @@ static char* pddby_decode_string_v12(pddby_decode_context_t* context, char const
 static char* pddby_decode_string_v13(pddby_decode_context_t* context, char const* path, size_t* str_size, int8_t topic_number)
 {
     char* str;
-    if (!pddby_aux_file_get_contents(context->pddby, path, &str, str_size))
+    if (!pddby_decode_file_get_contents(context->pddby, path, &str, str_size))
     {
         pddby_report(context->pddby, pddby_message_type_error, "unable to decode string");
         return NULL;
     }
 
+    pddby_trace_span_t span;
+    pddby_trace_begin(context->pddby, &span, pddby_trace_decrypt);
     for (size_t i = 0; i < *str_size; i++)
     {
         str[i] ^= (context->data_magic >> 8) ^ (i & 1 ? topic_number : 0) ^ (i & 1 ? 0x13 : 0x11) ^ ((i + 1) % 255);
     }
+    pddby_trace_end(context->pddby, &span, *str_size, 0);
 
     return str;
 }
@@ -1,7 +1,12 @@
 #ifndef PDDBY_PRIVATE_DECODE_CONTEXT_H
 #define PDDBY_PRIVATE_DECODE_CONTEXT_H
 
+#include "decode_manifest.h"
+#include "decode_sink.h"
+
 #include "pddby.h"
+#include "private/util/map.h"
+#include "private/util/seal.h"
 #include "private/util/string.h"
 
 #include <stdint.h>
@@ -19,9 +24,26 @@ struct pddby_decode_context
     uint16_t data_magic;
     uint16_t image_magic;
     pddby_decode_string_func_t decode_string;
+    // only derived when decoding into sealed cache
+    uint8_t sealed_key[PDDBY_SEAL_KEY_SIZE];
+    int use_image_store;
+
+    pddby_decode_sink_t* sink;
+    // only kept when decoding into cache file
+    pddby_decode_manifest_t* manifest;
+    // lookups of already decoded objects, so that decoding does not depend on reading sink output back
+    pddby_map_t* image_ids;
+    pddby_map_t* comment_ids;
+    pddby_map_t* traffreg_ids;
 };
 
 pddby_decode_context_t* pddby_decode_context_new(pddby_t* pddby, char const* root_path);
 void pddby_decode_context_free(pddby_decode_context_t* context);
 
+// reads source file, letting manifest know what it consists of
+int pddby_decode_file_get_contents(pddby_t* pddby, char const* path, char** buffer, size_t* buffer_size);
+
+// same key sealed cache was saved with, without decoding anything
+int pddby_decode_disc_key(pddby_t* pddby, char const* root_path, uint8_t* key);
+
 #endif // PDDBY_PRIVATE_DECODE_CONTEXT_H
@@ -1,13 +1,19 @@
 #include "decode_image.h"
 
-#include "image.h"
+#include "decode_context.h"
+#include "decode_sink.h"
+
+#include "private/pddby.h"
 #include "private/util/aux.h"
 #include "private/util/delphi.h"
+#include "private/util/image_store.h"
 #include "private/util/report.h"
 #include "private/util/string.h"
+#include "private/util/trace.h"
 
 #include <assert.h>
 #include <ctype.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -46,7 +52,7 @@ static inline void swap(uint32_t* left, uint32_t* right)
     *right = temp;
 }
 
-static int pddby_init_randseed_for_image(char const* name, uint16_t magic)
+static int pddby_init_randseed_for_image(char const* name, uint16_t magic, uint64_t* seed)
 {
     assert(name);
 
@@ -67,12 +73,12 @@ static int pddby_init_randseed_for_image(char const* name, uint16_t magic)
         }
     }
 
-    pddby_delphi_set_randseed(rand_seed);
+    *seed = rand_seed;
     return 1;
 }
 
-static pddby_image_t* pddby_decode_image_a8(pddby_t* pddby, char* basename, uint16_t magic, char* data,
-    size_t data_size)
+static int pddby_decode_image_a8(char const* basename, uint16_t magic, char* data, size_t data_size,
+    void** payload, size_t* payload_size)
 {
     // v9 image format
 
@@ -103,7 +109,7 @@ static pddby_image_t* pddby_decode_image_a8(pddby_t* pddby, char* basename, uint
         }
     }
 
-    pddby_delphi_set_randseed(seed + magic);
+    uint64_t rand_seed = seed + magic;
 
     for (size_t i = header->image_height; i > 0; i--)
     {
@@ -111,39 +117,45 @@ static pddby_image_t* pddby_decode_image_a8(pddby_t* pddby, char* basename, uint
         for (size_t j = 0; j < (header->image_width + 1) / 2; j++)
         {
             assert(&scanline[j] < data + header->file_size);
-            scanline[j] ^= pddby_delphi_random(255);
+            scanline[j] ^= pddby_delphi_random(&rand_seed, 255);
         }
     }
 
-    return pddby_image_new(pddby, pddby_string_delimit(basename, ".", '\0'), data, data_size);
+    *payload = data;
+    *payload_size = data_size;
+    return 1;
 }
 
-static pddby_image_t* pddby_decode_image_bpft(pddby_t* pddby, char* basename, uint16_t magic, char* data,
-    size_t data_size)
+static int pddby_decode_image_bpft(char const* basename, uint16_t magic, char* data, size_t data_size,
+    void** payload, size_t* payload_size)
 {
     // v10 & v11 image format
 
-    if (!pddby_init_randseed_for_image(basename, magic))
+    uint64_t rand_seed;
+    if (!pddby_init_randseed_for_image(basename, magic, &rand_seed))
     {
-        return NULL;
+        return 0;
     }
 
     for (size_t i = 4; i < data_size; i++)
     {
-        data[i] ^= pddby_delphi_random(255);
+        data[i] ^= pddby_delphi_random(&rand_seed, 255);
     }
 
-    return pddby_image_new(pddby, pddby_string_delimit(basename, ".", '\0'), data + 4, data_size - 4);
+    *payload = data + 4;
+    *payload_size = data_size - 4;
+    return 1;
 }
 
 static int pddby_decode_image_bpftcam_init(bpftcam_context_t* ctx, char const* basename, uint16_t magic)
 {
-    if (!pddby_init_randseed_for_image(basename, magic))
+    uint64_t rand_seed;
+    if (!pddby_init_randseed_for_image(basename, magic, &rand_seed))
     {
         return 0;
     }
 
-    ctx->a[0] = pddby_delphi_get_randseed();
+    ctx->a[0] = rand_seed;
     for (size_t i = 1; i < 12; i++)
     {
         uint32_t const* prev = i < 9 ? &ctx->a[i - 1] : &ctx->x[i - 9];
@@ -220,14 +232,15 @@ static uint8_t pddby_decode_image_bpftcam_next(bpftcam_context_t* ctx)
     return *ctx->x;
 }
 
-static pddby_image_t* pddby_decode_image_bpftcam(pddby_t* pddby, char* basename, uint16_t magic, char* data, size_t data_size)
+static int pddby_decode_image_bpftcam(char const* basename, uint16_t magic, char* data, size_t data_size,
+    void** payload, size_t* payload_size)
 {
     // v12 image format
 
     bpftcam_context_t context;
     if (!pddby_decode_image_bpftcam_init(&context, basename, magic))
     {
-        return NULL;
+        return 0;
     }
 
     for (size_t i = 7; i < data_size; i++)
@@ -235,20 +248,25 @@ static pddby_image_t* pddby_decode_image_bpftcam(pddby_t* pddby, char* basename,
         data[i] ^= pddby_decode_image_bpftcam_next(&context);
     }
 
-    return pddby_image_new(pddby, pddby_string_delimit(basename, ".", '\0'), data + 7, data_size - 7);
+    *payload = data + 7;
+    *payload_size = data_size - 7;
+    return 1;
 }
 
 int pddby_decode_image(pddby_t* pddby, char const* path, uint16_t magic)
 {
     char* data = NULL;
     size_t data_size;
-    pddby_image_t* image = NULL;
     char* basename = NULL;
+    char* name = NULL;
+    char* source_hash = NULL;
+    char* hash = NULL;
 
-    if (!pddby_aux_file_get_contents(pddby, path, &data, &data_size))
+    if (!pddby_decode_file_get_contents(pddby, path, &data, &data_size))
     {
         goto error;
     }
+    pddby_report_progress_bytes(pddby, data_size);
 
     basename = pddby_aux_path_get_basename(pddby, path);
     if (!basename)
@@ -256,17 +274,42 @@ int pddby_decode_image(pddby_t* pddby, char const* path, uint16_t magic)
         goto error;
     }
 
-    if (!strncmp(data, "A8", 2))
+    int const use_image_store = pddby->decode_context->use_image_store;
+    if (use_image_store)
+    {
+        // decrypted payload depends on file name and magic number as much as on file contents
+        char salt[256];
+        int const salt_size = snprintf(salt, sizeof(salt), "%s:%04x:", basename, magic);
+        source_hash = pddby_image_store_hash(pddby, salt, salt_size, data, data_size);
+        if (!source_hash)
+        {
+            goto error;
+        }
+
+        hash = pddby_image_store_find_source(pddby, source_hash);
+    }
+
+    pddby_trace_span_t span;
+    pddby_trace_begin(pddby, &span, pddby_trace_decrypt);
+
+    int result = 1;
+    void* payload = NULL;
+    size_t payload_size = 0;
+    if (hash)
     {
-        image = pddby_decode_image_a8(pddby, basename, magic, data, data_size);
+        // already decoded from this or another disc
+    }
+    else if (!strncmp(data, "A8", 2))
+    {
+        result = pddby_decode_image_a8(basename, magic, data, data_size, &payload, &payload_size);
     }
     else if (!strncmp(data, "BPFTCAM", 7))
     {
-        image = pddby_decode_image_bpftcam(pddby, basename, magic, data, data_size);
+        result = pddby_decode_image_bpftcam(basename, magic, data, data_size, &payload, &payload_size);
     }
     else if (!strncmp(data, "BPFT", 4))
     {
-        image = pddby_decode_image_bpft(pddby, basename, magic, data, data_size);
+        result = pddby_decode_image_bpft(basename, magic, data, data_size, &payload, &payload_size);
     }
     else
     {
@@ -274,38 +317,92 @@ int pddby_decode_image(pddby_t* pddby, char const* path, uint16_t magic)
         goto error;
     }
 
-    free(data);
-    data = NULL;
-    free(basename);
-    basename = NULL;
+    pddby_trace_end(pddby, &span, hash ? 0 : data_size, 1);
 
-    if (!image)
+    if (!result)
     {
         goto error;
     }
 
-    if (!pddby_image_save(image))
+    if (use_image_store && !hash)
+    {
+        hash = pddby_image_store_hash(pddby, NULL, 0, payload, payload_size);
+        if (!hash)
+        {
+            goto error;
+        }
+
+        // same image coming from another file
+        int const stored = pddby_image_store_contains(pddby, hash);
+        if (stored == -1)
+        {
+            goto error;
+        }
+        if (stored)
+        {
+            payload = NULL;
+            payload_size = 0;
+        }
+    }
+
+    name = pddby_string_downcase(pddby, pddby_string_delimit(basename, ".", '\0'));
+    if (!name)
+    {
+        goto error;
+    }
+
+    pddby_decode_record_t record;
+    record.type = pddby_decode_record_image;
+    record.value.image.name = name;
+    record.value.image.data = payload;
+    record.value.image.data_size = payload_size;
+    record.value.image.hash = hash;
+    record.value.image.source_hash = source_hash;
+    if (!pddby_decode_sink_write(pddby->decode_context->sink, &record))
     {
         goto error;
     }
 
-    pddby_image_free(image);
+    if (!pddby_map_set(pddby->decode_context->image_ids, name, strlen(name), record.id))
+    {
+        goto error;
+    }
+
+    if (hash)
+    {
+        free(hash);
+    }
+    if (source_hash)
+    {
+        free(source_hash);
+    }
+    free(name);
+    free(basename);
+    free(data);
     return 1;
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to decode image: %s", path);
 
-    if (data)
+    if (hash)
     {
-        free(data);
+        free(hash);
+    }
+    if (source_hash)
+    {
+        free(source_hash);
+    }
+    if (name)
+    {
+        free(name);
     }
     if (basename)
     {
         free(basename);
     }
-    if (image)
+    if (data)
     {
-        pddby_image_free(image);
+        free(data);
     }
 
     return 0;
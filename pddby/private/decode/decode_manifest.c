@@ -0,0 +1,580 @@
+#include "decode_manifest.h"
+
+#include "decode_sink.h"
+
+#include "array.h"
+#include "private/util/aux.h"
+#include "private/util/database.h"
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define PDDBY_DECODE_MANIFEST_MAGIC_KEY "decode_magic"
+
+struct pddby_decode_manifest_entry
+{
+    char* path;
+    int64_t size;
+    int64_t mtime;
+    char* hash;
+};
+
+typedef struct pddby_decode_manifest_entry pddby_decode_manifest_entry_t;
+
+struct pddby_decode_manifest
+{
+    pddby_t* pddby;
+    char const* root_path;
+    char magic[16];
+
+    int incremental;
+    int in_transaction;
+
+    // from last decode, path -> index
+    pddby_array_t* old_entries;
+    pddby_map_t* old_entry_indices;
+
+    pddby_array_t* entries;
+    // full path -> index of entries that are only hashed once decode reads them
+    pddby_map_t* pending_entry_indices;
+};
+
+static void pddby_decode_manifest_entry_free(void* data)
+{
+    pddby_decode_manifest_entry_t* entry = data;
+
+    if (entry->hash)
+    {
+        free(entry->hash);
+    }
+    if (entry->path)
+    {
+        free(entry->path);
+    }
+    free(entry);
+}
+
+static pddby_decode_manifest_entry_t* pddby_decode_manifest_entry_new(char const* path, int64_t size, int64_t mtime,
+    char const* hash)
+{
+    pddby_decode_manifest_entry_t* entry = calloc(1, sizeof(pddby_decode_manifest_entry_t));
+    if (!entry)
+    {
+        return NULL;
+    }
+
+    entry->path = strdup(path);
+    entry->hash = hash ? strdup(hash) : NULL;
+    if (!entry->path || (hash && !entry->hash))
+    {
+        pddby_decode_manifest_entry_free(entry);
+        return NULL;
+    }
+
+    entry->size = size;
+    entry->mtime = mtime;
+    return entry;
+}
+
+// statements are only used once per decode and must not outlive database if it gets discarded
+static int pddby_decode_manifest_exec(pddby_decode_manifest_t* manifest, char const* sql, int bind_count,
+    int64_t value)
+{
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(manifest->pddby, sql);
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    int result = 1;
+    for (int i = 1; i <= bind_count && result; i++)
+    {
+        result = pddby_db_bind_int64(db_stmt, i, value);
+    }
+    result = result && pddby_db_step(db_stmt) == 0;
+
+    pddby_db_finalize(db_stmt);
+    return result;
+}
+
+static int pddby_decode_manifest_load(pddby_decode_manifest_t* manifest, char** magic)
+{
+    *magic = NULL;
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(manifest->pddby, "SELECT `value` FROM `settings` WHERE `key`='"
+        PDDBY_DECODE_MANIFEST_MAGIC_KEY "'");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    int ret = pddby_db_step(db_stmt);
+    if (ret == 1)
+    {
+        char const* value = pddby_db_column_text(db_stmt, 0);
+        *magic = strdup(value ? value : "");
+        if (!*magic)
+        {
+            ret = -1;
+        }
+    }
+    pddby_db_finalize(db_stmt);
+    if (ret == -1)
+    {
+        return 0;
+    }
+
+    db_stmt = pddby_db_prepare(manifest->pddby, "SELECT `path`, `size`, `mtime`, `hash` FROM `manifest`");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        char const* path = pddby_db_column_text(db_stmt, 0);
+        pddby_decode_manifest_entry_t* entry = pddby_decode_manifest_entry_new(path,
+            pddby_db_column_int64(db_stmt, 1), pddby_db_column_int64(db_stmt, 2), pddby_db_column_text(db_stmt, 3));
+        if (!entry)
+        {
+            ret = -1;
+            break;
+        }
+
+        size_t const index = pddby_array_size(manifest->old_entries);
+        if (!pddby_array_add(manifest->old_entries, entry))
+        {
+            pddby_decode_manifest_entry_free(entry);
+            ret = -1;
+            break;
+        }
+
+        if (!pddby_map_set(manifest->old_entry_indices, entry->path, strlen(entry->path), index))
+        {
+            ret = -1;
+            break;
+        }
+    }
+    pddby_db_finalize(db_stmt);
+
+    return ret == 0;
+}
+
+pddby_decode_manifest_t* pddby_decode_manifest_new(pddby_t* pddby, char const* root_path, uint16_t data_magic,
+    uint16_t image_magic)
+{
+    char* old_magic = NULL;
+
+    pddby_decode_manifest_t* manifest = calloc(1, sizeof(pddby_decode_manifest_t));
+    if (!manifest)
+    {
+        goto error;
+    }
+
+    manifest->pddby = pddby;
+    manifest->root_path = root_path;
+    snprintf(manifest->magic, sizeof(manifest->magic), "%04x%04x", data_magic, image_magic);
+
+    manifest->old_entries = pddby_array_new(pddby, &pddby_decode_manifest_entry_free);
+    manifest->old_entry_indices = pddby_map_new(pddby);
+    manifest->entries = pddby_array_new(pddby, &pddby_decode_manifest_entry_free);
+    manifest->pending_entry_indices = pddby_map_new(pddby);
+    if (!manifest->old_entries || !manifest->old_entry_indices || !manifest->entries ||
+        !manifest->pending_entry_indices)
+    {
+        goto error;
+    }
+
+    int const state = pddby_db_open_for_update(pddby);
+    if (state == -1)
+    {
+        goto error;
+    }
+
+    if (state == 1)
+    {
+        if (!pddby_decode_manifest_load(manifest, &old_magic))
+        {
+            goto error;
+        }
+
+        // rows from disc decoded with another magic or before manifest was kept can't be matched to files
+        if (!old_magic || strcmp(old_magic, manifest->magic) != 0 || !pddby_array_size(manifest->old_entries))
+        {
+            pddby_report(pddby, pddby_message_type_log, "cache can't be updated, decoding from scratch");
+            pddby_db_discard(pddby);
+        }
+        else
+        {
+            if (!pddby_db_tx_begin(pddby))
+            {
+                goto error;
+            }
+            manifest->in_transaction = 1;
+            manifest->incremental = 1;
+            pddby_report(pddby, pddby_message_type_log, "updating cache, %zu source files known",
+                pddby_array_size(manifest->old_entries));
+        }
+    }
+
+    if (old_magic)
+    {
+        free(old_magic);
+    }
+
+    return manifest;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create decode manifest");
+    if (old_magic)
+    {
+        free(old_magic);
+    }
+    if (manifest)
+    {
+        pddby_decode_manifest_free(manifest);
+    }
+    return NULL;
+}
+
+void pddby_decode_manifest_free(pddby_decode_manifest_t* manifest)
+{
+    assert(manifest);
+
+    if (manifest->in_transaction)
+    {
+        pddby_db_tx_rollback(manifest->pddby);
+    }
+
+    if (manifest->pending_entry_indices)
+    {
+        pddby_map_free(manifest->pending_entry_indices);
+    }
+    if (manifest->entries)
+    {
+        pddby_array_free(manifest->entries, 1);
+    }
+    if (manifest->old_entry_indices)
+    {
+        pddby_map_free(manifest->old_entry_indices);
+    }
+    if (manifest->old_entries)
+    {
+        pddby_array_free(manifest->old_entries, 1);
+    }
+    free(manifest);
+}
+
+int pddby_decode_manifest_is_incremental(pddby_decode_manifest_t* manifest)
+{
+    return manifest && manifest->incremental;
+}
+
+int pddby_decode_manifest_check(pddby_decode_manifest_t* manifest, char const* path)
+{
+    assert(manifest);
+    assert(path);
+
+    char* hash = NULL;
+
+    // mount point may differ between decodes
+    char const* relative_path = path;
+    size_t const root_path_size = strlen(manifest->root_path);
+    if (!strncmp(path, manifest->root_path, root_path_size) &&
+        (path[root_path_size] == '/' || path[root_path_size] == '\0'))
+    {
+        relative_path += root_path_size;
+        while (*relative_path == '/')
+        {
+            relative_path++;
+        }
+    }
+
+    struct stat st;
+    if (stat(path, &st) == -1)
+    {
+        goto error;
+    }
+
+    pddby_decode_manifest_entry_t const* old_entry = NULL;
+    int64_t index;
+    if (pddby_map_get(manifest->old_entry_indices, relative_path, strlen(relative_path), &index))
+    {
+        old_entry = pddby_array_index(manifest->old_entries, index);
+    }
+
+    int changed = 1;
+    if (old_entry && old_entry->size == st.st_size && old_entry->mtime == st.st_mtime)
+    {
+        // not worth reading file again just to find out it is the same
+        hash = strdup(old_entry->hash);
+        changed = 0;
+        if (!hash)
+        {
+            goto error;
+        }
+    }
+    else if (old_entry)
+    {
+        hash = pddby_aux_file_get_checksum(manifest->pddby, path);
+        if (!hash)
+        {
+            goto error;
+        }
+        changed = strcmp(old_entry->hash, hash) != 0;
+    }
+
+    // file nothing is known about is decoded anyway, so it's hashed from what decode reads rather than read twice
+    pddby_decode_manifest_entry_t* entry = pddby_decode_manifest_entry_new(relative_path, st.st_size, st.st_mtime,
+        hash);
+    if (!entry)
+    {
+        goto error;
+    }
+
+    size_t const entry_index = pddby_array_size(manifest->entries);
+    if (!pddby_array_add(manifest->entries, entry))
+    {
+        pddby_decode_manifest_entry_free(entry);
+        goto error;
+    }
+
+    if (!hash && !pddby_map_set(manifest->pending_entry_indices, path, strlen(path), entry_index))
+    {
+        goto error;
+    }
+
+    if (hash)
+    {
+        free(hash);
+    }
+    return manifest->incremental ? changed : 1;
+
+error:
+    pddby_report(manifest->pddby, pddby_message_type_error, "unable to check source file \"%s\"", path);
+    if (hash)
+    {
+        free(hash);
+    }
+    return -1;
+}
+
+int pddby_decode_manifest_note_contents(pddby_decode_manifest_t* manifest, char const* path, void const* data,
+    size_t data_size)
+{
+    assert(manifest);
+    assert(path);
+
+    int64_t index;
+    if (!pddby_map_get(manifest->pending_entry_indices, path, strlen(path), &index))
+    {
+        return 1;
+    }
+
+    pddby_decode_manifest_entry_t* entry = pddby_array_index(manifest->entries, index);
+    if (entry->hash)
+    {
+        return 1;
+    }
+
+    entry->hash = pddby_aux_get_checksum(manifest->pddby, data, data_size);
+    return entry->hash != NULL;
+}
+
+int pddby_decode_manifest_load_ids(pddby_decode_manifest_t* manifest, int record_type, pddby_map_t* ids)
+{
+    assert(manifest);
+    assert(ids);
+
+    char const* sql;
+    switch (record_type)
+    {
+    case pddby_decode_record_image:
+        sql = "SELECT `id`, `name` FROM `images`";
+        break;
+    case pddby_decode_record_comment:
+        sql = "SELECT `id`, `number` FROM `comments`";
+        break;
+    case pddby_decode_record_traffreg:
+        sql = "SELECT `id`, `number` FROM `traffregs`";
+        break;
+    default:
+        assert(0);
+        return 0;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(manifest->pddby, sql);
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        int64_t const id = pddby_db_column_int64(db_stmt, 0);
+        int result;
+        if (record_type == pddby_decode_record_image)
+        {
+            char const* name = pddby_db_column_text(db_stmt, 1);
+            result = pddby_map_set(ids, name, strlen(name), id);
+        }
+        else
+        {
+            int32_t const number = pddby_db_column_int(db_stmt, 1);
+            result = pddby_map_set(ids, &number, sizeof(int32_t), id);
+        }
+        if (!result)
+        {
+            ret = -1;
+            break;
+        }
+    }
+    pddby_db_finalize(db_stmt);
+    if (ret == -1)
+    {
+        goto error;
+    }
+
+    return 1;
+
+error:
+    pddby_report(manifest->pddby, pddby_message_type_error, "unable to load ids of decoded objects");
+    return 0;
+}
+
+int pddby_decode_manifest_drop_traffreg_images(pddby_decode_manifest_t* manifest)
+{
+    assert(manifest);
+
+    if (!pddby_decode_manifest_exec(manifest, "DELETE FROM `images_traffregs`", 0, 0))
+    {
+        pddby_report(manifest->pddby, pddby_message_type_error, "unable to drop traffreg images");
+        return 0;
+    }
+
+    return 1;
+}
+
+int pddby_decode_manifest_drop_topic_questions(pddby_decode_manifest_t* manifest, int8_t topic_number)
+{
+    assert(manifest);
+
+    static char const* const s_drop_sql[] =
+    {
+        "DELETE FROM `answers` WHERE `question_id` IN (SELECT q.`id` FROM `questions` q INNER JOIN `topics` t ON "
+            "t.`id`=q.`topic_id` WHERE t.`number`=?)",
+        "DELETE FROM `question_advices` WHERE `question_id` IN (SELECT q.`id` FROM `questions` q INNER JOIN "
+            "`topics` t ON t.`id`=q.`topic_id` WHERE t.`number`=?)",
+        "DELETE FROM `questions_sections` WHERE `question_id` IN (SELECT q.`id` FROM `questions` q INNER JOIN "
+            "`topics` t ON t.`id`=q.`topic_id` WHERE t.`number`=?)",
+        "DELETE FROM `questions_traffregs` WHERE `question_id` IN (SELECT q.`id` FROM `questions` q INNER JOIN "
+            "`topics` t ON t.`id`=q.`topic_id` WHERE t.`number`=?)",
+        "DELETE FROM `questions` WHERE `topic_id` IN (SELECT `id` FROM `topics` WHERE `number`=?)",
+        NULL
+    };
+
+    for (char const* const* sql = s_drop_sql; *sql; sql++)
+    {
+        if (!pddby_decode_manifest_exec(manifest, *sql, 1, topic_number))
+        {
+            pddby_report(manifest->pddby, pddby_message_type_error, "unable to drop questions of topic %d",
+                topic_number);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int pddby_decode_manifest_save(pddby_decode_manifest_t* manifest)
+{
+    assert(manifest);
+
+    pddby_db_stmt_t* db_stmt = NULL;
+
+    if (!pddby_db_tx_begin(manifest->pddby))
+    {
+        goto error;
+    }
+
+    if (!pddby_decode_manifest_exec(manifest, "DELETE FROM `manifest`", 0, 0))
+    {
+        goto tx_error;
+    }
+
+    db_stmt = pddby_db_prepare(manifest->pddby, "INSERT OR REPLACE INTO `manifest` (`path`, `size`, `mtime`, "
+        "`hash`) VALUES (?, ?, ?, ?)");
+    if (!db_stmt)
+    {
+        goto tx_error;
+    }
+
+    for (size_t i = 0, size = pddby_array_size(manifest->entries); i < size; i++)
+    {
+        pddby_decode_manifest_entry_t const* entry = pddby_array_index(manifest->entries, i);
+        if (!entry->hash)
+        {
+            // decode never got to read it, next one will take it for a new file
+            continue;
+        }
+
+        if (!pddby_db_reset(db_stmt) ||
+            !pddby_db_bind_text(db_stmt, 1, entry->path) ||
+            !pddby_db_bind_int64(db_stmt, 2, entry->size) ||
+            !pddby_db_bind_int64(db_stmt, 3, entry->mtime) ||
+            !pddby_db_bind_text(db_stmt, 4, entry->hash) ||
+            pddby_db_step(db_stmt) != 0)
+        {
+            goto tx_error;
+        }
+    }
+
+    pddby_db_finalize(db_stmt);
+
+    db_stmt = pddby_db_prepare(manifest->pddby, "INSERT OR REPLACE INTO `settings` (`key`, `value`) VALUES ('"
+        PDDBY_DECODE_MANIFEST_MAGIC_KEY "', ?)");
+    if (!db_stmt ||
+        !pddby_db_bind_text(db_stmt, 1, manifest->magic) ||
+        pddby_db_step(db_stmt) != 0)
+    {
+        goto tx_error;
+    }
+
+    pddby_db_finalize(db_stmt);
+
+    return pddby_db_tx_commit(manifest->pddby);
+
+tx_error:
+    if (db_stmt)
+    {
+        pddby_db_finalize(db_stmt);
+    }
+    // incremental update is rolled back as a whole later on
+    pddby_db_tx_commit(manifest->pddby);
+
+error:
+    pddby_report(manifest->pddby, pddby_message_type_error, "unable to save decode manifest");
+    return 0;
+}
+
+int pddby_decode_manifest_commit(pddby_decode_manifest_t* manifest)
+{
+    assert(manifest);
+
+    if (!manifest->in_transaction)
+    {
+        return 1;
+    }
+
+    manifest->in_transaction = 0;
+    return pddby_db_tx_commit(manifest->pddby);
+}
@@ -0,0 +1,40 @@
+#ifndef PDDBY_PRIVATE_DECODE_MANIFEST_H
+#define PDDBY_PRIVATE_DECODE_MANIFEST_H
+
+#include "pddby.h"
+#include "private/util/map.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// source files consumed by decode into cache file, along with their size, modification time and checksum; next
+// decode into the same complete cache only redoes what changed, all in one transaction
+struct pddby_decode_manifest;
+typedef struct pddby_decode_manifest pddby_decode_manifest_t;
+
+pddby_decode_manifest_t* pddby_decode_manifest_new(pddby_t* pddby, char const* root_path, uint16_t data_magic,
+    uint16_t image_magic);
+// rolls back whatever was not committed
+void pddby_decode_manifest_free(pddby_decode_manifest_t* manifest);
+
+// 0 for NULL manifest too
+int pddby_decode_manifest_is_incremental(pddby_decode_manifest_t* manifest);
+
+// 1 if file has to be decoded, 0 if it didn't change since last decode, -1 on error; file is recorded either way
+int pddby_decode_manifest_check(pddby_decode_manifest_t* manifest, char const* path);
+
+// files that were not decoded before are hashed from contents decode reads anyway, rather than read once more
+int pddby_decode_manifest_note_contents(pddby_decode_manifest_t* manifest, char const* path, void const* data,
+    size_t data_size);
+
+// ids of rows kept from last decode, for records of given type to be looked up by
+int pddby_decode_manifest_load_ids(pddby_decode_manifest_t* manifest, int record_type, pddby_map_t* ids);
+
+// rows derived from file that is about to be decoded again and can't be updated in place
+int pddby_decode_manifest_drop_traffreg_images(pddby_decode_manifest_t* manifest);
+int pddby_decode_manifest_drop_topic_questions(pddby_decode_manifest_t* manifest, int8_t topic_number);
+
+int pddby_decode_manifest_save(pddby_decode_manifest_t* manifest);
+int pddby_decode_manifest_commit(pddby_decode_manifest_t* manifest);
+
+#endif // PDDBY_PRIVATE_DECODE_MANIFEST_H
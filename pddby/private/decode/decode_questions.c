@@ -1,29 +1,29 @@
 #include "decode_questions.h"
 
 #include "decode_context.h"
+#include "decode_sink.h"
+#include "decode_task.h"
 
 #include "answer.h"
-#include "comment.h"
 #include "config.h"
-#include "image.h"
 #include "private/pddby.h"
 #include "private/platform.h"
 #include "private/util/aux.h"
-#include "private/util/database.h"
 #include "private/util/report.h"
 #include "private/util/regex.h"
+#include "private/util/trace.h"
 #include "question.h"
 #include "section.h"
-#include "traffreg.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 pddby_topic_question_t* pddby_decode_topic_questions_table(pddby_decode_context_t* context, char const* path, size_t* table_size)
 {
     pddby_topic_question_t* table = NULL;
 
     char* t = NULL;
-    if (!pddby_aux_file_get_contents(context->pddby, path, &t, table_size))
+    if (!pddby_decode_file_get_contents(context->pddby, path, &t, table_size))
     {
         goto error;
     }
@@ -81,6 +81,7 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
     pddby_regex_t* word_break_regex = NULL;
     pddby_regex_t* spaces_regex = NULL;
     char* str = NULL;
+    int64_t* traffreg_ids = NULL;
 
     size_t str_size;
     str = context->pddby->decode_context->decode_string(context, dbt_path, &str_size, topic_number);
@@ -121,7 +122,7 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
         goto error;
     }
 
-    if (!pddby_db_tx_begin(context->pddby))
+    if (!pddby_decode_sink_batch_begin(context->sink))
     {
         goto error;
     }
@@ -129,8 +130,14 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
     pddby_report_progress_begin(context->pddby, table_size);
 
     int result = 1;
+    size_t traffreg_ids_size = 0;
     for (size_t i = 0; i < table_size; i++)
     {
+        if (pddby_decode_task_is_cancelled(context->pddby))
+        {
+            goto error;
+        }
+
         int32_t next_offset = str_size;
         for (size_t j = 0; j < table_size; j++)
         {
@@ -140,15 +147,18 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
             }
         }
 
+        pddby_trace_span_t span;
+        pddby_trace_begin(context->pddby, &span, pddby_trace_convert);
         char* text = pddby_string_convert(context->iconv, str + table[i].question_offset, next_offset -
             table[i].question_offset);
+        pddby_trace_end(context->pddby, &span, next_offset - table[i].question_offset, 1);
         if (!text)
         {
             goto error;
         }
+        pddby_report_progress_bytes(context->pddby, next_offset - table[i].question_offset);
 
         pddby_question_t* question = NULL;
-        pddby_traffregs_t* question_traffregs = NULL;
         pddby_sections_t* question_sections = NULL;
         pddby_answers_t* question_answers = NULL;
         char** parts = NULL;
@@ -166,11 +176,7 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
             goto cycle_error;
         }
 
-        question_traffregs = pddby_traffregs_new(context->pddby);
-        if (!question_traffregs)
-        {
-            goto cycle_error;
-        }
+        traffreg_ids_size = 0;
 
         question_sections = pddby_sections_new(context->pddby);
         if (!question_sections)
@@ -224,13 +230,19 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
             case 'G':
                 p++;
                 {
-                    pddby_image_t *image = pddby_image_find_by_name(context->pddby, *p);
-                    if (!image)
+                    char* image_name = pddby_string_downcase(context->pddby, *p);
+                    if (!image_name)
+                    {
+                        goto cycle_error;
+                    }
+                    if (!pddby_map_get(context->image_ids, image_name, strlen(image_name), &question->image_id))
                     {
+                        pddby_report(context->pddby, pddby_message_type_error, "unable to find image with name = "
+                            "\"%s\"", image_name);
+                        free(image_name);
                         goto cycle_error;
                     }
-                    question->image_id = image->id;
-                    pddby_image_free(image);
+                    free(image_name);
                 }
                 break;
 
@@ -358,22 +370,29 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
                         goto cycle_error;
                     }
 
+                    int64_t* new_traffreg_ids = realloc(traffreg_ids, (traffreg_ids_size +
+                        pddby_stringv_length(traffreg_numbers)) * sizeof(int64_t));
+                    if (!new_traffreg_ids)
+                    {
+                        pddby_stringv_free(traffreg_numbers);
+                        goto cycle_error;
+                    }
+                    traffreg_ids = new_traffreg_ids;
+
                     char** trn = traffreg_numbers;
                     while (*trn)
                     {
-                        pddby_traffreg_t *traffreg = pddby_traffreg_find_by_number(context->pddby, atoi(*trn));
-                        if (!traffreg)
-                        {
-                            pddby_stringv_free(traffreg_numbers);
-                            goto cycle_error;
-                        }
-
-                        if (!pddby_array_add(question_traffregs, traffreg))
+                        int32_t number = atoi(*trn);
+                        if (!pddby_map_get(context->traffreg_ids, &number, sizeof(number),
+                            &traffreg_ids[traffreg_ids_size]))
                         {
+                            pddby_report(context->pddby, pddby_message_type_error, "unable to find traffreg with "
+                                "number = %d", number);
                             pddby_stringv_free(traffreg_numbers);
                             goto cycle_error;
                         }
 
+                        traffreg_ids_size++;
                         trn++;
                     }
                     pddby_stringv_free(traffreg_numbers);
@@ -383,14 +402,13 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
             case 'C':
                 p++;
                 {
-                    pddby_comment_t *comment = pddby_comment_find_by_number(context->pddby, atoi(*p));
-                    if (!comment)
+                    int32_t number = atoi(*p);
+                    if (!pddby_map_get(context->comment_ids, &number, sizeof(number), &question->comment_id))
                     {
+                        pddby_report(context->pddby, pddby_message_type_error, "unable to find comment with number = "
+                            "%d", number);
                         goto cycle_error;
                     }
-
-                    question->comment_id = comment->id;
-                    pddby_comment_free(comment);
                 }
                 break;
 
@@ -401,33 +419,53 @@ int pddby_decode_questions_data(pddby_decode_context_t* context, char const* dbt
             p++;
         }
 
-        if (!pddby_question_save(question))
+        pddby_decode_record_t record;
+        record.type = pddby_decode_record_question;
+        record.value.question.topic_id = question->topic_id;
+        record.value.question.text = question->text;
+        record.value.question.image_id = question->image_id;
+        record.value.question.advice = question->advice;
+        record.value.question.comment_id = question->comment_id;
+        if (!pddby_decode_sink_write(context->sink, &record))
         {
             goto cycle_error;
         }
+
+        int64_t const question_id = record.id;
+
         for (size_t k = 0, size = pddby_array_size(question_answers); k < size; k++)
         {
-            pddby_answer_t* answer = (pddby_answer_t*)pddby_array_index(question_answers, k);
-            answer->question_id = question->id;
-            answer->is_correct = k == answer_number;
-            if (!pddby_answer_save(answer))
+            pddby_answer_t const* answer = pddby_array_index(question_answers, k);
+            record.type = pddby_decode_record_answer;
+            record.value.answer.question_id = question_id;
+            record.value.answer.text = answer->text;
+            record.value.answer.is_correct = k == answer_number;
+            if (!pddby_decode_sink_write(context->sink, &record))
             {
                 goto cycle_error;
             }
         }
-        if (!pddby_question_set_sections(question, question_sections))
+        for (size_t k = 0, size = pddby_array_size(question_sections); k < size; k++)
         {
-            goto cycle_error;
+            pddby_section_t const* section = pddby_array_index(question_sections, k);
+            if (!pddby_decode_sink_write_link(context->sink, pddby_decode_link_question_section, question_id,
+                section->id))
+            {
+                goto cycle_error;
+            }
         }
-        if (!pddby_question_set_traffregs(question, question_traffregs))
+        for (size_t k = 0; k < traffreg_ids_size; k++)
         {
-            goto cycle_error;
+            if (!pddby_decode_sink_write_link(context->sink, pddby_decode_link_question_traffreg, question_id,
+                traffreg_ids[k]))
+            {
+                goto cycle_error;
+            }
         }
 
         pddby_stringv_free(parts);
         pddby_answers_free(question_answers);
         pddby_sections_free(question_sections);
-        pddby_traffregs_free(question_traffregs);
         pddby_question_free(question);
 
         pddby_report_progress(context->pddby, i + 1);
@@ -449,10 +487,6 @@ cycle_error:
         {
             pddby_sections_free(question_sections);
         }
-        if (question_traffregs)
-        {
-            pddby_traffregs_free(question_traffregs);
-        }
         if (question)
         {
             pddby_question_free(question);
@@ -461,9 +495,14 @@ cycle_error:
         goto error;
     }
 
+    if (traffreg_ids)
+    {
+        free(traffreg_ids);
+    }
+
     pddby_report_progress_end(context->pddby);
 
-    if (!pddby_db_tx_commit(context->pddby))
+    if (!pddby_decode_sink_batch_end(context->sink))
     {
         goto error;
     }
@@ -480,6 +519,10 @@ cycle_error:
 error:
     pddby_report(context->pddby, pddby_message_type_error, "unable to decode questions data");
 
+    if (traffreg_ids)
+    {
+        free(traffreg_ids);
+    }
     if (str)
     {
         free(str);
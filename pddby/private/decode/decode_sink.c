@@ -0,0 +1,109 @@
+#include "decode_sink.h"
+
+#include "private/util/report.h"
+#include "private/util/trace.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+pddby_decode_sink_t* pddby_decode_sink_new(pddby_t* pddby, int output, char const* path)
+{
+    pddby_decode_sink_t* sink = NULL;
+
+    switch (output)
+    {
+    case pddby_decode_output_database:
+        sink = pddby_decode_sink_new_database(pddby);
+        break;
+    case pddby_decode_output_null:
+        sink = pddby_decode_sink_new_null(pddby);
+        break;
+    case pddby_decode_output_jsonl:
+        sink = pddby_decode_sink_new_jsonl(pddby, path);
+        break;
+    case pddby_decode_output_pack:
+        sink = pddby_decode_sink_new_pack(pddby, path);
+        break;
+    default:
+        pddby_report(pddby, pddby_message_type_error, "unknown decode output: %d", output);
+        break;
+    }
+
+    if (!sink)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to create decode sink");
+    }
+
+    return sink;
+}
+
+void pddby_decode_sink_free(pddby_decode_sink_t* sink)
+{
+    assert(sink);
+
+    sink->free(sink);
+}
+
+int pddby_decode_sink_batch_begin(pddby_decode_sink_t* sink)
+{
+    assert(sink);
+
+    return sink->batch_begin ? sink->batch_begin(sink) : 1;
+}
+
+int pddby_decode_sink_batch_end(pddby_decode_sink_t* sink)
+{
+    assert(sink);
+
+    return sink->batch_end ? sink->batch_end(sink) : 1;
+}
+
+int pddby_decode_sink_write(pddby_decode_sink_t* sink, pddby_decode_record_t* record)
+{
+    assert(sink);
+    assert(record);
+
+    pddby_trace_span_t span;
+    pddby_trace_begin(sink->pddby, &span, pddby_trace_insert);
+    int const result = sink->write(sink, record);
+    pddby_trace_end(sink->pddby, &span, 0, 1);
+
+    if (!result)
+    {
+        pddby_report(sink->pddby, pddby_message_type_error, "unable to write decode record of type %d", record->type);
+        return 0;
+    }
+
+    return 1;
+}
+
+int pddby_decode_sink_write_link(pddby_decode_sink_t* sink, int type, int64_t from_id, int64_t to_id)
+{
+    pddby_decode_record_t record;
+    record.type = pddby_decode_record_link;
+    record.id = 0;
+    record.value.link.type = type;
+    record.value.link.from_id = from_id;
+    record.value.link.to_id = to_id;
+
+    return pddby_decode_sink_write(sink, &record);
+}
+
+int pddby_decode_sink_finish(pddby_decode_sink_t* sink)
+{
+    assert(sink);
+
+    return sink->finish ? sink->finish(sink) : 1;
+}
+
+int64_t pddby_decode_sink_next_id(pddby_decode_sink_t* sink, int record_type)
+{
+    assert(sink);
+    assert(record_type >= 0 && record_type < pddby_decode_record_type_count);
+
+    return ++sink->last_id[record_type];
+}
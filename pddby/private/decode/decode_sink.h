@@ -0,0 +1,117 @@
+#ifndef PDDBY_PRIVATE_DECODE_SINK_H
+#define PDDBY_PRIVATE_DECODE_SINK_H
+
+#include "pddby.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum pddby_decode_record_type
+{
+    pddby_decode_record_image,
+    pddby_decode_record_comment,
+    pddby_decode_record_traffreg,
+    pddby_decode_record_question,
+    pddby_decode_record_answer,
+    pddby_decode_record_link,
+    pddby_decode_record_type_count
+};
+
+enum pddby_decode_link_type
+{
+    pddby_decode_link_image_traffreg,
+    pddby_decode_link_question_section,
+    pddby_decode_link_question_traffreg,
+    pddby_decode_link_count
+};
+
+struct pddby_decode_record
+{
+    int type;
+    // assigned by sink on write (except for links)
+    int64_t id;
+
+    union
+    {
+        struct
+        {
+            char const* name;
+            // NULL if payload is already in image store
+            void const* data;
+            size_t data_size;
+            // only set when decoding with image store
+            char const* hash;
+            char const* source_hash;
+        } image;
+
+        struct
+        {
+            int32_t number;
+            char const* text;
+        } comment;
+
+        struct
+        {
+            int32_t number;
+            char const* text;
+        } traffreg;
+
+        struct
+        {
+            int64_t topic_id;
+            char const* text;
+            int64_t image_id;
+            char const* advice;
+            int64_t comment_id;
+        } question;
+
+        struct
+        {
+            int64_t question_id;
+            char const* text;
+            int is_correct;
+        } answer;
+
+        struct
+        {
+            int type;
+            int64_t from_id;
+            int64_t to_id;
+        } link;
+    } value;
+};
+
+typedef struct pddby_decode_record pddby_decode_record_t;
+typedef struct pddby_decode_sink pddby_decode_sink_t;
+
+struct pddby_decode_sink
+{
+    pddby_t* pddby;
+
+    int64_t last_id[pddby_decode_record_type_count];
+
+    int (*batch_begin)(pddby_decode_sink_t* sink);
+    int (*batch_end)(pddby_decode_sink_t* sink);
+    int (*write)(pddby_decode_sink_t* sink, pddby_decode_record_t* record);
+    int (*finish)(pddby_decode_sink_t* sink);
+    void (*free)(pddby_decode_sink_t* sink);
+};
+
+pddby_decode_sink_t* pddby_decode_sink_new(pddby_t* pddby, int output, char const* path);
+void pddby_decode_sink_free(pddby_decode_sink_t* sink);
+
+int pddby_decode_sink_batch_begin(pddby_decode_sink_t* sink);
+int pddby_decode_sink_batch_end(pddby_decode_sink_t* sink);
+int pddby_decode_sink_write(pddby_decode_sink_t* sink, pddby_decode_record_t* record);
+int pddby_decode_sink_write_link(pddby_decode_sink_t* sink, int type, int64_t from_id, int64_t to_id);
+int pddby_decode_sink_finish(pddby_decode_sink_t* sink);
+
+// sequential ids for sinks not backed by database
+int64_t pddby_decode_sink_next_id(pddby_decode_sink_t* sink, int record_type);
+
+pddby_decode_sink_t* pddby_decode_sink_new_database(pddby_t* pddby);
+pddby_decode_sink_t* pddby_decode_sink_new_null(pddby_t* pddby);
+pddby_decode_sink_t* pddby_decode_sink_new_jsonl(pddby_t* pddby, char const* path);
+pddby_decode_sink_t* pddby_decode_sink_new_pack(pddby_t* pddby, char const* path);
+
+#endif // PDDBY_PRIVATE_DECODE_SINK_H
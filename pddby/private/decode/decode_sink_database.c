@@ -0,0 +1,738 @@
+#include "decode_sink.h"
+
+#include "decode_context.h"
+#include "private/pddby.h"
+#include "private/util/compress.h"
+#include "private/util/database.h"
+#include "private/util/map.h"
+#include "private/util/report.h"
+#include "private/util/settings.h"
+#include "private/util/texts.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+enum
+{
+    insert_text,
+    insert_image,
+    insert_image_data,
+    insert_image_blob,
+    insert_image_source,
+    insert_comment,
+    insert_traffreg,
+    insert_question,
+    insert_question_advice,
+    insert_answer,
+    insert_image_traffreg,
+    insert_question_section,
+    insert_question_traffreg,
+    insert_count
+};
+
+struct pddby_decode_sink_database
+{
+    pddby_decode_sink_t base;
+
+    pddby_db_stmt_t* statements[insert_count];
+
+    // ordered links are keyed by (owner, position), last owner seen is remembered per link type
+    int64_t link_owner_ids[pddby_decode_link_count];
+    int link_positions[pddby_decode_link_count];
+
+    // image payloads are compressed in background and inserted as they become ready
+    pddby_compress_pool_t* compress_pool;
+    uint64_t image_raw_size;
+    uint64_t image_stored_size;
+    // payloads go to shared image store rather than to `image_data`
+    int use_image_store;
+    size_t image_reused_count;
+
+    // text -> id of already stored texts, including ones kept from last decode when cache is updated
+    pddby_map_t* text_ids;
+    int text_ids_loaded;
+};
+
+static char const* const s_insert_sql[insert_count] =
+{
+    "INSERT INTO `texts` (`hash`, `text`) VALUES (?, ?)",
+    // rows keep their ids when updated by decode, so that rows referring to them stay valid
+    "INSERT OR REPLACE INTO `images` (`id`, `name`, `hash`) VALUES ((SELECT `id` FROM `images` WHERE `name`=?1), ?1, "
+        "?2)",
+    "INSERT OR REPLACE INTO `image_data` (`image_id`, `data`, `format`, `size`) VALUES (?, ?, ?, ?)",
+    "INSERT OR IGNORE INTO `store`.`blobs` (`hash`, `data`, `format`, `size`) SELECT `hash`, ?2, ?3, ?4 FROM `images` "
+        "WHERE `id`=?1",
+    "INSERT OR REPLACE INTO `store`.`sources` (`source_hash`, `hash`) VALUES (?, ?)",
+    "INSERT OR REPLACE INTO `comments` (`id`, `number`, `text`) VALUES ((SELECT `id` FROM `comments` WHERE "
+        "`number`=?1), ?1, ?2)",
+    "INSERT OR REPLACE INTO `traffregs` (`id`, `number`, `text_id`) VALUES ((SELECT `id` FROM `traffregs` WHERE "
+        "`number`=?1), ?1, ?2)",
+    "INSERT INTO `questions` (`topic_id`, `text`, `image_id`, `comment_id`) VALUES (?, ?, ?, ?)",
+    "INSERT INTO `question_advices` (`question_id`, `advice_id`) VALUES (?, ?)",
+    "INSERT INTO `answers` (`question_id`, `text_id`, `is_correct`) VALUES (?, ?, ?)",
+    "INSERT INTO `images_traffregs` (`image_id`, `traffreg_id`, `position`) VALUES (?, ?, ?)",
+    "INSERT OR IGNORE INTO `questions_sections` (`question_id`, `section_id`) VALUES (?, ?)",
+    "INSERT INTO `questions_traffregs` (`question_id`, `traffreg_id`, `position`) VALUES (?, ?, ?)"
+};
+
+static pddby_db_stmt_t* pddby_decode_sink_database_statement(struct pddby_decode_sink_database* sink, int index)
+{
+    if (!sink->statements[index])
+    {
+        sink->statements[index] = pddby_db_prepare(sink->base.pddby, s_insert_sql[index]);
+    }
+    return sink->statements[index];
+}
+
+static int pddby_db_bind_id(pddby_db_stmt_t* stmt, int field, int64_t value)
+{
+    return value ? pddby_db_bind_int64(stmt, field, value) : pddby_db_bind_null(stmt, field);
+}
+
+static int pddby_decode_sink_database_step(pddby_db_stmt_t* db_stmt)
+{
+    int ret = pddby_db_step(db_stmt);
+    if (ret == -1)
+    {
+        return 0;
+    }
+
+    assert(ret == 0);
+    return 1;
+}
+
+// texts of cache being updated are all loaded at once, there is nothing to load when decoding from scratch
+static int pddby_decode_sink_database_load_texts(struct pddby_decode_sink_database* sink)
+{
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(sink->base.pddby, "SELECT `id`, `text` FROM `texts`");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        char const* text = pddby_db_column_text(db_stmt, 1);
+        if (text && !pddby_map_set(sink->text_ids, text, strlen(text), pddby_db_column_int64(db_stmt, 0)))
+        {
+            ret = -1;
+            break;
+        }
+    }
+    pddby_db_finalize(db_stmt);
+
+    sink->text_ids_loaded = ret == 0;
+    return sink->text_ids_loaded;
+}
+
+// same as pddby_texts_intern, minus the lookup query
+static int64_t pddby_decode_sink_database_text(struct pddby_decode_sink_database* sink, char const* text)
+{
+    if (!text)
+    {
+        return 0;
+    }
+
+    if (!sink->text_ids_loaded && !pddby_decode_sink_database_load_texts(sink))
+    {
+        return -1;
+    }
+
+    size_t const text_size = strlen(text);
+
+    int64_t id;
+    if (pddby_map_get(sink->text_ids, text, text_size, &id))
+    {
+        return id;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_decode_sink_database_statement(sink, insert_text);
+    if (!db_stmt ||
+        !pddby_db_reset(db_stmt) ||
+        !pddby_db_bind_int64(db_stmt, 1, pddby_texts_hash(text)) ||
+        !pddby_db_bind_text(db_stmt, 2, text) ||
+        !pddby_decode_sink_database_step(db_stmt))
+    {
+        return -1;
+    }
+
+    id = pddby_db_last_insert_id(sink->base.pddby);
+    if (!pddby_map_set(sink->text_ids, text, text_size, id))
+    {
+        return -1;
+    }
+
+    return id;
+}
+
+static int pddby_decode_sink_database_link_position(struct pddby_decode_sink_database* sink,
+    pddby_decode_record_t const* record)
+{
+    int const type = record->value.link.type;
+    int64_t const owner_id = type == pddby_decode_link_image_traffreg ? record->value.link.to_id :
+        record->value.link.from_id;
+
+    if (sink->link_owner_ids[type] != owner_id)
+    {
+        sink->link_owner_ids[type] = owner_id;
+        sink->link_positions[type] = 0;
+    }
+
+    return sink->link_positions[type]++;
+}
+
+static int pddby_decode_sink_database_insert_image_data(void* user_data, int64_t id, int format, void const* data,
+    size_t data_size, size_t raw_size)
+{
+    struct pddby_decode_sink_database* db_sink = user_data;
+
+    pddby_db_stmt_t* db_stmt = pddby_decode_sink_database_statement(db_sink,
+        db_sink->use_image_store ? insert_image_blob : insert_image_data);
+    if (!db_stmt ||
+        !pddby_db_reset(db_stmt) ||
+        !pddby_db_bind_int64(db_stmt, 1, id) ||
+        !pddby_db_bind_blob(db_stmt, 2, data, data_size) ||
+        !pddby_db_bind_int(db_stmt, 3, format) ||
+        !pddby_db_bind_int64(db_stmt, 4, raw_size) ||
+        !pddby_decode_sink_database_step(db_stmt))
+    {
+        return 0;
+    }
+
+    db_sink->image_raw_size += raw_size;
+    db_sink->image_stored_size += data_size;
+    return 1;
+}
+
+static int pddby_decode_sink_database_batch_begin(pddby_decode_sink_t* sink)
+{
+    return pddby_db_tx_begin(sink->pddby);
+}
+
+static int pddby_decode_sink_database_batch_end(pddby_decode_sink_t* sink)
+{
+    return pddby_db_tx_commit(sink->pddby);
+}
+
+static int pddby_decode_sink_database_write(pddby_decode_sink_t* sink, pddby_decode_record_t* record)
+{
+    struct pddby_decode_sink_database* db_sink = (struct pddby_decode_sink_database*)sink;
+
+    int index;
+    switch (record->type)
+    {
+    case pddby_decode_record_image:
+        index = insert_image;
+        break;
+    case pddby_decode_record_comment:
+        index = insert_comment;
+        break;
+    case pddby_decode_record_traffreg:
+        index = insert_traffreg;
+        break;
+    case pddby_decode_record_question:
+        index = insert_question;
+        break;
+    case pddby_decode_record_answer:
+        index = insert_answer;
+        break;
+    case pddby_decode_record_link:
+        switch (record->value.link.type)
+        {
+        case pddby_decode_link_image_traffreg:
+            index = insert_image_traffreg;
+            break;
+        case pddby_decode_link_question_section:
+            index = insert_question_section;
+            break;
+        case pddby_decode_link_question_traffreg:
+            index = insert_question_traffreg;
+            break;
+        default:
+            goto error;
+        }
+        break;
+    default:
+        goto error;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_decode_sink_database_statement(db_sink, index);
+    if (!db_stmt || !pddby_db_reset(db_stmt))
+    {
+        goto error;
+    }
+
+    int bound;
+    int64_t text_id;
+    switch (record->type)
+    {
+    case pddby_decode_record_image:
+        bound =
+            pddby_db_bind_text(db_stmt, 1, record->value.image.name) &&
+            pddby_db_bind_text(db_stmt, 2, record->value.image.hash);
+        break;
+    case pddby_decode_record_comment:
+        bound =
+            pddby_db_bind_int(db_stmt, 1, record->value.comment.number) &&
+            pddby_db_bind_text(db_stmt, 2, record->value.comment.text);
+        break;
+    case pddby_decode_record_traffreg:
+        text_id = pddby_decode_sink_database_text(db_sink, record->value.traffreg.text);
+        bound =
+            text_id != -1 &&
+            pddby_db_bind_int(db_stmt, 1, record->value.traffreg.number) &&
+            pddby_db_bind_id(db_stmt, 2, text_id);
+        break;
+    case pddby_decode_record_question:
+        bound =
+            pddby_db_bind_id(db_stmt, 1, record->value.question.topic_id) &&
+            pddby_db_bind_text(db_stmt, 2, record->value.question.text) &&
+            pddby_db_bind_id(db_stmt, 3, record->value.question.image_id) &&
+            pddby_db_bind_id(db_stmt, 4, record->value.question.comment_id);
+        break;
+    case pddby_decode_record_answer:
+        text_id = pddby_decode_sink_database_text(db_sink, record->value.answer.text);
+        bound =
+            text_id != -1 &&
+            pddby_db_bind_id(db_stmt, 1, record->value.answer.question_id) &&
+            pddby_db_bind_id(db_stmt, 2, text_id) &&
+            pddby_db_bind_int(db_stmt, 3, record->value.answer.is_correct);
+        break;
+    default:
+        bound =
+            pddby_db_bind_int64(db_stmt, 1, record->value.link.from_id) &&
+            pddby_db_bind_int64(db_stmt, 2, record->value.link.to_id);
+        if (bound && index != insert_question_section)
+        {
+            bound = pddby_db_bind_int(db_stmt, 3, pddby_decode_sink_database_link_position(db_sink, record));
+        }
+        break;
+    }
+    if (!bound || !pddby_decode_sink_database_step(db_stmt))
+    {
+        goto error;
+    }
+
+    if (record->type == pddby_decode_record_link)
+    {
+        return 1;
+    }
+
+    record->id = pddby_db_last_insert_id(sink->pddby);
+
+    // lookups only trust sources whose payload made it to the store, so it's fine to map them right away
+    if (record->type == pddby_decode_record_image && record->value.image.source_hash)
+    {
+        db_stmt = pddby_decode_sink_database_statement(db_sink, insert_image_source);
+        if (!db_stmt ||
+            !pddby_db_reset(db_stmt) ||
+            !pddby_db_bind_text(db_stmt, 1, record->value.image.source_hash) ||
+            !pddby_db_bind_text(db_stmt, 2, record->value.image.hash) ||
+            !pddby_decode_sink_database_step(db_stmt))
+        {
+            goto error;
+        }
+    }
+
+    // cold columns live in their own tables so that lookups by name or topic never page them in
+    if (record->type == pddby_decode_record_image && !record->value.image.data)
+    {
+        db_sink->image_reused_count++;
+    }
+    else if (record->type == pddby_decode_record_image)
+    {
+        db_sink->use_image_store = record->value.image.hash != NULL;
+
+        if (!db_sink->compress_pool)
+        {
+            db_sink->compress_pool = pddby_compress_pool_new(sink->pddby);
+            if (!db_sink->compress_pool)
+            {
+                goto error;
+            }
+        }
+
+        if (!pddby_compress_pool_submit(db_sink->compress_pool, record->id, record->value.image.data,
+                record->value.image.data_size) ||
+            !pddby_compress_pool_collect(db_sink->compress_pool, 0, &pddby_decode_sink_database_insert_image_data,
+                db_sink))
+        {
+            goto error;
+        }
+    }
+    else if (record->type == pddby_decode_record_question && record->value.question.advice)
+    {
+        int64_t const advice_id = pddby_decode_sink_database_text(db_sink, record->value.question.advice);
+        db_stmt = pddby_decode_sink_database_statement(db_sink, insert_question_advice);
+        if (advice_id == -1 ||
+            !db_stmt ||
+            !pddby_db_reset(db_stmt) ||
+            !pddby_db_bind_int64(db_stmt, 1, record->id) ||
+            !pddby_db_bind_int64(db_stmt, 2, advice_id) ||
+            !pddby_decode_sink_database_step(db_stmt))
+        {
+            goto error;
+        }
+    }
+
+    return 1;
+
+error:
+    pddby_report(sink->pddby, pddby_message_type_error, "unable to insert decode record into database");
+    return 0;
+}
+
+// rows dropped or replaced by incremental decode leave texts nothing refers to any more
+static int pddby_decode_sink_database_drop_orphan_texts(pddby_decode_sink_t* sink)
+{
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(sink->pddby, "DELETE FROM `texts` WHERE `id` NOT IN (SELECT "
+        "`text_id` FROM `answers` WHERE `text_id` IS NOT NULL UNION SELECT `text_id` FROM `traffregs` WHERE "
+        "`text_id` IS NOT NULL UNION SELECT `advice_id` FROM `question_advices` WHERE `advice_id` IS NOT NULL)");
+    int result = db_stmt && pddby_db_tx_begin(sink->pddby);
+    if (result)
+    {
+        result = pddby_decode_sink_database_step(db_stmt);
+        result = pddby_db_tx_commit(sink->pddby) && result;
+    }
+    if (db_stmt)
+    {
+        pddby_db_finalize(db_stmt);
+    }
+
+    if (!result)
+    {
+        pddby_report(sink->pddby, pddby_message_type_error, "unable to drop unused texts");
+        return 0;
+    }
+
+    return 1;
+}
+
+static int pddby_decode_sink_database_build_stats(pddby_decode_sink_t* sink)
+{
+    static char const* const s_stats_sql[] =
+    {
+        "DELETE FROM `stats`",
+        "INSERT INTO `stats` (`kind`, `owner_id`, `question_count`, `ticket_count`, `image_question_count`, "
+            "`traffreg_question_count`, `comment_question_count`) SELECT 0, s.`id`, COUNT(q.`id`), "
+            "(COUNT(q.`id`) + 9) / 10, COUNT(NULLIF(q.`image_id`, 0)), SUM(EXISTS (SELECT 1 FROM "
+            "`questions_traffregs` qt WHERE qt.`question_id`=q.`id`)), COUNT(NULLIF(q.`comment_id`, 0)) FROM "
+            "`sections` s LEFT JOIN `questions_sections` qs ON qs.`section_id`=s.`id` LEFT JOIN `questions` q ON "
+            "q.`id`=qs.`question_id` GROUP BY s.`id`",
+        "INSERT INTO `stats` (`kind`, `owner_id`, `question_count`, `ticket_count`, `image_question_count`, "
+            "`traffreg_question_count`, `comment_question_count`) SELECT 1, t.`id`, COUNT(q.`id`), "
+            "(COUNT(q.`id`) + 9) / 10, COUNT(NULLIF(q.`image_id`, 0)), SUM(EXISTS (SELECT 1 FROM "
+            "`questions_traffregs` qt WHERE qt.`question_id`=q.`id`)), COUNT(NULLIF(q.`comment_id`, 0)) FROM "
+            "`topics` t LEFT JOIN `questions` q ON q.`topic_id`=t.`id` GROUP BY t.`id`",
+        NULL
+    };
+
+    if (!pddby_db_tx_begin(sink->pddby))
+    {
+        goto error;
+    }
+
+    int result = 1;
+    for (char const* const* sql = s_stats_sql; result && *sql; sql++)
+    {
+        pddby_db_stmt_t* db_stmt = pddby_db_prepare(sink->pddby, *sql);
+        result = db_stmt && pddby_decode_sink_database_step(db_stmt);
+        if (db_stmt)
+        {
+            pddby_db_finalize(db_stmt);
+        }
+    }
+
+    if (!pddby_db_tx_commit(sink->pddby) || !result)
+    {
+        goto error;
+    }
+
+    return 1;
+
+error:
+    pddby_report(sink->pddby, pddby_message_type_error, "unable to build stats");
+    return 0;
+}
+
+// ids of questions of first topic_count topics, one topic after another; topic_offsets tell where each one starts
+static int pddby_decode_sink_database_load_topic_questions(pddby_t* pddby, size_t topic_count, int64_t** ids,
+    size_t* topic_offsets)
+{
+    // distribution lists topics in their table order, including ones left without questions
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(pddby, "SELECT t.`id`, q.`id` FROM `topics` t LEFT JOIN `questions` q "
+        "ON q.`topic_id`=t.`id` ORDER BY t.`id`, q.`id`");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    size_t count = 0;
+    size_t reserved_count = 0;
+    size_t topic_index = 0;
+    int64_t topic_id = 0;
+
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        int64_t const row_topic_id = pddby_db_column_int64(db_stmt, 0);
+        if (row_topic_id != topic_id)
+        {
+            topic_index += topic_id ? 1 : 0;
+            if (topic_index == topic_count)
+            {
+                break;
+            }
+            topic_id = row_topic_id;
+            topic_offsets[topic_index] = count;
+        }
+
+        int64_t const question_id = pddby_db_column_int64(db_stmt, 1);
+        if (!question_id)
+        {
+            continue;
+        }
+
+        if (count == reserved_count)
+        {
+            reserved_count = reserved_count ? reserved_count * 2 : 1024;
+            int64_t* new_ids = realloc(*ids, reserved_count * sizeof(int64_t));
+            if (!new_ids)
+            {
+                ret = -1;
+                break;
+            }
+            *ids = new_ids;
+        }
+
+        (*ids)[count++] = question_id;
+    }
+
+    for (size_t i = topic_index < topic_count ? topic_index + 1 : topic_count; i <= topic_count; i++)
+    {
+        topic_offsets[i] = count;
+    }
+
+    pddby_db_finalize(db_stmt);
+    return ret != -1;
+}
+
+static int pddby_decode_sink_database_insert_tickets(pddby_t* pddby, int const* distribution, size_t topic_count,
+    int64_t const* question_ids, size_t const* topic_offsets)
+{
+    size_t max_topic_size = 0;
+    for (size_t i = 0; i < topic_count; i++)
+    {
+        size_t const topic_size = topic_offsets[i + 1] - topic_offsets[i];
+        if (max_topic_size < topic_size)
+        {
+            max_topic_size = topic_size;
+        }
+    }
+
+    // incremental decode may have changed any topic, so tickets are laid out anew every time
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(pddby, "DELETE FROM `tickets`");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+    int const deleted = pddby_decode_sink_database_step(db_stmt);
+    pddby_db_finalize(db_stmt);
+    if (!deleted)
+    {
+        return 0;
+    }
+
+    db_stmt = pddby_db_prepare(pddby, "INSERT INTO `tickets` (`ticket_number`, `slot`, `question_id`) "
+        "VALUES (?, ?, ?)");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    int result = 1;
+    for (size_t ticket = 0, ticket_count = (max_topic_size + 9) / 10; result && ticket < ticket_count; ticket++)
+    {
+        int slot = 0;
+        for (size_t i = 0; result && i < topic_count; i++)
+        {
+            size_t const topic_size = topic_offsets[i + 1] - topic_offsets[i];
+            for (int j = 0; result && topic_size && j < distribution[i]; j++)
+            {
+                result = pddby_db_reset(db_stmt) &&
+                    pddby_db_bind_int64(db_stmt, 1, ticket + 1) &&
+                    pddby_db_bind_int(db_stmt, 2, slot++) &&
+                    pddby_db_bind_int64(db_stmt, 3, question_ids[topic_offsets[i] + (ticket * 10 + j) % topic_size]) &&
+                    pddby_decode_sink_database_step(db_stmt);
+            }
+        }
+    }
+
+    pddby_db_finalize(db_stmt);
+    return result;
+}
+
+// lays out tickets the way they used to be composed on every lookup, starting every ticket 10 questions further
+// into each topic; there are as many tickets as it takes to go through the largest topic
+static int pddby_decode_sink_database_build_tickets(pddby_decode_sink_t* sink)
+{
+    size_t* topic_offsets = NULL;
+    int64_t* question_ids = NULL;
+
+    size_t topic_count;
+    int const* distribution = pddby_settings_get_int_array(sink->pddby, pddby_setting_ticket_topics_distribution,
+        &topic_count);
+    if (!distribution)
+    {
+        goto error;
+    }
+
+    topic_offsets = calloc(topic_count + 1, sizeof(size_t));
+    if (!topic_offsets)
+    {
+        goto error;
+    }
+
+    if (!pddby_decode_sink_database_load_topic_questions(sink->pddby, topic_count, &question_ids, topic_offsets) ||
+        !pddby_db_tx_begin(sink->pddby))
+    {
+        goto error;
+    }
+    int const inserted = pddby_decode_sink_database_insert_tickets(sink->pddby, distribution, topic_count,
+        question_ids, topic_offsets);
+    if (!pddby_db_tx_commit(sink->pddby) || !inserted)
+    {
+        goto error;
+    }
+
+    free(question_ids);
+    free(topic_offsets);
+    return 1;
+
+error:
+    pddby_report(sink->pddby, pddby_message_type_error, "unable to build tickets");
+    if (question_ids)
+    {
+        free(question_ids);
+    }
+    if (topic_offsets)
+    {
+        free(topic_offsets);
+    }
+    return 0;
+}
+
+static int pddby_decode_sink_database_finish(pddby_decode_sink_t* sink)
+{
+    struct pddby_decode_sink_database* db_sink = (struct pddby_decode_sink_database*)sink;
+
+    if (db_sink->compress_pool)
+    {
+        // cache is not marked complete on failure, so whatever got inserted may as well be committed
+        if (!pddby_db_tx_begin(sink->pddby))
+        {
+            goto error;
+        }
+        int const collected = pddby_compress_pool_collect(db_sink->compress_pool, 1,
+            &pddby_decode_sink_database_insert_image_data, db_sink);
+        if (!pddby_db_tx_commit(sink->pddby) || !collected)
+        {
+            goto error;
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    pddby_report(sink->pddby, pddby_message_type_log, "images take %llu bytes stored (%llu bytes decoded), "
+        "database takes %lld bytes, peak RSS is %ld KiB", (unsigned long long)db_sink->image_stored_size,
+        (unsigned long long)db_sink->image_raw_size, (long long)pddby_db_size(sink->pddby), usage.ru_maxrss);
+    if (db_sink->image_reused_count)
+    {
+        pddby_report(sink->pddby, pddby_message_type_log, "%zu images reused from image store",
+            db_sink->image_reused_count);
+    }
+
+    pddby_decode_manifest_t* manifest = sink->pddby->decode_context ? sink->pddby->decode_context->manifest : NULL;
+    if ((pddby_decode_manifest_is_incremental(manifest) && !pddby_decode_sink_database_drop_orphan_texts(sink)) ||
+        !pddby_decode_sink_database_build_tickets(sink) ||
+        !pddby_decode_sink_database_build_stats(sink))
+    {
+        return 0;
+    }
+
+    // from now on cache is opened read-only
+    if (!pddby_db_set_complete(sink->pddby))
+    {
+        return 0;
+    }
+
+    return !pddby_db_is_sealed(sink->pddby) ||
+        pddby_db_save_sealed(sink->pddby, sink->pddby->decode_context->sealed_key);
+
+error:
+    pddby_report(sink->pddby, pddby_message_type_error, "unable to store compressed images");
+    return 0;
+}
+
+static void pddby_decode_sink_database_free(pddby_decode_sink_t* sink)
+{
+    struct pddby_decode_sink_database* db_sink = (struct pddby_decode_sink_database*)sink;
+
+    if (db_sink->compress_pool)
+    {
+        pddby_compress_pool_free(db_sink->compress_pool);
+    }
+    if (db_sink->text_ids)
+    {
+        pddby_map_free(db_sink->text_ids);
+    }
+
+    for (int i = 0; i < insert_count; i++)
+    {
+        if (db_sink->statements[i])
+        {
+            pddby_db_finalize(db_sink->statements[i]);
+        }
+    }
+    free(db_sink);
+}
+
+pddby_decode_sink_t* pddby_decode_sink_new_database(pddby_t* pddby)
+{
+    if (pddby_db_is_read_only(pddby))
+    {
+        pddby_report(pddby, pddby_message_type_error, "cache is complete and can't be decoded into, remove it first");
+        return NULL;
+    }
+
+    struct pddby_decode_sink_database* sink = calloc(1, sizeof(struct pddby_decode_sink_database));
+    if (!sink)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to create database decode sink");
+        return NULL;
+    }
+
+    sink->text_ids = pddby_map_new(pddby);
+    if (!sink->text_ids)
+    {
+        free(sink);
+        pddby_report(pddby, pddby_message_type_error, "unable to create database decode sink");
+        return NULL;
+    }
+
+    sink->base.pddby = pddby;
+    sink->base.batch_begin = &pddby_decode_sink_database_batch_begin;
+    sink->base.batch_end = &pddby_decode_sink_database_batch_end;
+    sink->base.write = &pddby_decode_sink_database_write;
+    sink->base.finish = &pddby_decode_sink_database_finish;
+    sink->base.free = &pddby_decode_sink_database_free;
+
+    return &sink->base;
+}
@@ -0,0 +1,256 @@
+#include "decode_sink.h"
+
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+struct pddby_decode_sink_jsonl
+{
+    pddby_decode_sink_t base;
+
+    FILE* file;
+    char* buffer;
+};
+
+static void pddby_jsonl_put_string(FILE* f, char const* value)
+{
+    if (!value)
+    {
+        fputs("null", f);
+        return;
+    }
+
+    fputc('"', f);
+    for (unsigned char const* p = (unsigned char const*)value; *p; p++)
+    {
+        switch (*p)
+        {
+        case '"':
+            fputs("\\\"", f);
+            break;
+        case '\\':
+            fputs("\\\\", f);
+            break;
+        case '\n':
+            fputs("\\n", f);
+            break;
+        case '\r':
+            fputs("\\r", f);
+            break;
+        case '\t':
+            fputs("\\t", f);
+            break;
+        default:
+            if (*p < 0x20)
+            {
+                fprintf(f, "\\u%04x", *p);
+            }
+            else
+            {
+                fputc(*p, f);
+            }
+            break;
+        }
+    }
+    fputc('"', f);
+}
+
+static void pddby_jsonl_put_base64(FILE* f, void const* data, size_t data_size)
+{
+    static char const s_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    uint8_t const* p = data;
+    fputc('"', f);
+    for (size_t i = 0; i < data_size; i += 3)
+    {
+        uint32_t chunk = p[i] << 16;
+        if (i + 1 < data_size)
+        {
+            chunk |= p[i + 1] << 8;
+        }
+        if (i + 2 < data_size)
+        {
+            chunk |= p[i + 2];
+        }
+
+        fputc(s_alphabet[(chunk >> 18) & 0x3f], f);
+        fputc(s_alphabet[(chunk >> 12) & 0x3f], f);
+        fputc(i + 1 < data_size ? s_alphabet[(chunk >> 6) & 0x3f] : '=', f);
+        fputc(i + 2 < data_size ? s_alphabet[chunk & 0x3f] : '=', f);
+    }
+    fputc('"', f);
+}
+
+static void pddby_jsonl_put_id(FILE* f, int64_t value)
+{
+    if (value)
+    {
+        fprintf(f, "%" PRId64, value);
+    }
+    else
+    {
+        fputs("null", f);
+    }
+}
+
+static int pddby_decode_sink_jsonl_batch_end(pddby_decode_sink_t* sink)
+{
+    struct pddby_decode_sink_jsonl* jsonl_sink = (struct pddby_decode_sink_jsonl*)sink;
+
+    if (fflush(jsonl_sink->file) == EOF)
+    {
+        pddby_report(sink->pddby, pddby_message_type_error, "unable to flush decode output");
+        return 0;
+    }
+    return 1;
+}
+
+static int pddby_decode_sink_jsonl_write(pddby_decode_sink_t* sink, pddby_decode_record_t* record)
+{
+    static char const* const s_link_types[] =
+    {
+        "image_traffreg",
+        "question_section",
+        "question_traffreg"
+    };
+
+    FILE* f = ((struct pddby_decode_sink_jsonl*)sink)->file;
+
+    if (record->type != pddby_decode_record_link)
+    {
+        record->id = pddby_decode_sink_next_id(sink, record->type);
+    }
+
+    switch (record->type)
+    {
+    case pddby_decode_record_image:
+        fprintf(f, "{\"type\":\"image\",\"id\":%" PRId64 ",\"name\":", record->id);
+        pddby_jsonl_put_string(f, record->value.image.name);
+        fputs(",\"data\":", f);
+        pddby_jsonl_put_base64(f, record->value.image.data, record->value.image.data_size);
+        break;
+    case pddby_decode_record_comment:
+        fprintf(f, "{\"type\":\"comment\",\"id\":%" PRId64 ",\"number\":%d,\"text\":", record->id,
+            record->value.comment.number);
+        pddby_jsonl_put_string(f, record->value.comment.text);
+        break;
+    case pddby_decode_record_traffreg:
+        fprintf(f, "{\"type\":\"traffreg\",\"id\":%" PRId64 ",\"number\":%d,\"text\":", record->id,
+            record->value.traffreg.number);
+        pddby_jsonl_put_string(f, record->value.traffreg.text);
+        break;
+    case pddby_decode_record_question:
+        fprintf(f, "{\"type\":\"question\",\"id\":%" PRId64 ",\"topic_id\":", record->id);
+        pddby_jsonl_put_id(f, record->value.question.topic_id);
+        fputs(",\"text\":", f);
+        pddby_jsonl_put_string(f, record->value.question.text);
+        fputs(",\"image_id\":", f);
+        pddby_jsonl_put_id(f, record->value.question.image_id);
+        fputs(",\"advice\":", f);
+        pddby_jsonl_put_string(f, record->value.question.advice);
+        fputs(",\"comment_id\":", f);
+        pddby_jsonl_put_id(f, record->value.question.comment_id);
+        break;
+    case pddby_decode_record_answer:
+        fprintf(f, "{\"type\":\"answer\",\"id\":%" PRId64 ",\"question_id\":", record->id);
+        pddby_jsonl_put_id(f, record->value.answer.question_id);
+        fputs(",\"text\":", f);
+        pddby_jsonl_put_string(f, record->value.answer.text);
+        fprintf(f, ",\"is_correct\":%s", record->value.answer.is_correct ? "true" : "false");
+        break;
+    case pddby_decode_record_link:
+        if (record->value.link.type < 0 ||
+            (size_t)record->value.link.type >= sizeof(s_link_types) / sizeof(*s_link_types))
+        {
+            return 0;
+        }
+        fprintf(f, "{\"type\":\"link\",\"kind\":\"%s\",\"from\":%" PRId64 ",\"to\":%" PRId64,
+            s_link_types[record->value.link.type], record->value.link.from_id, record->value.link.to_id);
+        break;
+    default:
+        return 0;
+    }
+
+    fputs("}\n", f);
+
+    return !ferror(f);
+}
+
+static int pddby_decode_sink_jsonl_finish(pddby_decode_sink_t* sink)
+{
+    return pddby_decode_sink_jsonl_batch_end(sink);
+}
+
+static void pddby_decode_sink_jsonl_free(pddby_decode_sink_t* sink)
+{
+    struct pddby_decode_sink_jsonl* jsonl_sink = (struct pddby_decode_sink_jsonl*)sink;
+
+    if (jsonl_sink->file)
+    {
+        if (fclose(jsonl_sink->file) == EOF)
+        {
+            pddby_report(sink->pddby, pddby_message_type_warning, "unable to close decode output");
+        }
+    }
+    if (jsonl_sink->buffer)
+    {
+        free(jsonl_sink->buffer);
+    }
+    free(jsonl_sink);
+}
+
+pddby_decode_sink_t* pddby_decode_sink_new_jsonl(pddby_t* pddby, char const* path)
+{
+    struct pddby_decode_sink_jsonl* sink = NULL;
+
+    if (!path)
+    {
+        pddby_report(pddby, pddby_message_type_error, "no output path given for JSON Lines decode sink");
+        goto error;
+    }
+
+    sink = calloc(1, sizeof(struct pddby_decode_sink_jsonl));
+    if (!sink)
+    {
+        goto error;
+    }
+
+    sink->base.pddby = pddby;
+    sink->base.batch_end = &pddby_decode_sink_jsonl_batch_end;
+    sink->base.write = &pddby_decode_sink_jsonl_write;
+    sink->base.finish = &pddby_decode_sink_jsonl_finish;
+    sink->base.free = &pddby_decode_sink_jsonl_free;
+
+    sink->file = fopen(path, "wb");
+    if (!sink->file)
+    {
+        goto error;
+    }
+
+    // records are small and numerous, let stdio group them into large writes until batch ends
+    sink->buffer = malloc(256 * 1024);
+    if (sink->buffer)
+    {
+        setvbuf(sink->file, sink->buffer, _IOFBF, 256 * 1024);
+    }
+
+    return &sink->base;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create JSON Lines decode sink for \"%s\"",
+        path ? path : "");
+
+    if (sink)
+    {
+        pddby_decode_sink_jsonl_free(&sink->base);
+    }
+
+    return NULL;
+}
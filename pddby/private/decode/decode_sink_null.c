@@ -0,0 +1,41 @@
+#include "decode_sink.h"
+
+#include "private/util/report.h"
+
+#include <stdlib.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+// discards everything, only hands out ids so that decoding can proceed; useful to measure pure decode speed
+
+static int pddby_decode_sink_null_write(pddby_decode_sink_t* sink, pddby_decode_record_t* record)
+{
+    if (record->type != pddby_decode_record_link)
+    {
+        record->id = pddby_decode_sink_next_id(sink, record->type);
+    }
+    return 1;
+}
+
+static void pddby_decode_sink_null_free(pddby_decode_sink_t* sink)
+{
+    free(sink);
+}
+
+pddby_decode_sink_t* pddby_decode_sink_new_null(pddby_t* pddby)
+{
+    pddby_decode_sink_t* sink = calloc(1, sizeof(pddby_decode_sink_t));
+    if (!sink)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to create null decode sink");
+        return NULL;
+    }
+
+    sink->pddby = pddby;
+    sink->write = &pddby_decode_sink_null_write;
+    sink->free = &pddby_decode_sink_null_free;
+
+    return sink;
+}
@@ -0,0 +1,645 @@
+#include "decode_sink.h"
+
+#include "private/util/database.h"
+#include "private/util/map.h"
+#include "private/util/pack.h"
+#include "private/util/report.h"
+#include "section.h"
+#include "topic.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+struct pddby_pack_buffer
+{
+    char* data;
+    size_t size;
+    size_t reserved_size;
+};
+
+struct pddby_pack_link_pair
+{
+    uint32_t owner_id;
+    uint32_t id;
+};
+
+struct pddby_decode_sink_pack
+{
+    pddby_decode_sink_t base;
+
+    FILE* file;
+    uint64_t blobs_offset;
+    uint64_t blobs_size;
+
+    struct pddby_pack_buffer tables[pddby_pack_table_count];
+    struct pddby_pack_buffer link_pairs[pddby_pack_link_count];
+    int out_of_memory;
+
+    // repeating texts share one copy in string pool
+    pddby_map_t* string_offsets;
+};
+
+static int pddby_pack_buffer_append(struct pddby_pack_buffer* buffer, void const* data, size_t size)
+{
+    if (buffer->size + size > buffer->reserved_size)
+    {
+        size_t new_reserved_size = buffer->reserved_size ? buffer->reserved_size : 4096;
+        while (new_reserved_size < buffer->size + size)
+        {
+            new_reserved_size *= 2;
+        }
+
+        char* new_data = realloc(buffer->data, new_reserved_size);
+        if (!new_data)
+        {
+            return 0;
+        }
+
+        buffer->data = new_data;
+        buffer->reserved_size = new_reserved_size;
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+
+    return 1;
+}
+
+static int pddby_pack_buffer_append_uint32(struct pddby_pack_buffer* buffer, uint32_t value)
+{
+    return pddby_pack_buffer_append(buffer, &value, sizeof(value));
+}
+
+static uint32_t pddby_decode_sink_pack_string(struct pddby_decode_sink_pack* sink, char const* value)
+{
+    if (!value)
+    {
+        return 0;
+    }
+
+    size_t const value_size = strlen(value) + 1;
+
+    int64_t existing_offset;
+    if (pddby_map_get(sink->string_offsets, value, value_size, &existing_offset))
+    {
+        return existing_offset;
+    }
+
+    struct pddby_pack_buffer* strings = &sink->tables[pddby_pack_strings];
+    uint32_t const offset = strings->size;
+    if (!pddby_pack_buffer_append(strings, value, value_size) ||
+        !pddby_map_set(sink->string_offsets, value, value_size, offset))
+    {
+        sink->out_of_memory = 1;
+        return 0;
+    }
+
+    return offset;
+}
+
+static int pddby_decode_sink_pack_append(struct pddby_decode_sink_pack* sink, int table, void const* record)
+{
+    return pddby_pack_buffer_append(&sink->tables[table], record, pddby_pack_record_size(table));
+}
+
+static int pddby_decode_sink_pack_link(struct pddby_decode_sink_pack* sink, int link, int64_t owner_id, int64_t id)
+{
+    struct pddby_pack_link_pair pair = {owner_id, id};
+    return pddby_pack_buffer_append(&sink->link_pairs[link], &pair, sizeof(pair));
+}
+
+static int pddby_decode_sink_pack_pad(struct pddby_decode_sink_pack* sink)
+{
+    static char const s_zeros[PDDBY_PACK_ALIGNMENT] = {0};
+
+    long const position = ftell(sink->file);
+    if (position == -1)
+    {
+        return 0;
+    }
+
+    size_t const padding = (PDDBY_PACK_ALIGNMENT - position % PDDBY_PACK_ALIGNMENT) % PDDBY_PACK_ALIGNMENT;
+    return fwrite(s_zeros, 1, padding, sink->file) == padding;
+}
+
+static int pddby_decode_sink_pack_write(pddby_decode_sink_t* sink, pddby_decode_record_t* record)
+{
+    struct pddby_decode_sink_pack* pack_sink = (struct pddby_decode_sink_pack*)sink;
+
+    int result = 1;
+    switch (record->type)
+    {
+    case pddby_decode_record_image:
+        {
+            // blobs go to file right away, so that image data is never held in memory as a whole
+            struct pddby_pack_image image;
+            memset(&image, 0, sizeof(image));
+            image.name = pddby_decode_sink_pack_string(pack_sink, record->value.image.name);
+            image.data_offset = pack_sink->blobs_size;
+            image.data_size = record->value.image.data_size;
+
+            result =
+                fwrite(record->value.image.data, 1, image.data_size, pack_sink->file) == image.data_size &&
+                pddby_decode_sink_pack_pad(pack_sink) &&
+                pddby_decode_sink_pack_append(pack_sink, pddby_pack_images, &image);
+
+            long const position = ftell(pack_sink->file);
+            pack_sink->blobs_size = position - pack_sink->blobs_offset;
+        }
+        break;
+    case pddby_decode_record_comment:
+        {
+            struct pddby_pack_comment comment;
+            comment.number = record->value.comment.number;
+            comment.text = pddby_decode_sink_pack_string(pack_sink, record->value.comment.text);
+            result = pddby_decode_sink_pack_append(pack_sink, pddby_pack_comments, &comment);
+        }
+        break;
+    case pddby_decode_record_traffreg:
+        {
+            struct pddby_pack_traffreg traffreg;
+            traffreg.number = record->value.traffreg.number;
+            traffreg.text = pddby_decode_sink_pack_string(pack_sink, record->value.traffreg.text);
+            result = pddby_decode_sink_pack_append(pack_sink, pddby_pack_traffregs, &traffreg);
+        }
+        break;
+    case pddby_decode_record_question:
+        {
+            struct pddby_pack_question question;
+            question.topic_id = record->value.question.topic_id;
+            question.text = pddby_decode_sink_pack_string(pack_sink, record->value.question.text);
+            question.image_id = record->value.question.image_id;
+            question.advice = pddby_decode_sink_pack_string(pack_sink, record->value.question.advice);
+            question.comment_id = record->value.question.comment_id;
+            result = pddby_decode_sink_pack_append(pack_sink, pddby_pack_questions, &question);
+        }
+        break;
+    case pddby_decode_record_answer:
+        {
+            struct pddby_pack_answer answer;
+            answer.question_id = record->value.answer.question_id;
+            answer.text = pddby_decode_sink_pack_string(pack_sink, record->value.answer.text);
+            answer.is_correct = record->value.answer.is_correct;
+            result = pddby_decode_sink_pack_append(pack_sink, pddby_pack_answers, &answer);
+        }
+        break;
+    case pddby_decode_record_link:
+        switch (record->value.link.type)
+        {
+        case pddby_decode_link_image_traffreg:
+            result = pddby_decode_sink_pack_link(pack_sink, pddby_pack_link_traffreg_images, record->value.link.to_id,
+                record->value.link.from_id);
+            break;
+        case pddby_decode_link_question_section:
+            result = pddby_decode_sink_pack_link(pack_sink, pddby_pack_link_section_questions,
+                record->value.link.to_id, record->value.link.from_id);
+            break;
+        case pddby_decode_link_question_traffreg:
+            result = pddby_decode_sink_pack_link(pack_sink, pddby_pack_link_question_traffregs,
+                record->value.link.from_id, record->value.link.to_id);
+            break;
+        default:
+            result = 0;
+            break;
+        }
+        break;
+    default:
+        result = 0;
+        break;
+    }
+
+    if (!result || pack_sink->out_of_memory)
+    {
+        pddby_report(sink->pddby, pddby_message_type_error, "unable to write decode record to pack");
+        return 0;
+    }
+
+    if (record->type == pddby_decode_record_link)
+    {
+        return 1;
+    }
+
+    record->id = pddby_decode_sink_next_id(sink, record->type);
+    return 1;
+}
+
+static int pddby_decode_sink_pack_add_bootstrap(struct pddby_decode_sink_pack* sink)
+{
+    pddby_t* pddby = sink->base.pddby;
+
+    // sections, topics and settings are not decoded but come with bootstrap database; links refer to their ids,
+    // which are expected to be dense
+    pddby_sections_t* sections = pddby_sections_find_all(pddby);
+    if (!sections)
+    {
+        return 0;
+    }
+    for (size_t i = 0, size = pddby_array_size(sections); i < size; i++)
+    {
+        pddby_section_t const* section = pddby_array_index(sections, i);
+        if (section->id != (int64_t)i + 1)
+        {
+            pddby_sections_free(sections);
+            return 0;
+        }
+
+        struct pddby_pack_section pack_section;
+        pack_section.name = pddby_decode_sink_pack_string(sink, section->name);
+        pack_section.title_prefix = pddby_decode_sink_pack_string(sink, section->title_prefix);
+        pack_section.title = pddby_decode_sink_pack_string(sink, section->title);
+        if (!pddby_decode_sink_pack_append(sink, pddby_pack_sections, &pack_section))
+        {
+            pddby_sections_free(sections);
+            return 0;
+        }
+    }
+    pddby_sections_free(sections);
+
+    pddby_topics_t* topics = pddby_topics_find_all(pddby);
+    if (!topics)
+    {
+        return 0;
+    }
+    for (size_t i = 0, size = pddby_array_size(topics); i < size; i++)
+    {
+        pddby_topic_t const* topic = pddby_array_index(topics, i);
+        if (topic->id != (int64_t)i + 1)
+        {
+            pddby_topics_free(topics);
+            return 0;
+        }
+
+        struct pddby_pack_topic pack_topic;
+        pack_topic.number = topic->number;
+        pack_topic.title = pddby_decode_sink_pack_string(sink, topic->title);
+        if (!pddby_decode_sink_pack_append(sink, pddby_pack_topics, &pack_topic))
+        {
+            pddby_topics_free(topics);
+            return 0;
+        }
+    }
+    pddby_topics_free(topics);
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(pddby, "SELECT `key`, `value` FROM `settings`");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        struct pddby_pack_setting setting;
+        setting.key = pddby_decode_sink_pack_string(sink, pddby_db_column_text(db_stmt, 0));
+        setting.value = pddby_decode_sink_pack_string(sink, pddby_db_column_text(db_stmt, 1));
+        if (!pddby_decode_sink_pack_append(sink, pddby_pack_settings, &setting))
+        {
+            ret = -1;
+            break;
+        }
+    }
+    pddby_db_finalize(db_stmt);
+
+    return ret == 0;
+}
+
+static int pddby_decode_sink_pack_build_links(struct pddby_decode_sink_pack* sink, int link, int owner_table,
+    int index_table, int ids_table)
+{
+    size_t const owner_count = sink->tables[owner_table].size / pddby_pack_record_size(owner_table);
+    struct pddby_pack_link_pair const* pairs = (struct pddby_pack_link_pair const*)sink->link_pairs[link].data;
+    size_t const pair_count = sink->link_pairs[link].size / sizeof(struct pddby_pack_link_pair);
+
+    uint32_t* index = calloc(owner_count + 1, sizeof(uint32_t));
+    if (!index)
+    {
+        return 0;
+    }
+
+    // counting sort by owner, stable so that links keep their decode order
+    for (size_t i = 0; i < pair_count; i++)
+    {
+        if (pairs[i].owner_id < 1 || pairs[i].owner_id > owner_count)
+        {
+            free(index);
+            return 0;
+        }
+        index[pairs[i].owner_id]++;
+    }
+    for (size_t i = 0; i < owner_count; i++)
+    {
+        index[i + 1] += index[i];
+    }
+
+    struct pddby_pack_buffer* ids = &sink->tables[ids_table];
+    if (!pddby_pack_buffer_append(&sink->tables[index_table], index, (owner_count + 1) * sizeof(uint32_t)) ||
+        (pair_count && !pddby_pack_buffer_append(ids, pairs, pair_count * sizeof(uint32_t))))
+    {
+        free(index);
+        return 0;
+    }
+
+    uint32_t* ids_data = (uint32_t*)ids->data;
+    for (size_t i = 0; i < pair_count; i++)
+    {
+        ids_data[index[pairs[i].owner_id - 1]++] = pairs[i].id;
+    }
+
+    free(index);
+    return 1;
+}
+
+static int pddby_pack_compare_numbers(void const* a, void const* b)
+{
+    struct pddby_pack_link_pair const* pa = a;
+    struct pddby_pack_link_pair const* pb = b;
+    if ((int32_t)pa->owner_id != (int32_t)pb->owner_id)
+    {
+        return (int32_t)pa->owner_id < (int32_t)pb->owner_id ? -1 : 1;
+    }
+    return pa->id < pb->id ? -1 : pa->id > pb->id;
+}
+
+struct pddby_pack_name_pair
+{
+    char const* name;
+    uint32_t id;
+};
+
+static int pddby_pack_compare_names(void const* a, void const* b)
+{
+    struct pddby_pack_name_pair const* pa = a;
+    struct pddby_pack_name_pair const* pb = b;
+    int const result = strcmp(pa->name, pb->name);
+    if (result)
+    {
+        return result;
+    }
+    return pa->id < pb->id ? -1 : pa->id > pb->id;
+}
+
+static int pddby_decode_sink_pack_build_numbers(struct pddby_decode_sink_pack* sink, int table, int sorted_table)
+{
+    size_t const count = sink->tables[table].size / pddby_pack_record_size(table);
+    if (!count)
+    {
+        return 1;
+    }
+
+    // number and id pairs, reusing link pair layout
+    struct pddby_pack_link_pair* pairs = malloc(count * sizeof(struct pddby_pack_link_pair));
+    if (!pairs)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t const* number = (int32_t const*)(sink->tables[table].data + i * pddby_pack_record_size(table));
+        pairs[i].owner_id = *number;
+        pairs[i].id = i + 1;
+    }
+
+    qsort(pairs, count, sizeof(struct pddby_pack_link_pair), &pddby_pack_compare_numbers);
+
+    int result = 1;
+    for (size_t i = 0; i < count && result; i++)
+    {
+        result = pddby_pack_buffer_append_uint32(&sink->tables[sorted_table], pairs[i].id);
+    }
+
+    free(pairs);
+    return result;
+}
+
+static int pddby_decode_sink_pack_build_names(struct pddby_decode_sink_pack* sink)
+{
+    size_t const count = sink->tables[pddby_pack_images].size / sizeof(struct pddby_pack_image);
+    if (!count)
+    {
+        return 1;
+    }
+
+    struct pddby_pack_name_pair* pairs = malloc(count * sizeof(struct pddby_pack_name_pair));
+    if (!pairs)
+    {
+        return 0;
+    }
+
+    struct pddby_pack_image const* images = (struct pddby_pack_image const*)sink->tables[pddby_pack_images].data;
+    for (size_t i = 0; i < count; i++)
+    {
+        pairs[i].name = sink->tables[pddby_pack_strings].data + images[i].name;
+        pairs[i].id = i + 1;
+    }
+
+    qsort(pairs, count, sizeof(struct pddby_pack_name_pair), &pddby_pack_compare_names);
+
+    int result = 1;
+    for (size_t i = 0; i < count && result; i++)
+    {
+        result = pddby_pack_buffer_append_uint32(&sink->tables[pddby_pack_image_names], pairs[i].id);
+    }
+
+    free(pairs);
+    return result;
+}
+
+static int pddby_decode_sink_pack_build(struct pddby_decode_sink_pack* sink)
+{
+    // owners of topic question and question answer links are known from records themselves
+    struct pddby_pack_question const* questions =
+        (struct pddby_pack_question const*)sink->tables[pddby_pack_questions].data;
+    size_t const question_count = sink->tables[pddby_pack_questions].size / sizeof(struct pddby_pack_question);
+    for (size_t i = 0; i < question_count; i++)
+    {
+        if (!pddby_decode_sink_pack_link(sink, pddby_pack_link_topic_questions, questions[i].topic_id, i + 1))
+        {
+            return 0;
+        }
+    }
+
+    struct pddby_pack_answer const* answers = (struct pddby_pack_answer const*)sink->tables[pddby_pack_answers].data;
+    size_t const answer_count = sink->tables[pddby_pack_answers].size / sizeof(struct pddby_pack_answer);
+    for (size_t i = 0; i < answer_count; i++)
+    {
+        if (!pddby_decode_sink_pack_link(sink, pddby_pack_link_question_answers, answers[i].question_id, i + 1))
+        {
+            return 0;
+        }
+    }
+
+    return
+        pddby_decode_sink_pack_build_links(sink, pddby_pack_link_traffreg_images, pddby_pack_traffregs,
+            pddby_pack_traffreg_image_index, pddby_pack_traffreg_image_ids) &&
+        pddby_decode_sink_pack_build_links(sink, pddby_pack_link_section_questions, pddby_pack_sections,
+            pddby_pack_section_question_index, pddby_pack_section_question_ids) &&
+        pddby_decode_sink_pack_build_links(sink, pddby_pack_link_topic_questions, pddby_pack_topics,
+            pddby_pack_topic_question_index, pddby_pack_topic_question_ids) &&
+        pddby_decode_sink_pack_build_links(sink, pddby_pack_link_question_traffregs, pddby_pack_questions,
+            pddby_pack_question_traffreg_index, pddby_pack_question_traffreg_ids) &&
+        pddby_decode_sink_pack_build_links(sink, pddby_pack_link_question_answers, pddby_pack_questions,
+            pddby_pack_question_answer_index, pddby_pack_question_answer_ids) &&
+        pddby_decode_sink_pack_build_numbers(sink, pddby_pack_comments, pddby_pack_comment_numbers) &&
+        pddby_decode_sink_pack_build_numbers(sink, pddby_pack_traffregs, pddby_pack_traffreg_numbers) &&
+        pddby_decode_sink_pack_build_names(sink);
+}
+
+static int pddby_decode_sink_pack_finish(pddby_decode_sink_t* sink)
+{
+    struct pddby_decode_sink_pack* pack_sink = (struct pddby_decode_sink_pack*)sink;
+
+    if (!pddby_decode_sink_pack_add_bootstrap(pack_sink) ||
+        !pddby_decode_sink_pack_build(pack_sink) ||
+        pack_sink->out_of_memory)
+    {
+        goto error;
+    }
+
+    struct pddby_pack_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PDDBY_PACK_MAGIC, sizeof(PDDBY_PACK_MAGIC));
+    header.version = PDDBY_PACK_VERSION;
+    header.byte_order = PDDBY_PACK_BYTE_ORDER;
+    header.tables[pddby_pack_blobs].offset = pack_sink->blobs_offset;
+    header.tables[pddby_pack_blobs].size = pack_sink->blobs_size;
+
+    for (int i = 0; i < pddby_pack_table_count; i++)
+    {
+        if (i == pddby_pack_blobs)
+        {
+            continue;
+        }
+
+        if (!pddby_decode_sink_pack_pad(pack_sink))
+        {
+            goto error;
+        }
+
+        struct pddby_pack_buffer const* table = &pack_sink->tables[i];
+        header.tables[i].offset = ftell(pack_sink->file);
+        header.tables[i].size = table->size;
+        if (table->size && fwrite(table->data, 1, table->size, pack_sink->file) != table->size)
+        {
+            goto error;
+        }
+    }
+
+    long const file_size = ftell(pack_sink->file);
+    if (file_size == -1)
+    {
+        goto error;
+    }
+    header.file_size = file_size;
+
+    if (fseek(pack_sink->file, 0, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, pack_sink->file) != 1 ||
+        fflush(pack_sink->file) != 0)
+    {
+        goto error;
+    }
+
+    return 1;
+
+error:
+    pddby_report(sink->pddby, pddby_message_type_error, "unable to write pack");
+    return 0;
+}
+
+static void pddby_decode_sink_pack_free(pddby_decode_sink_t* sink)
+{
+    struct pddby_decode_sink_pack* pack_sink = (struct pddby_decode_sink_pack*)sink;
+
+    if (pack_sink->file)
+    {
+        if (fclose(pack_sink->file) == EOF)
+        {
+            pddby_report(sink->pddby, pddby_message_type_warning, "unable to close decode output");
+        }
+    }
+    for (int i = 0; i < pddby_pack_table_count; i++)
+    {
+        if (pack_sink->tables[i].data)
+        {
+            free(pack_sink->tables[i].data);
+        }
+    }
+    for (int i = 0; i < pddby_pack_link_count; i++)
+    {
+        if (pack_sink->link_pairs[i].data)
+        {
+            free(pack_sink->link_pairs[i].data);
+        }
+    }
+    if (pack_sink->string_offsets)
+    {
+        pddby_map_free(pack_sink->string_offsets);
+    }
+    free(pack_sink);
+}
+
+pddby_decode_sink_t* pddby_decode_sink_new_pack(pddby_t* pddby, char const* path)
+{
+    struct pddby_decode_sink_pack* sink = NULL;
+
+    if (!path)
+    {
+        pddby_report(pddby, pddby_message_type_error, "no output path given for pack decode sink");
+        goto error;
+    }
+
+    sink = calloc(1, sizeof(struct pddby_decode_sink_pack));
+    if (!sink)
+    {
+        goto error;
+    }
+
+    sink->base.pddby = pddby;
+    sink->base.write = &pddby_decode_sink_pack_write;
+    sink->base.finish = &pddby_decode_sink_pack_finish;
+    sink->base.free = &pddby_decode_sink_pack_free;
+
+    sink->string_offsets = pddby_map_new(pddby);
+    if (!sink->string_offsets)
+    {
+        goto error;
+    }
+
+    sink->file = fopen(path, "wb");
+    if (!sink->file)
+    {
+        goto error;
+    }
+
+    // header is written last, once table offsets are known; image blobs follow it right away
+    struct pddby_pack_header header;
+    memset(&header, 0, sizeof(header));
+    if (fwrite(&header, sizeof(header), 1, sink->file) != 1 ||
+        !pddby_decode_sink_pack_pad(sink))
+    {
+        goto error;
+    }
+    sink->blobs_offset = ftell(sink->file);
+
+    // offset 0 of string pool stands for NULL
+    if (!pddby_pack_buffer_append(&sink->tables[pddby_pack_strings], "", 1))
+    {
+        goto error;
+    }
+
+    return &sink->base;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create pack decode sink");
+    if (sink)
+    {
+        pddby_decode_sink_pack_free(&sink->base);
+    }
+    return NULL;
+}
@@ -0,0 +1,341 @@
+#include "decode_task.h"
+
+#include "private/pddby.h"
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+struct pddby_decode_event
+{
+    struct pddby_decode_event* next;
+    int type;
+    int value;
+    char* text;
+    pddby_progress_t progress;
+    pddby_trace_entry_t* entries;
+};
+
+typedef struct pddby_decode_event pddby_decode_event_t;
+
+struct pddby_decode_task
+{
+    pddby_t* pddby;
+    char* root_path;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+
+    pddby_decode_event_t* head;
+    pddby_decode_event_t* tail;
+
+    int cancelled;
+    int done;
+    int result;
+};
+
+static void pddby_decode_event_free(pddby_decode_event_t* event)
+{
+    if (event->text)
+    {
+        free(event->text);
+    }
+    if (event->entries)
+    {
+        free(event->entries);
+    }
+    free(event);
+}
+
+static void* pddby_decode_task_run(void* data)
+{
+    pddby_decode_task_t* task = data;
+
+    // wait for pddby_decode_async to finish filling the task in
+    pthread_mutex_lock(&task->mutex);
+    pthread_mutex_unlock(&task->mutex);
+
+    int result = pddby_decode(task->pddby, task->root_path);
+
+    pthread_mutex_lock(&task->mutex);
+    task->result = result;
+    task->done = 1;
+    pthread_mutex_unlock(&task->mutex);
+
+    return NULL;
+}
+
+static void pddby_decode_task_free(pddby_decode_task_t* task)
+{
+    while (task->head)
+    {
+        pddby_decode_event_t* next = task->head->next;
+        pddby_decode_event_free(task->head);
+        task->head = next;
+    }
+
+    pthread_mutex_destroy(&task->mutex);
+    free(task->root_path);
+    free(task);
+}
+
+pddby_decode_task_t* pddby_decode_async(pddby_t* pddby, char const* root_path)
+{
+    assert(pddby);
+    assert(root_path);
+
+    if (pddby->decode_task)
+    {
+        pddby_report(pddby, pddby_message_type_error, "decode is already in progress");
+        return NULL;
+    }
+
+    pddby_decode_task_t* task = calloc(1, sizeof(pddby_decode_task_t));
+    if (!task)
+    {
+        goto error;
+    }
+
+    task->pddby = pddby;
+
+    task->root_path = strdup(root_path);
+    if (!task->root_path)
+    {
+        free(task);
+        goto error;
+    }
+
+    if (pthread_mutex_init(&task->mutex, NULL))
+    {
+        free(task->root_path);
+        free(task);
+        goto error;
+    }
+
+    pddby->decode_task = task;
+
+    pthread_mutex_lock(&task->mutex);
+    int const create_error = pthread_create(&task->thread, NULL, &pddby_decode_task_run, task);
+    pthread_mutex_unlock(&task->mutex);
+
+    if (create_error)
+    {
+        pddby->decode_task = NULL;
+        pddby_decode_task_free(task);
+        goto error;
+    }
+
+    return task;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to start decode");
+    return NULL;
+}
+
+int pddby_decode_task_dispatch(pddby_decode_task_t* task)
+{
+    assert(task);
+
+    // buffered messages travel separately from events, so relative order between the two is only approximate
+    pddby_drain_messages(task->pddby, 0);
+
+    pthread_mutex_lock(&task->mutex);
+    pddby_decode_event_t* event = task->head;
+    task->head = task->tail = NULL;
+    int const running = !task->done;
+    pthread_mutex_unlock(&task->mutex);
+
+    pddby_callbacks_t const* callbacks = task->pddby->callbacks;
+
+    while (event)
+    {
+        switch (event->type)
+        {
+        case pddby_decode_event_message:
+            if (callbacks && callbacks->message)
+            {
+                callbacks->message(task->pddby, event->value, event->text);
+            }
+            break;
+        case pddby_decode_event_progress_begin:
+            if (callbacks && callbacks->progress_begin)
+            {
+                callbacks->progress_begin(task->pddby, event->value);
+            }
+            break;
+        case pddby_decode_event_progress:
+            if (callbacks && callbacks->progress)
+            {
+                callbacks->progress(task->pddby, event->value);
+            }
+            break;
+        case pddby_decode_event_progress_end:
+            if (callbacks && callbacks->progress_end)
+            {
+                callbacks->progress_end(task->pddby);
+            }
+            break;
+        case pddby_decode_event_progress_ex:
+            if (callbacks && callbacks->progress_ex)
+            {
+                callbacks->progress_ex(task->pddby, &event->progress);
+            }
+            break;
+        case pddby_decode_event_trace_summary:
+            if (callbacks && callbacks->trace_summary)
+            {
+                callbacks->trace_summary(task->pddby, event->entries, event->value);
+            }
+            break;
+        }
+
+        pddby_decode_event_t* next = event->next;
+        pddby_decode_event_free(event);
+        event = next;
+    }
+
+    return running;
+}
+
+void pddby_decode_task_cancel(pddby_decode_task_t* task)
+{
+    assert(task);
+
+    pthread_mutex_lock(&task->mutex);
+    task->cancelled = 1;
+    pthread_mutex_unlock(&task->mutex);
+}
+
+int pddby_decode_task_finish(pddby_decode_task_t* task)
+{
+    assert(task);
+
+    pthread_join(task->thread, NULL);
+    task->pddby->decode_task = NULL;
+
+    // deliver whatever worker managed to post before exiting
+    pddby_decode_task_dispatch(task);
+
+    int result = task->result;
+    pddby_decode_task_free(task);
+
+    return result;
+}
+
+static int pddby_decode_task_push(pddby_t* pddby, int type, int value, char* text, pddby_progress_t const* progress,
+    pddby_trace_entry_t* entries)
+{
+    assert(pddby);
+
+    pddby_decode_task_t* task = pddby->decode_task;
+    if (!task || !pthread_equal(pthread_self(), task->thread))
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&task->mutex);
+
+    // frontend only cares about latest position, so collapse consecutive progress updates
+    if ((type == pddby_decode_event_progress || type == pddby_decode_event_progress_ex) && task->tail &&
+        task->tail->type == type)
+    {
+        task->tail->value = value;
+        if (progress)
+        {
+            task->tail->progress = *progress;
+        }
+        pthread_mutex_unlock(&task->mutex);
+        return 1;
+    }
+
+    pddby_decode_event_t* event = malloc(sizeof(pddby_decode_event_t));
+    if (!event)
+    {
+        pthread_mutex_unlock(&task->mutex);
+        if (text)
+        {
+            free(text);
+        }
+        if (entries)
+        {
+            free(entries);
+        }
+        return 1;
+    }
+
+    event->next = NULL;
+    event->type = type;
+    event->value = value;
+    event->text = text;
+    event->entries = entries;
+    if (progress)
+    {
+        event->progress = *progress;
+    }
+
+    if (task->tail)
+    {
+        task->tail->next = event;
+    }
+    else
+    {
+        task->head = event;
+    }
+    task->tail = event;
+
+    pthread_mutex_unlock(&task->mutex);
+
+    return 1;
+}
+
+int pddby_decode_task_post(pddby_t* pddby, int type, int value, char* text)
+{
+    return pddby_decode_task_push(pddby, type, value, text, NULL, NULL);
+}
+
+int pddby_decode_task_post_progress(pddby_t* pddby, pddby_progress_t const* progress)
+{
+    return pddby_decode_task_push(pddby, pddby_decode_event_progress_ex, 0, NULL, progress, NULL);
+}
+
+int pddby_decode_task_post_trace_summary(pddby_t* pddby, pddby_trace_entry_t const* entries, int count)
+{
+    pddby_decode_task_t* task = pddby->decode_task;
+    if (!task || !pthread_equal(pthread_self(), task->thread))
+    {
+        return 0;
+    }
+
+    // caller's array is gone by the time frontend gets to it
+    pddby_trace_entry_t* entries_copy = malloc((count ? count : 1) * sizeof(pddby_trace_entry_t));
+    if (!entries_copy)
+    {
+        return 1;
+    }
+    memcpy(entries_copy, entries, count * sizeof(pddby_trace_entry_t));
+
+    return pddby_decode_task_push(pddby, pddby_decode_event_trace_summary, count, NULL, NULL, entries_copy);
+}
+
+int pddby_decode_task_is_cancelled(pddby_t* pddby)
+{
+    assert(pddby);
+
+    pddby_decode_task_t* task = pddby->decode_task;
+    if (!task)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&task->mutex);
+    int result = task->cancelled;
+    pthread_mutex_unlock(&task->mutex);
+
+    return result;
+}
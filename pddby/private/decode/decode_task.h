@@ -0,0 +1,24 @@
+#ifndef PDDBY_PRIVATE_DECODE_TASK_H
+#define PDDBY_PRIVATE_DECODE_TASK_H
+
+#include "pddby.h"
+
+enum pddby_decode_event_type
+{
+    pddby_decode_event_message,
+    pddby_decode_event_progress_begin,
+    pddby_decode_event_progress,
+    pddby_decode_event_progress_end,
+    pddby_decode_event_progress_ex,
+    pddby_decode_event_trace_summary
+};
+
+// returns 1 if event was queued for delivery on frontend thread (text ownership is taken), 0 if caller should
+// deliver it directly
+int pddby_decode_task_post(pddby_t* pddby, int type, int value, char* text);
+int pddby_decode_task_post_progress(pddby_t* pddby, pddby_progress_t const* progress);
+int pddby_decode_task_post_trace_summary(pddby_t* pddby, pddby_trace_entry_t const* entries, int count);
+
+int pddby_decode_task_is_cancelled(pddby_t* pddby);
+
+#endif // PDDBY_PRIVATE_DECODE_TASK_H
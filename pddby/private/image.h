@@ -0,0 +1,14 @@
+#ifndef PDDBY_PRIVATE_IMAGE_H
+#define PDDBY_PRIVATE_IMAGE_H
+
+#include "image.h"
+#include "private/util/database.h"
+
+#include <stdint.h>
+
+// format, size, `image_data` row id and store row id columns starting at column, in that order
+pddby_image_t* pddby_image_new_from_db(pddby_t* pddby, int64_t id, char const* name, pddby_db_stmt_t* db_stmt,
+    int column);
+pddby_image_t* pddby_image_new_from_pack(pddby_t* pddby, int64_t id);
+
+#endif // PDDBY_PRIVATE_IMAGE_H
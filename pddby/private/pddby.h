@@ -1,15 +1,46 @@
 #ifndef PDDBY_PRIVATE_PDDBY_H
 #define PDDBY_PRIVATE_PDDBY_H
 
+#include "private/util/random.h"
+#include "private/util/report.h"
+
+#include <pthread.h>
+#include <time.h>
+
 struct pddby_callbacks;
 struct pddby_db;
 struct pddby_decode_context;
+struct pddby_decode_task;
+struct pddby_identity_map;
+struct pddby_log;
+struct pddby_pack;
+struct pddby_settings;
+struct pddby_trace;
 
 struct pddby
 {
     struct pddby_callbacks const* callbacks;
     struct pddby_db* database;
+    struct pddby_pack* pack;
+    struct pddby_identity_map* identity_map;
+    struct pddby_settings* settings;
     struct pddby_decode_context* decode_context;
+    struct pddby_decode_task* decode_task;
+    int decode_output;
+    char* decode_output_path;
+
+    struct pddby_report_progress_state progress;
+
+    int log_level;
+    struct pddby_log* log;
+
+    struct pddby_trace* trace;
+    char* trace_path;
+
+    // reader threads may draw random tickets too, mutex guards both generator and pool of question ids
+    pthread_mutex_t random_mutex;
+    pddby_random_t random;
+    struct pddby_questions_pool* questions_pool;
 };
 
 #endif // PDDBY_PRIVATE_PDDBY_H
@@ -0,0 +1,63 @@
+#ifndef PDDBY_PRIVATE_QUERIES_H
+#define PDDBY_PRIVATE_QUERIES_H
+
+// lookups going through keys and indexes of the schema; tests/query_plan.c checks that they still do, so models
+// prepare them from here rather than from literals of their own
+
+// questions
+#define PDDBY_QUERY_QUESTION_BY_ID \
+    "SELECT `topic_id`, `text`, `image_id`, `comment_id` FROM `questions` WHERE `id`=? LIMIT 1"
+#define PDDBY_QUERY_QUESTIONS_BY_TOPIC \
+    "SELECT `id`, `text`, `image_id`, `comment_id` FROM `questions` WHERE `topic_id`=? ORDER BY `id` LIMIT ?,?"
+#define PDDBY_QUERY_QUESTIONS_BY_SECTION \
+    "SELECT q.`id`, q.`topic_id`, q.`text`, q.`image_id`, q.`comment_id` FROM `questions_sections` qs INNER JOIN " \
+    "`questions` q ON q.`id`=qs.`question_id` WHERE qs.`section_id`=?"
+#define PDDBY_QUERY_QUESTIONS_BY_TICKET \
+    "SELECT q.`id`, q.`topic_id`, q.`text`, q.`image_id`, q.`comment_id` FROM `tickets` t INNER JOIN `questions` q " \
+    "ON q.`id`=t.`question_id` WHERE t.`ticket_number`=? ORDER BY t.`slot`"
+#define PDDBY_QUERY_QUESTION_ADVICE \
+    "SELECT t.`text` FROM `question_advices` a INNER JOIN `texts` t ON t.`id`=a.`advice_id` WHERE a.`question_id`=? " \
+    "LIMIT 1"
+
+// answers
+#define PDDBY_QUERY_ANSWERS_BY_QUESTION \
+    "SELECT a.`id`, t.`text`, a.`is_correct` FROM `answers` a LEFT JOIN `texts` t ON t.`id`=a.`text_id` WHERE " \
+    "a.`question_id`=?"
+
+// images, `image_store` is a view that is empty unless image store is attached
+#define PDDBY_QUERY_IMAGE_BY_NAME \
+    "SELECT i.`id`, COALESCE(d.`format`, s.`format`), COALESCE(d.`size`, s.`size`), d.`image_id`, s.`row_id` FROM " \
+    "`images` i LEFT JOIN `image_data` d ON d.`image_id`=i.`id` LEFT JOIN `image_store` s ON s.`hash`=i.`hash` WHERE " \
+    "i.`name`=? LIMIT 1"
+#define PDDBY_QUERY_IMAGES_BY_TRAFFREG \
+    "SELECT i.`id`, i.`name`, COALESCE(d.`format`, s.`format`), COALESCE(d.`size`, s.`size`), d.`image_id`, " \
+    "s.`row_id` FROM `images_traffregs` it INNER JOIN `images` i ON i.`id`=it.`image_id` LEFT JOIN `image_data` d ON " \
+    "d.`image_id`=i.`id` LEFT JOIN `image_store` s ON s.`hash`=i.`hash` WHERE it.`traffreg_id`=? ORDER BY " \
+    "it.`position`"
+
+// comments and traffregs
+#define PDDBY_QUERY_COMMENT_BY_NUMBER \
+    "SELECT `id`, `text` FROM `comments` WHERE `number`=? LIMIT 1"
+#define PDDBY_QUERY_TRAFFREG_BY_NUMBER \
+    "SELECT r.`id`, t.`text` FROM `traffregs` r LEFT JOIN `texts` t ON t.`id`=r.`text_id` WHERE r.`number`=? LIMIT 1"
+#define PDDBY_QUERY_TRAFFREGS_BY_QUESTION \
+    "SELECT r.`id`, r.`number`, t.`text` FROM `questions_traffregs` qt INNER JOIN `traffregs` r ON " \
+    "r.`id`=qt.`traffreg_id` LEFT JOIN `texts` t ON t.`id`=r.`text_id` WHERE qt.`question_id`=? ORDER BY " \
+    "qt.`position`"
+#define PDDBY_QUERY_TRAFFREGS_WITH_IMAGES_BY_QUESTION \
+    "SELECT qt.`position`, r.`id`, r.`number`, t.`text`, i.`id`, i.`name`, COALESCE(d.`format`, s.`format`), " \
+    "COALESCE(d.`size`, s.`size`), d.`image_id`, s.`row_id` FROM `questions_traffregs` qt INNER JOIN `traffregs` r " \
+    "ON r.`id`=qt.`traffreg_id` LEFT JOIN `texts` t ON t.`id`=r.`text_id` LEFT JOIN `images_traffregs` it ON " \
+    "it.`traffreg_id`=r.`id` LEFT JOIN `images` i ON i.`id`=it.`image_id` LEFT JOIN `image_data` d ON " \
+    "d.`image_id`=i.`id` LEFT JOIN `image_store` s ON s.`hash`=i.`hash` WHERE qt.`question_id`=? ORDER BY " \
+    "qt.`position`, it.`position`"
+
+// texts, topics and sections
+#define PDDBY_QUERY_TEXT_BY_HASH \
+    "SELECT `id` FROM `texts` WHERE `hash`=? AND `text`=? LIMIT 1"
+#define PDDBY_QUERY_TOPIC_BY_NUMBER \
+    "SELECT `id`, `title` FROM `topics` WHERE `number`=? LIMIT 1"
+#define PDDBY_QUERY_SECTION_BY_NAME \
+    "SELECT `id`, `title_prefix`, `title` FROM `sections` WHERE `name`=? LIMIT 1"
+
+#endif // PDDBY_PRIVATE_QUERIES_H
@@ -0,0 +1,9 @@
+#ifndef PDDBY_PRIVATE_QUESTION_H
+#define PDDBY_PRIVATE_QUESTION_H
+
+#include "pddby.h"
+
+// ids random papers are drawn from are kept by handle until database they were read from is closed or decoded into
+void pddby_questions_pool_invalidate(pddby_t* pddby);
+
+#endif // PDDBY_PRIVATE_QUESTION_H
@@ -1,11 +1,12 @@
 #include "aux.h"
 
 #include "report.h"
+#include "trace.h"
 
 #include <assert.h>
 #include <dirent.h>
 #include <fcntl.h>
-#include <openssl/md5.h>
+#include <openssl/evp.h>
 #include <pwd.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -143,6 +144,9 @@ int pddby_aux_file_get_contents(pddby_t* pddby, char const* filename, char** buf
 
     *buffer = 0;
 
+    pddby_trace_span_t span;
+    pddby_trace_begin(pddby, &span, pddby_trace_file_read);
+
     int fd = open(filename, O_RDONLY);
     if (fd == -1)
     {
@@ -182,6 +186,8 @@ int pddby_aux_file_get_contents(pddby_t* pddby, char const* filename, char** buf
     }
 
     (*buffer)[file_size] = '\0';
+
+    pddby_trace_end(pddby, &span, file_size, 1);
     return 1;
 
 error:
@@ -209,11 +215,55 @@ error:
     return 0;
 }
 
+static char* pddby_aux_format_checksum(uint8_t const* md5sum, size_t md5sum_size)
+{
+    char* result = malloc(md5sum_size * 2 + 1);
+    if (!result)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < md5sum_size; i++)
+    {
+        if (sprintf(result + i * 2, "%02x", md5sum[i]) != 2)
+        {
+            free(result);
+            return NULL;
+        }
+    }
+
+    return result;
+}
+
+char* pddby_aux_get_checksum(pddby_t* pddby, void const* data, size_t data_size)
+{
+    uint8_t md5sum[EVP_MAX_MD_SIZE];
+    unsigned int md5sum_size = 0;
+
+    EVP_MD_CTX* md5ctx = EVP_MD_CTX_new();
+    int const digested = md5ctx &&
+        EVP_DigestInit_ex(md5ctx, EVP_md5(), NULL) &&
+        EVP_DigestUpdate(md5ctx, data, data_size) &&
+        EVP_DigestFinal_ex(md5ctx, md5sum, &md5sum_size);
+    if (md5ctx)
+    {
+        EVP_MD_CTX_free(md5ctx);
+    }
+
+    char* result = digested ? pddby_aux_format_checksum(md5sum, md5sum_size) : NULL;
+    if (!result)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to get checksum");
+    }
+    return result;
+}
+
 char* pddby_aux_file_get_checksum(pddby_t* pddby, char const* file_path)
 {
     assert(file_path);
 
     uint8_t* buffer = NULL;
+    EVP_MD_CTX* md5ctx = NULL;
 
     FILE* f = fopen(file_path, "rb");
     if (!f)
@@ -221,8 +271,12 @@ char* pddby_aux_file_get_checksum(pddby_t* pddby, char const* file_path)
         goto error;
     }
 
-    MD5_CTX md5ctx;
-    MD5_Init(&md5ctx);
+    md5ctx = EVP_MD_CTX_new();
+    if (!md5ctx ||
+        !EVP_DigestInit_ex(md5ctx, EVP_md5(), NULL))
+    {
+        goto error;
+    }
 
     buffer = malloc(32 * 1024);
     if (!buffer)
@@ -241,27 +295,27 @@ char* pddby_aux_file_get_checksum(pddby_t* pddby, char const* file_path)
             }
             goto error;
         }
-        MD5_Update(&md5ctx, buffer, bytes_read);
+        if (!EVP_DigestUpdate(md5ctx, buffer, bytes_read))
+        {
+            goto error;
+        }
     }
     while (!feof(f));
 
-    uint8_t md5sum[MD5_DIGEST_LENGTH];
-    MD5_Final(md5sum, &md5ctx);
-
-    char* result = malloc(MD5_DIGEST_LENGTH * 2 + 1);
-    if (!result)
+    uint8_t md5sum[EVP_MAX_MD_SIZE];
+    unsigned int md5sum_size = 0;
+    if (!EVP_DigestFinal_ex(md5ctx, md5sum, &md5sum_size))
     {
         goto error;
     }
 
-    for (size_t i = 0; i < MD5_DIGEST_LENGTH; i++)
+    char* result = pddby_aux_format_checksum(md5sum, md5sum_size);
+    if (!result)
     {
-        if (sprintf(result + i * 2, "%02x", md5sum[i]) != 2)
-        {
-            goto error;
-        }
+        goto error;
     }
 
+    EVP_MD_CTX_free(md5ctx);
     free(buffer);
     if (fclose(f) == EOF)
     {
@@ -273,6 +327,11 @@ char* pddby_aux_file_get_checksum(pddby_t* pddby, char const* file_path)
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to get checksum of \"%s\"", file_path);
 
+    if (md5ctx)
+    {
+        EVP_MD_CTX_free(md5ctx);
+    }
+
     if (buffer)
     {
         free(buffer);
@@ -287,8 +346,3 @@ error:
     }
     return NULL;
 }
-
-int32_t pddby_aux_random_int_range(int32_t begin, int32_t end)
-{
-    return begin + rand() * (double)(end - begin) / RAND_MAX;
-}
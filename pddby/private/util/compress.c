@@ -0,0 +1,426 @@
+#include "compress.h"
+
+#include "report.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define PDDBY_COMPRESS_MAX_THREADS 8
+// queued items per worker before submitter has to wait
+#define PDDBY_COMPRESS_QUEUE_DEPTH 4
+
+struct pddby_decompress_stream
+{
+    pddby_t* pddby;
+    z_stream stream;
+    int is_finished;
+};
+
+struct pddby_compress_item
+{
+    struct pddby_compress_item* next;
+    int64_t id;
+    int format;
+    void* data;
+    size_t data_size;
+    size_t raw_size;
+};
+
+typedef struct pddby_compress_item pddby_compress_item_t;
+
+struct pddby_compress_pool
+{
+    pddby_t* pddby;
+
+    pthread_t threads[PDDBY_COMPRESS_MAX_THREADS];
+    int thread_count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t queued_cond;
+    pthread_cond_t done_cond;
+
+    pddby_compress_item_t* queued_head;
+    pddby_compress_item_t* queued_tail;
+    size_t queued_count;
+
+    pddby_compress_item_t* done_head;
+    pddby_compress_item_t* done_tail;
+
+    // submitted but not yet finished
+    size_t busy_count;
+    int stop;
+};
+
+int pddby_compress(void const* data, size_t data_size, void** result, size_t* result_size)
+{
+    assert(data || !data_size);
+    assert(result);
+    assert(result_size);
+
+    uLongf compressed_size = compressBound(data_size);
+    Bytef* compressed = malloc(compressed_size);
+    if (!compressed)
+    {
+        return 0;
+    }
+
+    if (compress2(compressed, &compressed_size, data, data_size, Z_DEFAULT_COMPRESSION) != Z_OK ||
+        compressed_size >= data_size)
+    {
+        free(compressed);
+        return 0;
+    }
+
+    // bound is way too pessimistic to keep it around
+    void* shrunk = realloc(compressed, compressed_size);
+    *result = shrunk ? shrunk : compressed;
+    *result_size = compressed_size;
+    return 1;
+}
+
+void* pddby_decompress(pddby_t* pddby, int format, void const* data, size_t data_size, size_t result_size)
+{
+    void* result = malloc(result_size ? result_size : 1);
+    if (!result)
+    {
+        goto error;
+    }
+
+    switch (format)
+    {
+    case pddby_compress_format_raw:
+        if (data_size != result_size)
+        {
+            goto error;
+        }
+        memcpy(result, data, data_size);
+        break;
+    case pddby_compress_format_zlib:
+        {
+            uLongf size = result_size;
+            if (uncompress(result, &size, data, data_size) != Z_OK || size != result_size)
+            {
+                goto error;
+            }
+        }
+        break;
+    default:
+        pddby_report(pddby, pddby_message_type_error, "unknown compression format %d", format);
+        goto error;
+    }
+
+    return result;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to decompress data");
+    if (result)
+    {
+        free(result);
+    }
+    return NULL;
+}
+
+pddby_decompress_stream_t* pddby_decompress_stream_new(pddby_t* pddby)
+{
+    pddby_decompress_stream_t* stream = calloc(1, sizeof(pddby_decompress_stream_t));
+    if (!stream)
+    {
+        goto error;
+    }
+
+    stream->pddby = pddby;
+
+    if (inflateInit(&stream->stream) != Z_OK)
+    {
+        free(stream);
+        goto error;
+    }
+
+    return stream;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create decompression stream");
+    return NULL;
+}
+
+void pddby_decompress_stream_free(pddby_decompress_stream_t* stream)
+{
+    assert(stream);
+
+    inflateEnd(&stream->stream);
+    free(stream);
+}
+
+int pddby_decompress_stream_wants_input(pddby_decompress_stream_t const* stream)
+{
+    assert(stream);
+
+    return !stream->is_finished && stream->stream.avail_in == 0;
+}
+
+void pddby_decompress_stream_feed(pddby_decompress_stream_t* stream, void const* data, size_t data_size)
+{
+    assert(stream);
+    assert(data_size <= UINT_MAX);
+
+    stream->stream.next_in = (Bytef*)data;
+    stream->stream.avail_in = data_size;
+}
+
+int pddby_decompress_stream_read(pddby_decompress_stream_t* stream, void* buffer, size_t size, size_t* read_size)
+{
+    assert(stream);
+    assert(buffer);
+    assert(read_size);
+
+    *read_size = 0;
+
+    if (stream->is_finished)
+    {
+        return 0;
+    }
+
+    stream->stream.next_out = buffer;
+    stream->stream.avail_out = size < UINT_MAX ? size : UINT_MAX;
+
+    int const result = inflate(&stream->stream, Z_NO_FLUSH);
+    *read_size = (size < UINT_MAX ? size : UINT_MAX) - stream->stream.avail_out;
+
+    switch (result)
+    {
+    case Z_STREAM_END:
+        stream->is_finished = 1;
+        return *read_size ? 1 : 0;
+    case Z_OK:
+        return 1;
+    case Z_BUF_ERROR:
+        // no progress possible until more data is fed
+        if (stream->stream.avail_in == 0)
+        {
+            return 1;
+        }
+        break;
+    }
+
+    pddby_report(stream->pddby, pddby_message_type_error, "unable to decompress data (%d)", result);
+    return -1;
+}
+
+static void pddby_compress_items_free(pddby_compress_item_t* item)
+{
+    while (item)
+    {
+        pddby_compress_item_t* next = item->next;
+        free(item->data);
+        free(item);
+        item = next;
+    }
+}
+
+static void* pddby_compress_pool_run(void* data)
+{
+    pddby_compress_pool_t* pool = data;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;)
+    {
+        while (!pool->queued_head && !pool->stop)
+        {
+            pthread_cond_wait(&pool->queued_cond, &pool->mutex);
+        }
+        if (!pool->queued_head)
+        {
+            break;
+        }
+
+        pddby_compress_item_t* item = pool->queued_head;
+        pool->queued_head = item->next;
+        if (!pool->queued_head)
+        {
+            pool->queued_tail = NULL;
+        }
+        pool->queued_count--;
+        pthread_mutex_unlock(&pool->mutex);
+
+        // whatever doesn't compress stays raw
+        void* compressed;
+        size_t compressed_size;
+        if (pddby_compress(item->data, item->data_size, &compressed, &compressed_size))
+        {
+            free(item->data);
+            item->format = pddby_compress_format_zlib;
+            item->data = compressed;
+            item->data_size = compressed_size;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        item->next = NULL;
+        if (pool->done_tail)
+        {
+            pool->done_tail->next = item;
+        }
+        else
+        {
+            pool->done_head = item;
+        }
+        pool->done_tail = item;
+        pool->busy_count--;
+        pthread_cond_broadcast(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+pddby_compress_pool_t* pddby_compress_pool_new(pddby_t* pddby)
+{
+    pddby_compress_pool_t* pool = calloc(1, sizeof(pddby_compress_pool_t));
+    if (!pool)
+    {
+        goto error;
+    }
+
+    pool->pddby = pddby;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->queued_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    // decoding itself keeps one core busy
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (thread_count < 1)
+    {
+        thread_count = 1;
+    }
+    else if (thread_count > PDDBY_COMPRESS_MAX_THREADS)
+    {
+        thread_count = PDDBY_COMPRESS_MAX_THREADS;
+    }
+
+    while (pool->thread_count < thread_count)
+    {
+        if (pthread_create(&pool->threads[pool->thread_count], NULL, &pddby_compress_pool_run, pool) != 0)
+        {
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (!pool->thread_count)
+    {
+        pddby_compress_pool_free(pool);
+        goto error;
+    }
+
+    return pool;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create compression pool");
+    return NULL;
+}
+
+void pddby_compress_pool_free(pddby_compress_pool_t* pool)
+{
+    assert(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->queued_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pddby_compress_items_free(pool->queued_head);
+    pddby_compress_items_free(pool->done_head);
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->queued_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+int pddby_compress_pool_submit(pddby_compress_pool_t* pool, int64_t id, void const* data, size_t data_size)
+{
+    assert(pool);
+
+    pddby_compress_item_t* item = calloc(1, sizeof(pddby_compress_item_t));
+    if (!item)
+    {
+        goto error;
+    }
+
+    item->data = malloc(data_size ? data_size : 1);
+    if (!item->data)
+    {
+        free(item);
+        goto error;
+    }
+
+    memcpy(item->data, data, data_size);
+    item->id = id;
+    item->format = pddby_compress_format_raw;
+    item->data_size = data_size;
+    item->raw_size = data_size;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->queued_count >= (size_t)pool->thread_count * PDDBY_COMPRESS_QUEUE_DEPTH)
+    {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    if (pool->queued_tail)
+    {
+        pool->queued_tail->next = item;
+    }
+    else
+    {
+        pool->queued_head = item;
+    }
+    pool->queued_tail = item;
+    pool->queued_count++;
+    pool->busy_count++;
+    pthread_cond_signal(&pool->queued_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    return 1;
+
+error:
+    pddby_report(pool->pddby, pddby_message_type_error, "unable to submit data for compression");
+    return 0;
+}
+
+int pddby_compress_pool_collect(pddby_compress_pool_t* pool, int wait, pddby_compress_pool_func_t func,
+    void* user_data)
+{
+    assert(pool);
+    assert(func);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (wait && pool->busy_count)
+    {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pddby_compress_item_t* items = pool->done_head;
+    pool->done_head = NULL;
+    pool->done_tail = NULL;
+    pthread_mutex_unlock(&pool->mutex);
+
+    int result = 1;
+    for (pddby_compress_item_t* item = items; item && result; item = item->next)
+    {
+        result = func(user_data, item->id, item->format, item->data, item->data_size, item->raw_size);
+    }
+
+    pddby_compress_items_free(items);
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef PDDBY_PRIVATE_COMPRESS_H
+#define PDDBY_PRIVATE_COMPRESS_H
+
+#include "pddby.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// stored along with compressed data, never renumber
+enum pddby_compress_format
+{
+    pddby_compress_format_raw = 0,
+    pddby_compress_format_zlib = 1
+};
+
+// 0 if data doesn't get any smaller, it should then be stored raw
+int pddby_compress(void const* data, size_t data_size, void** result, size_t* result_size);
+void* pddby_decompress(pddby_t* pddby, int format, void const* data, size_t data_size, size_t result_size);
+
+struct pddby_decompress_stream;
+typedef struct pddby_decompress_stream pddby_decompress_stream_t;
+
+// decompresses zlib data piece by piece as it comes, without having all of it at hand
+pddby_decompress_stream_t* pddby_decompress_stream_new(pddby_t* pddby);
+void pddby_decompress_stream_free(pddby_decompress_stream_t* stream);
+// fed data has to stay around until stream wants more
+int pddby_decompress_stream_wants_input(pddby_decompress_stream_t const* stream);
+void pddby_decompress_stream_feed(pddby_decompress_stream_t* stream, void const* data, size_t data_size);
+// 1 with up to size bytes decompressed (maybe none if input ran out), 0 once everything is out, -1 on error
+int pddby_decompress_stream_read(pddby_decompress_stream_t* stream, void* buffer, size_t size, size_t* read_size);
+
+struct pddby_compress_pool;
+typedef struct pddby_compress_pool pddby_compress_pool_t;
+
+typedef int (*pddby_compress_pool_func_t)(void* user_data, int64_t id, int format, void const* data,
+    size_t data_size, size_t raw_size);
+
+// compresses submitted data on worker threads, results are handed back on collecting thread only
+pddby_compress_pool_t* pddby_compress_pool_new(pddby_t* pddby);
+void pddby_compress_pool_free(pddby_compress_pool_t* pool);
+
+// data is copied; blocks while workers are too far behind
+int pddby_compress_pool_submit(pddby_compress_pool_t* pool, int64_t id, void const* data, size_t data_size);
+// calls func for every finished item, with wait set also waits for all submitted items to finish
+int pddby_compress_pool_collect(pddby_compress_pool_t* pool, int wait, pddby_compress_pool_func_t func,
+    void* user_data);
+
+#endif // PDDBY_PRIVATE_COMPRESS_H
@@ -2,128 +2,953 @@
 
 #include "aux.h"
 #include "config.h"
+#include "database_sql.h"
+#include "identity.h"
 #include "report.h"
+#include "seal.h"
 #include "settings.h"
+#include "texts.h"
 
 #include "private/pddby.h"
+#include "private/question.h"
 
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <sqlite3.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef DMALLOC
 #include <dmalloc.h>
 #endif
 
+// settings key written once decode into cache has finished; such cache is never written to again
+#define PDDBY_DB_COMPLETE_KEY "cache_complete"
+// settings key written along with the one above if image payloads of cache went to image store
+#define PDDBY_DB_NEEDS_IMAGE_STORE_KEY "cache_needs_image_store"
+
+struct pddby_db_cached_stmt
+{
+    char const* sql;
+    pddby_db_stmt_t* stmt;
+};
+
+// statements of one connection keyed by address of their SQL, open addressing with power of two size
+struct pddby_db_stmt_cache
+{
+    struct pddby_db_cached_stmt* stmts;
+    size_t size;
+    size_t used;
+};
+
+// connection of its own for every other thread reading complete cache through the same handle
+struct pddby_db_reader
+{
+    struct pddby_db_reader* next;
+    pthread_t thread;
+    sqlite3* database;
+    struct pddby_db_stmt_cache stmt_cache;
+};
+
 struct pddby_db
 {
     int use_cache;
-    char* share_dir;
+    int use_sealed;
+    // complete cache is opened writable to be updated by decode
+    int for_update;
     char* database_file;
+    char* sealed_file;
+    char* image_store_file;
+    int image_store_attached;
+    // complete cache that has no images of its own without store
+    int needs_image_store;
     sqlite3* database;
     int database_tx_count;
+    int read_only;
+    int64_t open_time;
+    int queried;
+    struct pddby_db_stmt_cache stmt_cache;
+    // thread that opened the database, its queries keep going through the main connection
+    pthread_t owner_thread;
+    pthread_mutex_t readers_mutex;
+    struct pddby_db_reader* readers;
+};
+
+struct pddby_db_stmt
+{
+    pddby_t* pddby;
+    sqlite3_stmt* statement;
+};
+
+struct pddby_db_blob
+{
+    pddby_t* pddby;
+    sqlite3_blob* blob;
 };
 
-struct pddby_db_stmt
-{
-    pddby_t* pddby;
-    sqlite3_stmt* statement;
-};
+sqlite3* pddby_db_get(pddby_t* pddby);
+
+static int pddby_db_stmt_expect(pddby_db_stmt_t* stmt, int result, int expected_result, char const* scope,
+    char const* message)
+{
+    if (result != expected_result)
+    {
+        pddby_report(stmt->pddby, pddby_message_type_error, "%s: %s (%d: %s)", scope, message, result,
+            sqlite3_errmsg(sqlite3_db_handle(stmt->statement)));
+        return 0;
+    }
+    return 1;
+}
+
+static int pddby_db_expect(pddby_t* pddby, int result, int expected_result, char const* scope, char const* message)
+{
+    if (result != expected_result)
+    {
+        pddby_report(pddby, pddby_message_type_error, "%s: %s (%d: %s)", scope, message, result, sqlite3_errmsg(pddby_db_get(pddby)));
+        return 0;
+    }
+    return 1;
+}
+
+static int pddby_db_query_int(sqlite3* database, char const* sql)
+{
+    int value = -1;
+
+    sqlite3_stmt* statement;
+    if (sqlite3_prepare_v2(database, sql, -1, &statement, NULL) == SQLITE_OK)
+    {
+        if (sqlite3_step(statement) == SQLITE_ROW)
+        {
+            value = sqlite3_column_int(statement, 0);
+        }
+        sqlite3_finalize(statement);
+    }
+
+    return value;
+}
+
+static int pddby_db_latest_version()
+{
+    // caches created before schema got versioned are version 1
+    int version = 1;
+    for (pddby_db_migration_t const* migration = pddby_db_migrations; migration->sql; migration++)
+    {
+        version = migration->version;
+    }
+    return version;
+}
+
+static int64_t pddby_db_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int pddby_db_image_store_exists(pddby_t* pddby)
+{
+    return pddby->database->image_store_file && access(pddby->database->image_store_file, R_OK) == 0;
+}
+
+// returns schema version of existing cache (-1 if there is none or it is unreadable) without locking it; complete
+// cache whose image store has gone is as good as incomplete one, it has to be decoded again
+static int pddby_db_probe_ex(pddby_t* pddby, int* is_complete, int* needs_image_store, int* lacks_image_store)
+{
+    *is_complete = 0;
+    *needs_image_store = 0;
+    *lacks_image_store = 0;
+
+    if (access(pddby->database->database_file, R_OK) != 0)
+    {
+        return -1;
+    }
+
+    int version = -1;
+
+    sqlite3* database;
+    if (sqlite3_open_v2(pddby->database->database_file, &database, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK)
+    {
+        version = pddby_db_query_int(database, "PRAGMA user_version");
+        *is_complete = pddby_db_query_int(database, "SELECT COUNT(*) FROM `settings` WHERE `key`='"
+            PDDBY_DB_COMPLETE_KEY "'") > 0;
+        *needs_image_store = *is_complete && pddby_db_query_int(database, "SELECT COUNT(*) FROM `settings` WHERE "
+            "`key`='" PDDBY_DB_NEEDS_IMAGE_STORE_KEY "'") > 0;
+        *lacks_image_store = *needs_image_store && !pddby_db_image_store_exists(pddby);
+        if (*lacks_image_store)
+        {
+            *is_complete = 0;
+        }
+    }
+    sqlite3_close(database);
+
+    return version;
+}
+
+static int pddby_db_probe(pddby_t* pddby, int* is_complete)
+{
+    int needs_image_store;
+    int lacks_image_store;
+    return pddby_db_probe_ex(pddby, is_complete, &needs_image_store, &lacks_image_store);
+}
+
+int pddby_db_exists(pddby_t* pddby)
+{
+    int is_complete;
+    int needs_image_store;
+    int lacks_image_store;
+    int const version = pddby_db_probe_ex(pddby, &is_complete, &needs_image_store, &lacks_image_store);
+
+    if (lacks_image_store)
+    {
+        pddby_report(pddby, pddby_message_type_warning, "cache has its images in store \"%s\" which is missing",
+            pddby->database->image_store_file ? pddby->database->image_store_file : "");
+        return 0;
+    }
+
+    // older caches are upgraded in place, newer ones can't be read and have to be decoded again
+    return version >= 0 && version <= pddby_db_latest_version();
+}
+
+static int pddby_db_exec_versioned(pddby_t* pddby, sqlite3* database, char const* sql, int version)
+{
+    char version_sql[64];
+    snprintf(version_sql, sizeof(version_sql), "PRAGMA user_version = %d", version);
+
+    char* error_text = NULL;
+    if (sqlite3_exec(database, "BEGIN EXCLUSIVE TRANSACTION", NULL, NULL, &error_text) != SQLITE_OK ||
+        sqlite3_exec(database, sql, NULL, NULL, &error_text) != SQLITE_OK ||
+        sqlite3_exec(database, version_sql, NULL, NULL, &error_text) != SQLITE_OK ||
+        sqlite3_exec(database, "COMMIT TRANSACTION", NULL, NULL, &error_text) != SQLITE_OK)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to bring database to version %d (%s)", version,
+            error_text ? error_text : sqlite3_errmsg(database));
+        sqlite3_free(error_text);
+        sqlite3_exec(database, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+        return 0;
+    }
+
+    return 1;
+}
+
+static void pddby_db_text_hash_func(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+    (void)argc;
+
+    char const* text = (char const*)sqlite3_value_text(argv[0]);
+    if (text)
+    {
+        sqlite3_result_int64(context, pddby_texts_hash(text));
+    }
+    else
+    {
+        sqlite3_result_null(context);
+    }
+}
+
+static int pddby_db_migrate(pddby_t* pddby, sqlite3* database)
+{
+    int const latest_version = pddby_db_latest_version();
+
+    int version = pddby_db_query_int(database, "PRAGMA user_version");
+    if (version == 0)
+    {
+        int const table_count = pddby_db_query_int(database, "SELECT COUNT(*) FROM `sqlite_master` WHERE "
+            "`type`='table'");
+        if (table_count == 0)
+        {
+            return pddby_db_exec_versioned(pddby, database, pddby_db_bootstrap_sql, latest_version);
+        }
+        if (table_count > 0)
+        {
+            version = 1;
+        }
+    }
+
+    if (version < 1)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to get database version");
+        return 0;
+    }
+
+    if (version > latest_version)
+    {
+        pddby_report(pddby, pddby_message_type_error, "database version %d is newer than supported version %d",
+            version, latest_version);
+        return 0;
+    }
+
+    for (pddby_db_migration_t const* migration = pddby_db_migrations; migration->sql; migration++)
+    {
+        if (migration->version <= version)
+        {
+            continue;
+        }
+
+        pddby_report(pddby, pddby_message_type_log, "upgrading database from version %d to %d", version,
+            migration->version);
+
+        if (!pddby_db_exec_versioned(pddby, database, migration->sql, migration->version))
+        {
+            return 0;
+        }
+
+        version = migration->version;
+    }
+
+    return 1;
+}
+
+static int pddby_db_attach_image_store(pddby_t* pddby, sqlite3* database, int read_only)
+{
+    static char const* const s_store_sql =
+        "CREATE TABLE IF NOT EXISTS `store`.`blobs` (`hash` TEXT PRIMARY KEY, `data` BLOB, "
+            "`format` INTEGER NOT NULL DEFAULT 0, `size` INTEGER NOT NULL DEFAULT 0);"
+        "CREATE TABLE IF NOT EXISTS `store`.`sources` (`source_hash` TEXT PRIMARY KEY, `hash` TEXT NOT NULL) "
+            "WITHOUT ROWID;";
+
+    pddby->database->image_store_attached = 0;
+
+    // store is shared between caches of different discs, so it is not worth keeping in memory
+    if (pddby->database->use_cache && pddby->database->image_store_file &&
+        (!read_only || pddby_db_image_store_exists(pddby)))
+    {
+        char* sql = sqlite3_mprintf("ATTACH DATABASE %Q AS `store`", pddby->database->image_store_file);
+        int result = sql ? sqlite3_exec(database, sql, NULL, NULL, NULL) : SQLITE_NOMEM;
+        sqlite3_free(sql);
+        if (result == SQLITE_OK && !read_only)
+        {
+            result = sqlite3_exec(database, s_store_sql, NULL, NULL, NULL);
+        }
+        if (result == SQLITE_OK)
+        {
+            pddby->database->image_store_attached = 1;
+        }
+        else
+        {
+            // images are then stored along with the rest of data
+            pddby_report(pddby, pddby_message_type_warning, "unable to attach image store: %s",
+                sqlite3_errmsg(database));
+            sqlite3_exec(database, "DETACH DATABASE `store`", NULL, NULL, NULL);
+        }
+    }
+
+    if (pddby->database->needs_image_store && !pddby->database->image_store_attached)
+    {
+        // serving questions with images missing their data is worse than not serving them at all
+        pddby_report(pddby, pddby_message_type_error, "unable to open cache without its image store");
+        return 0;
+    }
+
+    // queries don't need to care whether store is there or not
+    int result = sqlite3_exec(database, pddby->database->image_store_attached ?
+        "CREATE TEMP VIEW `image_store` AS SELECT `rowid` AS `row_id`, `hash`, `data`, `format`, `size` FROM "
+        "`store`.`blobs`" :
+        "CREATE TEMP VIEW `image_store` AS SELECT NULL AS `row_id`, NULL AS `hash`, NULL AS `data`, 0 AS `format`, "
+        "0 AS `size` WHERE 0", NULL, NULL, NULL);
+    return pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to set up image store");
+}
+
+static int pddby_db_setup(pddby_t* pddby, sqlite3* database)
+{
+    // migrations intern texts same way decode does
+    int result = sqlite3_create_function(database, "pddby_text_hash", 1, SQLITE_UTF8, NULL, &pddby_db_text_hash_func,
+        NULL, NULL);
+    if (!pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to register database function") ||
+        !pddby_db_migrate(pddby, database) ||
+        !pddby_db_attach_image_store(pddby, database, 0))
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to open database");
+        return 0;
+    }
+
+    return 1;
+}
+
+static void pddby_db_stmt_cache_clear(struct pddby_db_stmt_cache* cache)
+{
+    for (size_t i = 0; i < cache->size; i++)
+    {
+        if (cache->stmts[i].stmt)
+        {
+            pddby_db_finalize(cache->stmts[i].stmt);
+        }
+    }
+    if (cache->stmts)
+    {
+        free(cache->stmts);
+    }
+    cache->stmts = NULL;
+    cache->size = 0;
+    cache->used = 0;
+}
+
+static void pddby_db_close(pddby_t* pddby)
+{
+    // objects mapped so far may not match whatever gets opened next
+    pddby_identity_map_clear(pddby->identity_map);
+    pddby_settings_invalidate(pddby);
+    pddby_questions_pool_invalidate(pddby);
+
+    while (pddby->database->readers)
+    {
+        struct pddby_db_reader* reader = pddby->database->readers;
+        pddby->database->readers = reader->next;
+        pddby_db_stmt_cache_clear(&reader->stmt_cache);
+        sqlite3_close(reader->database);
+        free(reader);
+    }
+
+    pddby_db_stmt_cache_clear(&pddby->database->stmt_cache);
+
+    if (pddby->database->database)
+    {
+        sqlite3_close(pddby->database->database);
+        pddby->database->database = NULL;
+    }
+}
+
+void pddby_db_init(pddby_t* pddby, char const* cache_dir)
+{
+    pddby->database = calloc(1, sizeof(pddby_db_t));
+    pthread_mutex_init(&pddby->database->readers_mutex, NULL);
+
+    pddby->database->database_file = pddby_aux_build_filename(pddby, cache_dir, "pddby.sqlite", 0);
+    pddby->database->sealed_file = pddby_aux_build_filename(pddby, cache_dir, "pddby.sealed", 0);
+}
+
+void pddby_db_cleanup(pddby_t* pddby)
+{
+    pddby_db_close(pddby);
+    if (pddby->database->database_file)
+    {
+        free(pddby->database->database_file);
+    }
+    if (pddby->database->sealed_file)
+    {
+        free(pddby->database->sealed_file);
+    }
+    if (pddby->database->image_store_file)
+    {
+        free(pddby->database->image_store_file);
+    }
+    pthread_mutex_destroy(&pddby->database->readers_mutex);
+    free(pddby->database);
+}
+
+void pddby_db_use_cache(pddby_t* pddby, int value)
+{
+    pddby->database->use_cache = value;
+}
+
+void pddby_db_use_sealed(pddby_t* pddby, int value)
+{
+    pddby->database->use_sealed = value;
+}
+
+int pddby_db_uses_cache(pddby_t* pddby)
+{
+    return pddby->database->use_cache;
+}
+
+int pddby_db_open_for_update(pddby_t* pddby)
+{
+    if (pddby->database->database)
+    {
+        if (pddby->database->read_only)
+        {
+            pddby_report(pddby, pddby_message_type_error, "unable to update cache (already opened read-only)");
+            return -1;
+        }
+        return 0;
+    }
+
+    int is_complete;
+    int const version = pddby_db_probe(pddby, &is_complete);
+    if (version < 0)
+    {
+        return 0;
+    }
+
+    if (!is_complete || version > pddby_db_latest_version())
+    {
+        // whatever interrupted decode left there can't be completed
+        pddby_db_discard(pddby);
+        return 0;
+    }
+
+    pddby->database->for_update = 1;
+    return pddby_db_get(pddby) ? 1 : -1;
+}
+
+void pddby_db_discard(pddby_t* pddby)
+{
+    pddby_db_close(pddby);
+
+    pddby->database->database_tx_count = 0;
+    pddby->database->read_only = 0;
+    pddby->database->for_update = 0;
+    pddby->database->image_store_attached = 0;
+    pddby->database->needs_image_store = 0;
+
+    if (pddby->database->use_cache)
+    {
+        unlink(pddby->database->database_file);
+    }
+}
+
+int pddby_db_is_sealed(pddby_t* pddby)
+{
+    return pddby->database->use_sealed && !pddby->database->use_cache;
+}
+
+int pddby_db_set_image_store(pddby_t* pddby, char const* path)
+{
+    char* new_path = NULL;
+    if (path)
+    {
+        new_path = strdup(path);
+        if (!new_path)
+        {
+            pddby_report(pddby, pddby_message_type_error, "unable to set image store");
+            return 0;
+        }
+    }
+
+    if (pddby->database->image_store_file)
+    {
+        free(pddby->database->image_store_file);
+    }
+    pddby->database->image_store_file = new_path;
+    return 1;
+}
+
+int pddby_db_has_image_store(pddby_t* pddby)
+{
+    return pddby_db_get(pddby) && pddby->database->image_store_attached;
+}
+
+static char* pddby_db_build_read_only_uri(pddby_t* pddby)
+{
+    char const* database_file = pddby->database->database_file;
+
+    // immutable cache needs no locking or change detection, which saves a good deal of I/O on slow disks; that only
+    // holds while no writer is around, which leaves write-ahead log behind until last connection closes
+    char* wal_file = malloc(strlen(database_file) + strlen("-wal") + 1);
+    if (!wal_file)
+    {
+        return NULL;
+    }
+    sprintf(wal_file, "%s-wal", database_file);
+    char const* const query = access(wal_file, F_OK) == 0 ? "?mode=ro" : "?immutable=1";
+    free(wal_file);
+
+    // worst case is every character being escaped
+    char* uri = malloc(strlen("file:") + strlen(database_file) * 3 + strlen(query) + 1);
+    if (!uri)
+    {
+        return NULL;
+    }
+
+    char* p = uri + sprintf(uri, "file:");
+    for (char const* c = database_file; *c; c++)
+    {
+        if (*c == '%' || *c == '?' || *c == '#')
+        {
+            p += sprintf(p, "%%%02X", (unsigned char)*c);
+        }
+        else
+        {
+            *p++ = *c;
+        }
+    }
+    strcpy(p, query);
+
+    return uri;
+}
+
+static sqlite3* pddby_db_open_reader(pddby_t* pddby)
+{
+    char* uri = pddby_db_build_read_only_uri(pddby);
+    if (!uri)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to open database");
+        return NULL;
+    }
+
+    sqlite3* database = NULL;
+    int result = sqlite3_open_v2(uri, &database, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, NULL);
+    free(uri);
+    if (result != SQLITE_OK)
+    {
+        pddby_report(pddby, pddby_message_type_error, "%s: unable to open database (%d: %s)", __FUNCTION__, result,
+            database ? sqlite3_errmsg(database) : sqlite3_errstr(result));
+        sqlite3_close(database);
+        return NULL;
+    }
+
+    if (!pddby_db_attach_image_store(pddby, database, 1))
+    {
+        sqlite3_close(database);
+        return NULL;
+    }
+
+    // whole cache easily fits into address space, so let pages come straight from the OS page cache
+    sqlite3_exec(database, "PRAGMA mmap_size = 268435456", NULL, NULL, NULL);
+    sqlite3_exec(database, "PRAGMA cache_size = -8192", NULL, NULL, NULL);
+
+    return database;
+}
+
+static int pddby_db_open_read_only(pddby_t* pddby)
+{
+    pddby->database->database = pddby_db_open_reader(pddby);
+    if (!pddby->database->database)
+    {
+        return 0;
+    }
+
+    pddby->database->read_only = 1;
+    return 1;
+}
+
+// connections are only added to the list and never removed while database stays open, so it can be walked unlocked
+// up to the head seen under lock
+static struct pddby_db_reader* pddby_db_get_reader(pddby_t* pddby)
+{
+    pthread_t const thread = pthread_self();
+
+    pthread_mutex_lock(&pddby->database->readers_mutex);
+    struct pddby_db_reader* reader = pddby->database->readers;
+    pthread_mutex_unlock(&pddby->database->readers_mutex);
+
+    for (; reader; reader = reader->next)
+    {
+        if (pthread_equal(reader->thread, thread))
+        {
+            return reader;
+        }
+    }
+
+    reader = calloc(1, sizeof(struct pddby_db_reader));
+    if (!reader)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to open database reader");
+        return NULL;
+    }
+
+    reader->thread = thread;
+    reader->database = pddby_db_open_reader(pddby);
+    if (!reader->database)
+    {
+        free(reader);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pddby->database->readers_mutex);
+    reader->next = pddby->database->readers;
+    pddby->database->readers = reader;
+    pthread_mutex_unlock(&pddby->database->readers_mutex);
+
+    return reader;
+}
+
+sqlite3* pddby_db_get(pddby_t* pddby)
+{
+    if (pddby->database->database)
+    {
+        return pddby->database->database;
+    }
+
+    pddby->database->open_time = pddby_db_now();
+    pddby->database->owner_thread = pthread_self();
 
-sqlite3* pddby_db_get(pddby_t* pddby);
+    int version = -1;
+    int is_complete = 0;
+    int needs_image_store = 0;
+    int lacks_image_store = 0;
+    if (pddby->database->use_cache)
+    {
+        version = pddby_db_probe_ex(pddby, &is_complete, &needs_image_store, &lacks_image_store);
+        if (version < 0 || version > pddby_db_latest_version() || lacks_image_store)
+        {
+            // stale cache of unsupported version or one whose images are gone, if any
+            unlink(pddby->database->database_file);
+            version = -1;
+            is_complete = 0;
+            needs_image_store = 0;
+        }
+    }
 
-static int pddby_db_expect(pddby_t* pddby, int result, int expected_result, char const* scope, char const* message)
-{
-    if (result != expected_result)
+    pddby->database->needs_image_store = needs_image_store;
+
+    if (version == pddby_db_latest_version() && is_complete && !pddby->database->for_update)
     {
-        pddby_report(pddby, pddby_message_type_error, "%s: %s (%d: %s)", scope, message, result, sqlite3_errmsg(pddby_db_get(pddby)));
-        return 0;
+        if (!pddby_db_open_read_only(pddby))
+        {
+            return NULL;
+        }
     }
-    return 1;
+    else
+    {
+        int result = sqlite3_open(pddby->database->use_cache ? pddby->database->database_file : ":memory:", &pddby->database->database);
+        if (!pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to open database"))
+        {
+            return NULL;
+        }
+
+        if (pddby->database->use_cache)
+        {
+            // lets readers of other handles and processes go on while decode writes
+            sqlite3_exec(pddby->database->database, "PRAGMA journal_mode = WAL", NULL, NULL, NULL);
+        }
+
+        if (!pddby_db_setup(pddby, pddby->database->database))
+        {
+            sqlite3_close(pddby->database->database);
+            pddby->database->database = NULL;
+            return NULL;
+        }
+    }
+
+    pddby_report(pddby, pddby_message_type_debug, "database opened%s in %.1f ms",
+        pddby->database->read_only ? " read-only" : "", (pddby_db_now() - pddby->database->open_time) / 1000000.0);
+
+    if (!pddby->pack)
+    {
+        // failure leaves settings missing, which is reported on first use
+        pddby_settings_load(pddby);
+    }
+
+    return pddby->database->database;
 }
 
-int pddby_db_exists(pddby_t* pddby)
+int pddby_db_open(pddby_t* pddby)
 {
-    return access(pddby->database->database_file, R_OK) == 0;
+    return pddby_db_get(pddby) != NULL;
 }
 
-void pddby_db_init(pddby_t* pddby, char const* share_dir, char const* cache_dir)
+int pddby_db_is_read_only(pddby_t* pddby)
 {
-    pddby->database = calloc(1, sizeof(pddby_db_t));
+    return pddby_db_get(pddby) && pddby->database->read_only;
+}
 
-    pddby->database->share_dir = strdup(share_dir);
-    pddby->database->database_file = pddby_aux_build_filename(pddby, cache_dir, "pddby.sqlite", 0);
+int pddby_db_set_complete(pddby_t* pddby)
+{
+    if (!pddby->database->use_cache)
+    {
+        return 1;
+    }
+
+    // images only decoded into store leave nothing but their hashes in cache
+    int result = sqlite3_exec(pddby_db_get(pddby), "DELETE FROM `settings` WHERE `key`='"
+        PDDBY_DB_NEEDS_IMAGE_STORE_KEY "'; INSERT INTO `settings` (`key`, `value`) SELECT '"
+        PDDBY_DB_NEEDS_IMAGE_STORE_KEY "', '1' WHERE EXISTS (SELECT 1 FROM `images` i WHERE i.`hash` IS NOT NULL AND "
+        "NOT EXISTS (SELECT 1 FROM `image_data` d WHERE d.`image_id`=i.`id`)); INSERT OR REPLACE INTO `settings` "
+        "(`key`, `value`) VALUES ('" PDDBY_DB_COMPLETE_KEY "', '1')", NULL, NULL, NULL);
+    return pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to mark cache complete");
 }
 
-void pddby_db_cleanup(pddby_t* pddby)
+int pddby_db_sealed_exists(pddby_t* pddby)
 {
-    if (pddby->database->database)
+    return access(pddby->database->sealed_file, R_OK) == 0;
+}
+
+int pddby_db_save_sealed(pddby_t* pddby, uint8_t const* key)
+{
+    void* sealed = NULL;
+    char* temp_file = NULL;
+    FILE* f = NULL;
+
+    sqlite3_int64 image_size;
+    unsigned char* image = sqlite3_serialize(pddby_db_get(pddby), "main", &image_size, 0);
+    if (!image)
     {
-        sqlite3_close(pddby->database->database);
+        goto error;
     }
-    if (pddby->database->database_file)
+
+    size_t sealed_size;
+    int const sealed_result = pddby_seal(pddby, key, image, image_size, &sealed, &sealed_size);
+    sqlite3_free(image);
+    if (!sealed_result)
     {
-        free(pddby->database->database_file);
+        goto error;
     }
-    if (pddby->database->share_dir)
+
+    // half-written file would look like one made from another disc, so it only replaces old one when complete
+    temp_file = malloc(strlen(pddby->database->sealed_file) + strlen(".tmp") + 1);
+    if (!temp_file)
     {
-        free(pddby->database->share_dir);
+        goto error;
     }
-    free(pddby->database);
+    sprintf(temp_file, "%s.tmp", pddby->database->sealed_file);
+
+    f = fopen(temp_file, "wb");
+    if (!f)
+    {
+        goto error;
+    }
+    int const written = fwrite(sealed, 1, sealed_size, f) == sealed_size;
+    int const closed = fclose(f) == 0;
+    f = NULL;
+    if (!written || !closed || rename(temp_file, pddby->database->sealed_file) == -1)
+    {
+        unlink(temp_file);
+        goto error;
+    }
+
+    free(temp_file);
+    free(sealed);
+    return 1;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to save sealed cache");
+    if (f)
+    {
+        fclose(f);
+    }
+    if (temp_file)
+    {
+        free(temp_file);
+    }
+    if (sealed)
+    {
+        free(sealed);
+    }
+    return 0;
 }
 
-void pddby_db_use_cache(pddby_t* pddby, int value)
+static void* pddby_db_sqlite_alloc(size_t size)
 {
-    pddby->database->use_cache = value;
+    return sqlite3_malloc64(size);
 }
 
-sqlite3* pddby_db_get(pddby_t* pddby)
+int pddby_db_load_sealed(pddby_t* pddby, uint8_t const* key)
 {
-    if (pddby->database->database)
+    char* sealed = NULL;
+    void* image = NULL;
+    sqlite3* database = NULL;
+
+    int64_t const start_time = pddby_db_now();
+
+    size_t sealed_size;
+    if (!pddby_aux_file_get_contents(pddby, pddby->database->sealed_file, &sealed, &sealed_size))
     {
-        return pddby->database->database;
+        goto error;
     }
 
-    if (pddby->database->use_cache && pddby_db_exists(pddby))
+    size_t image_size;
+    if (!pddby_unseal(pddby, key, sealed, sealed_size, &pddby_db_sqlite_alloc, &sqlite3_free, &image, &image_size))
     {
-        int result = sqlite3_open(pddby->database->database_file, &pddby->database->database);
-        if (!pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to open database"))
-        {
-            return NULL;
-        }
-        return pddby->database->database;
+        goto error;
     }
 
-    int result = sqlite3_open(pddby->database->use_cache ? pddby->database->database_file : ":memory:", &pddby->database->database);
+    free(sealed);
+    sealed = NULL;
+
+    int result = sqlite3_open(":memory:", &database);
     if (!pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to open database"))
     {
-        return NULL;
+        goto error;
     }
 
-    char* bootstrap_sql_filename = pddby_aux_build_filename(pddby, pddby->database->share_dir, "data", "10.sql", 0);
-    char* bootstrap_sql;
-    if (!pddby_aux_file_get_contents(pddby, bootstrap_sql_filename, &bootstrap_sql, 0))
+    // database takes ownership of the image even if it fails
+    result = sqlite3_deserialize(database, "main", image, image_size, image_size,
+        SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE);
+    image = NULL;
+    if (!pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to load database image") ||
+        !pddby_db_setup(pddby, database))
     {
-        pddby_report(pddby, pddby_message_type_error, "unable to open database");
-        sqlite3_close(pddby->database->database);
-        free(bootstrap_sql_filename);
-        return NULL;
+        goto error;
+    }
+
+    pddby_db_close(pddby);
+    pddby->database->database = database;
+    pddby->database->database_tx_count = 0;
+    pddby->database->read_only = 0;
+    pddby->database->open_time = pddby_db_now();
+    pddby->database->queried = 0;
+
+    pddby_report(pddby, pddby_message_type_debug, "sealed cache loaded in %.1f ms",
+        (pddby_db_now() - start_time) / 1000000.0);
+
+    if (!pddby->pack)
+    {
+        pddby_settings_load(pddby);
     }
-    free(bootstrap_sql_filename);
 
-    char* error_text;
-    result = sqlite3_exec(pddby->database->database, bootstrap_sql, NULL, NULL, &error_text);
-    if (!pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to bootstrap database"))
+    return 1;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to load sealed cache");
+    if (database)
     {
-        sqlite3_close(pddby->database->database);
-        unlink(pddby->database->database_file);
-        free(bootstrap_sql);
-        return NULL;
+        sqlite3_close(database);
     }
-    free(bootstrap_sql);
+    if (image)
+    {
+        sqlite3_free(image);
+    }
+    if (sealed)
+    {
+        free(sealed);
+    }
+    return 0;
+}
 
-    return pddby->database->database;
+int64_t pddby_db_size(pddby_t* pddby)
+{
+    sqlite3* database = pddby_db_get(pddby);
+    return (int64_t)pddby_db_query_int(database, "PRAGMA page_count") * pddby_db_query_int(database,
+        "PRAGMA page_size");
+}
+
+static void* pddby_db_prefetch_thread(void* database_file)
+{
+#ifdef POSIX_FADV_WILLNEED
+    int fd = open(database_file, O_RDONLY);
+    if (fd != -1)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+#endif
+
+    free(database_file);
+    return NULL;
+}
+
+void pddby_db_prefetch(pddby_t* pddby)
+{
+    if (access(pddby->database->database_file, R_OK) != 0)
+    {
+        return;
+    }
+
+    // thread owns its copy of file name, so it may safely outlive pddby
+    char* database_file = strdup(pddby->database->database_file);
+    if (!database_file)
+    {
+        goto error;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &pddby_db_prefetch_thread, database_file) != 0)
+    {
+        free(database_file);
+        goto error;
+    }
+    pthread_detach(thread);
+
+    return;
+
+error:
+    pddby_report(pddby, pddby_message_type_warning, "unable to prefetch database");
 }
 
 int pddby_db_tx_begin(pddby_t* pddby)
@@ -137,7 +962,8 @@ int pddby_db_tx_begin(pddby_t* pddby)
     {
         return 1;
     }
-    int result = sqlite3_exec(pddby_db_get(pddby), "BEGIN EXCLUSIVE TRANSACTION", NULL, NULL, NULL);
+    // in WAL mode this only keeps other writers away, readers go on with last committed state
+    int result = sqlite3_exec(pddby_db_get(pddby), "BEGIN IMMEDIATE TRANSACTION", NULL, NULL, NULL);
     return pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to begin transaction");
 }
 
@@ -161,53 +987,216 @@ int pddby_db_tx_commit(pddby_t* pddby)
     return pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to commit transaction");
 }
 
-pddby_db_stmt_t* pddby_db_prepare(pddby_t* pddby, char const* sql)
+int pddby_db_tx_rollback(pddby_t* pddby)
+{
+    if (!pddby->database->use_cache)
+    {
+        return 1;
+    }
+    if (!pddby->database->database_tx_count)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to rollback (no transaction in effect)");
+        return 0;
+    }
+    // nested transactions are rolled back as a whole
+    pddby->database->database_tx_count = 0;
+    int result = sqlite3_exec(pddby_db_get(pddby), "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+    return pddby_db_expect(pddby, result, SQLITE_OK, __FUNCTION__, "unable to rollback transaction");
+}
+
+static pddby_db_stmt_t* pddby_db_prepare_with_flags(pddby_t* pddby, sqlite3* database, char const* sql,
+    unsigned int flags)
 {
     pddby_db_stmt_t* result = malloc(sizeof(pddby_db_stmt_t));
+    if (!result)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to prepare statement");
+        return NULL;
+    }
+
     result->pddby = pddby;
-    int error = sqlite3_prepare_v2(pddby_db_get(pddby), sql, -1, &result->statement, NULL);
-    if (!pddby_db_expect(pddby, error, SQLITE_OK, __FUNCTION__, "unable to prepare statement"))
+    int error = sqlite3_prepare_v3(database, sql, -1, flags, &result->statement, NULL);
+    if (error != SQLITE_OK)
     {
+        pddby_report(pddby, pddby_message_type_error, "%s: unable to prepare statement (%d: %s)", __FUNCTION__, error,
+            sqlite3_errmsg(database));
         free(result);
         return NULL;
     }
     return result;
 }
 
+// reading threads other than the one that opened complete cache get connections of their own
+static sqlite3* pddby_db_get_for_thread(pddby_t* pddby, struct pddby_db_stmt_cache** cache)
+{
+    sqlite3* database = pddby_db_get(pddby);
+    if (!database)
+    {
+        return NULL;
+    }
+
+    *cache = &pddby->database->stmt_cache;
+    if (pddby->database->read_only && !pthread_equal(pthread_self(), pddby->database->owner_thread))
+    {
+        struct pddby_db_reader* reader = pddby_db_get_reader(pddby);
+        if (!reader)
+        {
+            return NULL;
+        }
+        database = reader->database;
+        *cache = &reader->stmt_cache;
+    }
+
+    return database;
+}
+
+pddby_db_stmt_t* pddby_db_prepare(pddby_t* pddby, char const* sql)
+{
+    struct pddby_db_stmt_cache* cache;
+    sqlite3* database = pddby_db_get_for_thread(pddby, &cache);
+    if (!database)
+    {
+        return NULL;
+    }
+
+    return pddby_db_prepare_with_flags(pddby, database, sql, 0);
+}
+
+static struct pddby_db_cached_stmt* pddby_db_cached_slot(struct pddby_db_cached_stmt* stmts, size_t size,
+    char const* sql)
+{
+    size_t i = (size_t)(((uintptr_t)sql >> 3) * 2654435761u) & (size - 1);
+    while (stmts[i].sql && stmts[i].sql != sql)
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return &stmts[i];
+}
+
+static int pddby_db_cached_grow(struct pddby_db_stmt_cache* cache)
+{
+    size_t const new_size = cache->size ? cache->size * 2 : 64;
+    struct pddby_db_cached_stmt* new_stmts = calloc(new_size, sizeof(struct pddby_db_cached_stmt));
+    if (!new_stmts)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < cache->size; i++)
+    {
+        struct pddby_db_cached_stmt const* old_slot = &cache->stmts[i];
+        if (old_slot->sql)
+        {
+            *pddby_db_cached_slot(new_stmts, new_size, old_slot->sql) = *old_slot;
+        }
+    }
+
+    if (cache->stmts)
+    {
+        free(cache->stmts);
+    }
+    cache->stmts = new_stmts;
+    cache->size = new_size;
+    return 1;
+}
+
+pddby_db_stmt_t* pddby_db_prepare_cached(pddby_t* pddby, char const* sql)
+{
+    struct pddby_db_stmt_cache* cache;
+    sqlite3* database = pddby_db_get_for_thread(pddby, &cache);
+    if (!database)
+    {
+        return NULL;
+    }
+
+    if (cache->size)
+    {
+        struct pddby_db_cached_stmt const* slot = pddby_db_cached_slot(cache->stmts, cache->size, sql);
+        if (slot->sql)
+        {
+            return slot->stmt;
+        }
+    }
+
+    pddby_db_stmt_t* stmt = pddby_db_prepare_with_flags(pddby, database, sql, SQLITE_PREPARE_PERSISTENT);
+    if (!stmt)
+    {
+        return NULL;
+    }
+
+    if (cache->used * 2 >= cache->size && !pddby_db_cached_grow(cache))
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to cache prepared statement");
+        pddby_db_finalize(stmt);
+        return NULL;
+    }
+
+    struct pddby_db_cached_stmt* slot = pddby_db_cached_slot(cache->stmts, cache->size, sql);
+    slot->sql = sql;
+    slot->stmt = stmt;
+    cache->used++;
+    return stmt;
+}
+
+void pddby_db_finalize(pddby_db_stmt_t* stmt)
+{
+    sqlite3_finalize(stmt->statement);
+    free(stmt);
+}
+
+char* pddby_db_join_ids(int64_t const* ids, size_t count)
+{
+    // 20 digits at most for each id, plus separator
+    char* result = malloc(count * 21 + 1);
+    if (!result)
+    {
+        return NULL;
+    }
+
+    char* it = result;
+    *it = '\0';
+    for (size_t i = 0; i < count; i++)
+    {
+        it += sprintf(it, i ? ",%lld" : "%lld", (long long)ids[i]);
+    }
+
+    return result;
+}
+
 int pddby_db_reset(pddby_db_stmt_t* stmt)
 {
     int error = sqlite3_reset(stmt->statement);
-    return pddby_db_expect(stmt->pddby, error, SQLITE_OK, __FUNCTION__, "unable to reset prepared statement");
+    return pddby_db_stmt_expect(stmt, error, SQLITE_OK, __FUNCTION__, "unable to reset prepared statement");
 }
 
 int pddby_db_bind_null(pddby_db_stmt_t* stmt, int field)
 {
     int error = sqlite3_bind_null(stmt->statement, field);
-    return pddby_db_expect(stmt->pddby, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
+    return pddby_db_stmt_expect(stmt, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
 }
 
 int pddby_db_bind_int(pddby_db_stmt_t* stmt, int field, int value)
 {
     int error = sqlite3_bind_int(stmt->statement, field, value);
-    return pddby_db_expect(stmt->pddby, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
+    return pddby_db_stmt_expect(stmt, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
 }
 
 int pddby_db_bind_int64(pddby_db_stmt_t* stmt, int field, int64_t value)
 {
     int error = sqlite3_bind_int64(stmt->statement, field, value);
-    return pddby_db_expect(stmt->pddby, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
+    return pddby_db_stmt_expect(stmt, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
 }
 
 int pddby_db_bind_text(pddby_db_stmt_t* stmt, int field, char const* value)
 {
     int error = sqlite3_bind_text(stmt->statement, field, value, -1, NULL);
-    return pddby_db_expect(stmt->pddby, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
+    return pddby_db_stmt_expect(stmt, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
 }
 
 int pddby_db_bind_blob(pddby_db_stmt_t* stmt, int field, void const* value, size_t value_size)
 {
     int error = sqlite3_bind_blob(stmt->statement, field, value, value_size, NULL);
-    return pddby_db_expect(stmt->pddby, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
+    return pddby_db_stmt_expect(stmt, error, SQLITE_OK, __FUNCTION__, "unable to bind param");
 }
 
 int pddby_db_column_int(pddby_db_stmt_t* stmt, int column)
@@ -238,14 +1227,80 @@ size_t pddby_db_column_bytes(pddby_db_stmt_t* stmt, int column)
 int pddby_db_step(pddby_db_stmt_t* stmt)
 {
     int error = sqlite3_step(stmt->statement);
+
+    pddby_db_t* database = stmt->pddby->database;
+    // reader threads never touch the flag, it belongs to owner's connection
+    if (sqlite3_db_handle(stmt->statement) == database->database && !database->queried)
+    {
+        database->queried = 1;
+        pddby_report(stmt->pddby, pddby_message_type_debug, "first database query done %.1f ms after open",
+            (pddby_db_now() - database->open_time) / 1000000.0);
+    }
+
     if (error == SQLITE_DONE)
     {
         return 0;
     }
-    return pddby_db_expect(stmt->pddby, error, SQLITE_ROW, __FUNCTION__, "unable to perform statement") ? 1 : -1;
+    return pddby_db_stmt_expect(stmt, error, SQLITE_ROW, __FUNCTION__, "unable to perform statement") ? 1 : -1;
 }
 
 int64_t pddby_db_last_insert_id(pddby_t* pddby)
 {
     return sqlite3_last_insert_rowid(pddby_db_get(pddby));
 }
+
+pddby_db_blob_t* pddby_db_blob_open(pddby_t* pddby, char const* database_name, char const* table, char const* column,
+    int64_t row_id)
+{
+    struct pddby_db_stmt_cache* cache;
+    sqlite3* database = pddby_db_get_for_thread(pddby, &cache);
+    if (!database)
+    {
+        return NULL;
+    }
+
+    pddby_db_blob_t* blob = calloc(1, sizeof(pddby_db_blob_t));
+    if (!blob)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to open blob");
+        return NULL;
+    }
+
+    blob->pddby = pddby;
+
+    int result = sqlite3_blob_open(database, database_name, table, column, row_id, 0, &blob->blob);
+    if (result != SQLITE_OK)
+    {
+        pddby_report(pddby, pddby_message_type_error, "%s: unable to open blob (%d: %s)", __FUNCTION__, result,
+            sqlite3_errmsg(database));
+        sqlite3_blob_close(blob->blob);
+        free(blob);
+        return NULL;
+    }
+
+    return blob;
+}
+
+void pddby_db_blob_close(pddby_db_blob_t* blob)
+{
+    sqlite3_blob_close(blob->blob);
+    free(blob);
+}
+
+size_t pddby_db_blob_size(pddby_db_blob_t* blob)
+{
+    return sqlite3_blob_bytes(blob->blob);
+}
+
+int pddby_db_blob_read(pddby_db_blob_t* blob, void* buffer, size_t size, size_t offset)
+{
+    assert(size <= INT_MAX && offset <= INT_MAX);
+
+    int result = sqlite3_blob_read(blob->blob, buffer, size, offset);
+    if (result != SQLITE_OK)
+    {
+        pddby_report(blob->pddby, pddby_message_type_error, "%s: unable to read blob (%d)", __FUNCTION__, result);
+        return 0;
+    }
+    return 1;
+}
@@ -8,17 +8,56 @@
 
 typedef struct pddby_db pddby_db_t;
 typedef struct pddby_db_stmt pddby_db_stmt_t;
+typedef struct pddby_db_blob pddby_db_blob_t;
 
 int pddby_db_exists(pddby_t* pddby);
-void pddby_db_init(pddby_t* pddby, char const* share_dir, char const* cache_dir);
+void pddby_db_init(pddby_t* pddby, char const* cache_dir);
 void pddby_db_cleanup(pddby_t* pddby);
 void pddby_db_use_cache(pddby_t* pddby, int value);
+int pddby_db_uses_cache(pddby_t* pddby);
+// 1 if complete cache is opened writable, 0 if there is none to update (leftovers of interrupted decode are removed)
+int pddby_db_open_for_update(pddby_t* pddby);
+// closes database and removes cache file, so that it is created anew on next use
+void pddby_db_discard(pddby_t* pddby);
+// in-memory database saved encrypted with disc key on decode and loaded back instead of decoding again
+void pddby_db_use_sealed(pddby_t* pddby, int value);
+int pddby_db_is_sealed(pddby_t* pddby);
+// images shared between caches of different discs, only used along with cache file
+int pddby_db_set_image_store(pddby_t* pddby, char const* path);
+int pddby_db_has_image_store(pddby_t* pddby);
+// hints OS to start reading cache file in background
+void pddby_db_prefetch(pddby_t* pddby);
+
+// database is otherwise opened on first use; settings are loaded along with it
+int pddby_db_open(pddby_t* pddby);
+// complete cache is opened read-only and can't be decoded into
+int pddby_db_is_read_only(pddby_t* pddby);
+int pddby_db_set_complete(pddby_t* pddby);
+
+int pddby_db_sealed_exists(pddby_t* pddby);
+int pddby_db_save_sealed(pddby_t* pddby, uint8_t const* key);
+int pddby_db_load_sealed(pddby_t* pddby, uint8_t const* key);
+
+// in bytes, for in-memory database as well
+int64_t pddby_db_size(pddby_t* pddby);
 
 int pddby_db_tx_begin(pddby_t* pddby);
 int pddby_db_tx_commit(pddby_t* pddby);
 int pddby_db_tx_rollback(pddby_t* pddby);
 
 pddby_db_stmt_t* pddby_db_prepare(pddby_t* pddby, char const* sql);
+// prepared once per handle and finalized along with connection, sql is looked up by address so has to be a literal
+pddby_db_stmt_t* pddby_db_prepare_cached(pddby_t* pddby, char const* sql);
+void pddby_db_finalize(pddby_db_stmt_t* stmt);
+
+// ids are passed as one comma-separated list and split back into (position, id) rows of `ids` by recursive CTE, so
+// that whole set is matched in one query no matter how many ids there are
+#define PDDBY_DB_IDS_CTE \
+    "WITH RECURSIVE `ids`(`position`, `id`, `rest`) AS (SELECT -1, NULL, ?||',' UNION ALL SELECT `position`+1, " \
+    "CAST(substr(`rest`, 1, instr(`rest`, ',')-1) AS INTEGER), substr(`rest`, instr(`rest`, ',')+1) FROM `ids` " \
+    "WHERE `rest`<>'') "
+// list to bind to PDDBY_DB_IDS_CTE parameter, freed by caller
+char* pddby_db_join_ids(int64_t const* ids, size_t count);
 int pddby_db_reset(pddby_db_stmt_t* stmt);
 
 int pddby_db_bind_null(pddby_db_stmt_t* stmt, int field);
@@ -36,4 +75,12 @@ size_t pddby_db_column_bytes(pddby_db_stmt_t* stmt, int column);
 int pddby_db_step(pddby_db_stmt_t* stmt);
 int64_t pddby_db_last_insert_id(pddby_t* pddby);
 
+// incremental reads of a single value, without loading it as a whole; blob has to be closed before anything is
+// written to its row
+pddby_db_blob_t* pddby_db_blob_open(pddby_t* pddby, char const* database_name, char const* table, char const* column,
+    int64_t row_id);
+void pddby_db_blob_close(pddby_db_blob_t* blob);
+size_t pddby_db_blob_size(pddby_db_blob_t* blob);
+int pddby_db_blob_read(pddby_db_blob_t* blob, void* buffer, size_t size, size_t offset);
+
 #endif // PDDBY_PRIVATE_DATABASE_H
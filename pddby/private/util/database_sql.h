@@ -0,0 +1,19 @@
+#ifndef PDDBY_PRIVATE_DATABASE_SQL_H
+#define PDDBY_PRIVATE_DATABASE_SQL_H
+
+// definitions are generated at build time from data/*.sql by CMake/EmbedSql.cmake
+
+struct pddby_db_migration
+{
+    int version;
+    char const* sql;
+};
+
+typedef struct pddby_db_migration pddby_db_migration_t;
+
+// creates schema of the latest version in an empty database
+extern char const* const pddby_db_bootstrap_sql;
+// ordered by version, terminated by entry with NULL sql; each one upgrades schema from previous version
+extern pddby_db_migration_t const pddby_db_migrations[];
+
+#endif // PDDBY_PRIVATE_DATABASE_SQL_H
@@ -3,9 +3,7 @@
 
 #include <stdint.h>
 
-uint32_t pddby_delphi_random(uint32_t limit);
-
-void pddby_delphi_set_randseed(uint64_t seed);
-uint64_t pddby_delphi_get_randseed();
+// seed is kept by caller, so that generators of different threads don't interfere
+uint32_t pddby_delphi_random(uint64_t* seed, uint32_t limit);
 
 #endif // PDDBY_PRIVATE_DELPHI_H
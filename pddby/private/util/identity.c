@@ -0,0 +1,223 @@
+#include "identity.h"
+
+#include "private/pddby.h"
+#include "private/util/map.h"
+#include "private/util/pool.h"
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+// precedes every object in pool slot
+struct pddby_identity_header
+{
+    // next mapped object
+    struct pddby_identity_header* next;
+    pddby_identity_dispose_func_t dispose_func;
+    int kind;
+    int ref_count;
+};
+
+struct pddby_identity_map
+{
+    pddby_t* pddby;
+
+    // reading threads may share handle, so everything below is guarded
+    pthread_mutex_t mutex;
+    pddby_pool_t* pools[pddby_identity_kind_count];
+    // (kind, id) pairs to objects
+    pddby_map_t* ids;
+    struct pddby_identity_header* mapped;
+};
+
+static struct pddby_identity_header* pddby_identity_header(void* object)
+{
+    return (struct pddby_identity_header*)object - 1;
+}
+
+static void pddby_identity_release_locked(pddby_identity_map_t* map, struct pddby_identity_header* header)
+{
+    assert(header->ref_count > 0);
+
+    if (--header->ref_count > 0)
+    {
+        return;
+    }
+
+    if (header->dispose_func)
+    {
+        header->dispose_func(header + 1);
+    }
+    pddby_pool_dealloc(map->pools[header->kind], header);
+}
+
+static void pddby_identity_map_clear_locked(pddby_identity_map_t* map)
+{
+    while (map->mapped)
+    {
+        struct pddby_identity_header* header = map->mapped;
+        map->mapped = header->next;
+        pddby_identity_release_locked(map, header);
+    }
+
+    if (map->ids)
+    {
+        pddby_map_free(map->ids);
+        map->ids = NULL;
+    }
+}
+
+pddby_identity_map_t* pddby_identity_map_new(pddby_t* pddby)
+{
+    pddby_identity_map_t* map = calloc(1, sizeof(pddby_identity_map_t));
+    if (!map)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to create identity map");
+        return NULL;
+    }
+
+    map->pddby = pddby;
+    pthread_mutex_init(&map->mutex, NULL);
+
+    return map;
+}
+
+void pddby_identity_map_free(pddby_identity_map_t* map)
+{
+    assert(map);
+
+    pddby_identity_map_clear_locked(map);
+
+    // objects not released by now go away along with their pools
+    for (int i = 0; i < pddby_identity_kind_count; i++)
+    {
+        if (map->pools[i])
+        {
+            pddby_pool_free(map->pools[i]);
+        }
+    }
+
+    pthread_mutex_destroy(&map->mutex);
+    free(map);
+}
+
+void pddby_identity_map_clear(pddby_identity_map_t* map)
+{
+    assert(map);
+
+    pthread_mutex_lock(&map->mutex);
+    pddby_identity_map_clear_locked(map);
+    pthread_mutex_unlock(&map->mutex);
+}
+
+void* pddby_identity_new(pddby_t* pddby, int kind, size_t size, pddby_identity_dispose_func_t dispose_func)
+{
+    assert(kind >= 0 && kind < pddby_identity_kind_count);
+
+    pddby_identity_map_t* map = pddby->identity_map;
+    struct pddby_identity_header* header = NULL;
+
+    pthread_mutex_lock(&map->mutex);
+    if (!map->pools[kind])
+    {
+        map->pools[kind] = pddby_pool_new(pddby, sizeof(struct pddby_identity_header) + size);
+    }
+    if (map->pools[kind])
+    {
+        header = pddby_pool_alloc(map->pools[kind]);
+    }
+    pthread_mutex_unlock(&map->mutex);
+
+    if (!header)
+    {
+        return NULL;
+    }
+
+    header->dispose_func = dispose_func;
+    header->kind = kind;
+    header->ref_count = 1;
+
+    return header + 1;
+}
+
+void* pddby_identity_find(pddby_t* pddby, int kind, int64_t id)
+{
+    pddby_identity_map_t* map = pddby->identity_map;
+    int64_t const key[2] = {kind, id};
+    int64_t value;
+    void* object = NULL;
+
+    pthread_mutex_lock(&map->mutex);
+    if (map->ids && pddby_map_get(map->ids, key, sizeof(key), &value))
+    {
+        object = (void*)(intptr_t)value;
+        pddby_identity_header(object)->ref_count++;
+    }
+    pthread_mutex_unlock(&map->mutex);
+
+    return object;
+}
+
+void* pddby_identity_add(pddby_t* pddby, int kind, int64_t id, void* object)
+{
+    assert(object);
+
+    pddby_identity_map_t* map = pddby->identity_map;
+    struct pddby_identity_header* header = pddby_identity_header(object);
+    int64_t const key[2] = {kind, id};
+    int64_t value;
+
+    assert(header->kind == kind);
+
+    pthread_mutex_lock(&map->mutex);
+    if (!map->ids)
+    {
+        map->ids = pddby_map_new(pddby);
+    }
+
+    if (map->ids && pddby_map_get(map->ids, key, sizeof(key), &value))
+    {
+        pddby_identity_release_locked(map, header);
+        object = (void*)(intptr_t)value;
+        pddby_identity_header(object)->ref_count++;
+    }
+    else if (map->ids && pddby_map_set(map->ids, key, sizeof(key), (intptr_t)object))
+    {
+        header->ref_count++;
+        header->next = map->mapped;
+        map->mapped = header;
+    }
+    // object that failed to get mapped is still good for the caller
+    pthread_mutex_unlock(&map->mutex);
+
+    return object;
+}
+
+void* pddby_identity_retain(pddby_t* pddby, void* object)
+{
+    assert(object);
+
+    pddby_identity_map_t* map = pddby->identity_map;
+
+    pthread_mutex_lock(&map->mutex);
+    pddby_identity_header(object)->ref_count++;
+    pthread_mutex_unlock(&map->mutex);
+
+    return object;
+}
+
+void pddby_identity_release(pddby_t* pddby, void* object)
+{
+    assert(object);
+
+    pddby_identity_map_t* map = pddby->identity_map;
+
+    pthread_mutex_lock(&map->mutex);
+    pddby_identity_release_locked(map, pddby_identity_header(object));
+    pthread_mutex_unlock(&map->mutex);
+}
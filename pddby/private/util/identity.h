@@ -0,0 +1,43 @@
+#ifndef PDDBY_PRIVATE_IDENTITY_H
+#define PDDBY_PRIVATE_IDENTITY_H
+
+#include "pddby.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// model objects found by id are shared within handle: one object per row, reference-counted and never modified
+// once mapped; map itself holds a reference, so objects live until map is cleared even if nobody else uses them
+
+enum pddby_identity_kind
+{
+    pddby_identity_comment,
+    pddby_identity_section,
+    pddby_identity_topic,
+    pddby_identity_traffreg,
+    pddby_identity_kind_count
+};
+
+// frees whatever object owns, but not object itself
+typedef void (*pddby_identity_dispose_func_t)(void* object);
+
+struct pddby_identity_map;
+typedef struct pddby_identity_map pddby_identity_map_t;
+
+pddby_identity_map_t* pddby_identity_map_new(pddby_t* pddby);
+void pddby_identity_map_free(pddby_identity_map_t* map);
+// forgets all objects, so that they are looked up anew; ones still referenced stay alive until released
+void pddby_identity_map_clear(pddby_identity_map_t* map);
+
+// zero-filled unmapped object with single reference; object size has to be the same for all objects of a kind
+void* pddby_identity_new(pddby_t* pddby, int kind, size_t size, pddby_identity_dispose_func_t dispose_func);
+// mapped object with reference added, NULL if there is none
+void* pddby_identity_find(pddby_t* pddby, int kind, int64_t id);
+// maps new object under id and returns it; if the same id got mapped meanwhile, that object is returned instead
+// and given one is released
+void* pddby_identity_add(pddby_t* pddby, int kind, int64_t id, void* object);
+
+void* pddby_identity_retain(pddby_t* pddby, void* object);
+void pddby_identity_release(pddby_t* pddby, void* object);
+
+#endif // PDDBY_PRIVATE_IDENTITY_H
@@ -0,0 +1,127 @@
+#include "image_store.h"
+
+#include "database.h"
+#include "report.h"
+
+#include <assert.h>
+#include <openssl/evp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+int pddby_image_store_is_available(pddby_t* pddby)
+{
+    return pddby_db_has_image_store(pddby);
+}
+
+char* pddby_image_store_hash(pddby_t* pddby, void const* salt, size_t salt_size, void const* data, size_t data_size)
+{
+    assert(salt || !salt_size);
+    assert(data || !data_size);
+
+    uint8_t digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size = 0;
+
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    int const hashed = ctx &&
+        EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+        EVP_DigestUpdate(ctx, salt, salt_size) &&
+        EVP_DigestUpdate(ctx, data, data_size) &&
+        EVP_DigestFinal_ex(ctx, digest, &digest_size);
+    if (ctx)
+    {
+        EVP_MD_CTX_free(ctx);
+    }
+    if (!hashed)
+    {
+        goto error;
+    }
+
+    char* result = malloc(digest_size * 2 + 1);
+    if (!result)
+    {
+        goto error;
+    }
+
+    for (unsigned int i = 0; i < digest_size; i++)
+    {
+        sprintf(result + i * 2, "%02x", digest[i]);
+    }
+
+    return result;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to hash image data");
+    return NULL;
+}
+
+char* pddby_image_store_find_source(pddby_t* pddby, char const* source_hash)
+{
+    assert(source_hash);
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT s.`hash` FROM `store`.`sources` s INNER JOIN "
+        "`store`.`blobs` b ON b.`hash`=s.`hash` WHERE s.`source_hash`=? LIMIT 1");
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
+    if (!pddby_db_reset(db_stmt) ||
+        !pddby_db_bind_text(db_stmt, 1, source_hash))
+    {
+        goto error;
+    }
+
+    switch (pddby_db_step(db_stmt))
+    {
+    case -1:
+        goto error;
+    case 0:
+        return NULL;
+    }
+
+    char* result = strdup(pddby_db_column_text(db_stmt, 0));
+    if (!result)
+    {
+        goto error;
+    }
+
+    return result;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to look up image source");
+    return NULL;
+}
+
+int pddby_image_store_contains(pddby_t* pddby, char const* hash)
+{
+    assert(hash);
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT 1 FROM `store`.`blobs` WHERE `hash`=? LIMIT 1");
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
+    if (!pddby_db_reset(db_stmt) ||
+        !pddby_db_bind_text(db_stmt, 1, hash))
+    {
+        goto error;
+    }
+
+    int const result = pddby_db_step(db_stmt);
+    if (result == -1)
+    {
+        goto error;
+    }
+
+    return result;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to look up stored image");
+    return -1;
+}
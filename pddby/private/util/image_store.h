@@ -0,0 +1,22 @@
+#ifndef PDDBY_PRIVATE_IMAGE_STORE_H
+#define PDDBY_PRIVATE_IMAGE_STORE_H
+
+#include "pddby.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// image payloads are stored once for all discs, keyed by hash of decrypted payload; encrypted files already seen are
+// mapped to that hash as well, so that decoding another disc doesn't have to decrypt them again
+
+int pddby_image_store_is_available(pddby_t* pddby);
+
+// hex-encoded SHA-256, salt may be NULL
+char* pddby_image_store_hash(pddby_t* pddby, void const* salt, size_t salt_size, void const* data, size_t data_size);
+
+// NULL with no error reported if source is not known or its payload is not stored
+char* pddby_image_store_find_source(pddby_t* pddby, char const* source_hash);
+// 1 if stored, 0 if not, -1 on error
+int pddby_image_store_contains(pddby_t* pddby, char const* hash);
+
+#endif // PDDBY_PRIVATE_IMAGE_STORE_H
@@ -0,0 +1,160 @@
+#include "log.h"
+
+#include "private/pddby.h"
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define PDDBY_LOG_TEXT_SIZE 500
+
+// bounded queue after D. Vyukov: each slot carries a sequence number telling whose turn it is, so producers
+// only contend on a single compare-and-swap and never block each other or the consumer
+
+struct pddby_log_slot
+{
+    size_t sequence;
+    int type;
+    char text[PDDBY_LOG_TEXT_SIZE];
+};
+
+struct pddby_log
+{
+    pddby_t* pddby;
+
+    struct pddby_log_slot* slots;
+    size_t mask;
+
+    size_t enqueue_pos;
+    size_t dequeue_pos;
+    size_t dropped_count;
+};
+
+pddby_log_t* pddby_log_new(pddby_t* pddby, size_t size)
+{
+    assert(pddby);
+
+    size_t real_size = 2;
+    while (real_size < size)
+    {
+        real_size *= 2;
+    }
+
+    pddby_log_t* log = calloc(1, sizeof(pddby_log_t));
+    if (!log)
+    {
+        goto error;
+    }
+
+    log->slots = malloc(real_size * sizeof(struct pddby_log_slot));
+    if (!log->slots)
+    {
+        free(log);
+        goto error;
+    }
+
+    for (size_t i = 0; i < real_size; i++)
+    {
+        log->slots[i].sequence = i;
+    }
+
+    log->pddby = pddby;
+    log->mask = real_size - 1;
+
+    return log;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create log buffer");
+    return NULL;
+}
+
+void pddby_log_free(pddby_log_t* log)
+{
+    assert(log);
+
+    free(log->slots);
+    free(log);
+}
+
+int pddby_log_push(pddby_log_t* log, int type, char const* text, va_list args)
+{
+    assert(log);
+
+    struct pddby_log_slot* slot;
+    size_t pos = __atomic_load_n(&log->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        slot = &log->slots[pos & log->mask];
+        size_t const sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        intptr_t const diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&log->enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+                __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            __atomic_fetch_add(&log->dropped_count, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        else
+        {
+            pos = __atomic_load_n(&log->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->type = type;
+    vsnprintf(slot->text, sizeof(slot->text), text, args);
+
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+size_t pddby_log_drain(pddby_log_t* log, size_t max_count)
+{
+    assert(log);
+
+    pddby_t* pddby = log->pddby;
+    void (*message)(pddby_t* pddby, int type, char const* text) = pddby->callbacks ? pddby->callbacks->message :
+        NULL;
+
+    size_t count = 0;
+    while (!max_count || count < max_count)
+    {
+        struct pddby_log_slot* slot = &log->slots[log->dequeue_pos & log->mask];
+        size_t const sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence != log->dequeue_pos + 1)
+        {
+            break;
+        }
+
+        if (message)
+        {
+            message(pddby, slot->type, slot->text);
+        }
+
+        __atomic_store_n(&slot->sequence, log->dequeue_pos + log->mask + 1, __ATOMIC_RELEASE);
+        log->dequeue_pos++;
+        count++;
+    }
+
+    size_t const dropped_count = __atomic_exchange_n(&log->dropped_count, 0, __ATOMIC_RELAXED);
+    if (dropped_count && message)
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "%lu log messages dropped", (unsigned long)dropped_count);
+        message(pddby, pddby_message_type_warning, text);
+    }
+
+    return count;
+}
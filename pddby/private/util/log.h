@@ -0,0 +1,20 @@
+#ifndef PDDBY_PRIVATE_LOG_H
+#define PDDBY_PRIVATE_LOG_H
+
+#include "pddby.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+
+struct pddby_log;
+typedef struct pddby_log pddby_log_t;
+
+pddby_log_t* pddby_log_new(pddby_t* pddby, size_t size);
+void pddby_log_free(pddby_log_t* log);
+
+// safe to call from any number of threads; message is dropped (and counted) if buffer is full
+int pddby_log_push(pddby_log_t* log, int type, char const* text, va_list args);
+// single consumer only; delivers messages through message callback, max_count of 0 means everything available
+size_t pddby_log_drain(pddby_log_t* log, size_t max_count);
+
+#endif // PDDBY_PRIVATE_LOG_H
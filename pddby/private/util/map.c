@@ -0,0 +1,195 @@
+#include "map.h"
+
+#include "report.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+struct pddby_map_entry
+{
+    uint64_t hash;
+    void* key;
+    size_t key_size;
+    int64_t value;
+};
+
+struct pddby_map
+{
+    pddby_t* pddby;
+
+    size_t used_size;
+    size_t reserved_size;
+    struct pddby_map_entry* entries;
+};
+
+static uint64_t pddby_map_hash(void const* key, size_t key_size)
+{
+    // FNV-1a
+    uint8_t const* p = key;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < key_size; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static struct pddby_map_entry* pddby_map_lookup(struct pddby_map_entry* entries, size_t reserved_size, uint64_t hash,
+    void const* key, size_t key_size)
+{
+    size_t index = hash & (reserved_size - 1);
+    for (;;)
+    {
+        struct pddby_map_entry* entry = &entries[index];
+        if (!entry->key)
+        {
+            return entry;
+        }
+        if (entry->hash == hash && entry->key_size == key_size && !memcmp(entry->key, key, key_size))
+        {
+            return entry;
+        }
+        index = (index + 1) & (reserved_size - 1);
+    }
+}
+
+static int pddby_map_realloc(pddby_map_t* map, size_t new_size)
+{
+    struct pddby_map_entry* entries = calloc(new_size, sizeof(struct pddby_map_entry));
+    if (!entries)
+    {
+        pddby_report(map->pddby, pddby_message_type_error, "unable to reallocate map data");
+        return 0;
+    }
+
+    for (size_t i = 0; i < map->reserved_size; i++)
+    {
+        struct pddby_map_entry* entry = &map->entries[i];
+        if (entry->key)
+        {
+            *pddby_map_lookup(entries, new_size, entry->hash, entry->key, entry->key_size) = *entry;
+        }
+    }
+
+    free(map->entries);
+    map->entries = entries;
+    map->reserved_size = new_size;
+    return 1;
+}
+
+pddby_map_t* pddby_map_new(pddby_t* pddby)
+{
+    pddby_map_t* result = calloc(1, sizeof(pddby_map_t));
+    if (!result)
+    {
+        goto error;
+    }
+
+    result->pddby = pddby;
+
+    if (!pddby_map_realloc(result, 64))
+    {
+        goto error;
+    }
+
+    return result;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create map");
+
+    if (result)
+    {
+        pddby_map_free(result);
+    }
+
+    return NULL;
+}
+
+void pddby_map_free(pddby_map_t* map)
+{
+    assert(map);
+
+    if (map->entries)
+    {
+        for (size_t i = 0; i < map->reserved_size; i++)
+        {
+            if (map->entries[i].key)
+            {
+                free(map->entries[i].key);
+            }
+        }
+        free(map->entries);
+    }
+    free(map);
+}
+
+int pddby_map_set(pddby_map_t* map, void const* key, size_t key_size, int64_t value)
+{
+    assert(map);
+    assert(key);
+
+    // keep load factor below 3/4
+    if ((map->used_size + 1) * 4 > map->reserved_size * 3)
+    {
+        if (!pddby_map_realloc(map, map->reserved_size * 2))
+        {
+            goto error;
+        }
+    }
+
+    uint64_t const hash = pddby_map_hash(key, key_size);
+    struct pddby_map_entry* entry = pddby_map_lookup(map->entries, map->reserved_size, hash, key, key_size);
+    if (!entry->key)
+    {
+        // zero-sized keys still need a non-null marker
+        entry->key = malloc(key_size ? key_size : 1);
+        if (!entry->key)
+        {
+            goto error;
+        }
+
+        memcpy(entry->key, key, key_size);
+        entry->key_size = key_size;
+        entry->hash = hash;
+        map->used_size++;
+    }
+
+    entry->value = value;
+    return 1;
+
+error:
+    pddby_report(map->pddby, pddby_message_type_error, "unable to add map entry");
+    return 0;
+}
+
+int pddby_map_get(pddby_map_t const* map, void const* key, size_t key_size, int64_t* value)
+{
+    assert(map);
+    assert(key);
+
+    struct pddby_map_entry const* entry = pddby_map_lookup(map->entries, map->reserved_size,
+        pddby_map_hash(key, key_size), key, key_size);
+    if (!entry->key)
+    {
+        return 0;
+    }
+
+    if (value)
+    {
+        *value = entry->value;
+    }
+    return 1;
+}
+
+size_t pddby_map_size(pddby_map_t const* map)
+{
+    assert(map);
+
+    return map->used_size;
+}
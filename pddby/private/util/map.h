@@ -0,0 +1,19 @@
+#ifndef PDDBY_PRIVATE_MAP_H
+#define PDDBY_PRIVATE_MAP_H
+
+#include "pddby.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct pddby_map;
+typedef struct pddby_map pddby_map_t;
+
+pddby_map_t* pddby_map_new(pddby_t* pddby);
+void pddby_map_free(pddby_map_t* map);
+
+int pddby_map_set(pddby_map_t* map, void const* key, size_t key_size, int64_t value);
+int pddby_map_get(pddby_map_t const* map, void const* key, size_t key_size, int64_t* value);
+size_t pddby_map_size(pddby_map_t const* map);
+
+#endif // PDDBY_PRIVATE_MAP_H
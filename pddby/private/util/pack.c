@@ -0,0 +1,339 @@
+#include "pack.h"
+
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+struct pddby_pack
+{
+    pddby_t* pddby;
+
+    void* data;
+    size_t data_size;
+
+    struct pddby_pack_header const* header;
+};
+
+struct pddby_pack_link_info
+{
+    int owner_table;
+    int index_table;
+    int ids_table;
+};
+
+static size_t const s_record_sizes[pddby_pack_table_count] =
+{
+    1,
+    sizeof(struct pddby_pack_setting),
+    sizeof(struct pddby_pack_image),
+    sizeof(uint32_t),
+    sizeof(struct pddby_pack_comment),
+    sizeof(uint32_t),
+    sizeof(struct pddby_pack_traffreg),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(struct pddby_pack_section),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(struct pddby_pack_topic),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(struct pddby_pack_question),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(struct pddby_pack_answer),
+    1
+};
+
+static struct pddby_pack_link_info const s_links[pddby_pack_link_count] =
+{
+    {pddby_pack_traffregs, pddby_pack_traffreg_image_index, pddby_pack_traffreg_image_ids},
+    {pddby_pack_sections, pddby_pack_section_question_index, pddby_pack_section_question_ids},
+    {pddby_pack_topics, pddby_pack_topic_question_index, pddby_pack_topic_question_ids},
+    {pddby_pack_questions, pddby_pack_question_traffreg_index, pddby_pack_question_traffreg_ids},
+    {pddby_pack_questions, pddby_pack_question_answer_index, pddby_pack_question_answer_ids}
+};
+
+static void const* pddby_pack_table(pddby_pack_t const* pack, int table)
+{
+    return (char const*)pack->data + pack->header->tables[table].offset;
+}
+
+static int pddby_pack_validate(pddby_pack_t* pack)
+{
+    if (pack->data_size < sizeof(struct pddby_pack_header))
+    {
+        return 0;
+    }
+
+    struct pddby_pack_header const* header = pack->data;
+    if (memcmp(header->magic, PDDBY_PACK_MAGIC, sizeof(PDDBY_PACK_MAGIC)) != 0 ||
+        header->version != PDDBY_PACK_VERSION ||
+        header->byte_order != PDDBY_PACK_BYTE_ORDER ||
+        header->file_size != pack->data_size)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < pddby_pack_table_count; i++)
+    {
+        struct pddby_pack_table_ref const* ref = &header->tables[i];
+        if (ref->offset % PDDBY_PACK_ALIGNMENT != 0 ||
+            ref->offset > pack->data_size ||
+            ref->size > pack->data_size - ref->offset ||
+            ref->size % s_record_sizes[i] != 0)
+        {
+            return 0;
+        }
+    }
+
+    pack->header = header;
+
+    // string lookups rely on pool starting with NULL placeholder and ending with terminator
+    struct pddby_pack_table_ref const* strings = &header->tables[pddby_pack_strings];
+    if (strings->size == 0 || ((char const*)pddby_pack_table(pack, pddby_pack_strings))[strings->size - 1] != '\0')
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < pddby_pack_link_count; i++)
+    {
+        if (pddby_pack_count(pack, s_links[i].index_table) != pddby_pack_count(pack, s_links[i].owner_table) + 1)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+pddby_pack_t* pddby_pack_open(pddby_t* pddby, char const* path)
+{
+    assert(path);
+
+    pddby_pack_t* pack = calloc(1, sizeof(pddby_pack_t));
+    if (!pack)
+    {
+        goto error;
+    }
+
+    pack->pddby = pddby;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        goto error;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size <= 0)
+    {
+        close(fd);
+        goto error;
+    }
+
+    pack->data_size = st.st_size;
+    pack->data = mmap(NULL, pack->data_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pack->data == MAP_FAILED)
+    {
+        pack->data = NULL;
+        goto error;
+    }
+
+    if (!pddby_pack_validate(pack))
+    {
+        pddby_report(pddby, pddby_message_type_error, "\"%s\" is not a valid pack file", path);
+        goto error;
+    }
+
+    return pack;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to open pack file \"%s\"", path);
+    if (pack)
+    {
+        pddby_pack_close(pack);
+    }
+    return NULL;
+}
+
+void pddby_pack_close(pddby_pack_t* pack)
+{
+    assert(pack);
+
+    if (pack->data)
+    {
+        munmap(pack->data, pack->data_size);
+    }
+    free(pack);
+}
+
+size_t pddby_pack_record_size(int table)
+{
+    assert(table >= 0 && table < pddby_pack_table_count);
+
+    return s_record_sizes[table];
+}
+
+size_t pddby_pack_count(pddby_pack_t const* pack, int table)
+{
+    assert(pack);
+    assert(table >= 0 && table < pddby_pack_table_count);
+
+    return pack->header->tables[table].size / s_record_sizes[table];
+}
+
+void const* pddby_pack_record(pddby_pack_t const* pack, int table, int64_t id)
+{
+    assert(pack);
+
+    if (id < 1 || (uint64_t)id > pddby_pack_count(pack, table))
+    {
+        return NULL;
+    }
+
+    return (char const*)pddby_pack_table(pack, table) + (id - 1) * s_record_sizes[table];
+}
+
+char const* pddby_pack_string(pddby_pack_t const* pack, uint32_t offset)
+{
+    assert(pack);
+
+    if (!offset || offset >= pack->header->tables[pddby_pack_strings].size)
+    {
+        return NULL;
+    }
+
+    return (char const*)pddby_pack_table(pack, pddby_pack_strings) + offset;
+}
+
+void const* pddby_pack_blob(pddby_pack_t const* pack, uint64_t offset, uint64_t size)
+{
+    assert(pack);
+
+    uint64_t const blobs_size = pack->header->tables[pddby_pack_blobs].size;
+    if (offset > blobs_size || size > blobs_size - offset)
+    {
+        return NULL;
+    }
+
+    return (char const*)pddby_pack_table(pack, pddby_pack_blobs) + offset;
+}
+
+uint32_t const* pddby_pack_links(pddby_pack_t const* pack, int link, int64_t owner_id, size_t* count)
+{
+    assert(pack);
+    assert(link >= 0 && link < pddby_pack_link_count);
+    assert(count);
+
+    struct pddby_pack_link_info const* info = &s_links[link];
+
+    *count = 0;
+
+    if (owner_id < 1 || (uint64_t)owner_id > pddby_pack_count(pack, info->owner_table))
+    {
+        return NULL;
+    }
+
+    uint32_t const* index = pddby_pack_table(pack, info->index_table);
+    uint32_t const begin = index[owner_id - 1];
+    uint32_t const end = index[owner_id];
+    if (begin > end || end > pddby_pack_count(pack, info->ids_table))
+    {
+        return NULL;
+    }
+
+    *count = end - begin;
+    return (uint32_t const*)pddby_pack_table(pack, info->ids_table) + begin;
+}
+
+int64_t pddby_pack_find_by_number(pddby_pack_t const* pack, int table, int32_t number)
+{
+    assert(pack);
+    assert(table == pddby_pack_comments || table == pddby_pack_traffregs);
+
+    int const sorted_table = table == pddby_pack_comments ? pddby_pack_comment_numbers : pddby_pack_traffreg_numbers;
+    uint32_t const* ids = pddby_pack_table(pack, sorted_table);
+
+    size_t begin = 0;
+    size_t end = pddby_pack_count(pack, sorted_table);
+    while (begin < end)
+    {
+        size_t const middle = begin + (end - begin) / 2;
+        int32_t const* middle_number = pddby_pack_record(pack, table, ids[middle]);
+        if (!middle_number)
+        {
+            return 0;
+        }
+
+        if (*middle_number < number)
+        {
+            begin = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    if (begin == pddby_pack_count(pack, sorted_table))
+    {
+        return 0;
+    }
+
+    int32_t const* found_number = pddby_pack_record(pack, table, ids[begin]);
+    return found_number && *found_number == number ? ids[begin] : 0;
+}
+
+int64_t pddby_pack_find_image_by_name(pddby_pack_t const* pack, char const* name)
+{
+    assert(pack);
+    assert(name);
+
+    uint32_t const* ids = pddby_pack_table(pack, pddby_pack_image_names);
+
+    size_t begin = 0;
+    size_t end = pddby_pack_count(pack, pddby_pack_image_names);
+    while (begin < end)
+    {
+        size_t const middle = begin + (end - begin) / 2;
+        struct pddby_pack_image const* image = pddby_pack_record(pack, pddby_pack_images, ids[middle]);
+        char const* middle_name = image ? pddby_pack_string(pack, image->name) : NULL;
+        if (!middle_name)
+        {
+            return 0;
+        }
+
+        if (strcmp(middle_name, name) < 0)
+        {
+            begin = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    if (begin == pddby_pack_count(pack, pddby_pack_image_names))
+    {
+        return 0;
+    }
+
+    struct pddby_pack_image const* image = pddby_pack_record(pack, pddby_pack_images, ids[begin]);
+    char const* found_name = image ? pddby_pack_string(pack, image->name) : NULL;
+    return found_name && strcmp(found_name, name) == 0 ? ids[begin] : 0;
+}
@@ -0,0 +1,147 @@
+#ifndef PDDBY_PRIVATE_PACK_H
+#define PDDBY_PRIVATE_PACK_H
+
+#include "pddby.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pack file is a read-only snapshot of decoded data meant to be used straight from memory map. All records are
+// fixed-width, strings are offsets into string pool (0 meaning NULL), ids are 1-based record indices, and
+// one-to-many links are stored CSR-style: per-owner start indices (owner count + 1 of them) into flat id array.
+
+#define PDDBY_PACK_MAGIC "PDDBYPK"
+#define PDDBY_PACK_VERSION 1
+#define PDDBY_PACK_BYTE_ORDER 0x01020304
+#define PDDBY_PACK_ALIGNMENT 16
+
+enum pddby_pack_table
+{
+    pddby_pack_strings,
+    pddby_pack_settings,
+    pddby_pack_images,
+    pddby_pack_image_names,
+    pddby_pack_comments,
+    pddby_pack_comment_numbers,
+    pddby_pack_traffregs,
+    pddby_pack_traffreg_numbers,
+    pddby_pack_traffreg_image_index,
+    pddby_pack_traffreg_image_ids,
+    pddby_pack_sections,
+    pddby_pack_section_question_index,
+    pddby_pack_section_question_ids,
+    pddby_pack_topics,
+    pddby_pack_topic_question_index,
+    pddby_pack_topic_question_ids,
+    pddby_pack_questions,
+    pddby_pack_question_traffreg_index,
+    pddby_pack_question_traffreg_ids,
+    pddby_pack_question_answer_index,
+    pddby_pack_question_answer_ids,
+    pddby_pack_answers,
+    pddby_pack_blobs,
+    pddby_pack_table_count
+};
+
+enum pddby_pack_link
+{
+    pddby_pack_link_traffreg_images,
+    pddby_pack_link_section_questions,
+    pddby_pack_link_topic_questions,
+    pddby_pack_link_question_traffregs,
+    pddby_pack_link_question_answers,
+    pddby_pack_link_count
+};
+
+struct pddby_pack_table_ref
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct pddby_pack_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    struct pddby_pack_table_ref tables[pddby_pack_table_count];
+};
+
+struct pddby_pack_setting
+{
+    uint32_t key;
+    uint32_t value;
+};
+
+struct pddby_pack_image
+{
+    uint32_t name;
+    uint32_t reserved;
+    // relative to blob area
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+// records looked up by number start with it
+struct pddby_pack_comment
+{
+    int32_t number;
+    uint32_t text;
+};
+
+struct pddby_pack_traffreg
+{
+    int32_t number;
+    uint32_t text;
+};
+
+struct pddby_pack_section
+{
+    uint32_t name;
+    uint32_t title_prefix;
+    uint32_t title;
+};
+
+struct pddby_pack_topic
+{
+    int32_t number;
+    uint32_t title;
+};
+
+struct pddby_pack_question
+{
+    uint32_t topic_id;
+    uint32_t text;
+    uint32_t image_id;
+    uint32_t advice;
+    uint32_t comment_id;
+};
+
+struct pddby_pack_answer
+{
+    uint32_t question_id;
+    uint32_t text;
+    uint32_t is_correct;
+};
+
+struct pddby_pack;
+typedef struct pddby_pack pddby_pack_t;
+
+pddby_pack_t* pddby_pack_open(pddby_t* pddby, char const* path);
+void pddby_pack_close(pddby_pack_t* pack);
+
+size_t pddby_pack_record_size(int table);
+size_t pddby_pack_count(pddby_pack_t const* pack, int table);
+// NULL if there's no record with such id
+void const* pddby_pack_record(pddby_pack_t const* pack, int table, int64_t id);
+char const* pddby_pack_string(pddby_pack_t const* pack, uint32_t offset);
+void const* pddby_pack_blob(pddby_pack_t const* pack, uint64_t offset, uint64_t size);
+
+uint32_t const* pddby_pack_links(pddby_pack_t const* pack, int link, int64_t owner_id, size_t* count);
+
+// binary search over sorted indices, 0 if not found
+int64_t pddby_pack_find_by_number(pddby_pack_t const* pack, int table, int32_t number);
+int64_t pddby_pack_find_image_by_name(pddby_pack_t const* pack, char const* name);
+
+#endif // PDDBY_PRIVATE_PACK_H
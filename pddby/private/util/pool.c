@@ -0,0 +1,105 @@
+#include "pool.h"
+
+#include "report.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define PDDBY_POOL_CHUNK_ITEMS 64
+
+struct pddby_pool_chunk
+{
+    struct pddby_pool_chunk* next;
+};
+
+struct pddby_pool
+{
+    pddby_t* pddby;
+    size_t item_size;
+
+    struct pddby_pool_chunk* chunks;
+    // free items are linked through their first bytes
+    void* free_items;
+};
+
+// keeps items following chunk header aligned for anything they may hold
+static size_t pddby_pool_align(size_t size)
+{
+    size_t const alignment = sizeof(long double) > sizeof(void*) ? sizeof(long double) : sizeof(void*);
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+pddby_pool_t* pddby_pool_new(pddby_t* pddby, size_t item_size)
+{
+    pddby_pool_t* pool = calloc(1, sizeof(pddby_pool_t));
+    if (!pool)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to create pool");
+        return NULL;
+    }
+
+    pool->pddby = pddby;
+    pool->item_size = pddby_pool_align(item_size > sizeof(void*) ? item_size : sizeof(void*));
+
+    return pool;
+}
+
+void pddby_pool_free(pddby_pool_t* pool)
+{
+    assert(pool);
+
+    while (pool->chunks)
+    {
+        struct pddby_pool_chunk* chunk = pool->chunks;
+        pool->chunks = chunk->next;
+        free(chunk);
+    }
+    free(pool);
+}
+
+void* pddby_pool_alloc(pddby_pool_t* pool)
+{
+    assert(pool);
+
+    if (!pool->free_items)
+    {
+        size_t const header_size = pddby_pool_align(sizeof(struct pddby_pool_chunk));
+        struct pddby_pool_chunk* chunk = malloc(header_size + PDDBY_POOL_CHUNK_ITEMS * pool->item_size);
+        if (!chunk)
+        {
+            pddby_report(pool->pddby, pddby_message_type_error, "unable to allocate pool chunk");
+            return NULL;
+        }
+
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+
+        char* items = (char*)chunk + header_size;
+        for (size_t i = PDDBY_POOL_CHUNK_ITEMS; i > 0; i--)
+        {
+            void* item = items + (i - 1) * pool->item_size;
+            *(void**)item = pool->free_items;
+            pool->free_items = item;
+        }
+    }
+
+    void* item = pool->free_items;
+    pool->free_items = *(void**)item;
+
+    memset(item, 0, pool->item_size);
+    return item;
+}
+
+void pddby_pool_dealloc(pddby_pool_t* pool, void* item)
+{
+    assert(pool);
+    assert(item);
+
+    *(void**)item = pool->free_items;
+    pool->free_items = item;
+}
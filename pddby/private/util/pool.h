@@ -0,0 +1,20 @@
+#ifndef PDDBY_PRIVATE_POOL_H
+#define PDDBY_PRIVATE_POOL_H
+
+#include "pddby.h"
+
+#include <stddef.h>
+
+struct pddby_pool;
+typedef struct pddby_pool pddby_pool_t;
+
+// fixed-size items carved out of larger chunks, which are only returned to the system when pool is freed; not
+// thread-safe
+pddby_pool_t* pddby_pool_new(pddby_t* pddby, size_t item_size);
+void pddby_pool_free(pddby_pool_t* pool);
+
+// zero-filled
+void* pddby_pool_alloc(pddby_pool_t* pool);
+void pddby_pool_dealloc(pddby_pool_t* pool, void* item);
+
+#endif // PDDBY_PRIVATE_POOL_H
@@ -0,0 +1,55 @@
+#include "random.h"
+
+#include <assert.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define PDDBY_RANDOM_MULTIPLIER 6364136223846793005ULL
+
+void pddby_random_init(pddby_random_t* random, uint64_t seed)
+{
+    assert(random);
+
+    // stream is derived from seed too, so that close seeds don't give shifted copies of one sequence
+    random->state = 0;
+    random->increment = (seed * PDDBY_RANDOM_MULTIPLIER) << 1 | 1;
+    pddby_random_next(random);
+    random->state += seed;
+    pddby_random_next(random);
+}
+
+uint32_t pddby_random_next(pddby_random_t* random)
+{
+    assert(random);
+
+    uint64_t const state = random->state;
+    random->state = state * PDDBY_RANDOM_MULTIPLIER + random->increment;
+
+    uint32_t const xorshifted = ((state >> 18) ^ state) >> 27;
+    uint32_t const rotation = state >> 59;
+    return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+}
+
+uint64_t pddby_random_next64(pddby_random_t* random)
+{
+    uint64_t const high = pddby_random_next(random);
+    return high << 32 | pddby_random_next(random);
+}
+
+uint32_t pddby_random_below(pddby_random_t* random, uint32_t bound)
+{
+    assert(bound);
+
+    // values below threshold would make lower results slightly more likely than higher ones, so they are redrawn
+    uint32_t const threshold = -bound % bound;
+    for (;;)
+    {
+        uint32_t const value = pddby_random_next(random);
+        if (value >= threshold)
+        {
+            return value % bound;
+        }
+    }
+}
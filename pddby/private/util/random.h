@@ -0,0 +1,22 @@
+#ifndef PDDBY_PRIVATE_RANDOM_H
+#define PDDBY_PRIVATE_RANDOM_H
+
+#include <stdint.h>
+
+// PCG32 generator, state is kept by caller so that same seed always yields same sequence regardless of who else
+// draws numbers at the same time
+struct pddby_random
+{
+    uint64_t state;
+    uint64_t increment;
+};
+
+typedef struct pddby_random pddby_random_t;
+
+void pddby_random_init(pddby_random_t* random, uint64_t seed);
+uint32_t pddby_random_next(pddby_random_t* random);
+uint64_t pddby_random_next64(pddby_random_t* random);
+// uniformly distributed in [0, bound), bound must not be zero
+uint32_t pddby_random_below(pddby_random_t* random, uint32_t bound);
+
+#endif // PDDBY_PRIVATE_RANDOM_H
@@ -1,6 +1,7 @@
 #include "regex.h"
 
 #include "report.h"
+#include "trace.h"
 
 #include <assert.h>
 #include <pcre.h>
@@ -108,8 +109,12 @@ int pddby_regex_match(pddby_regex_t* regex, char const* string, pddby_regex_matc
     (*regex_match)->count = D(regex)->cap_count + 1;
     (*regex_match)->string = string;
     (*regex_match)->pddby = D(regex)->pddby;
-    int result = pcre_exec(D(regex)->regex, D(regex)->regex_extra, string, strlen(string), 0, 0, (*regex_match)->caps,
+    size_t const string_size = strlen(string);
+    pddby_trace_span_t span;
+    pddby_trace_begin(D(regex)->pddby, &span, pddby_trace_regex);
+    int result = pcre_exec(D(regex)->regex, D(regex)->regex_extra, string, string_size, 0, 0, (*regex_match)->caps,
         (D(regex)->cap_count + 1) * 3);
+    pddby_trace_end(D(regex)->pddby, &span, string_size, 1);
     if (result >= 0)
     {
         return 1;
@@ -1,9 +1,12 @@
 #include "report.h"
 
+#include "private/decode/decode_task.h"
 #include "private/pddby.h"
+#include "private/util/log.h"
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -14,7 +17,58 @@
 #include <dmalloc.h>
 #endif
 
-static void print_prefix(int err_no, int type)
+// broken-down timestamp of the last printed message, kept per thread since readers of shared handle report too
+struct pddby_report_time
+{
+    time_t time;
+    char text[24];
+};
+
+static pthread_key_t s_report_time_key;
+static pthread_once_t s_report_time_once = PTHREAD_ONCE_INIT;
+
+static void pddby_report_time_key_init()
+{
+    pthread_key_create(&s_report_time_key, &free);
+}
+
+static char const* pddby_report_time_text(char* fallback, size_t fallback_size)
+{
+    pthread_once(&s_report_time_once, &pddby_report_time_key_init);
+
+    struct pddby_report_time* cache = pthread_getspecific(s_report_time_key);
+    if (!cache)
+    {
+        cache = calloc(1, sizeof(struct pddby_report_time));
+        if (cache && pthread_setspecific(s_report_time_key, cache) != 0)
+        {
+            free(cache);
+            cache = NULL;
+        }
+    }
+
+    // breaking time down is comparatively expensive, and messages tend to come in bursts within the same second
+    time_t const current_time = time(NULL);
+    if (cache && cache->time == current_time)
+    {
+        return cache->text;
+    }
+
+    char* text = cache ? cache->text : fallback;
+    size_t const text_size = cache ? sizeof(cache->text) : fallback_size;
+
+    struct tm tm;
+    localtime_r(&current_time, &tm);
+    strftime(text, text_size, "%Y-%m-%d %H:%M:%S", &tm);
+    if (cache)
+    {
+        cache->time = current_time;
+    }
+
+    return text;
+}
+
+static void pddby_report_print(int err_no, int type, char const* text, va_list args)
 {
     char type_char = '?';
     switch (type)
@@ -33,29 +87,52 @@ static void print_prefix(int err_no, int type)
         break;
     }
 
-    time_t current_time = time(NULL);
-    struct tm tm = *localtime(&current_time);
-
-    printf("[%04d-%02d-%02d %02d:%02d:%02d] [%c] ", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-        tm.tm_min, tm.tm_sec, type_char);
+    char time_text[24];
+    char buffer[1024];
+    int size = snprintf(buffer, sizeof(buffer), "[%s] [%c] ", pddby_report_time_text(time_text, sizeof(time_text)),
+        type_char);
 
     if (type > pddby_message_type_log && err_no)
     {
-        printf("[%d | %s] ", err_no, strerror(err_no));
+        size += snprintf(buffer + size, sizeof(buffer) - size, "[%d | %s] ", err_no, strerror(err_no));
+    }
+
+    if ((size_t)size < sizeof(buffer))
+    {
+        size += vsnprintf(buffer + size, sizeof(buffer) - size, text, args);
     }
+    if ((size_t)size >= sizeof(buffer) - 1)
+    {
+        size = sizeof(buffer) - 2;
+    }
+    buffer[size++] = '\n';
+
+    fwrite(buffer, 1, size, stdout);
 }
 
 void pddby_report(pddby_t* pddby, int type, char const* text, ...)
 {
     assert(pddby);
 
+    // filtered out messages should cost nothing, so check before doing any formatting
+    if (type < pddby->log_level)
+    {
+        errno = 0;
+        return;
+    }
+
     va_list args;
     va_start(args, text);
 
-    if (pddby->callbacks && pddby->callbacks->message)
+    if (pddby->log && pddby->callbacks && pddby->callbacks->message)
+    {
+        pddby_log_push(pddby->log, type, text, args);
+    }
+    else if (pddby->callbacks && pddby->callbacks->message)
     {
         char* buffer;
-        if (vasprintf(&buffer, text, args) != -1)
+        if (vasprintf(&buffer, text, args) != -1 &&
+            !pddby_decode_task_post(pddby, pddby_decode_event_message, type, buffer))
         {
             pddby->callbacks->message(pddby, type, buffer);
             free(buffer);
@@ -63,9 +140,7 @@ void pddby_report(pddby_t* pddby, int type, char const* text, ...)
     }
     else
     {
-        print_prefix(errno, type);
-        vprintf(text, args);
-        printf("\n");
+        pddby_report_print(errno, type, text, args);
     }
 
     va_end(args);
@@ -73,11 +148,79 @@ void pddby_report(pddby_t* pddby, int type, char const* text, ...)
     errno = 0;
 }
 
+static double pddby_report_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void pddby_report_progress_ex(pddby_t* pddby, double now)
+{
+    if (!pddby->callbacks || !pddby->callbacks->progress_ex)
+    {
+        return;
+    }
+
+    struct pddby_report_progress_state const* state = &pddby->progress;
+
+    pddby_progress_t progress;
+    progress.stage = state->stage_count ? state->stage : -1;
+    progress.stage_count = state->stage_count;
+    progress.pos = state->pos;
+    progress.size = state->size;
+
+    double const part_fraction = state->size > 0 ? (double)state->pos / state->size : 0;
+    if (state->stage_count)
+    {
+        double total_weight = 0;
+        for (int i = 0; i < state->stage_count; i++)
+        {
+            total_weight += state->stage_weights[i];
+        }
+
+        double stage_fraction = (state->part + part_fraction) / (state->part_count > 0 ? state->part_count : 1);
+        if (stage_fraction > 1)
+        {
+            stage_fraction = 1;
+        }
+
+        progress.fraction = total_weight > 0 ? (state->stage_offset + state->stage_weights[state->stage] *
+            stage_fraction) / total_weight : 0;
+    }
+    else
+    {
+        progress.fraction = part_fraction;
+    }
+
+    double const elapsed = now - state->start_time;
+    progress.items_per_second = elapsed > 0 ? state->items / elapsed : 0;
+    progress.bytes_per_second = elapsed > 0 ? state->bytes / elapsed : 0;
+    progress.eta = progress.fraction > 0 && elapsed > 0 ? elapsed * (1 - progress.fraction) / progress.fraction : -1;
+
+    if (!pddby_decode_task_post_progress(pddby, &progress))
+    {
+        pddby->callbacks->progress_ex(pddby, &progress);
+    }
+}
+
 void pddby_report_progress_begin(pddby_t* pddby, int size)
 {
     assert(pddby);
 
-    if (pddby->callbacks && pddby->callbacks->progress_begin)
+    struct pddby_report_progress_state* state = &pddby->progress;
+    if (!state->stage_count)
+    {
+        state->items = 0;
+        state->bytes = 0;
+        state->start_time = pddby_report_now();
+    }
+    state->size = size;
+    state->pos = 0;
+    state->last_time = 0;
+
+    if (pddby->callbacks && pddby->callbacks->progress_begin &&
+        !pddby_decode_task_post(pddby, pddby_decode_event_progress_begin, size, NULL))
     {
         pddby->callbacks->progress_begin(pddby, size);
     }
@@ -87,18 +230,112 @@ void pddby_report_progress(pddby_t* pddby, int pos)
 {
     assert(pddby);
 
-    if (pddby->callbacks && pddby->callbacks->progress)
+    struct pddby_report_progress_state* state = &pddby->progress;
+    if (pos > state->pos)
+    {
+        state->items += pos - state->pos;
+    }
+    state->pos = pos;
+
+    if (!pddby->callbacks || (!pddby->callbacks->progress && !pddby->callbacks->progress_ex))
+    {
+        return;
+    }
+
+    // last position is always reported so that frontends do not get stuck short of completion
+    double const now = pddby_report_now();
+    if (state->interval_msec > 0 && pos < state->size && (now - state->last_time) * 1000 < state->interval_msec)
+    {
+        return;
+    }
+    state->last_time = now;
+
+    if (pddby->callbacks->progress && !pddby_decode_task_post(pddby, pddby_decode_event_progress, pos, NULL))
     {
         pddby->callbacks->progress(pddby, pos);
     }
+
+    pddby_report_progress_ex(pddby, now);
 }
 
 void pddby_report_progress_end(pddby_t* pddby)
 {
     assert(pddby);
 
-    if (pddby->callbacks && pddby->callbacks->progress_end)
+    struct pddby_report_progress_state* state = &pddby->progress;
+    if (state->part < state->part_count)
+    {
+        state->part++;
+    }
+    state->size = 0;
+    state->pos = 0;
+
+    if (pddby->callbacks && pddby->callbacks->progress_end &&
+        !pddby_decode_task_post(pddby, pddby_decode_event_progress_end, 0, NULL))
     {
         pddby->callbacks->progress_end(pddby);
     }
+
+    pddby_report_progress_ex(pddby, pddby_report_now());
+}
+
+void pddby_report_stages_begin(pddby_t* pddby, double const* weights, int count)
+{
+    assert(pddby);
+    assert(weights);
+
+    struct pddby_report_progress_state* state = &pddby->progress;
+    state->stage_weights = weights;
+    state->stage_count = count;
+    state->stage = 0;
+    state->stage_offset = 0;
+    state->part_count = 1;
+    state->part = 0;
+    state->items = 0;
+    state->bytes = 0;
+    state->start_time = pddby_report_now();
+}
+
+void pddby_report_stage(pddby_t* pddby, int stage)
+{
+    assert(pddby);
+
+    struct pddby_report_progress_state* state = &pddby->progress;
+    assert(stage >= 0 && stage < state->stage_count);
+
+    state->stage_offset = 0;
+    for (int i = 0; i < stage; i++)
+    {
+        state->stage_offset += state->stage_weights[i];
+    }
+    state->stage = stage;
+    state->part_count = 1;
+    state->part = 0;
+}
+
+void pddby_report_stage_parts(pddby_t* pddby, int count)
+{
+    assert(pddby);
+
+    pddby->progress.part_count = count;
+}
+
+void pddby_report_stages_end(pddby_t* pddby)
+{
+    assert(pddby);
+
+    struct pddby_report_progress_state* state = &pddby->progress;
+    state->stage_weights = NULL;
+    state->stage_count = 0;
+    state->stage = 0;
+    state->stage_offset = 0;
+    state->part_count = 0;
+    state->part = 0;
+}
+
+void pddby_report_progress_bytes(pddby_t* pddby, size_t bytes)
+{
+    assert(pddby);
+
+    pddby->progress.bytes += bytes;
 }
@@ -3,10 +3,42 @@
 
 #include "pddby.h"
 
+#include <stddef.h>
+#include <stdint.h>
+
+struct pddby_report_progress_state
+{
+    int interval_msec;
+
+    double const* stage_weights;
+    int stage_count;
+    int stage;
+    double stage_offset;
+    int part_count;
+    int part;
+
+    int size;
+    int pos;
+
+    int64_t items;
+    int64_t bytes;
+    double start_time;
+    double last_time;
+};
+
 void pddby_report(pddby_t* pddby, int type, char const* text, ...);
 
 void pddby_report_progress_begin(pddby_t* pddby, int size);
 void pddby_report_progress(pddby_t* pddby, int pos);
 void pddby_report_progress_end(pddby_t* pddby);
 
+// overall progress is split into stages weighted by expected cost, each made of one or more
+// progress_begin/progress_end parts
+void pddby_report_stages_begin(pddby_t* pddby, double const* weights, int count);
+void pddby_report_stage(pddby_t* pddby, int stage);
+void pddby_report_stage_parts(pddby_t* pddby, int count);
+void pddby_report_stages_end(pddby_t* pddby);
+
+void pddby_report_progress_bytes(pddby_t* pddby, size_t bytes);
+
 #endif // PDDBY_PRIVATE_REPORT_H
@@ -0,0 +1,165 @@
+#include "seal.h"
+
+#include "report.h"
+
+#include <assert.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define PDDBY_SEAL_MAGIC "PDDBYSC1"
+#define PDDBY_SEAL_IV_SIZE 12
+#define PDDBY_SEAL_TAG_SIZE 16
+
+struct pddby_seal_header
+{
+    char magic[8];
+    uint8_t iv[PDDBY_SEAL_IV_SIZE];
+    uint8_t tag[PDDBY_SEAL_TAG_SIZE];
+};
+
+int pddby_seal_derive_key(pddby_t* pddby, void const* secret, size_t secret_size, uint8_t* key)
+{
+    assert(secret);
+    assert(key);
+
+    static char const s_salt[] = "pddby sealed cache";
+
+    unsigned int key_size = 0;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    int const result = ctx &&
+        EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+        EVP_DigestUpdate(ctx, s_salt, sizeof(s_salt)) &&
+        EVP_DigestUpdate(ctx, secret, secret_size) &&
+        EVP_DigestFinal_ex(ctx, key, &key_size) &&
+        key_size == PDDBY_SEAL_KEY_SIZE;
+    if (ctx)
+    {
+        EVP_MD_CTX_free(ctx);
+    }
+
+    if (!result)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to derive sealing key");
+    }
+    return result;
+}
+
+int pddby_seal(pddby_t* pddby, uint8_t const* key, void const* data, size_t data_size, void** result,
+    size_t* result_size)
+{
+    assert(key);
+    assert(result);
+    assert(result_size);
+
+    EVP_CIPHER_CTX* ctx = NULL;
+
+    uint8_t* sealed = malloc(sizeof(struct pddby_seal_header) + data_size);
+    if (!sealed)
+    {
+        goto error;
+    }
+
+    struct pddby_seal_header* header = (struct pddby_seal_header*)sealed;
+    memcpy(header->magic, PDDBY_SEAL_MAGIC, sizeof(header->magic));
+    if (RAND_bytes(header->iv, sizeof(header->iv)) != 1)
+    {
+        goto error;
+    }
+
+    ctx = EVP_CIPHER_CTX_new();
+    int length;
+    int final_length;
+    if (!ctx ||
+        !EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, header->iv) ||
+        !EVP_EncryptUpdate(ctx, sealed + sizeof(*header), &length, data, data_size) ||
+        !EVP_EncryptFinal_ex(ctx, sealed + sizeof(*header) + length, &final_length) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, sizeof(header->tag), header->tag))
+    {
+        goto error;
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    *result = sealed;
+    *result_size = sizeof(*header) + length + final_length;
+    return 1;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to seal data");
+    if (ctx)
+    {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+    if (sealed)
+    {
+        free(sealed);
+    }
+    return 0;
+}
+
+int pddby_unseal(pddby_t* pddby, uint8_t const* key, void const* data, size_t data_size,
+    void* (*alloc_func)(size_t size), void (*free_func)(void* data), void** result, size_t* result_size)
+{
+    assert(key);
+    assert(alloc_func);
+    assert(free_func);
+    assert(result);
+    assert(result_size);
+
+    EVP_CIPHER_CTX* ctx = NULL;
+    uint8_t* unsealed = NULL;
+
+    struct pddby_seal_header header;
+    if (data_size < sizeof(header))
+    {
+        goto error;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, PDDBY_SEAL_MAGIC, sizeof(header.magic)) != 0)
+    {
+        goto error;
+    }
+
+    size_t const unsealed_size = data_size - sizeof(header);
+    unsealed = alloc_func(unsealed_size ? unsealed_size : 1);
+    if (!unsealed)
+    {
+        goto error;
+    }
+
+    ctx = EVP_CIPHER_CTX_new();
+    int length;
+    int final_length;
+    if (!ctx ||
+        !EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, header.iv) ||
+        !EVP_DecryptUpdate(ctx, unsealed, &length, (uint8_t const*)data + sizeof(header), unsealed_size) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, sizeof(header.tag), header.tag) ||
+        EVP_DecryptFinal_ex(ctx, unsealed + length, &final_length) <= 0)
+    {
+        goto error;
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    *result = unsealed;
+    *result_size = length + final_length;
+    return 1;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to unseal data (damaged or made from another disc)");
+    if (ctx)
+    {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+    if (unsealed)
+    {
+        free_func(unsealed);
+    }
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef PDDBY_PRIVATE_SEAL_H
+#define PDDBY_PRIVATE_SEAL_H
+
+#include "pddby.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PDDBY_SEAL_KEY_SIZE 32
+
+// sealed data is encrypted and authenticated, so unsealing with key of another disc fails instead of yielding garbage
+
+int pddby_seal_derive_key(pddby_t* pddby, void const* secret, size_t secret_size, uint8_t* key);
+
+int pddby_seal(pddby_t* pddby, uint8_t const* key, void const* data, size_t data_size, void** result,
+    size_t* result_size);
+// result is allocated with alloc_func, so that it can be handed over to whoever frees it with matching function
+int pddby_unseal(pddby_t* pddby, uint8_t const* key, void const* data, size_t data_size,
+    void* (*alloc_func)(size_t size), void (*free_func)(void* data), void** result, size_t* result_size);
+
+#endif // PDDBY_PRIVATE_SEAL_H
@@ -2,48 +2,363 @@
 
 #include "config.h"
 #include "database.h"
+#include "pack.h"
+#include "private/pddby.h"
 #include "report.h"
+#include "string.h"
 
 #include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifdef DMALLOC
 #include <dmalloc.h>
 #endif
 
-char* pddby_settings_get(pddby_t* pddby, char const* key)
+enum pddby_setting_type
 {
-    assert(key);
+    pddby_setting_type_int_array,
+    pddby_setting_type_string_list
+};
 
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+struct pddby_setting_info
+{
+    char const* key;
+    int type;
+};
+
+static struct pddby_setting_info const s_settings[pddby_setting_count] =
+{
+    {"ticket_topics_distribution", pddby_setting_type_int_array},
+    {"image_dirs", pddby_setting_type_string_list}
+};
+
+struct pddby_setting_value
+{
+    // as stored, to tell whether it changed; NULL if missing
+    char* raw;
+
+    // only one of these is there, depending on type, none if value is malformed
+    int* ints;
+    char** strings;
+    size_t count;
+};
+
+struct pddby_settings_listener
+{
+    struct pddby_settings_listener* next;
+    pddby_settings_changed_func_t func;
+    void* user_data;
+};
+
+struct pddby_settings
+{
+    pddby_t* pddby;
+    int is_loaded;
+    struct pddby_setting_value values[pddby_setting_count];
+    struct pddby_settings_listener* listeners;
+};
+
+static void pddby_setting_value_clear(struct pddby_setting_value* value)
+{
+    if (value->raw)
+    {
+        free(value->raw);
+    }
+    if (value->ints)
+    {
+        free(value->ints);
+    }
+    if (value->strings)
+    {
+        pddby_stringv_free(value->strings);
+    }
+    memset(value, 0, sizeof(*value));
+}
+
+static int pddby_setting_value_parse(pddby_t* pddby, int setting, char const* raw, struct pddby_setting_value* value)
+{
+    if (!raw)
+    {
+        return 1;
+    }
+
+    value->raw = strdup(raw);
+    if (!value->raw)
+    {
+        return 0;
+    }
+
+    char** parts = pddby_string_split(pddby, raw, ":");
+    if (!parts)
+    {
+        return 0;
+    }
+
+    size_t const count = pddby_stringv_length(parts);
+
+    if (s_settings[setting].type == pddby_setting_type_string_list)
+    {
+        value->strings = parts;
+        value->count = count;
+        return 1;
+    }
+
+    value->ints = malloc((count ? count : 1) * sizeof(int));
+    if (!value->ints)
+    {
+        pddby_stringv_free(parts);
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char* end;
+        long const number = strtol(parts[i], &end, 10);
+        if (end == parts[i] || *end != '\0' || number < 0 || number > INT_MAX)
+        {
+            // malformed value is as good as missing one, it's not a reason to fail whole load though
+            pddby_report(pddby, pddby_message_type_warning, "malformed value \"%s\" of setting \"%s\"", raw,
+                s_settings[setting].key);
+            free(value->ints);
+            value->ints = NULL;
+            pddby_stringv_free(parts);
+            return 1;
+        }
+        value->ints[i] = number;
+    }
+
+    value->count = count;
+    pddby_stringv_free(parts);
+    return 1;
+}
+
+static int pddby_settings_find(char const* key)
+{
+    for (int i = 0; key && i < pddby_setting_count; i++)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `value` FROM `settings` WHERE `key`=? LIMIT 1");
-        if (!db_stmt)
+        if (strcmp(s_settings[i].key, key) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int pddby_settings_read_pack(pddby_t* pddby, char** raw_values)
+{
+    size_t const count = pddby_pack_count(pddby->pack, pddby_pack_settings);
+    for (size_t i = 1; i <= count; i++)
+    {
+        struct pddby_pack_setting const* setting = pddby_pack_record(pddby->pack, pddby_pack_settings, i);
+        int const index = pddby_settings_find(pddby_pack_string(pddby->pack, setting->key));
+        char const* value = pddby_pack_string(pddby->pack, setting->value);
+        if (index == -1 || !value || raw_values[index])
+        {
+            continue;
+        }
+
+        raw_values[index] = strdup(value);
+        if (!raw_values[index])
         {
-            goto error;
+            return 0;
         }
     }
 
-    if (!pddby_db_reset(db_stmt) ||
-        !pddby_db_bind_text(db_stmt, 1, key))
+    return 1;
+}
+
+static int pddby_settings_read_db(pddby_t* pddby, char** raw_values)
+{
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT `key`, `value` FROM `settings`");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    if (!pddby_db_reset(db_stmt))
     {
-        goto error;
+        return 0;
     }
 
-    switch (pddby_db_step(db_stmt))
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        int const index = pddby_settings_find(pddby_db_column_text(db_stmt, 0));
+        char const* value = pddby_db_column_text(db_stmt, 1);
+        if (index == -1 || !value)
+        {
+            continue;
+        }
+
+        raw_values[index] = strdup(value);
+        if (!raw_values[index])
+        {
+            return 0;
+        }
+    }
+
+    return ret == 0;
+}
+
+pddby_settings_t* pddby_settings_new(pddby_t* pddby)
+{
+    pddby_settings_t* settings = calloc(1, sizeof(pddby_settings_t));
+    if (!settings)
     {
-    case -1:
-        goto error;
-    case 0:
+        pddby_report(pddby, pddby_message_type_error, "unable to create settings");
         return NULL;
     }
 
-    char const* value = pddby_db_column_text(db_stmt, 0);
+    settings->pddby = pddby;
+
+    return settings;
+}
+
+void pddby_settings_free(pddby_settings_t* settings)
+{
+    assert(settings);
+
+    for (int i = 0; i < pddby_setting_count; i++)
+    {
+        pddby_setting_value_clear(&settings->values[i]);
+    }
+
+    while (settings->listeners)
+    {
+        struct pddby_settings_listener* listener = settings->listeners;
+        settings->listeners = listener->next;
+        free(listener);
+    }
+
+    free(settings);
+}
+
+int pddby_settings_load(pddby_t* pddby)
+{
+    pddby_settings_t* settings = pddby->settings;
+
+    char* raw_values[pddby_setting_count];
+    struct pddby_setting_value values[pddby_setting_count];
+    memset(raw_values, 0, sizeof(raw_values));
+    memset(values, 0, sizeof(values));
+
+    int result = pddby->pack ? pddby_settings_read_pack(pddby, raw_values) : pddby_settings_read_db(pddby, raw_values);
+    for (int i = 0; result && i < pddby_setting_count; i++)
+    {
+        result = pddby_setting_value_parse(pddby, i, raw_values[i], &values[i]);
+    }
+
+    for (int i = 0; i < pddby_setting_count; i++)
+    {
+        if (raw_values[i])
+        {
+            free(raw_values[i]);
+        }
+    }
+
+    if (!result)
+    {
+        for (int i = 0; i < pddby_setting_count; i++)
+        {
+            pddby_setting_value_clear(&values[i]);
+        }
+        pddby_report(pddby, pddby_message_type_error, "unable to load settings");
+        return 0;
+    }
+
+    int is_changed[pddby_setting_count];
+    for (int i = 0; i < pddby_setting_count; i++)
+    {
+        struct pddby_setting_value* value = &settings->values[i];
+        is_changed[i] = (value->raw || values[i].raw) &&
+            (!value->raw || !values[i].raw || strcmp(value->raw, values[i].raw) != 0);
+
+        pddby_setting_value_clear(value);
+        *value = values[i];
+    }
+
+    settings->is_loaded = 1;
+
+    for (int i = 0; i < pddby_setting_count; i++)
+    {
+        for (struct pddby_settings_listener* listener = settings->listeners; is_changed[i] && listener;
+            listener = listener->next)
+        {
+            listener->func(pddby, i, listener->user_data);
+        }
+    }
+
+    return 1;
+}
+
+void pddby_settings_invalidate(pddby_t* pddby)
+{
+    pddby->settings->is_loaded = 0;
+}
+
+int pddby_settings_add_listener(pddby_t* pddby, pddby_settings_changed_func_t func, void* user_data)
+{
+    assert(func);
+
+    struct pddby_settings_listener* listener = calloc(1, sizeof(struct pddby_settings_listener));
+    if (!listener)
+    {
+        pddby_report(pddby, pddby_message_type_error, "unable to add settings listener");
+        return 0;
+    }
+
+    listener->func = func;
+    listener->user_data = user_data;
+    listener->next = pddby->settings->listeners;
+    pddby->settings->listeners = listener;
+
+    return 1;
+}
+
+void pddby_settings_remove_listener(pddby_t* pddby, pddby_settings_changed_func_t func, void* user_data)
+{
+    for (struct pddby_settings_listener** it = &pddby->settings->listeners; *it; it = &(*it)->next)
+    {
+        struct pddby_settings_listener* listener = *it;
+        if (listener->func == func && listener->user_data == user_data)
+        {
+            *it = listener->next;
+            free(listener);
+            return;
+        }
+    }
+}
+
+static struct pddby_setting_value const* pddby_settings_value(pddby_t* pddby, int setting, int type)
+{
+    assert(setting >= 0 && setting < pddby_setting_count);
+    assert(s_settings[setting].type == type);
+
+    if (!pddby->settings->is_loaded && !pddby->pack)
+    {
+        // settings are loaded as soon as database is opened
+        pddby_db_open(pddby);
+    }
+
+    return &pddby->settings->values[setting];
+}
 
-    return strdup(value);
+int const* pddby_settings_get_int_array(pddby_t* pddby, int setting, size_t* count)
+{
+    assert(count);
+
+    struct pddby_setting_value const* value = pddby_settings_value(pddby, setting, pddby_setting_type_int_array);
+    *count = value->ints ? value->count : 0;
+    return value->ints;
+}
+
+char const* const* pddby_settings_get_string_list(pddby_t* pddby, int setting, size_t* count)
+{
+    assert(count);
 
-error:
-    pddby_report(pddby, pddby_message_type_error, "unable to get settings value for key \"%s\"", key);
-    return NULL;
+    struct pddby_setting_value const* value = pddby_settings_value(pddby, setting, pddby_setting_type_string_list);
+    *count = value->strings ? value->count : 0;
+    return (char const* const*)value->strings;
 }
@@ -3,6 +3,36 @@
 
 #include "pddby.h"
 
-char* pddby_settings_get(pddby_t* pddby, char const* key);
+#include <stddef.h>
+
+// settings library knows about, each of them has fixed type; other keys are ignored
+enum pddby_setting
+{
+    // int array, questions to take from each topic when composing ticket
+    pddby_setting_ticket_topics_distribution,
+    // string list, directories on disc images are decoded from
+    pddby_setting_image_dirs,
+    pddby_setting_count
+};
+
+struct pddby_settings;
+typedef struct pddby_settings pddby_settings_t;
+
+typedef void (*pddby_settings_changed_func_t)(pddby_t* pddby, int setting, void* user_data);
+
+pddby_settings_t* pddby_settings_new(pddby_t* pddby);
+void pddby_settings_free(pddby_settings_t* settings);
+
+// reads all settings from pack or database at once, listeners hear about every one that changed since last load
+int pddby_settings_load(pddby_t* pddby);
+// values are kept until next load, it's only done once something asks for them again
+void pddby_settings_invalidate(pddby_t* pddby);
+
+int pddby_settings_add_listener(pddby_t* pddby, pddby_settings_changed_func_t func, void* user_data);
+void pddby_settings_remove_listener(pddby_t* pddby, pddby_settings_changed_func_t func, void* user_data);
+
+// NULL if setting is missing or malformed, values stay valid until settings change
+int const* pddby_settings_get_int_array(pddby_t* pddby, int setting, size_t* count);
+char const* const* pddby_settings_get_string_list(pddby_t* pddby, int setting, size_t* count);
 
 #endif // PDDBY_PRIVATE_SETTINGS_H
@@ -0,0 +1,79 @@
+#include "texts.h"
+
+#include "database.h"
+#include "report.h"
+
+#include "private/queries.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+int64_t pddby_texts_hash(char const* text)
+{
+    assert(text);
+
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint8_t const* p = (uint8_t const*)text; *p; p++)
+    {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    return (int64_t)hash;
+}
+
+int64_t pddby_texts_intern(pddby_t* pddby, char const* text)
+{
+    if (!text)
+    {
+        return 0;
+    }
+
+    pddby_db_stmt_t* find_db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_TEXT_BY_HASH);
+    if (!find_db_stmt)
+    {
+        goto error;
+    }
+
+    pddby_db_stmt_t* insert_db_stmt = pddby_db_prepare_cached(pddby, "INSERT INTO `texts` (`hash`, `text`) VALUES (?, "
+        "?)");
+    if (!insert_db_stmt)
+    {
+        goto error;
+    }
+
+    int64_t const hash = pddby_texts_hash(text);
+
+    if (!pddby_db_reset(find_db_stmt) ||
+        !pddby_db_bind_int64(find_db_stmt, 1, hash) ||
+        !pddby_db_bind_text(find_db_stmt, 2, text))
+    {
+        goto error;
+    }
+
+    switch (pddby_db_step(find_db_stmt))
+    {
+    case -1:
+        goto error;
+    case 1:
+        return pddby_db_column_int64(find_db_stmt, 0);
+    }
+
+    if (!pddby_db_reset(insert_db_stmt) ||
+        !pddby_db_bind_int64(insert_db_stmt, 1, hash) ||
+        !pddby_db_bind_text(insert_db_stmt, 2, text) ||
+        pddby_db_step(insert_db_stmt) != 0)
+    {
+        goto error;
+    }
+
+    return pddby_db_last_insert_id(pddby);
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to store text");
+    return -1;
+}
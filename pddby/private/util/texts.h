@@ -0,0 +1,15 @@
+#ifndef PDDBY_PRIVATE_TEXTS_H
+#define PDDBY_PRIVATE_TEXTS_H
+
+#include "pddby.h"
+
+#include <stdint.h>
+
+// decoded texts repeat a lot (answer wordings in particular), so each of them is stored once in `texts` table and
+// referred to by id; rows are looked up by content hash
+
+int64_t pddby_texts_hash(char const* text);
+// id of stored text, adding it if needed; 0 for NULL text, -1 on error
+int64_t pddby_texts_intern(pddby_t* pddby, char const* text);
+
+#endif // PDDBY_PRIVATE_TEXTS_H
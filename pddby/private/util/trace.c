@@ -0,0 +1,248 @@
+#include "trace.h"
+
+#include "private/decode/decode_task.h"
+#include "private/pddby.h"
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+struct pddby_trace_kind_info
+{
+    char const* name;
+    // fine-grained kinds happen per record and are only aggregated, not put on timeline
+    int on_timeline;
+};
+
+static struct pddby_trace_kind_info const s_kinds[pddby_trace_kind_count] =
+{
+    {"decode", 1},
+    {"magic", 1},
+    {"images", 1},
+    {"comments", 1},
+    {"traffregs", 1},
+    {"questions", 1},
+    {"dir_scan", 1},
+    {"file_read", 1},
+    {"decrypt", 1},
+    {"convert", 0},
+    {"regex", 0},
+    {"insert", 0}
+};
+
+struct pddby_trace_event
+{
+    int kind;
+    int64_t start;
+    int64_t duration;
+    uint64_t bytes;
+    uint64_t records;
+};
+
+struct pddby_trace
+{
+    pddby_t* pddby;
+    char* path;
+    int64_t start;
+
+    pddby_trace_entry_t totals[pddby_trace_kind_count];
+
+    struct pddby_trace_event* events;
+    size_t events_size;
+    size_t events_reserved_size;
+};
+
+static int64_t pddby_trace_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+pddby_trace_t* pddby_trace_new(pddby_t* pddby, char const* path)
+{
+    assert(pddby);
+
+    pddby_trace_t* trace = calloc(1, sizeof(pddby_trace_t));
+    if (!trace)
+    {
+        goto error;
+    }
+
+    if (path)
+    {
+        trace->path = strdup(path);
+        if (!trace->path)
+        {
+            free(trace);
+            goto error;
+        }
+    }
+
+    trace->pddby = pddby;
+    trace->start = pddby_trace_now();
+
+    for (int i = 0; i < pddby_trace_kind_count; i++)
+    {
+        trace->totals[i].name = s_kinds[i].name;
+    }
+
+    return trace;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create trace");
+    return NULL;
+}
+
+void pddby_trace_free(pddby_trace_t* trace)
+{
+    assert(trace);
+
+    if (trace->events)
+    {
+        free(trace->events);
+    }
+    if (trace->path)
+    {
+        free(trace->path);
+    }
+    free(trace);
+}
+
+void pddby_trace_begin(pddby_t* pddby, pddby_trace_span_t* span, int kind)
+{
+    span->kind = kind;
+    span->start = pddby->trace ? pddby_trace_now() : 0;
+}
+
+void pddby_trace_end(pddby_t* pddby, pddby_trace_span_t const* span, uint64_t bytes, uint64_t records)
+{
+    pddby_trace_t* trace = pddby->trace;
+    if (!trace || !span->start)
+    {
+        return;
+    }
+
+    assert(span->kind >= 0 && span->kind < pddby_trace_kind_count);
+
+    int64_t const duration = pddby_trace_now() - span->start;
+
+    pddby_trace_entry_t* total = &trace->totals[span->kind];
+    total->count++;
+    total->seconds += duration / 1000000000.0;
+    total->bytes += bytes;
+    total->records += records;
+
+    if (!trace->path || !s_kinds[span->kind].on_timeline)
+    {
+        return;
+    }
+
+    if (trace->events_size == trace->events_reserved_size)
+    {
+        size_t const new_reserved_size = trace->events_reserved_size ? trace->events_reserved_size * 2 : 1024;
+        struct pddby_trace_event* new_events = realloc(trace->events, new_reserved_size *
+            sizeof(struct pddby_trace_event));
+        if (!new_events)
+        {
+            // timeline gets incomplete, but summary stays correct
+            return;
+        }
+        trace->events = new_events;
+        trace->events_reserved_size = new_reserved_size;
+    }
+
+    struct pddby_trace_event* event = &trace->events[trace->events_size++];
+    event->kind = span->kind;
+    event->start = span->start - trace->start;
+    event->duration = duration;
+    event->bytes = bytes;
+    event->records = records;
+}
+
+static int pddby_trace_write(pddby_trace_t* trace)
+{
+    FILE* f = fopen(trace->path, "w");
+    if (!f)
+    {
+        goto error;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", f);
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"pddby\"}}", f);
+
+    for (size_t i = 0; i < trace->events_size; i++)
+    {
+        struct pddby_trace_event const* event = &trace->events[i];
+        // trace event timestamps are in microseconds
+        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"decode\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+            "\"args\":{\"bytes\":%llu,\"records\":%llu}}", s_kinds[event->kind].name, event->start / 1000.0,
+            event->duration / 1000.0, (unsigned long long)event->bytes, (unsigned long long)event->records);
+    }
+
+    fputs("\n]}\n", f);
+
+    if (ferror(f))
+    {
+        fclose(f);
+        goto error;
+    }
+    if (fclose(f) == EOF)
+    {
+        goto error;
+    }
+
+    return 1;
+
+error:
+    pddby_report(trace->pddby, pddby_message_type_error, "unable to write trace to \"%s\"", trace->path);
+    return 0;
+}
+
+int pddby_trace_finish(pddby_trace_t* trace)
+{
+    assert(trace);
+
+    pddby_t* pddby = trace->pddby;
+
+    int result = 1;
+    if (trace->path)
+    {
+        result = pddby_trace_write(trace);
+    }
+
+    pddby_trace_entry_t entries[pddby_trace_kind_count];
+    int entries_size = 0;
+    for (int i = 0; i < pddby_trace_kind_count; i++)
+    {
+        if (trace->totals[i].count)
+        {
+            entries[entries_size++] = trace->totals[i];
+        }
+    }
+
+    if (pddby->callbacks && pddby->callbacks->trace_summary)
+    {
+        if (!pddby_decode_task_post_trace_summary(pddby, entries, entries_size))
+        {
+            pddby->callbacks->trace_summary(pddby, entries, entries_size);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < entries_size; i++)
+        {
+            pddby_report(pddby, pddby_message_type_log, "trace: %-10s %8lu x %10.3f s %12llu bytes %8llu records",
+                entries[i].name, entries[i].count, entries[i].seconds, entries[i].bytes, entries[i].records);
+        }
+    }
+
+    return result;
+}
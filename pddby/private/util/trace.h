@@ -0,0 +1,46 @@
+#ifndef PDDBY_PRIVATE_TRACE_H
+#define PDDBY_PRIVATE_TRACE_H
+
+#include "pddby.h"
+
+#include <stdint.h>
+
+enum pddby_trace_kind
+{
+    pddby_trace_decode,
+    pddby_trace_magic,
+    pddby_trace_stage_images,
+    pddby_trace_stage_comments,
+    pddby_trace_stage_traffregs,
+    pddby_trace_stage_questions,
+    pddby_trace_dir_scan,
+    pddby_trace_file_read,
+    pddby_trace_decrypt,
+    pddby_trace_convert,
+    pddby_trace_regex,
+    pddby_trace_insert,
+    pddby_trace_kind_count
+};
+
+struct pddby_trace;
+typedef struct pddby_trace pddby_trace_t;
+
+struct pddby_trace_span
+{
+    int kind;
+    int64_t start;
+};
+
+typedef struct pddby_trace_span pddby_trace_span_t;
+
+pddby_trace_t* pddby_trace_new(pddby_t* pddby, char const* path);
+void pddby_trace_free(pddby_trace_t* trace);
+
+// both are no-ops unless pddby has an active trace
+void pddby_trace_begin(pddby_t* pddby, pddby_trace_span_t* span, int kind);
+void pddby_trace_end(pddby_t* pddby, pddby_trace_span_t const* span, uint64_t bytes, uint64_t records);
+
+// writes out timeline (if requested) and hands summary over to frontend
+int pddby_trace_finish(pddby_trace_t* trace);
+
+#endif // PDDBY_PRIVATE_TRACE_H
@@ -1,14 +1,20 @@
 #include "question.h"
 
 #include "config.h"
-#include "private/util/aux.h"
+#include "private/cursor.h"
+#include "private/pddby.h"
+#include "private/queries.h"
+#include "private/question.h"
 #include "private/util/database.h"
+#include "private/util/pack.h"
+#include "private/util/random.h"
 #include "private/util/report.h"
 #include "private/util/settings.h"
-#include "private/util/string.h"
+#include "private/util/texts.h"
 #include "topic.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -16,8 +22,6 @@
 #include <dmalloc.h>
 #endif
 
-static int* ticket_topics_distribution = NULL;
-
 static pddby_question_t* pddby_question_new_with_id(pddby_t* pddby, int64_t id, int64_t topic_id, char const* text, int64_t image_id,
     char const* advice, int64_t comment_id)
 {
@@ -56,6 +60,38 @@ error:
     return NULL;
 }
 
+static pddby_question_t* pddby_question_new_from_pack(pddby_t* pddby, int64_t id)
+{
+    struct pddby_pack_question const* question = pddby_pack_record(pddby->pack, pddby_pack_questions, id);
+    if (!question)
+    {
+        return NULL;
+    }
+
+    return pddby_question_new_with_id(pddby, id, question->topic_id, pddby_pack_string(pddby->pack, question->text),
+        question->image_id, NULL, question->comment_id);
+}
+
+static pddby_questions_t* pddby_questions_new_from_pack(pddby_t* pddby, uint32_t const* ids, size_t count)
+{
+    pddby_questions_t* questions = pddby_questions_new(pddby);
+    if (!questions)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!pddby_array_add(questions, pddby_question_new_from_pack(pddby, ids[i])))
+        {
+            pddby_questions_free(questions);
+            return NULL;
+        }
+    }
+
+    return questions;
+}
+
 pddby_question_t* pddby_question_new(pddby_t* pddby, int64_t topic_id, char const* text, int64_t image_id, char const* advice,
     int64_t comment_id)
 {
@@ -77,19 +113,48 @@ void pddby_question_free(pddby_question_t *question)
     free(question);
 }
 
+static int pddby_question_save_advice(pddby_question_t* question)
+{
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(question->pddby, "INSERT INTO `question_advices` "
+        "(`question_id`, `advice_id`) VALUES (?, ?)");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    int64_t advice_id = pddby_texts_intern(question->pddby, question->advice);
+    if (advice_id == -1)
+    {
+        return 0;
+    }
+
+    if (!pddby_db_reset(db_stmt) ||
+        !pddby_db_bind_int64(db_stmt, 1, question->id) ||
+        !pddby_db_bind_int64(db_stmt, 2, advice_id))
+    {
+        return 0;
+    }
+
+    int ret = pddby_db_step(db_stmt);
+    if (ret == -1)
+    {
+        return 0;
+    }
+
+    assert(ret == 0);
+
+    return 1;
+}
+
 int pddby_question_save(pddby_question_t* question)
 {
     assert(question);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(question->pddby, "INSERT INTO `questions` (`topic_id`, `text`, "
+        "`image_id`, `comment_id`) VALUES (?, ?, ?, ?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(question->pddby, "INSERT INTO `questions` (`topic_id`, `text`, `image_id`, `advice`, `comment_id`) "
-            "VALUES (?, ?, ?, ?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -100,10 +165,9 @@ int pddby_question_save(pddby_question_t* question)
         !(question->image_id ?
             pddby_db_bind_int64(db_stmt, 3, question->image_id) :
             pddby_db_bind_null(db_stmt, 3)) ||
-        !pddby_db_bind_text(db_stmt, 4, question->advice) ||
         !(question->comment_id ?
-            pddby_db_bind_int64(db_stmt, 5, question->comment_id) :
-            pddby_db_bind_null(db_stmt, 5)))
+            pddby_db_bind_int64(db_stmt, 4, question->comment_id) :
+            pddby_db_bind_null(db_stmt, 4)))
     {
         goto error;
     }
@@ -118,6 +182,11 @@ int pddby_question_save(pddby_question_t* question)
 
     question->id = pddby_db_last_insert_id(question->pddby);
 
+    if (question->advice && !pddby_question_save_advice(question))
+    {
+        goto error;
+    }
+
     return 1;
 
 error:
@@ -125,18 +194,77 @@ error:
     return 0;
 }
 
-int pddby_question_set_sections(pddby_question_t* question, pddby_sections_t* sections)
+char const* pddby_question_get_advice(pddby_question_t* question)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    assert(question);
+
+    if (question->advice || !question->id)
+    {
+        return question->advice;
+    }
+
+    if (question->pddby->pack)
+    {
+        struct pddby_pack_question const* record = pddby_pack_record(question->pddby->pack, pddby_pack_questions,
+            question->id);
+        char const* advice = record ? pddby_pack_string(question->pddby->pack, record->advice) : NULL;
+        if (advice)
+        {
+            question->advice = strdup(advice);
+            if (!question->advice)
+            {
+                goto error;
+            }
+        }
+        return question->advice;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(question->pddby, PDDBY_QUERY_QUESTION_ADVICE);
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(question->pddby, "INSERT INTO `questions_sections` (`question_id`, `section_id`) VALUES (?, ?)");
-        if (!db_stmt)
+        goto error;
+    }
+
+    if (!pddby_db_reset(db_stmt) ||
+        !pddby_db_bind_int64(db_stmt, 1, question->id))
+    {
+        goto error;
+    }
+
+    switch (pddby_db_step(db_stmt))
+    {
+    case -1:
+        goto error;
+    case 0:
+        return NULL;
+    }
+
+    char const* advice = pddby_db_column_text(db_stmt, 0);
+    if (advice)
+    {
+        question->advice = strdup(advice);
+        if (!question->advice)
         {
             goto error;
         }
     }
 
+    return question->advice;
+
+error:
+    pddby_report(question->pddby, pddby_message_type_error, "unable to get question object advice");
+    return NULL;
+}
+
+int pddby_question_set_sections(pddby_question_t* question, pddby_sections_t* sections)
+{
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(question->pddby, "INSERT OR IGNORE INTO `questions_sections` "
+        "(`question_id`, `section_id`) VALUES (?, ?)");
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
     for (size_t i = 0, size = pddby_array_size(sections); i < size; i++)
     {
         pddby_section_t* section = pddby_array_index(sections, i);
@@ -166,14 +294,11 @@ error:
 
 int pddby_question_set_traffregs(pddby_question_t* question, pddby_traffregs_t* traffregs)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(question->pddby, "INSERT INTO `questions_traffregs` "
+        "(`question_id`, `traffreg_id`, `position`) VALUES (?, ?, ?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(question->pddby, "INSERT INTO `questions_traffregs` (`question_id`, `traffreg_id`) VALUES (?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     for (size_t i = 0, size = pddby_array_size(traffregs); i < size; i++)
@@ -182,7 +307,8 @@ int pddby_question_set_traffregs(pddby_question_t* question, pddby_traffregs_t*
 
         if (!pddby_db_reset(db_stmt) ||
             !pddby_db_bind_int64(db_stmt, 1, question->id) ||
-            !pddby_db_bind_int64(db_stmt, 2, traffreg->id))
+            !pddby_db_bind_int64(db_stmt, 2, traffreg->id) ||
+            !pddby_db_bind_int(db_stmt, 3, i))
         {
             goto error;
         }
@@ -205,15 +331,15 @@ error:
 
 pddby_question_t* pddby_question_find_by_id(pddby_t* pddby, int64_t id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    if (pddby->pack)
+    {
+        return pddby_question_new_from_pack(pddby, id);
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_QUESTION_BY_ID);
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `topic_id`, `text`, `image_id`, `advice`, `comment_id` FROM "
-            "`questions` WHERE `rowid`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -233,10 +359,9 @@ pddby_question_t* pddby_question_find_by_id(pddby_t* pddby, int64_t id)
     int64_t topic_id = pddby_db_column_int64(db_stmt, 0);
     char const* text = pddby_db_column_text(db_stmt, 1);
     int64_t image_id = pddby_db_column_int64(db_stmt, 2);
-    char const* advice = pddby_db_column_text(db_stmt, 3);
-    int64_t comment_id = pddby_db_column_int64(db_stmt, 4);
+    int64_t comment_id = pddby_db_column_int64(db_stmt, 3);
 
-    return pddby_question_new_with_id(pddby, id, topic_id, text, image_id, advice, comment_id);
+    return pddby_question_new_with_id(pddby, id, topic_id, text, image_id, NULL, comment_id);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find question object with id = %lld", id);
@@ -250,16 +375,22 @@ pddby_questions_t* pddby_questions_new(pddby_t* pddby)
 
 pddby_questions_t* pddby_questions_find_by_section(pddby_t* pddby, int64_t section_id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    if (pddby->pack)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT q.`rowid`, q.`topic_id`, q.`text`, q.`image_id`, q.`advice`, "
-            "q.`comment_id` FROM `questions` q INNER JOIN `questions_sections` qs ON q.`rowid`=qs.`question_id` WHERE "
-            "qs.`section_id`=?");
-        if (!db_stmt)
+        size_t count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_section_questions, section_id, &count);
+        pddby_questions_t* questions = pddby_questions_new_from_pack(pddby, ids, count);
+        if (!questions)
         {
             goto error;
         }
+        return questions;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_QUESTIONS_BY_SECTION);
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -281,10 +412,9 @@ pddby_questions_t* pddby_questions_find_by_section(pddby_t* pddby, int64_t secti
         int64_t topic_id = pddby_db_column_int64(db_stmt, 1);
         char const* text = pddby_db_column_text(db_stmt, 2);
         int64_t image_id = pddby_db_column_int64(db_stmt, 3);
-        char const* advice = pddby_db_column_text(db_stmt, 4);
-        int64_t comment_id = pddby_db_column_int64(db_stmt, 5);
+        int64_t comment_id = pddby_db_column_int64(db_stmt, 4);
 
-        if (!pddby_array_add(questions, pddby_question_new_with_id(pddby, id, topic_id, text, image_id, advice, comment_id)))
+        if (!pddby_array_add(questions, pddby_question_new_with_id(pddby, id, topic_id, text, image_id, NULL, comment_id)))
         {
             ret = -1;
             break;
@@ -304,17 +434,103 @@ error:
     return NULL;
 }
 
-static pddby_questions_t* pddby_questions_find_with_offset(pddby_t* pddby, int64_t topic_id, int offset, int count)
+static void pddby_question_row_read_db(void* row, int fields, pddby_db_stmt_t* db_stmt)
+{
+    pddby_question_row_t* question = row;
+    question->id = pddby_db_column_int64(db_stmt, 0);
+    question->topic_id = pddby_db_column_int64(db_stmt, 1);
+    question->text = fields & pddby_cursor_field_text ? pddby_db_column_text(db_stmt, 2) : NULL;
+    question->image_id = pddby_db_column_int64(db_stmt, 3);
+    question->comment_id = pddby_db_column_int64(db_stmt, 4);
+}
+
+static int pddby_question_row_read_pack(void* row, int fields, pddby_pack_t const* pack, int64_t id)
+{
+    struct pddby_pack_question const* pack_question = pddby_pack_record(pack, pddby_pack_questions, id);
+    if (!pack_question)
+    {
+        return 0;
+    }
+
+    pddby_question_row_t* question = row;
+    question->id = id;
+    question->topic_id = pack_question->topic_id;
+    question->text = fields & pddby_cursor_field_text ? pddby_pack_string(pack, pack_question->text) : NULL;
+    question->image_id = pack_question->image_id;
+    question->comment_id = pack_question->comment_id;
+    return 1;
+}
+
+pddby_cursor_t* pddby_questions_cursor_by_section(pddby_t* pddby, int64_t section_id, int fields, int offset,
+    int count)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    if (pddby->pack)
+    {
+        size_t links_count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_section_questions, section_id,
+            &links_count);
+        size_t const begin = (size_t)offset < links_count ? (size_t)offset : links_count;
+        size_t const end = count < 0 || (size_t)count > links_count - begin ? links_count : begin + count;
+        pddby_cursor_t* cursor = pddby_cursor_new_from_pack(pddby, fields, sizeof(pddby_question_row_t),
+            ids ? ids + begin : NULL, end - begin, &pddby_question_row_read_pack);
+        if (!cursor)
+        {
+            goto error;
+        }
+        return cursor;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare(pddby, fields & pddby_cursor_field_text ?
+        "SELECT q.`id`, q.`topic_id`, q.`text`, q.`image_id`, q.`comment_id` FROM `questions_sections` qs INNER JOIN "
+        "`questions` q ON q.`id`=qs.`question_id` WHERE qs.`section_id`=? ORDER BY qs.`question_id` LIMIT ?,?" :
+        "SELECT q.`id`, q.`topic_id`, NULL, q.`image_id`, q.`comment_id` FROM `questions_sections` qs INNER JOIN "
+        "`questions` q ON q.`id`=qs.`question_id` WHERE qs.`section_id`=? ORDER BY qs.`question_id` LIMIT ?,?");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `text`, `image_id`, `advice`, `comment_id` FROM `questions` "
-            "WHERE `topic_id`=? LIMIT ?,?");
-        if (!db_stmt)
+        goto error;
+    }
+
+    if (!pddby_db_bind_int64(db_stmt, 1, section_id) ||
+        !pddby_db_bind_int(db_stmt, 2, offset) ||
+        !pddby_db_bind_int(db_stmt, 3, count))
+    {
+        pddby_db_finalize(db_stmt);
+        goto error;
+    }
+
+    pddby_cursor_t* cursor = pddby_cursor_new_from_db(pddby, fields, sizeof(pddby_question_row_t), db_stmt,
+        &pddby_question_row_read_db);
+    if (!cursor)
+    {
+        goto error;
+    }
+    return cursor;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to open question cursor with section id = %lld", section_id);
+    return NULL;
+}
+
+static pddby_questions_t* pddby_questions_find_with_offset(pddby_t* pddby, int64_t topic_id, int offset, int count)
+{
+    if (pddby->pack)
+    {
+        size_t links_count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_topic_questions, topic_id, &links_count);
+        size_t const begin = (size_t)offset < links_count ? (size_t)offset : links_count;
+        size_t const end = count < 0 || (size_t)count > links_count - begin ? links_count : begin + count;
+        pddby_questions_t* questions = pddby_questions_new_from_pack(pddby, ids ? ids + begin : NULL, end - begin);
+        if (!questions)
         {
             goto error;
         }
+        return questions;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_QUESTIONS_BY_TOPIC);
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -337,10 +553,9 @@ static pddby_questions_t* pddby_questions_find_with_offset(pddby_t* pddby, int64
         int64_t id = pddby_db_column_int64(db_stmt, 0);
         char const* text = pddby_db_column_text(db_stmt, 1);
         int64_t image_id = pddby_db_column_int64(db_stmt, 2);
-        char const* advice = pddby_db_column_text(db_stmt, 3);
-        int64_t comment_id = pddby_db_column_int64(db_stmt, 4);
+        int64_t comment_id = pddby_db_column_int64(db_stmt, 3);
 
-        if (!pddby_array_add(questions, pddby_question_new_with_id(pddby, id, topic_id, text, image_id, advice, comment_id)))
+        if (!pddby_array_add(questions, pddby_question_new_with_id(pddby, id, topic_id, text, image_id, NULL, comment_id)))
         {
             ret = -1;
             break;
@@ -370,72 +585,822 @@ pddby_questions_t* pddby_questions_find_by_topic(pddby_t* pddby, int64_t topic_i
     return pddby_questions_find_with_offset(pddby, topic_id, 0, -1);
 }
 
-static void pddby_load_ticket_topics_distribution(pddby_t* pddby)
+// number of questions to take from each topic, as many entries as there are both topics and distribution values
+static int const* pddby_questions_ticket_distribution(pddby_t* pddby, pddby_topics_t const* topics, size_t* count)
 {
-    if (ticket_topics_distribution)
+    int const* distribution = pddby_settings_get_int_array(pddby, pddby_setting_ticket_topics_distribution, count);
+    if (!distribution)
     {
-        return;
+        pddby_report(pddby, pddby_message_type_error, "unable to get ticket topics distribution");
+        *count = 0;
+        return NULL;
     }
 
-    char *raw_ttd = pddby_settings_get(pddby, "ticket_topics_distribution");
-    char **ttd = pddby_string_split(pddby, raw_ttd, ":");
-    free(raw_ttd);
-
-    ticket_topics_distribution = malloc(pddby_stringv_length(ttd) * sizeof(int));
-
-    char **it = ttd;
-    size_t i = 0;
-    while (*it)
+    size_t const topic_count = topics ? pddby_array_size(topics) : 0;
+    if (*count != topic_count)
     {
-        ticket_topics_distribution[i] = atoi(*it);
-        it++;
-        i++;
+        pddby_report(pddby, pddby_message_type_warning, "ticket topics distribution has %zu value(s) for %zu topic(s)",
+            *count, topic_count);
+        if (*count > topic_count)
+        {
+            *count = topic_count;
+        }
     }
 
-    pddby_stringv_free(ttd);
+    return distribution;
 }
 
-pddby_questions_t* pddby_questions_find_by_ticket(pddby_t* pddby, int ticket_number)
+static pddby_questions_t* pddby_questions_compose_ticket(pddby_t* pddby, int ticket_number)
 {
-    pddby_load_ticket_topics_distribution(pddby);
+    pddby_questions_t* questions = NULL;
 
     pddby_topics_t* topics = pddby_topics_find_all(pddby);
-    pddby_questions_t* questions = pddby_questions_new(pddby);
-    for (size_t i = 0, size = pddby_array_size(topics); i < size; i++)
+    if (!topics)
+    {
+        goto error;
+    }
+
+    size_t distribution_count;
+    int const* distribution = pddby_questions_ticket_distribution(pddby, topics, &distribution_count);
+    if (!distribution)
+    {
+        goto error;
+    }
+
+    questions = pddby_questions_new(pddby);
+    if (!questions)
+    {
+        goto error;
+    }
+
+    for (size_t i = 0; i < distribution_count; i++)
     {
         pddby_topic_t const* topic = pddby_array_index(topics, i);
         int32_t count = pddby_topic_get_question_count(topic);
-        for (int j = 0; j < ticket_topics_distribution[i]; j++)
+        for (int j = 0; count && j < distribution[i]; j++)
         {
             pddby_questions_t* topic_questions = pddby_questions_find_with_offset(pddby, topic->id,
                 ((ticket_number - 1) * 10 + j) % count, 1);
-            pddby_array_add(questions, pddby_array_index(topic_questions, 0));
+            if (!topic_questions)
+            {
+                goto error;
+            }
+
+            pddby_question_t* question = pddby_array_size(topic_questions) ? pddby_array_index(topic_questions, 0) :
+                NULL;
             pddby_array_free(topic_questions, 0);
+            if (!question)
+            {
+                goto error;
+            }
+
+            if (!pddby_array_add(questions, question))
+            {
+                pddby_question_free(question);
+                goto error;
+            }
         }
     }
+
     pddby_topics_free(topics);
     return questions;
+
+error:
+    if (questions)
+    {
+        pddby_questions_free(questions);
+    }
+    if (topics)
+    {
+        pddby_topics_free(topics);
+    }
+    pddby_report(pddby, pddby_message_type_error, "unable to compose question objects for ticket number = %d",
+        ticket_number);
+    return NULL;
 }
 
-pddby_questions_t* pddby_questions_find_random(pddby_t* pddby)
+pddby_questions_t* pddby_questions_find_by_ticket(pddby_t* pddby, int ticket_number)
 {
-    pddby_load_ticket_topics_distribution(pddby);
+    if (pddby->pack)
+    {
+        return pddby_questions_compose_ticket(pddby, ticket_number);
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_QUESTIONS_BY_TICKET);
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
+    if (!pddby_db_reset(db_stmt) ||
+        !pddby_db_bind_int(db_stmt, 1, ticket_number))
+    {
+        goto error;
+    }
 
-    pddby_topics_t* topics = pddby_topics_find_all(pddby);
     pddby_questions_t* questions = pddby_questions_new(pddby);
-    for (size_t i = 0, size = pddby_array_size(topics); i < size; i++)
+    if (!questions)
     {
-        pddby_topic_t const* topic = pddby_array_index(topics, i);
-        int32_t count = pddby_topic_get_question_count(topic);
-        for (int j = 0; j < ticket_topics_distribution[i]; j++)
+        goto error;
+    }
+
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        int64_t id = pddby_db_column_int64(db_stmt, 0);
+        int64_t topic_id = pddby_db_column_int64(db_stmt, 1);
+        char const* text = pddby_db_column_text(db_stmt, 2);
+        int64_t image_id = pddby_db_column_int64(db_stmt, 3);
+        int64_t comment_id = pddby_db_column_int64(db_stmt, 4);
+
+        if (!pddby_array_add(questions, pddby_question_new_with_id(pddby, id, topic_id, text, image_id, NULL, comment_id)))
         {
-            pddby_questions_t* topic_questions = pddby_questions_find_with_offset(pddby, topic->id,
-                pddby_aux_random_int_range(0, count - 1), 1);
-            pddby_array_add(questions, pddby_array_index(topic_questions, 0));
-            pddby_array_free(topic_questions, 0);
+            ret = -1;
+            break;
         }
     }
-    pddby_topics_free(topics);
+
+    if (ret == -1)
+    {
+        pddby_questions_free(questions);
+        goto error;
+    }
+
+    if (!pddby_array_size(questions))
+    {
+        // ticket numbers past the ones laid out by decode, as well as caches decoded before tickets were, wrap around
+        pddby_questions_free(questions);
+        return pddby_questions_compose_ticket(pddby, ticket_number);
+    }
+
+    return questions;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to find question objects with ticket number = %d",
+        ticket_number);
+    return NULL;
+}
+
+// attempts to draw a paper unlike those already drawn before settling for a repeated one
+#define PDDBY_QUESTIONS_BATCH_ATTEMPTS 64
+
+// ids of questions random papers are drawn from, grouped by topic in ticket order; the same pool is shared by draws
+// of all threads until handle lets go of it, the last one to hold it frees it
+struct pddby_questions_pool
+{
+    int ref_count;
+
+    int64_t* ids;
+    size_t count;
+
+    // copied, settings it comes from go away along with database
+    int* distribution;
+    // topic_count + 1 entries, ids of i-th topic are in [topic_begin[i], topic_begin[i + 1])
+    size_t* topic_begin;
+    size_t topic_count;
+
+    size_t paper_size;
+};
+
+static void pddby_questions_pool_free(struct pddby_questions_pool* pool)
+{
+    if (pool->ids)
+    {
+        free(pool->ids);
+    }
+    if (pool->distribution)
+    {
+        free(pool->distribution);
+    }
+    if (pool->topic_begin)
+    {
+        free(pool->topic_begin);
+    }
+    free(pool);
+}
+
+// rows come ordered by topic id rather than by ticket topic order, so they are bucketed by topic index first
+static int pddby_questions_pool_read_db(pddby_t* pddby, struct pddby_questions_pool* pool, pddby_topics_t const* topics)
+{
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT `topic_id`, `id` FROM `questions` "
+        "ORDER BY `topic_id`, `id`");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    if (!pddby_db_reset(db_stmt))
+    {
+        return 0;
+    }
+
+    size_t* topic_indices = NULL;
+    size_t capacity = 0;
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        int64_t const topic_id = pddby_db_column_int64(db_stmt, 0);
+        size_t topic_index = 0;
+        while (topic_index < pool->topic_count &&
+            ((pddby_topic_t const*)pddby_array_index(topics, topic_index))->id != topic_id)
+        {
+            topic_index++;
+        }
+        if (topic_index == pool->topic_count)
+        {
+            continue;
+        }
+
+        if (pool->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 256;
+            int64_t* ids = realloc(pool->ids, capacity * sizeof(int64_t));
+            if (ids)
+            {
+                pool->ids = ids;
+            }
+            size_t* new_topic_indices = realloc(topic_indices, capacity * sizeof(size_t));
+            if (new_topic_indices)
+            {
+                topic_indices = new_topic_indices;
+            }
+            if (!ids || !new_topic_indices)
+            {
+                ret = -1;
+                break;
+            }
+        }
+
+        pool->ids[pool->count] = pddby_db_column_int64(db_stmt, 1);
+        topic_indices[pool->count] = topic_index;
+        pool->topic_begin[topic_index + 1]++;
+        pool->count++;
+    }
+
+    if (ret == 0)
+    {
+        for (size_t i = 0; i < pool->topic_count; i++)
+        {
+            pool->topic_begin[i + 1] += pool->topic_begin[i];
+        }
+
+        size_t* positions = malloc((pool->topic_count ? pool->topic_count : 1) * sizeof(size_t));
+        int64_t* ids = malloc((pool->count ? pool->count : 1) * sizeof(int64_t));
+        if (positions && ids)
+        {
+            memcpy(positions, pool->topic_begin, pool->topic_count * sizeof(size_t));
+            for (size_t i = 0; i < pool->count; i++)
+            {
+                ids[positions[topic_indices[i]]++] = pool->ids[i];
+            }
+            if (pool->ids)
+            {
+                free(pool->ids);
+            }
+            pool->ids = ids;
+        }
+        else
+        {
+            if (ids)
+            {
+                free(ids);
+            }
+            ret = -1;
+        }
+
+        if (positions)
+        {
+            free(positions);
+        }
+    }
+
+    if (topic_indices)
+    {
+        free(topic_indices);
+    }
+
+    return ret == 0;
+}
+
+static int pddby_questions_pool_read_pack(pddby_t* pddby, struct pddby_questions_pool* pool,
+    pddby_topics_t const* topics)
+{
+    for (size_t i = 0; i < pool->topic_count; i++)
+    {
+        pddby_topic_t const* topic = pddby_array_index(topics, i);
+        size_t links_count;
+        pddby_pack_links(pddby->pack, pddby_pack_link_topic_questions, topic->id, &links_count);
+        pool->topic_begin[i + 1] = pool->topic_begin[i] + links_count;
+    }
+
+    pool->count = pool->topic_begin[pool->topic_count];
+    pool->ids = malloc((pool->count ? pool->count : 1) * sizeof(int64_t));
+    if (!pool->ids)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < pool->topic_count; i++)
+    {
+        pddby_topic_t const* topic = pddby_array_index(topics, i);
+        size_t links_count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_topic_questions, topic->id,
+            &links_count);
+        for (size_t j = 0; j < links_count; j++)
+        {
+            pool->ids[pool->topic_begin[i] + j] = ids[j];
+        }
+    }
+
+    return 1;
+}
+
+static struct pddby_questions_pool* pddby_questions_pool_new(pddby_t* pddby)
+{
+    pddby_topics_t* topics = NULL;
+    int const* distribution;
+
+    struct pddby_questions_pool* pool = calloc(1, sizeof(struct pddby_questions_pool));
+    if (!pool)
+    {
+        goto error;
+    }
+
+    pool->ref_count = 1;
+
+    topics = pddby_topics_find_all(pddby);
+    if (!topics)
+    {
+        goto error;
+    }
+
+    distribution = pddby_questions_ticket_distribution(pddby, topics, &pool->topic_count);
+    pool->distribution = malloc((pool->topic_count ? pool->topic_count : 1) * sizeof(int));
+    pool->topic_begin = calloc(pool->topic_count + 1, sizeof(size_t));
+    if (!pool->distribution || !pool->topic_begin)
+    {
+        goto error;
+    }
+
+    if (pool->topic_count)
+    {
+        memcpy(pool->distribution, distribution, pool->topic_count * sizeof(int));
+    }
+
+    if (!(pddby->pack ? pddby_questions_pool_read_pack(pddby, pool, topics) :
+        pddby_questions_pool_read_db(pddby, pool, topics)))
+    {
+        goto error;
+    }
+
+    pddby_topics_free(topics);
+
+    for (size_t i = 0; i < pool->topic_count; i++)
+    {
+        size_t const topic_size = pool->topic_begin[i + 1] - pool->topic_begin[i];
+        pool->paper_size += (size_t)pool->distribution[i] < topic_size ? (size_t)pool->distribution[i] : topic_size;
+    }
+
+    return pool;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to read question ids to draw random papers from");
+    if (topics)
+    {
+        pddby_topics_free(topics);
+    }
+    if (pool)
+    {
+        pddby_questions_pool_free(pool);
+    }
+    return NULL;
+}
+
+// pool is read on first draw after handle let go of the previous one
+static struct pddby_questions_pool* pddby_questions_pool_acquire(pddby_t* pddby)
+{
+    pthread_mutex_lock(&pddby->random_mutex);
+    if (!pddby->questions_pool)
+    {
+        pddby->questions_pool = pddby_questions_pool_new(pddby);
+    }
+    struct pddby_questions_pool* pool = pddby->questions_pool;
+    if (pool)
+    {
+        pool->ref_count++;
+    }
+    pthread_mutex_unlock(&pddby->random_mutex);
+
+    return pool;
+}
+
+static void pddby_questions_pool_release(pddby_t* pddby, struct pddby_questions_pool* pool)
+{
+    pthread_mutex_lock(&pddby->random_mutex);
+    int const is_last = --pool->ref_count == 0;
+    pthread_mutex_unlock(&pddby->random_mutex);
+
+    if (is_last)
+    {
+        pddby_questions_pool_free(pool);
+    }
+}
+
+void pddby_questions_pool_invalidate(pddby_t* pddby)
+{
+    pthread_mutex_lock(&pddby->random_mutex);
+    struct pddby_questions_pool* pool = pddby->questions_pool;
+    pddby->questions_pool = NULL;
+    pthread_mutex_unlock(&pddby->random_mutex);
+
+    if (pool)
+    {
+        pddby_questions_pool_release(pddby, pool);
+    }
+}
+
+// partial shuffle of each topic's part of order, caller's own copy of pool indices; questions within a paper never
+// repeat, paper gets pool indices in ticket order
+static void pddby_questions_pool_draw(struct pddby_questions_pool const* pool, size_t* order, pddby_random_t* random,
+    size_t* paper)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < pool->topic_count; i++)
+    {
+        size_t* topic_order = order + pool->topic_begin[i];
+        size_t const topic_size = pool->topic_begin[i + 1] - pool->topic_begin[i];
+        size_t const take = (size_t)pool->distribution[i] < topic_size ? (size_t)pool->distribution[i] : topic_size;
+        for (size_t j = 0; j < take; j++)
+        {
+            size_t const k = j + pddby_random_below(random, topic_size - j);
+            size_t const index = topic_order[k];
+            topic_order[k] = topic_order[j];
+            topic_order[j] = index;
+            paper[n++] = index;
+        }
+    }
+}
+
+static int pddby_questions_compare_index(void const* a, void const* b)
+{
+    size_t const lhs = *(size_t const*)a;
+    size_t const rhs = *(size_t const*)b;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static uint64_t pddby_questions_paper_hash(size_t const* paper, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ paper[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// scratch state of one batch; questions are loaded once however many papers they are in, the first paper takes
+// loaded object and only the rest get copies of it
+struct pddby_questions_batch
+{
+    size_t count;
+    size_t paper_size;
+
+    // pool indices of drawn papers in ticket order, followed by their sorted copies
+    size_t* papers;
+    uint64_t* hashes;
+    // open addressing set of sorted papers keyed by their hashes, holds paper number + 1, power of two size
+    size_t* paper_set;
+    size_t paper_set_size;
+
+    size_t* order;
+    // pool index to drawn question number, SIZE_MAX if it's not drawn
+    size_t* drawn_numbers;
+    int64_t* drawn_ids;
+    pddby_question_t** drawn_questions;
+    char* is_taken;
+    size_t drawn_count;
+};
+
+static int pddby_questions_batch_init(struct pddby_questions_batch* batch, struct pddby_questions_pool const* pool,
+    size_t count)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->count = count;
+    batch->paper_size = pool->paper_size;
+
+    batch->paper_set_size = 1;
+    while (batch->paper_set_size < count * 2)
+    {
+        batch->paper_set_size *= 2;
+    }
+
+    size_t const pool_count = pool->count ? pool->count : 1;
+    batch->papers = malloc((count * pool->paper_size * 2 + 1) * sizeof(size_t));
+    batch->hashes = malloc((count ? count : 1) * sizeof(uint64_t));
+    batch->paper_set = calloc(batch->paper_set_size, sizeof(size_t));
+    batch->order = malloc(pool_count * sizeof(size_t));
+    batch->drawn_numbers = malloc(pool_count * sizeof(size_t));
+    batch->drawn_ids = malloc(pool_count * sizeof(int64_t));
+    batch->drawn_questions = calloc(pool_count, sizeof(pddby_question_t*));
+    batch->is_taken = calloc(pool_count, sizeof(char));
+    if (!batch->papers || !batch->hashes || !batch->paper_set || !batch->order || !batch->drawn_numbers ||
+        !batch->drawn_ids || !batch->drawn_questions || !batch->is_taken)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < pool->count; i++)
+    {
+        batch->order[i] = i;
+        batch->drawn_numbers[i] = SIZE_MAX;
+    }
+
+    return 1;
+}
+
+static void pddby_questions_batch_free(struct pddby_questions_batch* batch)
+{
+    if (batch->drawn_questions)
+    {
+        for (size_t i = 0; i < batch->drawn_count; i++)
+        {
+            if (batch->drawn_questions[i] && !batch->is_taken[i])
+            {
+                pddby_question_free(batch->drawn_questions[i]);
+            }
+        }
+        free(batch->drawn_questions);
+    }
+    if (batch->is_taken)
+    {
+        free(batch->is_taken);
+    }
+    if (batch->drawn_ids)
+    {
+        free(batch->drawn_ids);
+    }
+    if (batch->drawn_numbers)
+    {
+        free(batch->drawn_numbers);
+    }
+    if (batch->order)
+    {
+        free(batch->order);
+    }
+    if (batch->paper_set)
+    {
+        free(batch->paper_set);
+    }
+    if (batch->hashes)
+    {
+        free(batch->hashes);
+    }
+    if (batch->papers)
+    {
+        free(batch->papers);
+    }
+}
+
+// 0 if the same set of questions was already drawn, in whatever order
+static int pddby_questions_batch_add_to_set(struct pddby_questions_batch* batch, size_t number)
+{
+    size_t const* sorted_papers = batch->papers + batch->count * batch->paper_size;
+    size_t const* sorted_paper = sorted_papers + number * batch->paper_size;
+    size_t const mask = batch->paper_set_size - 1;
+
+    size_t slot = (size_t)batch->hashes[number] & mask;
+    for (; batch->paper_set[slot]; slot = (slot + 1) & mask)
+    {
+        size_t const other = batch->paper_set[slot] - 1;
+        if (batch->hashes[other] == batch->hashes[number] &&
+            memcmp(sorted_papers + other * batch->paper_size, sorted_paper, batch->paper_size * sizeof(size_t)) == 0)
+        {
+            return 0;
+        }
+    }
+
+    batch->paper_set[slot] = number + 1;
+    return 1;
+}
+
+// questions of database are loaded by one query for the whole drawn set
+static int pddby_questions_batch_load(pddby_t* pddby, struct pddby_questions_batch* batch)
+{
+    if (pddby->pack)
+    {
+        for (size_t i = 0; i < batch->drawn_count; i++)
+        {
+            batch->drawn_questions[i] = pddby_question_new_from_pack(pddby, batch->drawn_ids[i]);
+            if (!batch->drawn_questions[i])
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_DB_IDS_CTE
+        "SELECT i.`position`, q.`topic_id`, q.`text`, q.`image_id`, q.`comment_id` FROM `ids` i INNER JOIN "
+        "`questions` q ON q.`id`=i.`id`");
+    if (!db_stmt)
+    {
+        return 0;
+    }
+
+    char* ids = pddby_db_join_ids(batch->drawn_ids, batch->drawn_count);
+    if (!ids)
+    {
+        return 0;
+    }
+
+    int ret = -1;
+    if (pddby_db_reset(db_stmt) &&
+        pddby_db_bind_text(db_stmt, 1, ids))
+    {
+        while ((ret = pddby_db_step(db_stmt)) == 1)
+        {
+            int64_t const position = pddby_db_column_int64(db_stmt, 0);
+            if (position < 0 || (uint64_t)position >= batch->drawn_count || batch->drawn_questions[position])
+            {
+                ret = -1;
+                break;
+            }
+
+            batch->drawn_questions[position] = pddby_question_new_with_id(pddby, batch->drawn_ids[position],
+                pddby_db_column_int64(db_stmt, 1), pddby_db_column_text(db_stmt, 2),
+                pddby_db_column_int64(db_stmt, 3), NULL, pddby_db_column_int64(db_stmt, 4));
+            if (!batch->drawn_questions[position])
+            {
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    free(ids);
+
+    if (ret != 0)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < batch->drawn_count; i++)
+    {
+        if (!batch->drawn_questions[i])
+        {
+            pddby_report(pddby, pddby_message_type_error, "unable to find question object with id = %lld",
+                (long long)batch->drawn_ids[i]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static pddby_questions_t* pddby_questions_batch_make_paper(pddby_t* pddby, struct pddby_questions_batch* batch,
+    size_t number)
+{
+    pddby_questions_t* questions = pddby_questions_new(pddby);
+    if (!questions)
+    {
+        return NULL;
+    }
+
+    size_t const* paper = batch->papers + number * batch->paper_size;
+    for (size_t i = 0; i < batch->paper_size; i++)
+    {
+        size_t const drawn_number = batch->drawn_numbers[paper[i]];
+        pddby_question_t const* question = batch->drawn_questions[drawn_number];
+        if (!batch->is_taken[drawn_number])
+        {
+            if (!pddby_array_add(questions, batch->drawn_questions[drawn_number]))
+            {
+                pddby_questions_free(questions);
+                return NULL;
+            }
+            batch->is_taken[drawn_number] = 1;
+        }
+        else if (!pddby_array_add(questions, pddby_question_new_with_id(pddby, question->id, question->topic_id,
+            question->text, question->image_id, NULL, question->comment_id)))
+        {
+            pddby_questions_free(questions);
+            return NULL;
+        }
+    }
+
+    return questions;
+}
+
+pddby_array_t* pddby_questions_generate_random_batch(pddby_t* pddby, size_t count, uint64_t seed)
+{
+    struct pddby_questions_batch batch;
+    memset(&batch, 0, sizeof(batch));
+    pddby_array_t* result = NULL;
+
+    struct pddby_questions_pool* pool = pddby_questions_pool_acquire(pddby);
+    if (!pool)
+    {
+        goto error;
+    }
+
+    // papers, their sorted copies and set of them all have to fit
+    if (count > SIZE_MAX / (4 * sizeof(size_t)) / (pool->paper_size ? pool->paper_size : 1))
+    {
+        pddby_report(pddby, pddby_message_type_error, "%zu random papers of %zu question(s) are too many", count,
+            pool->paper_size);
+        goto error;
+    }
+
+    result = pddby_array_new(pddby, (pddby_array_free_func_t)pddby_questions_free);
+    if (!result || !pddby_questions_batch_init(&batch, pool, count))
+    {
+        goto error;
+    }
+
+    pddby_random_t random;
+    pddby_random_init(&random, seed);
+
+    size_t const paper_size = batch.paper_size;
+    size_t repeated_count = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t* paper = batch.papers + i * paper_size;
+        size_t* sorted_paper = batch.papers + (count + i) * paper_size;
+        int is_repeated = 1;
+        for (int attempt = 0; is_repeated && attempt < PDDBY_QUESTIONS_BATCH_ATTEMPTS; attempt++)
+        {
+            pddby_questions_pool_draw(pool, batch.order, &random, paper);
+            memcpy(sorted_paper, paper, paper_size * sizeof(size_t));
+            qsort(sorted_paper, paper_size, sizeof(size_t), &pddby_questions_compare_index);
+            batch.hashes[i] = pddby_questions_paper_hash(sorted_paper, paper_size);
+            is_repeated = !pddby_questions_batch_add_to_set(&batch, i);
+        }
+        repeated_count += is_repeated;
+
+        for (size_t j = 0; j < paper_size; j++)
+        {
+            if (batch.drawn_numbers[paper[j]] == SIZE_MAX)
+            {
+                batch.drawn_numbers[paper[j]] = batch.drawn_count;
+                batch.drawn_ids[batch.drawn_count++] = pool->ids[paper[j]];
+            }
+        }
+    }
+
+    pddby_questions_pool_release(pddby, pool);
+    pool = NULL;
+
+    if (!pddby_questions_batch_load(pddby, &batch))
+    {
+        goto error;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!pddby_array_add(result, pddby_questions_batch_make_paper(pddby, &batch, i)))
+        {
+            goto error;
+        }
+    }
+
+    if (repeated_count)
+    {
+        pddby_report(pddby, pddby_message_type_warning, "%zu of %zu random paper(s) repeat others, there are not "
+            "enough questions to draw them all different", repeated_count, count);
+    }
+
+    pddby_questions_batch_free(&batch);
+    return result;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to generate %zu random paper(s)", count);
+    if (result)
+    {
+        pddby_array_free(result, 1);
+    }
+    pddby_questions_batch_free(&batch);
+    if (pool)
+    {
+        pddby_questions_pool_release(pddby, pool);
+    }
+    return NULL;
+}
+
+pddby_questions_t* pddby_questions_find_random(pddby_t* pddby)
+{
+    // handle's generator only hands out seeds, so that drawing itself doesn't keep other threads waiting
+    pthread_mutex_lock(&pddby->random_mutex);
+    uint64_t const seed = pddby_random_next64(&pddby->random);
+    pthread_mutex_unlock(&pddby->random_mutex);
+
+    pddby_array_t* papers = pddby_questions_generate_random_batch(pddby, 1, seed);
+    if (!papers)
+    {
+        return NULL;
+    }
+
+    pddby_questions_t* questions = pddby_array_index(papers, 0);
+    pddby_array_free(papers, 0);
     return questions;
 }
 
@@ -7,10 +7,12 @@ extern "C"
 #endif
 
 #include "array.h"
+#include "cursor.h"
 #include "pddby.h"
 #include "section.h"
 #include "traffreg.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 struct pddby_question
@@ -28,12 +30,27 @@ struct pddby_question
 typedef struct pddby_question pddby_question_t;
 typedef pddby_array_t pddby_questions_t;
 
+// borrowed view of question, see pddby_cursor_next
+struct pddby_question_row
+{
+    int64_t id;
+    int64_t topic_id;
+    char const* text;
+    int64_t image_id;
+    int64_t comment_id;
+};
+
+typedef struct pddby_question_row pddby_question_row_t;
+
 pddby_question_t* pddby_question_new(pddby_t* pddby, int64_t topic_id, char const* text, int64_t image_id, char const* advice,
     int64_t comment_id);
 void pddby_question_free(pddby_question_t* question);
 
 int pddby_question_save(pddby_question_t* question);
 
+// advice is rarely needed and is only loaded on first request
+char const* pddby_question_get_advice(pddby_question_t* question);
+
 int pddby_question_set_sections(pddby_question_t* question, pddby_sections_t* sections);
 int pddby_question_set_traffregs(pddby_question_t* question, pddby_traffregs_t* traffregs);
 
@@ -41,9 +58,15 @@ pddby_question_t* pddby_question_find_by_id(pddby_t* pddby, int64_t id);
 
 pddby_questions_t* pddby_questions_new(pddby_t* pddby);
 pddby_questions_t* pddby_questions_find_by_section(pddby_t* pddby, int64_t section_id);
+// yields pddby_question_row_t rows ordered by id, count of -1 means all the rest
+pddby_cursor_t* pddby_questions_cursor_by_section(pddby_t* pddby, int64_t section_id, int fields, int offset,
+    int count);
 pddby_questions_t* pddby_questions_find_by_topic(pddby_t* pddby, int64_t topic_id, int ticket_number);
 pddby_questions_t* pddby_questions_find_by_ticket(pddby_t* pddby, int ticket_number);
 pddby_questions_t* pddby_questions_find_random(pddby_t* pddby);
+// array of count pddby_questions_t papers composed like random ticket and differing from each other while there are
+// enough questions to tell them apart; same seed over same cache always gives same papers
+pddby_array_t* pddby_questions_generate_random_batch(pddby_t* pddby, size_t count, uint64_t seed);
 void pddby_questions_free(pddby_questions_t* questions);
 
 #ifdef __cplusplus
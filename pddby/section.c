@@ -1,9 +1,14 @@
 #include "section.h"
 
 #include "config.h"
+#include "private/pddby.h"
+#include "private/queries.h"
 #include "private/util/database.h"
+#include "private/util/identity.h"
+#include "private/util/pack.h"
 #include "private/util/report.h"
 #include "question.h"
+#include "stats.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -13,10 +18,27 @@
 #include <dmalloc.h>
 #endif
 
+static void pddby_section_dispose(pddby_section_t* section)
+{
+    if (section->name)
+    {
+        free(section->name);
+    }
+    if (section->title_prefix)
+    {
+        free(section->title_prefix);
+    }
+    if (section->title)
+    {
+        free(section->title);
+    }
+}
+
 static pddby_section_t* pddby_section_new_with_id(pddby_t* pddby, int64_t id, char const* name, char const* title_prefix,
     char const* title)
 {
-    pddby_section_t* section = calloc(1, sizeof(pddby_section_t));
+    pddby_section_t* section = pddby_identity_new(pddby, pddby_identity_section, sizeof(pddby_section_t),
+        (pddby_identity_dispose_func_t)&pddby_section_dispose);
     if (!section)
     {
         goto error;
@@ -47,45 +69,72 @@ static pddby_section_t* pddby_section_new_with_id(pddby_t* pddby, int64_t id, ch
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to create section object");
+    if (section)
+    {
+        pddby_identity_release(pddby, section);
+    }
     return NULL;
 }
 
+// row is only turned into object if it's not mapped yet
+static pddby_section_t* pddby_section_new_shared(pddby_t* pddby, int64_t id, char const* name, char const* title_prefix,
+    char const* title)
+{
+    pddby_section_t* section = pddby_identity_find(pddby, pddby_identity_section, id);
+    if (section)
+    {
+        return section;
+    }
+
+    section = pddby_section_new_with_id(pddby, id, name, title_prefix, title);
+    return section ? pddby_identity_add(pddby, pddby_identity_section, id, section) : NULL;
+}
+
+static pddby_section_t* pddby_section_new_from_pack(pddby_t* pddby, int64_t id)
+{
+    struct pddby_pack_section const* section = pddby_pack_record(pddby->pack, pddby_pack_sections, id);
+    if (!section)
+    {
+        return NULL;
+    }
+
+    return pddby_section_new_shared(pddby, id, pddby_pack_string(pddby->pack, section->name),
+        pddby_pack_string(pddby->pack, section->title_prefix), pddby_pack_string(pddby->pack, section->title));
+}
+
 pddby_section_t* pddby_section_new(pddby_t* pddby, char const* name, char const* title_prefix, char const* title)
 {
     return pddby_section_new_with_id(pddby, 0, name, title_prefix, title);
 }
 
-void pddby_section_free(pddby_section_t* section)
+pddby_section_t* pddby_section_retain(pddby_section_t* section)
 {
     assert(section);
 
-    if (section->name)
-    {
-        free(section->name);
-    }
-    if (section->title_prefix)
-    {
-        free(section->title_prefix);
-    }
-    if (section->title)
-    {
-        free(section->title);
-    }
-    free(section);
+    return pddby_identity_retain(section->pddby, section);
+}
+
+void pddby_section_release(pddby_section_t* section)
+{
+    assert(section);
+
+    pddby_identity_release(section->pddby, section);
+}
+
+void pddby_section_free(pddby_section_t* section)
+{
+    pddby_section_release(section);
 }
 
 int pddby_section_save(pddby_section_t* section)
 {
     assert(section);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(section->pddby, "INSERT INTO `sections` (`name`, "
+        "`title_prefix`, `title`) VALUES (?, ?, ?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(section->pddby, "INSERT INTO `sections` (`name`, `title_prefix`, `title`) VALUES (?, ?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -115,14 +164,22 @@ error:
 
 pddby_section_t* pddby_section_find_by_id(pddby_t* pddby, int64_t id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_section_t* section = pddby_identity_find(pddby, pddby_identity_section, id);
+    if (section)
+    {
+        return section;
+    }
+
+    if (pddby->pack)
+    {
+        return pddby_section_new_from_pack(pddby, id);
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT `name`, `title_prefix`, `title` FROM `sections` "
+        "WHERE `id`=? LIMIT 1");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `name`, `title_prefix`, `title` FROM `sections` WHERE `rowid`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -143,7 +200,7 @@ pddby_section_t* pddby_section_find_by_id(pddby_t* pddby, int64_t id)
     char const* title_prefix = pddby_db_column_text(db_stmt, 1);
     char const* title = pddby_db_column_text(db_stmt, 2);
 
-    return pddby_section_new_with_id(pddby, id, name, title_prefix, title);
+    return pddby_section_new_shared(pddby, id, name, title_prefix, title);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to vind section object with id = %lld", id);
@@ -154,14 +211,24 @@ pddby_section_t* pddby_section_find_by_name(pddby_t* pddby, char const* name)
 {
     assert(name);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    if (pddby->pack)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `title_prefix`, `title` FROM `sections` WHERE `name`=? LIMIT 1");
-        if (!db_stmt)
+        for (size_t id = 1, count = pddby_pack_count(pddby->pack, pddby_pack_sections); id <= count; id++)
         {
-            goto error;
+            struct pddby_pack_section const* section = pddby_pack_record(pddby->pack, pddby_pack_sections, id);
+            char const* section_name = pddby_pack_string(pddby->pack, section->name);
+            if (section_name && strcmp(section_name, name) == 0)
+            {
+                return pddby_section_new_from_pack(pddby, id);
+            }
         }
+        return NULL;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_SECTION_BY_NAME);
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -182,7 +249,7 @@ pddby_section_t* pddby_section_find_by_name(pddby_t* pddby, char const* name)
     char const* title_prefix = pddby_db_column_text(db_stmt, 1);
     char const* title = pddby_db_column_text(db_stmt, 2);
 
-    return pddby_section_new_with_id(pddby, id, name, title_prefix, title);
+    return pddby_section_new_shared(pddby, id, name, title_prefix, title);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find section object with name = \"%s\"", name);
@@ -196,14 +263,31 @@ pddby_sections_t* pddby_sections_new(pddby_t* pddby)
 
 pddby_sections_t* pddby_sections_find_all(pddby_t* pddby)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    if (pddby->pack)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `name`, `title_prefix`, `title` FROM `sections`");
-        if (!db_stmt)
+        pddby_sections_t* sections = pddby_sections_new(pddby);
+        if (!sections)
         {
             goto error;
         }
+
+        for (size_t id = 1, count = pddby_pack_count(pddby->pack, pddby_pack_sections); id <= count; id++)
+        {
+            if (!pddby_array_add(sections, pddby_section_new_from_pack(pddby, id)))
+            {
+                pddby_sections_free(sections);
+                goto error;
+            }
+        }
+
+        return sections;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT `id`, `name`, `title_prefix`, `title` FROM "
+        "`sections`");
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt))
@@ -225,7 +309,7 @@ pddby_sections_t* pddby_sections_find_all(pddby_t* pddby)
         char const* title_prefix = pddby_db_column_text(db_stmt, 2);
         char const* title = pddby_db_column_text(db_stmt, 3);
 
-        if (!pddby_array_add(sections, pddby_section_new_with_id(pddby, id, name, title_prefix, title)))
+        if (!pddby_array_add(sections, pddby_section_new_shared(pddby, id, name, title_prefix, title)))
         {
             ret = -1;
             break;
@@ -256,28 +340,34 @@ size_t pddby_section_get_question_count(pddby_section_t* section)
 {
     assert(section);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    if (section->pddby->pack)
+    {
+        size_t count;
+        pddby_pack_links(section->pddby->pack, pddby_pack_link_section_questions, section->id, &count);
+        return count;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(section->pddby, "SELECT `question_count` FROM `stats` WHERE "
+        "`kind`=? AND `owner_id`=?");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(section->pddby, "SELECT COUNT(*) FROM `questions_sections` WHERE `section_id`=?");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
-        !pddby_db_bind_int64(db_stmt, 1, section->id))
+        !pddby_db_bind_int(db_stmt, 1, pddby_stat_kind_section) ||
+        !pddby_db_bind_int64(db_stmt, 2, section->id))
     {
         goto error;
     }
 
-    if (pddby_db_step(db_stmt) != 1)
+    int ret = pddby_db_step(db_stmt);
+    if (ret == -1)
     {
         goto error;
     }
 
-    return pddby_db_column_int(db_stmt, 0);
+    return ret == 1 ? pddby_db_column_int(db_stmt, 0) : 0;
 
 error:
     pddby_report(section->pddby, pddby_message_type_error, "unable to get questions count of section object");
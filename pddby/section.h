@@ -25,6 +25,9 @@ typedef struct pddby_section pddby_section_t;
 typedef pddby_array_t pddby_sections_t;
 
 pddby_section_t* pddby_section_new(pddby_t* pddby, char const* name, char const* title_prefix, char const* title);
+pddby_section_t* pddby_section_retain(pddby_section_t* section);
+void pddby_section_release(pddby_section_t* section);
+// same as pddby_section_release
 void pddby_section_free(pddby_section_t* section);
 
 int pddby_section_save(pddby_section_t* section);
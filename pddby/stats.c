@@ -0,0 +1,168 @@
+#include "stats.h"
+
+#include "config.h"
+#include "private/pddby.h"
+#include "private/util/database.h"
+#include "private/util/pack.h"
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+static pddby_stats_t* pddby_stats_new(pddby_t* pddby)
+{
+    return pddby_array_new(pddby, &free);
+}
+
+// packs don't carry statistics, they are counted from links instead
+static pddby_stat_t* pddby_stat_new_from_pack(pddby_t* pddby, int kind, int64_t owner_id)
+{
+    pddby_stat_t* stat = calloc(1, sizeof(pddby_stat_t));
+    if (!stat)
+    {
+        return NULL;
+    }
+
+    stat->kind = kind;
+    stat->owner_id = owner_id;
+
+    size_t count;
+    uint32_t const* ids = pddby_pack_links(pddby->pack, kind == pddby_stat_kind_section ?
+        pddby_pack_link_section_questions : pddby_pack_link_topic_questions, owner_id, &count);
+    for (size_t i = 0; i < count; i++)
+    {
+        struct pddby_pack_question const* question = pddby_pack_record(pddby->pack, pddby_pack_questions, ids[i]);
+        if (!question)
+        {
+            continue;
+        }
+
+        size_t traffregs_count;
+        pddby_pack_links(pddby->pack, pddby_pack_link_question_traffregs, ids[i], &traffregs_count);
+
+        stat->question_count++;
+        stat->image_question_count += question->image_id ? 1 : 0;
+        stat->traffreg_question_count += traffregs_count ? 1 : 0;
+        stat->comment_question_count += question->comment_id ? 1 : 0;
+    }
+
+    stat->ticket_count = (stat->question_count + 9) / 10;
+
+    return stat;
+}
+
+pddby_stats_t* pddby_stats_find_all(pddby_t* pddby)
+{
+    if (pddby->pack)
+    {
+        pddby_stats_t* stats = pddby_stats_new(pddby);
+        if (!stats)
+        {
+            goto error;
+        }
+
+        for (size_t id = 1, count = pddby_pack_count(pddby->pack, pddby_pack_sections); id <= count; id++)
+        {
+            if (!pddby_array_add(stats, pddby_stat_new_from_pack(pddby, pddby_stat_kind_section, id)))
+            {
+                pddby_stats_free(stats);
+                goto error;
+            }
+        }
+
+        for (size_t id = 1, count = pddby_pack_count(pddby->pack, pddby_pack_topics); id <= count; id++)
+        {
+            if (!pddby_array_add(stats, pddby_stat_new_from_pack(pddby, pddby_stat_kind_topic, id)))
+            {
+                pddby_stats_free(stats);
+                goto error;
+            }
+        }
+
+        return stats;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT `kind`, `owner_id`, `question_count`, "
+        "`ticket_count`, `image_question_count`, `traffreg_question_count`, `comment_question_count` FROM `stats`");
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
+    if (!pddby_db_reset(db_stmt))
+    {
+        goto error;
+    }
+
+    pddby_stats_t* stats = pddby_stats_new(pddby);
+    if (!stats)
+    {
+        goto error;
+    }
+
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        pddby_stat_t* stat = malloc(sizeof(pddby_stat_t));
+        if (!stat)
+        {
+            ret = -1;
+            break;
+        }
+
+        stat->kind = pddby_db_column_int(db_stmt, 0);
+        stat->owner_id = pddby_db_column_int64(db_stmt, 1);
+        stat->question_count = pddby_db_column_int(db_stmt, 2);
+        stat->ticket_count = pddby_db_column_int(db_stmt, 3);
+        stat->image_question_count = pddby_db_column_int(db_stmt, 4);
+        stat->traffreg_question_count = pddby_db_column_int(db_stmt, 5);
+        stat->comment_question_count = pddby_db_column_int(db_stmt, 6);
+
+        if (!pddby_array_add(stats, stat))
+        {
+            free(stat);
+            ret = -1;
+            break;
+        }
+    }
+
+    if (ret == -1)
+    {
+        pddby_stats_free(stats);
+        goto error;
+    }
+
+    return stats;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to find all stat objects");
+    return NULL;
+}
+
+void pddby_stats_free(pddby_stats_t* stats)
+{
+    assert(stats);
+
+    pddby_array_free(stats, 1);
+}
+
+pddby_stat_t const* pddby_stats_find(pddby_stats_t const* stats, int kind, int64_t owner_id)
+{
+    assert(stats);
+
+    for (size_t i = 0, size = pddby_array_size(stats); i < size; i++)
+    {
+        pddby_stat_t const* stat = pddby_array_index(stats, i);
+        if (stat->kind == kind && stat->owner_id == owner_id)
+        {
+            return stat;
+        }
+    }
+
+    return NULL;
+}
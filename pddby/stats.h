@@ -0,0 +1,47 @@
+#ifndef PDDBY_STATS_H
+#define PDDBY_STATS_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "array.h"
+#include "pddby.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// stored in cache, never renumber
+enum pddby_stat_kind
+{
+    pddby_stat_kind_section = 0,
+    pddby_stat_kind_topic = 1
+};
+
+struct pddby_stat
+{
+    int kind;
+    // section or topic id, depending on kind
+    int64_t owner_id;
+
+    size_t question_count;
+    size_t ticket_count;
+    size_t image_question_count;
+    size_t traffreg_question_count;
+    size_t comment_question_count;
+};
+
+typedef struct pddby_stat pddby_stat_t;
+typedef pddby_array_t pddby_stats_t;
+
+pddby_stats_t* pddby_stats_find_all(pddby_t* pddby);
+void pddby_stats_free(pddby_stats_t* stats);
+
+pddby_stat_t const* pddby_stats_find(pddby_stats_t const* stats, int kind, int64_t owner_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PDDBY_STATS_H
@@ -0,0 +1,147 @@
+#include "pddby.h"
+#include "private/util/report.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PDDBY_LOG_TEST_THREADS 4
+#define PDDBY_LOG_TEST_MESSAGES 20000
+// small enough for producers to overrun consumer now and then
+#define PDDBY_LOG_TEST_BUFFER_SIZE 64
+
+struct pddby_log_test_state
+{
+    // index of last message delivered from each producer
+    int last_index[PDDBY_LOG_TEST_THREADS];
+    long delivered_count;
+    long dropped_count;
+    int failed;
+};
+
+struct pddby_log_test_thread
+{
+    pthread_t thread;
+    pddby_t* pddby;
+    int number;
+};
+
+static struct pddby_log_test_state s_state;
+
+static void on_message(pddby_t* pddby, int type, char const* text)
+{
+    (void)pddby;
+
+    unsigned long dropped_count;
+    int number;
+    int index;
+    if (type == pddby_message_type_warning && sscanf(text, "%lu log messages dropped", &dropped_count) == 1)
+    {
+        s_state.dropped_count += dropped_count;
+    }
+    else if (type == pddby_message_type_log && sscanf(text, "thread %d message %d", &number, &index) == 2 &&
+        number >= 0 && number < PDDBY_LOG_TEST_THREADS && index > s_state.last_index[number])
+    {
+        // messages of one producer may be dropped but never duplicated or reordered
+        s_state.last_index[number] = index;
+        s_state.delivered_count++;
+    }
+    else
+    {
+        fprintf(stderr, "unexpected message \"%s\" of type %d\n", text, type);
+        s_state.failed = 1;
+    }
+}
+
+static void* pddby_log_test_thread_main(void* arg)
+{
+    struct pddby_log_test_thread* thread = arg;
+
+    for (int i = 0; i < PDDBY_LOG_TEST_MESSAGES; i++)
+    {
+        pddby_report(thread->pddby, pddby_message_type_log, "thread %d message %d", thread->number, i);
+        // filtered out before reaching buffer
+        pddby_report(thread->pddby, pddby_message_type_debug, "thread %d filtered message %d", thread->number, i);
+        // give consumer a chance on machines with fewer cores than there are threads
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+int main()
+{
+    for (int i = 0; i < PDDBY_LOG_TEST_THREADS; i++)
+    {
+        s_state.last_index[i] = -1;
+    }
+
+    pddby_callbacks_t callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.message = &on_message;
+
+    pddby_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.cache_dir = ".";
+    options.callbacks = &callbacks;
+    options.log_level = pddby_message_type_log;
+    options.log_buffer_size = PDDBY_LOG_TEST_BUFFER_SIZE;
+
+    pddby_t* pddby = pddby_init_with_options(&options);
+    if (!pddby)
+    {
+        fprintf(stderr, "unable to init library\n");
+        return 1;
+    }
+
+    struct pddby_log_test_thread threads[PDDBY_LOG_TEST_THREADS];
+    int started_count = 0;
+    for (; started_count < PDDBY_LOG_TEST_THREADS; started_count++)
+    {
+        threads[started_count].pddby = pddby;
+        threads[started_count].number = started_count;
+        if (pthread_create(&threads[started_count].thread, NULL, &pddby_log_test_thread_main,
+            &threads[started_count]) != 0)
+        {
+            fprintf(stderr, "unable to start producer thread\n");
+            s_state.failed = 1;
+            break;
+        }
+    }
+
+    // drain while producers are still pushing, then whatever is left once they are done
+    while (s_state.delivered_count + s_state.dropped_count < (long)started_count * PDDBY_LOG_TEST_MESSAGES / 2)
+    {
+        pddby_drain_messages(pddby, PDDBY_LOG_TEST_BUFFER_SIZE / 2);
+    }
+
+    for (int i = 0; i < started_count; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+    }
+
+    pddby_drain_messages(pddby, 0);
+
+    long const pushed_count = (long)started_count * PDDBY_LOG_TEST_MESSAGES;
+    if (s_state.delivered_count + s_state.dropped_count != pushed_count)
+    {
+        fprintf(stderr, "%ld message(s) delivered and %ld dropped out of %ld\n", s_state.delivered_count,
+            s_state.dropped_count, pushed_count);
+        s_state.failed = 1;
+    }
+
+    // buffer is empty again, so nothing more is dropped
+    pddby_report(pddby, pddby_message_type_log, "thread 0 message %d", PDDBY_LOG_TEST_MESSAGES);
+    if (pddby_drain_messages(pddby, 0) != 1 || s_state.last_index[0] != PDDBY_LOG_TEST_MESSAGES)
+    {
+        fprintf(stderr, "message pushed into drained buffer is not delivered\n");
+        s_state.failed = 1;
+    }
+
+    pddby_close(pddby);
+
+    printf("%ld message(s) delivered, %ld dropped\n", s_state.delivered_count, s_state.dropped_count);
+    return s_state.failed ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+#include "pddby.h"
+#include "private/util/database.h"
+#include "private/util/database_sql.h"
+
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// cache as written before schema was versioned, with a few rows for migrations to carry over
+static char const s_v1_sql[] =
+    "CREATE TABLE `settings` (`key` TEXT, `value` TEXT);"
+    "CREATE TABLE `images` (`name` TEXT, `data` BLOB);"
+    "CREATE TABLE `comments` (`number` INT, `text` TEXT);"
+    "CREATE TABLE `traffregs` (`number` INT, `text` TEXT);"
+    "CREATE TABLE `images_traffregs` (`image_id` INT, `traffreg_id` INT);"
+    "CREATE TABLE `sections` (`name` TEXT, `title_prefix` TEXT, `title` TEXT);"
+    "CREATE TABLE `topics` (`number` TEXT, `title` TEXT);"
+    "CREATE TABLE `questions` (`topic_id` INT, `text` TEXT, `image_id` INT, `advice` TEXT, `comment_id` INT);"
+    "CREATE TABLE `questions_sections` (`question_id` INT, `section_id`);"
+    "CREATE TABLE `questions_traffregs` (`question_id` INT, `traffreg_id`);"
+    "CREATE TABLE `answers` (`question_id` INT, `text` TEXT, `is_correct` INT);"
+    "INSERT INTO `settings` VALUES ('ticket_topics_distribution', '1:1');"
+    "INSERT INTO `sections` VALUES ('1', 'Section 1', 'First section');"
+    "INSERT INTO `topics` VALUES ('1', 'First topic');"
+    "INSERT INTO `topics` VALUES ('2', 'Second topic');"
+    "INSERT INTO `images` VALUES ('1.jpg', x'ffd8ffe0');"
+    "INSERT INTO `comments` VALUES (1, 'Comment');"
+    "INSERT INTO `traffregs` VALUES (10, 'Rule');"
+    "INSERT INTO `images_traffregs` VALUES (1, 1);"
+    "INSERT INTO `questions` VALUES (1, 'First question', 1, 'Advice', 1);"
+    "INSERT INTO `questions` VALUES (2, 'Second question', 0, NULL, 0);"
+    "INSERT INTO `questions_sections` VALUES (1, 1);"
+    "INSERT INTO `questions_traffregs` VALUES (1, 1);"
+    "INSERT INTO `answers` VALUES (1, 'Yes', 1);"
+    "INSERT INTO `answers` VALUES (1, 'No', 0);"
+    "INSERT INTO `answers` VALUES (2, 'Maybe', 1);";
+
+// one row per column, index and view or trigger, in an order that doesn't depend on how schema came to be
+static char const* const s_schema_queries[] =
+{
+    "SELECT m.`name`, m.`sql` LIKE '%WITHOUT ROWID%', c.`name`, c.`type`, c.`notnull`, c.`dflt_value`, c.`pk` "
+        "FROM `sqlite_master` m, pragma_table_info(m.`name`) c WHERE m.`type`='table' AND m.`name` NOT LIKE "
+        "'sqlite_%' ORDER BY m.`name`, c.`cid`",
+    "SELECT m.`name`, l.`name`, l.`unique`, l.`origin`, l.`partial`, (SELECT group_concat(`name`) FROM (SELECT "
+        "`name` FROM pragma_index_info(l.`name`) ORDER BY `seqno`)) FROM `sqlite_master` m, "
+        "pragma_index_list(m.`name`) l WHERE m.`type`='table' AND m.`name` NOT LIKE 'sqlite_%' ORDER BY m.`name`, "
+        "l.`name`",
+    "SELECT `type`, `name`, `tbl_name` FROM `sqlite_master` WHERE `type` IN ('view', 'trigger') ORDER BY `type`, "
+        "`name`",
+    NULL
+};
+
+// rows the migrated cache has to end up with
+static struct
+{
+    char const* sql;
+    int count;
+} const s_row_counts[] =
+{
+    {"SELECT count(*) FROM `topics`", 2},
+    {"SELECT count(*) FROM `questions` WHERE `topic_id`=1", 1},
+    {"SELECT count(*) FROM `answers`", 3},
+    {"SELECT count(*) FROM `questions_traffregs`", 1},
+    {"SELECT count(*) FROM `images_traffregs`", 1},
+    {NULL, 0}
+};
+
+static char const* const s_cache_files[] =
+{
+    "pddby.sqlite",
+    "pddby.sqlite-wal",
+    "pddby.sqlite-shm",
+    NULL
+};
+
+static void on_message(pddby_t* pddby, int type, char const* text)
+{
+    (void)pddby;
+
+    if (type >= pddby_message_type_warning)
+    {
+        fprintf(stderr, "%s\n", text);
+    }
+}
+
+static char* pddby_migrations_describe_schema(sqlite3* database)
+{
+    size_t size = 0;
+    char* result = calloc(1, 1);
+
+    for (char const* const* query = s_schema_queries; result && *query; query++)
+    {
+        sqlite3_stmt* statement;
+        if (sqlite3_prepare_v2(database, *query, -1, &statement, NULL) != SQLITE_OK)
+        {
+            fprintf(stderr, "unable to describe schema (%s)\n", sqlite3_errmsg(database));
+            free(result);
+            return NULL;
+        }
+
+        while (result && sqlite3_step(statement) == SQLITE_ROW)
+        {
+            for (int i = 0; result && i < sqlite3_column_count(statement); i++)
+            {
+                char const* value = (char const*)sqlite3_column_text(statement, i);
+                size_t const value_size = strlen(value ? value : "-") + 1;
+                char* new_result = realloc(result, size + value_size + 1);
+                if (!new_result)
+                {
+                    free(result);
+                    result = NULL;
+                    break;
+                }
+
+                result = new_result;
+                sprintf(result + size, "%s%c", value ? value : "-", i + 1 < sqlite3_column_count(statement) ? '|' :
+                    '\n');
+                size += value_size;
+            }
+        }
+
+        sqlite3_finalize(statement);
+    }
+
+    return result;
+}
+
+static int pddby_migrations_query_int(sqlite3* database, char const* sql)
+{
+    sqlite3_stmt* statement;
+    if (sqlite3_prepare_v2(database, sql, -1, &statement, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "unable to prepare \"%s\" (%s)\n", sql, sqlite3_errmsg(database));
+        return -1;
+    }
+
+    int result = sqlite3_step(statement) == SQLITE_ROW ? sqlite3_column_int(statement, 0) : -1;
+    sqlite3_finalize(statement);
+    return result;
+}
+
+// writes version 1 cache into cache_dir and lets library open it
+static int pddby_migrations_upgrade(char const* cache_dir, char const* cache_path)
+{
+    sqlite3* database;
+    if (sqlite3_open(cache_path, &database) != SQLITE_OK)
+    {
+        fprintf(stderr, "unable to create version 1 cache\n");
+        return 0;
+    }
+
+    char* error_text = NULL;
+    if (sqlite3_exec(database, s_v1_sql, NULL, NULL, &error_text) != SQLITE_OK)
+    {
+        fprintf(stderr, "unable to create version 1 cache (%s)\n", error_text);
+        sqlite3_free(error_text);
+        sqlite3_close(database);
+        return 0;
+    }
+
+    sqlite3_close(database);
+
+    pddby_callbacks_t callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.message = &on_message;
+
+    pddby_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.cache_dir = cache_dir;
+    options.log_level = pddby_message_type_warning;
+    options.callbacks = &callbacks;
+
+    pddby_t* pddby = pddby_init_with_options(&options);
+    if (!pddby)
+    {
+        fprintf(stderr, "unable to init library\n");
+        return 0;
+    }
+
+    pddby_use_cache(pddby, 1);
+    int const result = pddby_db_open(pddby);
+    pddby_close(pddby);
+
+    if (!result)
+    {
+        fprintf(stderr, "unable to open version 1 cache\n");
+    }
+    return result;
+}
+
+static int pddby_migrations_check(char const* cache_path)
+{
+    int latest_version = 1;
+    for (pddby_db_migration_t const* migration = pddby_db_migrations; migration->sql; migration++)
+    {
+        latest_version = migration->version;
+    }
+
+    sqlite3* migrated;
+    sqlite3* bootstrapped;
+    if (sqlite3_open(cache_path, &migrated) != SQLITE_OK ||
+        sqlite3_open(":memory:", &bootstrapped) != SQLITE_OK ||
+        sqlite3_exec(bootstrapped, pddby_db_bootstrap_sql, NULL, NULL, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "unable to open databases\n");
+        return 0;
+    }
+
+    int result = 1;
+
+    int const version = pddby_migrations_query_int(migrated, "PRAGMA user_version");
+    if (version != latest_version)
+    {
+        fprintf(stderr, "migrated cache has version %d instead of %d\n", version, latest_version);
+        result = 0;
+    }
+
+    char* migrated_schema = pddby_migrations_describe_schema(migrated);
+    char* bootstrapped_schema = pddby_migrations_describe_schema(bootstrapped);
+    if (!migrated_schema || !bootstrapped_schema)
+    {
+        result = 0;
+    }
+    else if (strcmp(migrated_schema, bootstrapped_schema) != 0)
+    {
+        fprintf(stderr, "migrated schema:\n%s\nbootstrapped schema:\n%s\n", migrated_schema, bootstrapped_schema);
+        result = 0;
+    }
+
+    free(migrated_schema);
+    free(bootstrapped_schema);
+
+    for (int i = 0; s_row_counts[i].sql; i++)
+    {
+        int const count = pddby_migrations_query_int(migrated, s_row_counts[i].sql);
+        if (count != s_row_counts[i].count)
+        {
+            fprintf(stderr, "\"%s\" gives %d instead of %d\n", s_row_counts[i].sql, count, s_row_counts[i].count);
+            result = 0;
+        }
+    }
+
+    sqlite3_close(bootstrapped);
+    sqlite3_close(migrated);
+
+    return result;
+}
+
+int main()
+{
+    // relative to build directory tests are run from
+    char cache_dir[] = "migrations-XXXXXX";
+    if (!mkdtemp(cache_dir))
+    {
+        fprintf(stderr, "unable to create cache directory\n");
+        return 1;
+    }
+
+    char cache_path[64];
+    snprintf(cache_path, sizeof(cache_path), "%s/%s", cache_dir, s_cache_files[0]);
+
+    int const result = pddby_migrations_upgrade(cache_dir, cache_path) && pddby_migrations_check(cache_path);
+
+    for (char const* const* file = s_cache_files; *file; file++)
+    {
+        char file_path[64];
+        snprintf(file_path, sizeof(file_path), "%s/%s", cache_dir, *file);
+        unlink(file_path);
+    }
+    rmdir(cache_dir);
+
+    printf("version 1 cache %s\n", result ? "migrated to bootstrapped schema" : "not migrated as expected");
+    return result ? 0 : 1;
+}
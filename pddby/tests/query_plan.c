@@ -0,0 +1,203 @@
+#include "private/queries.h"
+#include "private/util/database_sql.h"
+
+#include <sqlite3.h>
+#include <stdio.h>
+#include <string.h>
+
+struct pddby_query_plan_case
+{
+    char const* name;
+    char const* sql;
+    // each has to be found in some row of query plan
+    char const* const searches[4];
+    // tables (by alias) that are allowed to be scanned, every other one has to be searched
+    char const* const scans[4];
+};
+
+// view standing in for missing image store has no rows, so it is scanned
+#define PDDBY_QUERY_PLAN_IMAGE_STORE_SCANS {"s", "CONSTANT"}
+
+static struct pddby_query_plan_case const s_cases[] =
+{
+    {
+        "question by id", PDDBY_QUERY_QUESTION_BY_ID,
+        {"USING INTEGER PRIMARY KEY (rowid=?)"},
+        {NULL}
+    },
+    {
+        "questions by topic", PDDBY_QUERY_QUESTIONS_BY_TOPIC,
+        {"USING INDEX questions_topic_id (topic_id=?)"},
+        {NULL}
+    },
+    {
+        "questions by section", PDDBY_QUERY_QUESTIONS_BY_SECTION,
+        {"USING PRIMARY KEY (section_id=?)", "USING INTEGER PRIMARY KEY (rowid=?)"},
+        {NULL}
+    },
+    {
+        "questions by ticket", PDDBY_QUERY_QUESTIONS_BY_TICKET,
+        {"USING PRIMARY KEY (ticket_number=?)", "USING INTEGER PRIMARY KEY (rowid=?)"},
+        {NULL}
+    },
+    {
+        "question advice", PDDBY_QUERY_QUESTION_ADVICE,
+        {"USING INTEGER PRIMARY KEY (rowid=?)"},
+        {NULL}
+    },
+    {
+        "answers by question", PDDBY_QUERY_ANSWERS_BY_QUESTION,
+        {"USING INDEX answers_question_id (question_id=?)", "USING INTEGER PRIMARY KEY (rowid=?)"},
+        {NULL}
+    },
+    {
+        "image by name", PDDBY_QUERY_IMAGE_BY_NAME,
+        {"USING INDEX images_name (name=?)", "USING INTEGER PRIMARY KEY (rowid=?)"},
+        PDDBY_QUERY_PLAN_IMAGE_STORE_SCANS
+    },
+    {
+        "images by traffreg", PDDBY_QUERY_IMAGES_BY_TRAFFREG,
+        {"USING PRIMARY KEY (traffreg_id=?)", "USING INTEGER PRIMARY KEY (rowid=?)"},
+        PDDBY_QUERY_PLAN_IMAGE_STORE_SCANS
+    },
+    {
+        "comment by number", PDDBY_QUERY_COMMENT_BY_NUMBER,
+        {"USING INDEX comments_number (number=?)"},
+        {NULL}
+    },
+    {
+        "traffreg by number", PDDBY_QUERY_TRAFFREG_BY_NUMBER,
+        {"USING INDEX traffregs_number (number=?)", "USING INTEGER PRIMARY KEY (rowid=?)"},
+        {NULL}
+    },
+    {
+        "traffregs by question", PDDBY_QUERY_TRAFFREGS_BY_QUESTION,
+        {"USING PRIMARY KEY (question_id=?)", "USING INTEGER PRIMARY KEY (rowid=?)"},
+        {NULL}
+    },
+    {
+        "traffregs with images by question", PDDBY_QUERY_TRAFFREGS_WITH_IMAGES_BY_QUESTION,
+        {"USING PRIMARY KEY (question_id=?)", "USING PRIMARY KEY (traffreg_id=?)",
+            "USING INTEGER PRIMARY KEY (rowid=?)"},
+        PDDBY_QUERY_PLAN_IMAGE_STORE_SCANS
+    },
+    {
+        "text by hash", PDDBY_QUERY_TEXT_BY_HASH,
+        {"USING INDEX texts_hash (hash=?)"},
+        {NULL}
+    },
+    {
+        "topic by number", PDDBY_QUERY_TOPIC_BY_NUMBER,
+        {"(number=?)"},
+        {NULL}
+    },
+    {
+        "section by name", PDDBY_QUERY_SECTION_BY_NAME,
+        {"(name=?)"},
+        {NULL}
+    },
+    {NULL, NULL, {NULL}, {NULL}}
+};
+
+static int pddby_query_plan_scan_allowed(struct pddby_query_plan_case const* test_case, char const* detail)
+{
+    if (strncmp(detail, "SCAN ", 5) != 0)
+    {
+        return 1;
+    }
+
+    // older SQLite versions put "TABLE" before table name
+    char const* table = detail + 5;
+    if (strncmp(table, "TABLE ", 6) == 0)
+    {
+        table += 6;
+    }
+
+    size_t const table_length = strcspn(table, " ");
+    for (char const* const* scan = test_case->scans; *scan; scan++)
+    {
+        if (strlen(*scan) == table_length && strncmp(table, *scan, table_length) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int pddby_query_plan_check(sqlite3* database, struct pddby_query_plan_case const* test_case)
+{
+    char sql[2048];
+    snprintf(sql, sizeof(sql), "EXPLAIN QUERY PLAN %s", test_case->sql);
+
+    sqlite3_stmt* statement;
+    if (sqlite3_prepare_v2(database, sql, -1, &statement, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "%s: unable to prepare query (%s)\n", test_case->name, sqlite3_errmsg(database));
+        return 0;
+    }
+
+    int result = 1;
+    int found[4] = {0};
+    while (sqlite3_step(statement) == SQLITE_ROW)
+    {
+        char const* detail = (char const*)sqlite3_column_text(statement, 3);
+        if (!pddby_query_plan_scan_allowed(test_case, detail))
+        {
+            fprintf(stderr, "%s: unexpected \"%s\"\n", test_case->name, detail);
+            result = 0;
+        }
+
+        for (int i = 0; test_case->searches[i]; i++)
+        {
+            found[i] |= strstr(detail, test_case->searches[i]) != NULL;
+        }
+    }
+
+    sqlite3_finalize(statement);
+
+    for (int i = 0; test_case->searches[i]; i++)
+    {
+        if (!found[i])
+        {
+            fprintf(stderr, "%s: missing \"%s\"\n", test_case->name, test_case->searches[i]);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int main()
+{
+    sqlite3* database;
+    if (sqlite3_open(":memory:", &database) != SQLITE_OK)
+    {
+        fprintf(stderr, "unable to open database\n");
+        return 1;
+    }
+
+    // same view database sets up when there is no image store attached
+    char* error_text = NULL;
+    if (sqlite3_exec(database, pddby_db_bootstrap_sql, NULL, NULL, &error_text) != SQLITE_OK ||
+        sqlite3_exec(database, "CREATE TEMP VIEW `image_store` AS SELECT NULL AS `row_id`, NULL AS `hash`, NULL AS "
+            "`data`, 0 AS `format`, 0 AS `size` WHERE 0", NULL, NULL, &error_text) != SQLITE_OK)
+    {
+        fprintf(stderr, "unable to bootstrap database (%s)\n", error_text ? error_text : sqlite3_errmsg(database));
+        sqlite3_free(error_text);
+        sqlite3_close(database);
+        return 1;
+    }
+
+    int failed_count = 0;
+    for (struct pddby_query_plan_case const* test_case = s_cases; test_case->name; test_case++)
+    {
+        failed_count += !pddby_query_plan_check(database, test_case);
+    }
+
+    sqlite3_close(database);
+
+    printf("%d of %d query plan(s) as expected\n", (int)(sizeof(s_cases) / sizeof(*s_cases)) - 1 - failed_count,
+        (int)(sizeof(s_cases) / sizeof(*s_cases)) - 1);
+    return failed_count ? 1 : 0;
+}
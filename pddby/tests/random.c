@@ -0,0 +1,166 @@
+#include "pddby.h"
+#include "private/pddby.h"
+#include "private/util/random.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PDDBY_RANDOM_TEST_DRAWS 100000
+
+static int pddby_random_test_same_seed()
+{
+    uint64_t const seeds[] = {0, 1, 42, UINT64_MAX};
+
+    int result = 1;
+    for (size_t i = 0; i < sizeof(seeds) / sizeof(*seeds); i++)
+    {
+        pddby_random_t first;
+        pddby_random_t second;
+        pddby_random_init(&first, seeds[i]);
+        pddby_random_init(&second, seeds[i]);
+
+        for (int j = 0; j < 1000; j++)
+        {
+            if (pddby_random_next(&first) != pddby_random_next(&second))
+            {
+                fprintf(stderr, "seed %llu gives different sequences\n", (unsigned long long)seeds[i]);
+                result = 0;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int pddby_random_test_close_seeds()
+{
+    int result = 1;
+    for (uint64_t seed = 0; seed < 16; seed++)
+    {
+        pddby_random_t first;
+        pddby_random_t second;
+        pddby_random_init(&first, seed);
+        pddby_random_init(&second, seed + 1);
+
+        // one sequence must not be the other one shifted by a step
+        pddby_random_next(&second);
+
+        int same_count = 0;
+        for (int j = 0; j < 64; j++)
+        {
+            same_count += pddby_random_next(&first) == pddby_random_next(&second);
+        }
+
+        if (same_count > 1)
+        {
+            fprintf(stderr, "seeds %llu and %llu give related sequences\n", (unsigned long long)seed,
+                (unsigned long long)seed + 1);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int pddby_random_test_below()
+{
+    uint32_t const bounds[] = {1, 2, 3, 7, 10, 1000, 0x80000001u, UINT32_MAX};
+
+    pddby_random_t random;
+    pddby_random_init(&random, 1);
+
+    int result = 1;
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(*bounds); i++)
+    {
+        for (int j = 0; j < 10000; j++)
+        {
+            uint32_t const value = pddby_random_below(&random, bounds[i]);
+            if (value >= bounds[i])
+            {
+                fprintf(stderr, "%u is out of [0, %u)\n", value, bounds[i]);
+                result = 0;
+                break;
+            }
+        }
+    }
+
+    // every value is about equally likely
+    int counts[10] = {0};
+    for (int i = 0; i < PDDBY_RANDOM_TEST_DRAWS; i++)
+    {
+        counts[pddby_random_below(&random, 10)]++;
+    }
+
+    for (int i = 0; i < 10; i++)
+    {
+        if (counts[i] < PDDBY_RANDOM_TEST_DRAWS / 10 * 95 / 100 || counts[i] > PDDBY_RANDOM_TEST_DRAWS / 10 * 105 / 100)
+        {
+            fprintf(stderr, "%d is drawn %d time(s) out of %d\n", i, counts[i], PDDBY_RANDOM_TEST_DRAWS);
+            result = 0;
+        }
+    }
+
+    // with bound of three quarters of range, plain modulo would put half of values into lowest third
+    uint32_t const bound = 0xc0000000u;
+    int low_count = 0;
+    for (int i = 0; i < PDDBY_RANDOM_TEST_DRAWS; i++)
+    {
+        low_count += pddby_random_below(&random, bound) < bound / 3;
+    }
+
+    if (low_count < PDDBY_RANDOM_TEST_DRAWS * 31 / 100 || low_count > PDDBY_RANDOM_TEST_DRAWS * 35 / 100)
+    {
+        fprintf(stderr, "lowest third of [0, %u) is drawn %d time(s) out of %d\n", bound, low_count,
+            PDDBY_RANDOM_TEST_DRAWS);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int pddby_random_test_handles()
+{
+    pddby_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.cache_dir = ".";
+    options.use_random_seed = 1;
+    options.random_seed = 0;
+
+    pddby_t* first = pddby_init_with_options(&options);
+    pddby_t* second = pddby_init_with_options(&options);
+    if (!first || !second)
+    {
+        fprintf(stderr, "unable to init library\n");
+        return 0;
+    }
+
+    int result = 1;
+    for (int i = 0; i < 1000; i++)
+    {
+        if (pddby_random_below(&first->random, 1000) != pddby_random_below(&second->random, 1000))
+        {
+            fprintf(stderr, "handles with same random seed draw different numbers\n");
+            result = 0;
+            break;
+        }
+    }
+
+    pddby_close(second);
+    pddby_close(first);
+
+    return result;
+}
+
+int main()
+{
+    int failed_count = 0;
+    failed_count += !pddby_random_test_same_seed();
+    failed_count += !pddby_random_test_close_seeds();
+    failed_count += !pddby_random_test_below();
+    failed_count += !pddby_random_test_handles();
+
+    printf("%d of 4 random check(s) as expected\n", 4 - failed_count);
+    return failed_count ? 1 : 0;
+}
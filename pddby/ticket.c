@@ -0,0 +1,444 @@
+#include "ticket.h"
+
+#include "config.h"
+#include "private/pddby.h"
+#include "private/util/database.h"
+#include "private/util/pack.h"
+#include "private/util/report.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define PDDBY_TICKET_NO_TEXT ((size_t)-1)
+
+struct pddby_ticket_builder_answer
+{
+    size_t question_index;
+    int64_t id;
+    size_t text_offset;
+    int is_correct;
+};
+
+struct pddby_ticket_builder_traffreg
+{
+    size_t question_index;
+    int64_t id;
+};
+
+// rows are collected here first, in question order, and then laid out in one piece
+struct pddby_ticket_builder
+{
+    pddby_t* pddby;
+    pddby_questions_t const* questions;
+
+    size_t* question_text_offsets;
+
+    struct pddby_ticket_builder_answer* answers;
+    size_t answer_count;
+    size_t answer_capacity;
+
+    struct pddby_ticket_builder_traffreg* traffregs;
+    size_t traffreg_count;
+    size_t traffreg_capacity;
+
+    char* strings;
+    size_t strings_size;
+    size_t strings_capacity;
+};
+
+static int pddby_ticket_builder_reserve(void** items, size_t* capacity, size_t size, size_t item_size)
+{
+    if (size <= *capacity)
+    {
+        return 1;
+    }
+
+    size_t new_capacity = *capacity ? *capacity : 16;
+    while (new_capacity < size)
+    {
+        new_capacity *= 2;
+    }
+
+    void* new_items = realloc(*items, new_capacity * item_size);
+    if (!new_items)
+    {
+        return 0;
+    }
+
+    *items = new_items;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static int pddby_ticket_builder_add_string(struct pddby_ticket_builder* builder, char const* text, size_t* offset)
+{
+    if (!text)
+    {
+        *offset = PDDBY_TICKET_NO_TEXT;
+        return 1;
+    }
+
+    size_t const text_size = strlen(text) + 1;
+    if (!pddby_ticket_builder_reserve((void**)&builder->strings, &builder->strings_capacity,
+        builder->strings_size + text_size, 1))
+    {
+        return 0;
+    }
+
+    memcpy(builder->strings + builder->strings_size, text, text_size);
+    *offset = builder->strings_size;
+    builder->strings_size += text_size;
+    return 1;
+}
+
+static int pddby_ticket_builder_add_answer(struct pddby_ticket_builder* builder, size_t question_index, int64_t id,
+    char const* text, int is_correct)
+{
+    if (!pddby_ticket_builder_reserve((void**)&builder->answers, &builder->answer_capacity,
+        builder->answer_count + 1, sizeof(struct pddby_ticket_builder_answer)))
+    {
+        return 0;
+    }
+
+    struct pddby_ticket_builder_answer* answer = &builder->answers[builder->answer_count];
+    if (!pddby_ticket_builder_add_string(builder, text, &answer->text_offset))
+    {
+        return 0;
+    }
+
+    answer->question_index = question_index;
+    answer->id = id;
+    answer->is_correct = is_correct;
+    builder->answer_count++;
+    return 1;
+}
+
+static int pddby_ticket_builder_add_traffreg(struct pddby_ticket_builder* builder, size_t question_index, int64_t id)
+{
+    if (!pddby_ticket_builder_reserve((void**)&builder->traffregs, &builder->traffreg_capacity,
+        builder->traffreg_count + 1, sizeof(struct pddby_ticket_builder_traffreg)))
+    {
+        return 0;
+    }
+
+    builder->traffregs[builder->traffreg_count].question_index = question_index;
+    builder->traffregs[builder->traffreg_count].id = id;
+    builder->traffreg_count++;
+    return 1;
+}
+
+static void pddby_ticket_builder_cleanup(struct pddby_ticket_builder* builder)
+{
+    if (builder->question_text_offsets)
+    {
+        free(builder->question_text_offsets);
+    }
+    if (builder->answers)
+    {
+        free(builder->answers);
+    }
+    if (builder->traffregs)
+    {
+        free(builder->traffregs);
+    }
+    if (builder->strings)
+    {
+        free(builder->strings);
+    }
+}
+
+static int pddby_ticket_builder_collect_pack(struct pddby_ticket_builder* builder)
+{
+    pddby_pack_t const* pack = builder->pddby->pack;
+
+    for (size_t i = 0, size = pddby_array_size(builder->questions); i < size; i++)
+    {
+        pddby_question_t const* question = pddby_array_index(builder->questions, i);
+
+        size_t count;
+        uint32_t const* ids = pddby_pack_links(pack, pddby_pack_link_question_answers, question->id, &count);
+        for (size_t j = 0; j < count; j++)
+        {
+            struct pddby_pack_answer const* answer = pddby_pack_record(pack, pddby_pack_answers, ids[j]);
+            if (!answer ||
+                !pddby_ticket_builder_add_answer(builder, i, ids[j], pddby_pack_string(pack, answer->text),
+                    answer->is_correct))
+            {
+                return 0;
+            }
+        }
+
+        ids = pddby_pack_links(pack, pddby_pack_link_question_traffregs, question->id, &count);
+        for (size_t j = 0; j < count; j++)
+        {
+            if (!pddby_ticket_builder_add_traffreg(builder, i, ids[j]))
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static char* pddby_ticket_builder_join_ids(struct pddby_ticket_builder* builder)
+{
+    size_t const size = pddby_array_size(builder->questions);
+
+    int64_t* ids = malloc((size ? size : 1) * sizeof(int64_t));
+    if (!ids)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        ids[i] = ((pddby_question_t const*)pddby_array_index(builder->questions, i))->id;
+    }
+
+    char* result = pddby_db_join_ids(ids, size);
+    free(ids);
+    return result;
+}
+
+static int pddby_ticket_builder_collect_db(struct pddby_ticket_builder* builder)
+{
+    pddby_db_stmt_t* answers_db_stmt = pddby_db_prepare_cached(builder->pddby, PDDBY_DB_IDS_CTE
+        "SELECT i.`position`, a.`id`, t.`text`, a.`is_correct` FROM `ids` i INNER JOIN `answers` a ON "
+        "a.`question_id`=i.`id` LEFT JOIN `texts` t ON t.`id`=a.`text_id` ORDER BY i.`position`, a.`id`");
+    if (!answers_db_stmt)
+    {
+        return 0;
+    }
+
+    pddby_db_stmt_t* traffregs_db_stmt = pddby_db_prepare_cached(builder->pddby, PDDBY_DB_IDS_CTE
+        "SELECT i.`position`, qt.`traffreg_id` FROM `ids` i INNER JOIN `questions_traffregs` qt ON "
+        "qt.`question_id`=i.`id` INNER JOIN `traffregs` r ON r.`id`=qt.`traffreg_id` ORDER BY i.`position`, "
+        "qt.`position`");
+    if (!traffregs_db_stmt)
+    {
+        return 0;
+    }
+
+    char* ids = pddby_ticket_builder_join_ids(builder);
+    if (!ids)
+    {
+        return 0;
+    }
+
+    int ret = -1;
+    if (pddby_db_reset(answers_db_stmt) &&
+        pddby_db_bind_text(answers_db_stmt, 1, ids))
+    {
+        while ((ret = pddby_db_step(answers_db_stmt)) == 1)
+        {
+            if (!pddby_ticket_builder_add_answer(builder, pddby_db_column_int64(answers_db_stmt, 0),
+                pddby_db_column_int64(answers_db_stmt, 1), pddby_db_column_text(answers_db_stmt, 2),
+                pddby_db_column_int(answers_db_stmt, 3)))
+            {
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    if (ret == 0 &&
+        pddby_db_reset(traffregs_db_stmt) &&
+        pddby_db_bind_text(traffregs_db_stmt, 1, ids))
+    {
+        while ((ret = pddby_db_step(traffregs_db_stmt)) == 1)
+        {
+            if (!pddby_ticket_builder_add_traffreg(builder, pddby_db_column_int64(traffregs_db_stmt, 0),
+                pddby_db_column_int64(traffregs_db_stmt, 1)))
+            {
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    free(ids);
+
+    return ret == 0;
+}
+
+static pddby_ticket_bundle_t* pddby_ticket_builder_finish(struct pddby_ticket_builder* builder)
+{
+    size_t const question_count = pddby_array_size(builder->questions);
+
+    // structures go first, all of them are 8-byte aligned, strings come last
+    size_t const questions_offset = sizeof(pddby_ticket_bundle_t);
+    size_t const answers_offset = questions_offset + question_count * sizeof(pddby_ticket_question_t);
+    size_t const traffregs_offset = answers_offset + builder->answer_count * sizeof(pddby_ticket_answer_t);
+    size_t const strings_offset = traffregs_offset + builder->traffreg_count * sizeof(int64_t);
+
+    char* data = malloc(strings_offset + builder->strings_size);
+    if (!data)
+    {
+        return NULL;
+    }
+
+    pddby_ticket_bundle_t* bundle = (pddby_ticket_bundle_t*)data;
+    pddby_ticket_question_t* questions = (pddby_ticket_question_t*)(data + questions_offset);
+    pddby_ticket_answer_t* answers = (pddby_ticket_answer_t*)(data + answers_offset);
+    int64_t* traffreg_ids = (int64_t*)(data + traffregs_offset);
+    char* strings = data + strings_offset;
+
+    if (builder->strings_size)
+    {
+        memcpy(strings, builder->strings, builder->strings_size);
+    }
+
+    bundle->pddby = builder->pddby;
+    bundle->questions = questions;
+    bundle->question_count = question_count;
+
+    size_t answer_index = 0;
+    size_t traffreg_index = 0;
+    for (size_t i = 0; i < question_count; i++)
+    {
+        pddby_question_t const* source = pddby_array_index(builder->questions, i);
+        pddby_ticket_question_t* question = &questions[i];
+
+        question->id = source->id;
+        question->topic_id = source->topic_id;
+        question->text = builder->question_text_offsets[i] != PDDBY_TICKET_NO_TEXT ?
+            strings + builder->question_text_offsets[i] : NULL;
+        question->image_id = source->image_id;
+        question->comment_id = source->comment_id;
+
+        question->answers = &answers[answer_index];
+        question->answer_count = 0;
+        question->correct_answer = -1;
+        for (; answer_index < builder->answer_count && builder->answers[answer_index].question_index == i;
+            answer_index++)
+        {
+            struct pddby_ticket_builder_answer const* answer = &builder->answers[answer_index];
+
+            answers[answer_index].id = answer->id;
+            answers[answer_index].text = answer->text_offset != PDDBY_TICKET_NO_TEXT ?
+                strings + answer->text_offset : NULL;
+            if (answer->is_correct && question->correct_answer == -1)
+            {
+                question->correct_answer = question->answer_count;
+            }
+            question->answer_count++;
+        }
+
+        question->traffreg_ids = &traffreg_ids[traffreg_index];
+        question->traffreg_count = 0;
+        for (; traffreg_index < builder->traffreg_count && builder->traffregs[traffreg_index].question_index == i;
+            traffreg_index++)
+        {
+            traffreg_ids[traffreg_index] = builder->traffregs[traffreg_index].id;
+            question->traffreg_count++;
+        }
+    }
+
+    return bundle;
+}
+
+pddby_ticket_bundle_t* pddby_ticket_bundle_new(pddby_t* pddby, pddby_questions_t const* questions)
+{
+    assert(questions);
+
+    struct pddby_ticket_builder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.pddby = pddby;
+    builder.questions = questions;
+
+    size_t const question_count = pddby_array_size(questions);
+
+    builder.question_text_offsets = malloc((question_count ? question_count : 1) * sizeof(size_t));
+    if (!builder.question_text_offsets)
+    {
+        goto error;
+    }
+
+    for (size_t i = 0; i < question_count; i++)
+    {
+        pddby_question_t const* question = pddby_array_index(questions, i);
+        if (!pddby_ticket_builder_add_string(&builder, question->text, &builder.question_text_offsets[i]))
+        {
+            goto error;
+        }
+    }
+
+    if (question_count &&
+        !(pddby->pack ? pddby_ticket_builder_collect_pack(&builder) : pddby_ticket_builder_collect_db(&builder)))
+    {
+        goto error;
+    }
+
+    pddby_ticket_bundle_t* bundle = pddby_ticket_builder_finish(&builder);
+    if (!bundle)
+    {
+        goto error;
+    }
+
+    pddby_ticket_builder_cleanup(&builder);
+
+    return bundle;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to create ticket bundle");
+    pddby_ticket_builder_cleanup(&builder);
+    return NULL;
+}
+
+void pddby_ticket_bundle_free(pddby_ticket_bundle_t* bundle)
+{
+    assert(bundle);
+
+    free(bundle);
+}
+
+pddby_ticket_bundle_t* pddby_ticket_bundle_find_by_ticket(pddby_t* pddby, int ticket_number)
+{
+    pddby_questions_t* questions = pddby_questions_find_by_ticket(pddby, ticket_number);
+    if (!questions)
+    {
+        goto error;
+    }
+
+    pddby_ticket_bundle_t* bundle = pddby_ticket_bundle_new(pddby, questions);
+    pddby_questions_free(questions);
+    if (!bundle)
+    {
+        goto error;
+    }
+
+    return bundle;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to find ticket bundle with ticket number = %d",
+        ticket_number);
+    return NULL;
+}
+
+pddby_ticket_bundle_t* pddby_ticket_bundle_find_by_section(pddby_t* pddby, int64_t section_id)
+{
+    pddby_questions_t* questions = pddby_questions_find_by_section(pddby, section_id);
+    if (!questions)
+    {
+        goto error;
+    }
+
+    pddby_ticket_bundle_t* bundle = pddby_ticket_bundle_new(pddby, questions);
+    pddby_questions_free(questions);
+    if (!bundle)
+    {
+        goto error;
+    }
+
+    return bundle;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to find ticket bundle with section id = %lld", section_id);
+    return NULL;
+}
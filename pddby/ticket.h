@@ -0,0 +1,64 @@
+#ifndef PDDBY_TICKET_H
+#define PDDBY_TICKET_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "pddby.h"
+#include "question.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct pddby_ticket_answer
+{
+    int64_t id;
+    char const* text;
+};
+
+typedef struct pddby_ticket_answer pddby_ticket_answer_t;
+
+struct pddby_ticket_question
+{
+    int64_t id;
+    int64_t topic_id;
+    char const* text;
+    int64_t image_id;
+    int64_t comment_id;
+
+    pddby_ticket_answer_t const* answers;
+    size_t answer_count;
+    // index into answers, -1 if none is marked correct
+    int correct_answer;
+
+    int64_t const* traffreg_ids;
+    size_t traffreg_count;
+};
+
+typedef struct pddby_ticket_question pddby_ticket_question_t;
+
+// everything needed to show a set of questions, laid out in one piece and freed at once
+struct pddby_ticket_bundle
+{
+    pddby_t* pddby;
+
+    pddby_ticket_question_t const* questions;
+    size_t question_count;
+};
+
+typedef struct pddby_ticket_bundle pddby_ticket_bundle_t;
+
+// answers and traffreg links of all questions are fetched at once, not question by question
+pddby_ticket_bundle_t* pddby_ticket_bundle_new(pddby_t* pddby, pddby_questions_t const* questions);
+void pddby_ticket_bundle_free(pddby_ticket_bundle_t* bundle);
+
+pddby_ticket_bundle_t* pddby_ticket_bundle_find_by_ticket(pddby_t* pddby, int ticket_number);
+pddby_ticket_bundle_t* pddby_ticket_bundle_find_by_section(pddby_t* pddby, int64_t section_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PDDBY_TICKET_H
@@ -1,9 +1,14 @@
 #include "topic.h"
 
 #include "config.h"
+#include "private/pddby.h"
+#include "private/queries.h"
 #include "private/util/database.h"
+#include "private/util/identity.h"
+#include "private/util/pack.h"
 #include "private/util/report.h"
 #include "question.h"
+#include "stats.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -13,9 +18,18 @@
 #include <dmalloc.h>
 #endif
 
+static void pddby_topic_dispose(pddby_topic_t* topic)
+{
+    if (topic->title)
+    {
+        free(topic->title);
+    }
+}
+
 static pddby_topic_t* pddby_topic_new_with_id(pddby_t* pddby, int64_t id, int number, char const* title)
 {
-    pddby_topic_t* topic = calloc(1, sizeof(pddby_topic_t));
+    pddby_topic_t* topic = pddby_identity_new(pddby, pddby_identity_topic, sizeof(pddby_topic_t),
+        (pddby_identity_dispose_func_t)&pddby_topic_dispose);
     if (!topic)
     {
         goto error;
@@ -35,37 +49,70 @@ static pddby_topic_t* pddby_topic_new_with_id(pddby_t* pddby, int64_t id, int nu
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to create topic object");
+    if (topic)
+    {
+        pddby_identity_release(pddby, topic);
+    }
     return NULL;
 }
 
+// row is only turned into object if it's not mapped yet
+static pddby_topic_t* pddby_topic_new_shared(pddby_t* pddby, int64_t id, int number, char const* title)
+{
+    pddby_topic_t* topic = pddby_identity_find(pddby, pddby_identity_topic, id);
+    if (topic)
+    {
+        return topic;
+    }
+
+    topic = pddby_topic_new_with_id(pddby, id, number, title);
+    return topic ? pddby_identity_add(pddby, pddby_identity_topic, id, topic) : NULL;
+}
+
+static pddby_topic_t* pddby_topic_new_from_pack(pddby_t* pddby, int64_t id)
+{
+    struct pddby_pack_topic const* topic = pddby_pack_record(pddby->pack, pddby_pack_topics, id);
+    if (!topic)
+    {
+        return NULL;
+    }
+
+    return pddby_topic_new_shared(pddby, id, topic->number, pddby_pack_string(pddby->pack, topic->title));
+}
+
 pddby_topic_t* pddby_topic_new(pddby_t* pddby, int number, char const* title)
 {
     return pddby_topic_new_with_id(pddby, 0, number, title);
 }
 
-void pddby_topic_free(pddby_topic_t* topic)
+pddby_topic_t* pddby_topic_retain(pddby_topic_t* topic)
 {
     assert(topic);
 
-    if (topic->title)
-    {
-        free(topic->title);
-    }
-    free(topic);
+    return pddby_identity_retain(topic->pddby, topic);
+}
+
+void pddby_topic_release(pddby_topic_t* topic)
+{
+    assert(topic);
+
+    pddby_identity_release(topic->pddby, topic);
+}
+
+void pddby_topic_free(pddby_topic_t* topic)
+{
+    pddby_topic_release(topic);
 }
 
 int pddby_topic_save(pddby_topic_t* topic)
 {
     assert(topic);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(topic->pddby, "INSERT INTO `topics` (`number`, `title`) VALUES "
+        "(?, ?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(topic->pddby, "INSERT INTO `topics` (`number`, `title`) VALUES (?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -94,14 +141,22 @@ error:
 
 pddby_topic_t* pddby_topic_find_by_id(pddby_t* pddby, int64_t id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_topic_t* topic = pddby_identity_find(pddby, pddby_identity_topic, id);
+    if (topic)
+    {
+        return topic;
+    }
+
+    if (pddby->pack)
+    {
+        return pddby_topic_new_from_pack(pddby, id);
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT `number`, `title` FROM `topics` WHERE `id`=? "
+        "LIMIT 1");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `number`, `title` FROM `topics` WHERE `rowid`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -121,7 +176,7 @@ pddby_topic_t* pddby_topic_find_by_id(pddby_t* pddby, int64_t id)
     int number = pddby_db_column_int(db_stmt, 0);
     char const* title = pddby_db_column_text(db_stmt, 1);
 
-    return pddby_topic_new_with_id(pddby, id, number, title);
+    return pddby_topic_new_shared(pddby, id, number, title);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find topic object with id = %lld", id);
@@ -130,14 +185,23 @@ error:
 
 pddby_topic_t* pddby_topic_find_by_number(pddby_t* pddby, int number)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    if (pddby->pack)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `title` FROM `topics` WHERE `number`=? LIMIT 1");
-        if (!db_stmt)
+        for (size_t id = 1, count = pddby_pack_count(pddby->pack, pddby_pack_topics); id <= count; id++)
         {
-            goto error;
+            struct pddby_pack_topic const* topic = pddby_pack_record(pddby->pack, pddby_pack_topics, id);
+            if (topic->number == number)
+            {
+                return pddby_topic_new_from_pack(pddby, id);
+            }
         }
+        return NULL;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_TOPIC_BY_NUMBER);
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -157,7 +221,7 @@ pddby_topic_t* pddby_topic_find_by_number(pddby_t* pddby, int number)
     int64_t id = pddby_db_column_int64(db_stmt, 0);
     char const* title = pddby_db_column_text(db_stmt, 1);
 
-    return pddby_topic_new_with_id(pddby, id, number, title);
+    return pddby_topic_new_shared(pddby, id, number, title);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find topic object with number = %d", number);
@@ -171,14 +235,30 @@ pddby_topics_t* pddby_topics_new(pddby_t* pddby)
 
 pddby_topics_t* pddby_topics_find_all(pddby_t* pddby)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    if (pddby->pack)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `number`, `title` FROM `topics`");
-        if (!db_stmt)
+        pddby_topics_t* topics = pddby_topics_new(pddby);
+        if (!topics)
         {
             goto error;
         }
+
+        for (size_t id = 1, count = pddby_pack_count(pddby->pack, pddby_pack_topics); id <= count; id++)
+        {
+            if (!pddby_array_add(topics, pddby_topic_new_from_pack(pddby, id)))
+            {
+                pddby_topics_free(topics);
+                goto error;
+            }
+        }
+
+        return topics;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT `id`, `number`, `title` FROM `topics`");
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt))
@@ -199,7 +279,7 @@ pddby_topics_t* pddby_topics_find_all(pddby_t* pddby)
         int number = pddby_db_column_int(db_stmt, 1);
         char const* title = pddby_db_column_text(db_stmt, 2);
 
-        if (!pddby_array_add(topics, pddby_topic_new_with_id(pddby, id, number, title)))
+        if (!pddby_array_add(topics, pddby_topic_new_shared(pddby, id, number, title)))
         {
             ret = -1;
             break;
@@ -230,28 +310,34 @@ size_t pddby_topic_get_question_count(pddby_topic_t const* topic)
 {
     assert(topic);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    if (topic->pddby->pack)
+    {
+        size_t count;
+        pddby_pack_links(topic->pddby->pack, pddby_pack_link_topic_questions, topic->id, &count);
+        return count;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(topic->pddby, "SELECT `question_count` FROM `stats` WHERE "
+        "`kind`=? AND `owner_id`=?");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(topic->pddby, "SELECT COUNT(*) FROM `questions` WHERE `topic_id`=?");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
-        !pddby_db_bind_int64(db_stmt, 1, topic->id))
+        !pddby_db_bind_int(db_stmt, 1, pddby_stat_kind_topic) ||
+        !pddby_db_bind_int64(db_stmt, 2, topic->id))
     {
         goto error;
     }
 
-    if (pddby_db_step(db_stmt) != 1)
+    int ret = pddby_db_step(db_stmt);
+    if (ret == -1)
     {
         goto error;
     }
 
-    return pddby_db_column_int(db_stmt, 0);
+    return ret == 1 ? pddby_db_column_int(db_stmt, 0) : 0;
 
 error:
     pddby_report(topic->pddby, pddby_message_type_error, "unable to get questions count of topic object");
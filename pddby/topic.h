@@ -24,6 +24,9 @@ typedef struct pddby_topic pddby_topic_t;
 typedef pddby_array_t pddby_topics_t;
 
 pddby_topic_t* pddby_topic_new(pddby_t* pddby, int number, char const* title);
+pddby_topic_t* pddby_topic_retain(pddby_topic_t* topic);
+void pddby_topic_release(pddby_topic_t* topic);
+// same as pddby_topic_release
 void pddby_topic_free(pddby_topic_t* topic);
 
 int pddby_topic_save(pddby_topic_t* topic);
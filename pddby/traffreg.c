@@ -1,8 +1,14 @@
 #include "traffreg.h"
 
 #include "config.h"
+#include "private/image.h"
+#include "private/pddby.h"
+#include "private/queries.h"
 #include "private/util/database.h"
+#include "private/util/identity.h"
+#include "private/util/pack.h"
 #include "private/util/report.h"
+#include "private/util/texts.h"
 #include "question.h"
 
 #include <assert.h>
@@ -13,9 +19,18 @@
 #include <dmalloc.h>
 #endif
 
+static void pddby_traffreg_dispose(pddby_traffreg_t* traffreg)
+{
+    if (traffreg->text)
+    {
+        free(traffreg->text);
+    }
+}
+
 static pddby_traffreg_t* pddby_traffreg_new_with_id(pddby_t* pddby, int64_t id, int32_t number, char const* text)
 {
-    pddby_traffreg_t *traffreg = malloc(sizeof(pddby_traffreg_t));
+    pddby_traffreg_t* traffreg = pddby_identity_new(pddby, pddby_identity_traffreg, sizeof(pddby_traffreg_t),
+        (pddby_identity_dispose_func_t)&pddby_traffreg_dispose);
     if (!traffreg)
     {
         goto error;
@@ -37,44 +52,81 @@ error:
     pddby_report(pddby, pddby_message_type_error, "unable to create traffreg object");
     if (traffreg)
     {
-        pddby_traffreg_free(traffreg);
+        pddby_identity_release(pddby, traffreg);
     }
     return NULL;
 }
 
+// row is only turned into object if it's not mapped yet
+static pddby_traffreg_t* pddby_traffreg_new_shared(pddby_t* pddby, int64_t id, int32_t number, char const* text)
+{
+    pddby_traffreg_t* traffreg = pddby_identity_find(pddby, pddby_identity_traffreg, id);
+    if (traffreg)
+    {
+        return traffreg;
+    }
+
+    traffreg = pddby_traffreg_new_with_id(pddby, id, number, text);
+    return traffreg ? pddby_identity_add(pddby, pddby_identity_traffreg, id, traffreg) : NULL;
+}
+
+static pddby_traffreg_t* pddby_traffreg_new_from_pack(pddby_t* pddby, int64_t id)
+{
+    struct pddby_pack_traffreg const* traffreg = pddby_pack_record(pddby->pack, pddby_pack_traffregs, id);
+    if (!traffreg)
+    {
+        return NULL;
+    }
+
+    return pddby_traffreg_new_shared(pddby, id, traffreg->number, pddby_pack_string(pddby->pack, traffreg->text));
+}
+
 pddby_traffreg_t* pddby_traffreg_new(pddby_t* pddby, int32_t number, char const* text)
 {
     return pddby_traffreg_new_with_id(pddby, 0, number, text);
 }
 
-void pddby_traffreg_free(pddby_traffreg_t* traffreg)
+pddby_traffreg_t* pddby_traffreg_retain(pddby_traffreg_t* traffreg)
 {
     assert(traffreg);
 
-    if (traffreg->text)
-    {
-        free(traffreg->text);
-    }
-    free(traffreg);
+    return pddby_identity_retain(traffreg->pddby, traffreg);
+}
+
+void pddby_traffreg_release(pddby_traffreg_t* traffreg)
+{
+    assert(traffreg);
+
+    pddby_identity_release(traffreg->pddby, traffreg);
+}
+
+void pddby_traffreg_free(pddby_traffreg_t* traffreg)
+{
+    pddby_traffreg_release(traffreg);
 }
 
 int pddby_traffreg_save(pddby_traffreg_t* traffreg)
 {
     assert(traffreg);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(traffreg->pddby, "INSERT INTO `traffregs` (`number`, `text_id`) "
+        "VALUES (?, ?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(traffreg->pddby, "INSERT INTO `traffregs` (`number`, `text`) VALUES (?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
+    }
+
+    int64_t text_id = pddby_texts_intern(traffreg->pddby, traffreg->text);
+    if (text_id == -1)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
         !pddby_db_bind_int(db_stmt, 1, traffreg->number) ||
-        !pddby_db_bind_text(db_stmt, 2, traffreg->text))
+        !(text_id ?
+            pddby_db_bind_int64(db_stmt, 2, text_id) :
+            pddby_db_bind_null(db_stmt, 2)))
     {
         goto error;
     }
@@ -101,14 +153,11 @@ int pddby_traffreg_set_images(pddby_traffreg_t* traffreg, pddby_images_t* images
     assert(traffreg);
     assert(images);
 
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(traffreg->pddby, "INSERT INTO `images_traffregs` (`image_id`, "
+        "`traffreg_id`, `position`) VALUES (?, ?, ?)");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(traffreg->pddby, "INSERT INTO `images_traffregs` (`image_id`, `traffreg_id`) VALUES (?, ?)");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     for (size_t i = 0, size = pddby_array_size(images); i < size; i++)
@@ -117,7 +166,8 @@ int pddby_traffreg_set_images(pddby_traffreg_t* traffreg, pddby_images_t* images
 
         if (!pddby_db_reset(db_stmt) ||
             !pddby_db_bind_int64(db_stmt, 1, image->id) ||
-            !pddby_db_bind_int64(db_stmt, 2, traffreg->id))
+            !pddby_db_bind_int64(db_stmt, 2, traffreg->id) ||
+            !pddby_db_bind_int(db_stmt, 3, i))
         {
             goto error;
         }
@@ -140,14 +190,22 @@ error:
 
 pddby_traffreg_t* pddby_traffreg_find_by_id(pddby_t* pddby, int64_t id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    pddby_traffreg_t* traffreg = pddby_identity_find(pddby, pddby_identity_traffreg, id);
+    if (traffreg)
+    {
+        return traffreg;
+    }
+
+    if (pddby->pack)
+    {
+        return pddby_traffreg_new_from_pack(pddby, id);
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, "SELECT r.`number`, t.`text` FROM `traffregs` r LEFT "
+        "JOIN `texts` t ON t.`id`=r.`text_id` WHERE r.`id`=? LIMIT 1");
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `number`, `text` FROM `traffregs` WHERE `rowid`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -167,7 +225,7 @@ pddby_traffreg_t* pddby_traffreg_find_by_id(pddby_t* pddby, int64_t id)
     int32_t number = pddby_db_column_int(db_stmt, 0);
     char const*text = pddby_db_column_text(db_stmt, 1);
 
-    return pddby_traffreg_new_with_id(pddby, id, number, text);
+    return pddby_traffreg_new_shared(pddby, id, number, text);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find traffreg object with id = %lld", id);
@@ -176,14 +234,16 @@ error:
 
 pddby_traffreg_t* pddby_traffreg_find_by_number(pddby_t* pddby, int32_t number)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
+    if (pddby->pack)
+    {
+        return pddby_traffreg_new_from_pack(pddby, pddby_pack_find_by_number(pddby->pack, pddby_pack_traffregs,
+            number));
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_TRAFFREG_BY_NUMBER);
     if (!db_stmt)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT `rowid`, `text` FROM `traffregs` WHERE `number`=? LIMIT 1");
-        if (!db_stmt)
-        {
-            goto error;
-        }
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -203,7 +263,7 @@ pddby_traffreg_t* pddby_traffreg_find_by_number(pddby_t* pddby, int32_t number)
     int64_t id = pddby_db_column_int64(db_stmt, 0);
     char const*text = pddby_db_column_text(db_stmt, 1);
 
-    return pddby_traffreg_new_with_id(pddby, id, number, text);
+    return pddby_traffreg_new_shared(pddby, id, number, text);
 
 error:
     pddby_report(pddby, pddby_message_type_error, "unable to find traffreg object with number = %d", number);
@@ -217,15 +277,32 @@ pddby_traffregs_t* pddby_traffregs_new(pddby_t* pddby)
 
 pddby_traffregs_t* pddby_traffregs_find_by_question(pddby_t* pddby, int64_t question_id)
 {
-    static pddby_db_stmt_t* db_stmt = NULL;
-    if (!db_stmt)
+    if (pddby->pack)
     {
-        db_stmt = pddby_db_prepare(pddby, "SELECT t.`rowid`, t.`number`, t.`text` FROM `traffregs` t INNER JOIN "
-            "`questions_traffregs` qt ON t.`rowid`=qt.`traffreg_id` WHERE qt.`question_id`=?");
-        if (!db_stmt)
+        pddby_traffregs_t* traffregs = pddby_traffregs_new(pddby);
+        if (!traffregs)
         {
             goto error;
         }
+
+        size_t count;
+        uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_question_traffregs, question_id, &count);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!pddby_array_add(traffregs, pddby_traffreg_new_from_pack(pddby, ids[i])))
+            {
+                pddby_traffregs_free(traffregs);
+                goto error;
+            }
+        }
+
+        return traffregs;
+    }
+
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_TRAFFREGS_BY_QUESTION);
+    if (!db_stmt)
+    {
+        goto error;
     }
 
     if (!pddby_db_reset(db_stmt) ||
@@ -247,7 +324,7 @@ pddby_traffregs_t* pddby_traffregs_find_by_question(pddby_t* pddby, int64_t ques
         int32_t number = pddby_db_column_int(db_stmt, 1);
         char const*text = pddby_db_column_text(db_stmt, 2);
 
-        if (!pddby_array_add(traffregs, pddby_traffreg_new_with_id(pddby, id, number, text)))
+        if (!pddby_array_add(traffregs, pddby_traffreg_new_shared(pddby, id, number, text)))
         {
             ret = -1;
             break;
@@ -274,3 +351,179 @@ void pddby_traffregs_free(pddby_traffregs_t* traffregs)
 
     pddby_array_free(traffregs, 1);
 }
+
+static void pddby_traffreg_with_images_free(pddby_traffreg_with_images_t* item)
+{
+    if (item->traffreg)
+    {
+        pddby_traffreg_release(item->traffreg);
+    }
+    if (item->images)
+    {
+        pddby_images_free(item->images);
+    }
+    free(item);
+}
+
+// takes over traffreg reference, even on failure
+static pddby_traffreg_with_images_t* pddby_traffreg_with_images_new(pddby_t* pddby, pddby_traffreg_t* traffreg)
+{
+    if (!traffreg)
+    {
+        return NULL;
+    }
+
+    pddby_traffreg_with_images_t* item = calloc(1, sizeof(pddby_traffreg_with_images_t));
+    if (!item)
+    {
+        pddby_traffreg_release(traffreg);
+        return NULL;
+    }
+
+    item->traffreg = traffreg;
+    item->images = pddby_images_new(pddby);
+    if (!item->images)
+    {
+        pddby_traffreg_with_images_free(item);
+        return NULL;
+    }
+
+    return item;
+}
+
+static pddby_traffregs_with_images_t* pddby_traffregs_with_images_new(pddby_t* pddby)
+{
+    return pddby_array_new(pddby, (pddby_array_free_func_t)pddby_traffreg_with_images_free);
+}
+
+static pddby_traffregs_with_images_t* pddby_traffregs_with_images_find_in_pack(pddby_t* pddby, int64_t question_id)
+{
+    pddby_traffregs_with_images_t* traffregs = pddby_traffregs_with_images_new(pddby);
+    if (!traffregs)
+    {
+        return NULL;
+    }
+
+    size_t count;
+    uint32_t const* ids = pddby_pack_links(pddby->pack, pddby_pack_link_question_traffregs, question_id, &count);
+    for (size_t i = 0; i < count; i++)
+    {
+        pddby_traffreg_with_images_t* item = pddby_traffreg_with_images_new(pddby,
+            pddby_traffreg_new_from_pack(pddby, ids[i]));
+        if (!pddby_array_add(traffregs, item))
+        {
+            if (item)
+            {
+                pddby_traffreg_with_images_free(item);
+            }
+            pddby_traffregs_with_images_free(traffregs);
+            return NULL;
+        }
+
+        size_t image_count;
+        uint32_t const* image_ids = pddby_pack_links(pddby->pack, pddby_pack_link_traffreg_images, ids[i],
+            &image_count);
+        for (size_t j = 0; j < image_count; j++)
+        {
+            if (!pddby_array_add(item->images, pddby_image_new_from_pack(pddby, image_ids[j])))
+            {
+                pddby_traffregs_with_images_free(traffregs);
+                return NULL;
+            }
+        }
+    }
+
+    return traffregs;
+}
+
+pddby_traffregs_with_images_t* pddby_traffregs_with_images_find_by_question(pddby_t* pddby, int64_t question_id)
+{
+    if (pddby->pack)
+    {
+        pddby_traffregs_with_images_t* traffregs = pddby_traffregs_with_images_find_in_pack(pddby, question_id);
+        if (!traffregs)
+        {
+            goto error;
+        }
+        return traffregs;
+    }
+
+    // one row per image, or a single one with NULL image for traffregs without any
+    pddby_db_stmt_t* db_stmt = pddby_db_prepare_cached(pddby, PDDBY_QUERY_TRAFFREGS_WITH_IMAGES_BY_QUESTION);
+    if (!db_stmt)
+    {
+        goto error;
+    }
+
+    if (!pddby_db_reset(db_stmt) ||
+        !pddby_db_bind_int64(db_stmt, 1, question_id))
+    {
+        goto error;
+    }
+
+    pddby_traffregs_with_images_t* traffregs = pddby_traffregs_with_images_new(pddby);
+    if (!traffregs)
+    {
+        goto error;
+    }
+
+    pddby_traffreg_with_images_t* item = NULL;
+    int64_t position = -1;
+
+    int ret;
+    while ((ret = pddby_db_step(db_stmt)) == 1)
+    {
+        if (!item || pddby_db_column_int64(db_stmt, 0) != position)
+        {
+            int64_t id = pddby_db_column_int64(db_stmt, 1);
+            int32_t number = pddby_db_column_int(db_stmt, 2);
+            char const* text = pddby_db_column_text(db_stmt, 3);
+
+            item = pddby_traffreg_with_images_new(pddby, pddby_traffreg_new_shared(pddby, id, number, text));
+            if (!pddby_array_add(traffregs, item))
+            {
+                if (item)
+                {
+                    pddby_traffreg_with_images_free(item);
+                }
+                ret = -1;
+                break;
+            }
+
+            position = pddby_db_column_int64(db_stmt, 0);
+        }
+
+        int64_t image_id = pddby_db_column_int64(db_stmt, 4);
+        if (!image_id)
+        {
+            continue;
+        }
+
+        char const* image_name = pddby_db_column_text(db_stmt, 5);
+        if (!pddby_array_add(item->images, pddby_image_new_from_db(pddby, image_id, image_name, db_stmt, 6)))
+        {
+            ret = -1;
+            break;
+        }
+    }
+
+    if (ret == -1)
+    {
+        pddby_traffregs_with_images_free(traffregs);
+        goto error;
+    }
+
+    return traffregs;
+
+error:
+    pddby_report(pddby, pddby_message_type_error, "unable to find traffreg objects with images with question id = "
+        "%lld", question_id);
+    return NULL;
+}
+
+void pddby_traffregs_with_images_free(pddby_traffregs_with_images_t* traffregs)
+{
+    assert(traffregs);
+
+    pddby_array_free(traffregs, 1);
+}
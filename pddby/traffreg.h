@@ -24,7 +24,19 @@ struct pddby_traffreg
 typedef struct pddby_traffreg pddby_traffreg_t;
 typedef pddby_array_t pddby_traffregs_t;
 
+struct pddby_traffreg_with_images
+{
+    pddby_traffreg_t* traffreg;
+    pddby_images_t* images;
+};
+
+typedef struct pddby_traffreg_with_images pddby_traffreg_with_images_t;
+typedef pddby_array_t pddby_traffregs_with_images_t;
+
 pddby_traffreg_t* pddby_traffreg_new(pddby_t* pddby, int32_t number, char const* text);
+pddby_traffreg_t* pddby_traffreg_retain(pddby_traffreg_t* traffreg);
+void pddby_traffreg_release(pddby_traffreg_t* traffreg);
+// same as pddby_traffreg_release
 void pddby_traffreg_free(pddby_traffreg_t* traffreg);
 
 int pddby_traffreg_save(pddby_traffreg_t* traffreg);
@@ -38,6 +50,10 @@ pddby_traffregs_t* pddby_traffregs_new(pddby_t* pddby);
 pddby_traffregs_t* pddby_traffregs_find_by_question(pddby_t* pddby, int64_t question_id);
 void pddby_traffregs_free(pddby_traffregs_t* traffregs);
 
+// traffregs and their images in the order they are shown, found in one go; image data is only read on request
+pddby_traffregs_with_images_t* pddby_traffregs_with_images_find_by_question(pddby_t* pddby, int64_t question_id);
+void pddby_traffregs_with_images_free(pddby_traffregs_with_images_t* traffregs);
+
 #ifdef __cplusplus
 }
 #endif